@@ -378,6 +378,12 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         min=0.0, max=1.0,
         default=0.01,
     )
+    use_light_tree: BoolProperty(
+        name="Light Tree",
+        description="Sample lights based on their estimated contribution to the shading point, "
+        "reducing noise in scenes with many lights (not used when sampling all lights)",
+        default=False,
+    )
 
     use_adaptive_sampling: BoolProperty(
         name="Use Adaptive Sampling",
@@ -663,6 +669,16 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         description="Use BVH spatial splits: longer builder time, faster render",
         default=False,
     )
+    debug_use_two_level_bvh: BoolProperty(
+        name="Use Two-Level BVH",
+        description="Keep a BVH per object data in final renders and only rebuild the BVH over the objects when they move: faster to update animations with persistent data, slower render",
+        default=False,
+    )
+    debug_use_bvh_cache: BoolProperty(
+        name="Cache BVH",
+        description="Store BVHs built for final renders on disk and reuse them when rendering the same geometry again, only used without Embree",
+        default=False,
+    )
     debug_use_hair_bvh: BoolProperty(
         name="Use Hair BVH",
         description="Use special type BVH optimized for hair (uses more ram but renders faster)",
@@ -781,6 +797,19 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         items=enum_texture_limit
     )
 
+    use_texture_cache: BoolProperty(
+        name="Texture Cache",
+        description="Read image textures on demand, only loading the tiles and mipmap levels "
+        "that are used instead of the full images (CPU only)",
+        default=False,
+    )
+    texture_cache_size: IntProperty(
+        name="Cache Size",
+        description="Maximum memory used by the texture cache, in megabytes",
+        default=4096,
+        min=64, soft_max=65536,
+    )
+
     ao_bounces: IntProperty(
         name="AO Bounces",
         default=0,
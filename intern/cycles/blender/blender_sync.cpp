@@ -39,6 +39,7 @@
 #include "util/util_hash.h"
 #include "util/util_opengl.h"
 #include "util/util_openimagedenoise.h"
+#include "util/util_path.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -294,6 +295,7 @@ void BlenderSync::sync_integrator()
   integrator->sample_all_lights_direct = get_boolean(cscene, "sample_all_lights_direct");
   integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
   integrator->light_sampling_threshold = get_float(cscene, "light_sampling_threshold");
+  integrator->use_light_tree = get_boolean(cscene, "use_light_tree");
 
   if (RNA_boolean_get(&cscene, "use_adaptive_sampling")) {
     integrator->sampling_pattern = SAMPLING_PATTERN_PMJ;
@@ -346,6 +348,15 @@ void BlenderSync::sync_integrator()
     integrator->ao_bounces = 0;
   }
 
+  /* Light tree is built by the light manager, depending on the sampling method. */
+  if (integrator->use_light_tree != previntegrator.use_light_tree ||
+      (integrator->use_light_tree &&
+       (integrator->method != previntegrator.method ||
+        integrator->sample_all_lights_direct != previntegrator.sample_all_lights_direct ||
+        integrator->sample_all_lights_indirect != previntegrator.sample_all_lights_indirect))) {
+    scene->light_manager->tag_update(scene);
+  }
+
   if (integrator->modified(previntegrator))
     integrator->tag_update(scene);
 }
@@ -721,7 +732,9 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
   else if (shadingsystem == 1)
     params.shadingsystem = SHADINGSYSTEM_OSL;
 
-  if (background || DebugFlags().viewport_static_bvh)
+  if (background && get_boolean(cscene, "debug_use_two_level_bvh"))
+    params.bvh_type = SceneParams::BVH_TWO_LEVEL;
+  else if (background || DebugFlags().viewport_static_bvh)
     params.bvh_type = SceneParams::BVH_STATIC;
   else
     params.bvh_type = SceneParams::BVH_DYNAMIC;
@@ -730,6 +743,11 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
   params.use_bvh_unaligned_nodes = RNA_boolean_get(&cscene, "debug_use_hair_bvh");
   params.num_bvh_time_steps = RNA_int_get(&cscene, "debug_bvh_time_steps");
 
+  /* Only final renders, where the same geometry is likely rendered again. The cache directory
+   * follows XDG_CACHE_HOME, which render farms can point to shared storage. */
+  if (background && get_boolean(cscene, "debug_use_bvh_cache"))
+    params.bvh_cache_path = path_cache_get("bvh");
+
   PointerRNA csscene = RNA_pointer_get(&b_scene.ptr, "cycles_curves");
   params.hair_subdivisions = get_int(csscene, "subdivisions");
   params.hair_shape = (CurveShapeType)get_enum(
@@ -754,6 +772,10 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
     params.texture_limit = 0;
   }
 
+  if (get_boolean(cscene, "use_texture_cache")) {
+    params.texture_cache_size = get_int(cscene, "texture_cache_size");
+  }
+
   params.bvh_layout = DebugFlags().cpu.bvh_layout;
 
   params.background = background;
@@ -23,6 +23,7 @@
 
 #include "bvh/bvh2.h"
 #include "bvh/bvh_build.h"
+#include "bvh/bvh_cache.h"
 #include "bvh/bvh_embree.h"
 #include "bvh/bvh_node.h"
 #include "bvh/bvh_optix.h"
@@ -30,6 +31,7 @@
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_progress.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -127,6 +129,16 @@ BVH *BVH::create(const BVHParams &params,
 
 void BVH::build(Progress &progress, Stats *)
 {
+  /* Reuse a BVH built for the same geometry earlier, by this or another render. */
+  string cache_key;
+  if (!params.cache_path.empty()) {
+    progress.set_substatus("Reading BVH from cache");
+    cache_key = bvh_cache_key(params, geometry, objects);
+    if (bvh_cache_read(params.cache_path, cache_key, pack)) {
+      return;
+    }
+  }
+
   progress.set_substatus("Building BVH");
 
   /* build nodes */
@@ -175,6 +187,11 @@ void BVH::build(Progress &progress, Stats *)
 
   /* free build nodes */
   root->deleteSubtree();
+
+  if (!cache_key.empty() && !progress.get_cancel()) {
+    progress.set_substatus("Writing BVH to cache");
+    bvh_cache_write(params.cache_path, cache_key, pack);
+  }
 }
 
 /* Refitting */
@@ -343,10 +360,7 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
   size_t prim_index_size = pack.prim_index.size();
   size_t prim_tri_verts_size = pack.prim_tri_verts.size();
 
-  size_t pack_prim_index_offset = prim_index_size;
   size_t pack_prim_tri_verts_offset = prim_tri_verts_size;
-  size_t pack_nodes_offset = nodes_size;
-  size_t pack_leaf_nodes_offset = leaf_nodes_size;
   size_t object_offset = 0;
 
   foreach (Geometry *geom, geometry) {
@@ -384,9 +398,18 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
   int4 *pack_leaf_nodes = (pack.leaf_nodes.size()) ? &pack.leaf_nodes[0] : NULL;
   float2 *pack_prim_time = (pack.prim_time.size()) ? &pack.prim_time[0] : NULL;
 
+  /* Offsets of the data of every geometry BVH in the merged arrays. */
+  struct InstanceOffsets {
+    BVH *bvh;
+    int geom_prim_offset;
+    size_t prim_index_offset;
+    size_t prim_tri_verts_offset;
+    size_t nodes_offset;
+    size_t leaf_nodes_offset;
+  };
+  vector<InstanceOffsets> instances;
   map<Geometry *, int> geometry_map;
 
-  /* merge */
   foreach (Object *ob, objects) {
     Geometry *geom = ob->geometry;
 
@@ -412,7 +435,6 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
     int noffset = nodes_offset;
     int noffset_leaf = nodes_leaf_offset;
-    int geom_prim_offset = geom->prim_offset;
 
     /* fill in node indexes for instances */
     if (bvh->pack.root_index == -1)
@@ -422,6 +444,34 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
     geometry_map[geom] = pack.object_node[object_offset - 1];
 
+    InstanceOffsets instance;
+    instance.bvh = bvh;
+    instance.geom_prim_offset = geom->prim_offset;
+    instance.prim_index_offset = prim_offset;
+    instance.prim_tri_verts_offset = pack_prim_tri_verts_offset;
+    instance.nodes_offset = nodes_offset;
+    instance.leaf_nodes_offset = nodes_leaf_offset;
+    instances.push_back(instance);
+
+    nodes_offset += bvh->pack.nodes.size();
+    nodes_leaf_offset += bvh->pack.leaf_nodes.size();
+    prim_offset += bvh->pack.prim_index.size();
+    pack_prim_tri_verts_offset += bvh->pack.prim_tri_verts.size();
+  }
+
+  /* Merge, every geometry BVH writes its own range of the arrays. With a two level BVH this is
+   * all that remains to be done for geometry that did not change. */
+  parallel_for(size_t(0), instances.size(), [&](size_t instance_index) {
+    const InstanceOffsets &instance = instances[instance_index];
+    BVH *bvh = instance.bvh;
+
+    const int noffset = instance.nodes_offset;
+    const int noffset_leaf = instance.leaf_nodes_offset;
+    const int geom_prim_offset = instance.geom_prim_offset;
+    size_t pack_prim_index_offset = instance.prim_index_offset;
+    size_t pack_nodes_offset = instance.nodes_offset;
+    size_t pack_leaf_nodes_offset = instance.leaf_nodes_offset;
+
     /* merge primitive, object and triangle indexes */
     if (bvh->pack.prim_index.size()) {
       size_t bvh_prim_index_size = bvh->pack.prim_index.size();
@@ -439,7 +489,7 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
         else {
           pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + geom_prim_offset;
           pack_prim_tri_index[pack_prim_index_offset] = bvh_prim_tri_index[i] +
-                                                        pack_prim_tri_verts_offset;
+                                                        instance.prim_tri_verts_offset;
         }
 
         pack_prim_type[pack_prim_index_offset] = bvh_prim_type[i];
@@ -455,10 +505,9 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
     /* Merge triangle vertices data. */
     if (bvh->pack.prim_tri_verts.size()) {
       const size_t prim_tri_size = bvh->pack.prim_tri_verts.size();
-      memcpy(pack_prim_tri_verts + pack_prim_tri_verts_offset,
+      memcpy(pack_prim_tri_verts + instance.prim_tri_verts_offset,
              &bvh->pack.prim_tri_verts[0],
              prim_tri_size * sizeof(float4));
-      pack_prim_tri_verts_offset += prim_tri_size;
     }
 
     /* merge nodes */
@@ -467,8 +516,8 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
       size_t leaf_nodes_offset_size = bvh->pack.leaf_nodes.size();
       for (size_t i = 0, j = 0; i < leaf_nodes_offset_size; i += BVH_NODE_LEAF_SIZE, j++) {
         int4 data = leaf_nodes_offset[i];
-        data.x += prim_offset;
-        data.y += prim_offset;
+        data.x += instance.prim_index_offset;
+        data.y += instance.prim_index_offset;
         pack_leaf_nodes[pack_leaf_nodes_offset] = data;
         for (int j = 1; j < BVH_NODE_LEAF_SIZE; ++j) {
           pack_leaf_nodes[pack_leaf_nodes_offset + j] = leaf_nodes_offset[i + j];
@@ -511,11 +560,7 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
         i += nsize;
       }
     }
-
-    nodes_offset += bvh->pack.nodes.size();
-    nodes_leaf_offset += bvh->pack.leaf_nodes.size();
-    prim_offset += bvh->pack.prim_index.size();
-  }
+  });
 }
 
 CCL_NAMESPACE_END
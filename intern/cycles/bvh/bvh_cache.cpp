@@ -0,0 +1,347 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "bvh/bvh_cache.h"
+
+#include "bvh/bvh.h"
+#include "bvh/bvh_params.h"
+
+#include "render/hair.h"
+#include "render/mesh.h"
+#include "render/object.h"
+#include "render/scene.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_foreach.h"
+#include "util/util_logging.h"
+#include "util/util_md5.h"
+#include "util/util_path.h"
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Bump when the packed layout or anything the build depends on changes, so files written by
+ * older versions are not used anymore. */
+#define BVH_CACHE_VERSION 1
+#define BVH_CACHE_MAGIC 0x48564243 /* "CBVH" */
+/* Total size of the files in the cache directory, the least recently used ones are removed
+ * beyond it. Every frame of an animation writes a new top level BVH. */
+#define BVH_CACHE_MAX_SIZE (4ULL * 1024 * 1024 * 1024)
+
+namespace {
+
+struct BVHCacheHeader {
+  uint magic;
+  uint version;
+  int root_index;
+  uint64_t nodes_size;
+  uint64_t leaf_nodes_size;
+  uint64_t object_node_size;
+  uint64_t prim_tri_index_size;
+  uint64_t prim_tri_verts_size;
+  uint64_t prim_type_size;
+  uint64_t prim_visibility_size;
+  uint64_t prim_index_size;
+  uint64_t prim_object_size;
+  uint64_t prim_time_size;
+};
+
+/* MD5Hash::append() takes an int size, so hash big arrays in pieces. */
+void hash_data(MD5Hash &md5, const void *data, size_t size)
+{
+  const size_t chunk_size = 1 << 30;
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (size > 0) {
+    const size_t n = min(size, chunk_size);
+    md5.append(bytes, (int)n);
+    bytes += n;
+    size -= n;
+  }
+}
+
+template<typename T> void hash_value(MD5Hash &md5, const T &value)
+{
+  hash_data(md5, &value, sizeof(value));
+}
+
+template<typename T> void hash_array(MD5Hash &md5, const array<T> &data)
+{
+  hash_value(md5, (uint64_t)data.size());
+  hash_data(md5, data.data(), data.size() * sizeof(T));
+}
+
+/* The fourth component of float3 is padding that is not always zero, only hash x, y and z. */
+void hash_float3(MD5Hash &md5, const float3 *data, size_t size)
+{
+  const size_t block_size = 4096;
+  float block[block_size * 3];
+
+  hash_value(md5, (uint64_t)size);
+  for (size_t start = 0; start < size; start += block_size) {
+    const size_t n = min(size - start, block_size);
+    for (size_t i = 0; i < n; i++) {
+      block[i * 3 + 0] = data[start + i].x;
+      block[i * 3 + 1] = data[start + i].y;
+      block[i * 3 + 2] = data[start + i].z;
+    }
+    hash_data(md5, block, n * 3 * sizeof(float));
+  }
+}
+
+void hash_motion_attribute(MD5Hash &md5, const Geometry *geom)
+{
+  const Attribute *attr = geom->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+  const bool has_attr = (attr != NULL);
+  hash_value(md5, has_attr);
+  if (has_attr) {
+    hash_float3(md5, attr->data_float3(), attr->buffer.size() / sizeof(float3));
+  }
+}
+
+uint64_t cache_file_size(const BVHCacheHeader &header)
+{
+  return sizeof(header) + header.nodes_size * sizeof(int4) +
+         header.leaf_nodes_size * sizeof(int4) + header.object_node_size * sizeof(int) +
+         header.prim_tri_index_size * sizeof(uint) + header.prim_tri_verts_size * sizeof(float4) +
+         header.prim_type_size * sizeof(int) + header.prim_visibility_size * sizeof(uint) +
+         header.prim_index_size * sizeof(int) + header.prim_object_size * sizeof(int) +
+         header.prim_time_size * sizeof(float2);
+}
+
+string cache_filepath(const string &directory, const string &key)
+{
+  return path_join(directory, key + ".bvh");
+}
+
+template<typename T> bool read_array(FILE *f, array<T> &data, uint64_t size)
+{
+  data.resize(size);
+  if (size == 0) {
+    return true;
+  }
+  if (data.data() == NULL) {
+    return false;
+  }
+  return fread(data.data(), sizeof(T), size, f) == size;
+}
+
+template<typename T> bool write_array(FILE *f, const array<T> &data)
+{
+  if (data.size() == 0) {
+    return true;
+  }
+  return fwrite(data.data(), sizeof(T), data.size(), f) == data.size();
+}
+
+}  // namespace
+
+string bvh_cache_key(const BVHParams &params,
+                     const vector<Geometry *> &geometry,
+                     const vector<Object *> &objects)
+{
+  MD5Hash md5;
+
+  hash_value(md5, (uint)BVH_CACHE_VERSION);
+
+  /* Parameters, one by one since the class is not tightly packed. */
+  hash_value(md5, params.use_spatial_split);
+  hash_value(md5, params.spatial_split_alpha);
+  hash_value(md5, params.unaligned_split_threshold);
+  hash_value(md5, params.sah_node_cost);
+  hash_value(md5, params.sah_primitive_cost);
+  hash_value(md5, params.min_leaf_size);
+  hash_value(md5, params.max_triangle_leaf_size);
+  hash_value(md5, params.max_motion_triangle_leaf_size);
+  hash_value(md5, params.max_curve_leaf_size);
+  hash_value(md5, params.max_motion_curve_leaf_size);
+  hash_value(md5, params.top_level);
+  hash_value(md5, params.bvh_layout);
+  hash_value(md5, params.use_unaligned_nodes);
+  hash_value(md5, params.num_motion_curve_steps);
+  hash_value(md5, params.num_motion_triangle_steps);
+  hash_value(md5, params.bvh_type);
+  hash_value(md5, params.curve_subdivisions);
+
+  /* Geometry, including what decides whether it is instanced or built into the top level. */
+  hash_value(md5, (uint64_t)geometry.size());
+  foreach (const Geometry *geom, geometry) {
+    hash_value(md5, geom->type);
+    hash_value(md5, geom->transform_applied);
+    hash_value(md5, geom->has_surface_bssrdf);
+    hash_value(md5, geom->need_build_bvh(params.bvh_layout));
+    /* Primitive offsets are only packed into the top level BVH, they change whenever other
+     * geometry in the scene is added or removed. */
+    if (params.top_level) {
+      hash_value(md5, (uint64_t)geom->prim_offset);
+    }
+    hash_value(md5, geom->motion_steps);
+    hash_value(md5, geom->use_motion_blur);
+
+    if (geom->type == Geometry::MESH) {
+      const Mesh *mesh = static_cast<const Mesh *>(geom);
+      hash_float3(md5, mesh->verts.data(), mesh->verts.size());
+      hash_array(md5, mesh->triangles);
+    }
+    else if (geom->type == Geometry::HAIR) {
+      const Hair *hair = static_cast<const Hair *>(geom);
+      hash_float3(md5, hair->curve_keys.data(), hair->curve_keys.size());
+      hash_array(md5, hair->curve_radius);
+      hash_array(md5, hair->curve_first_key);
+      hash_value(md5, hair->curve_shape);
+    }
+
+    hash_motion_attribute(md5, geom);
+  }
+
+  /* Objects, with the geometry referenced by index since pointers differ between sessions. */
+  hash_value(md5, (uint64_t)objects.size());
+  foreach (const Object *ob, objects) {
+    const vector<Geometry *>::const_iterator it = std::find(
+        geometry.begin(), geometry.end(), ob->geometry);
+    hash_value(md5, (int64_t)((it != geometry.end()) ? it - geometry.begin() : -1));
+    /* Transforms only end up in the top level BVH, or in the geometry when they are applied.
+     * Leaving them out otherwise lets moved objects share the BVH of their geometry. */
+    const bool use_transform = params.top_level || params.bvh_type == SceneParams::BVH_STATIC ||
+                               (ob->geometry && ob->geometry->transform_applied);
+    hash_value(md5, use_transform);
+    if (use_transform) {
+      hash_value(md5, ob->tfm);
+      hash_value(md5, (uint64_t)ob->motion.size());
+      hash_data(md5, ob->motion.data(), ob->motion.size() * sizeof(Transform));
+      hash_float3(md5, &ob->bounds.min, 1);
+      hash_float3(md5, &ob->bounds.max, 1);
+    }
+    hash_value(md5, ob->visibility_for_tracing());
+    hash_value(md5, ob->is_traceable());
+  }
+
+  return md5.get_hex();
+}
+
+bool bvh_cache_read(const string &directory, const string &key, PackedBVH &pack)
+{
+  const string filepath = cache_filepath(directory, key);
+  FILE *f = path_fopen(filepath, "rb");
+  if (!f) {
+    return false;
+  }
+
+  BVHCacheHeader header;
+  bool ok = (fread(&header, sizeof(header), 1, f) == 1) && header.magic == BVH_CACHE_MAGIC &&
+            header.version == BVH_CACHE_VERSION;
+
+  /* Check sizes against the file before allocating anything. */
+  ok = ok && (cache_file_size(header) == path_file_size(filepath));
+
+  ok = ok && read_array(f, pack.nodes, header.nodes_size);
+  ok = ok && read_array(f, pack.leaf_nodes, header.leaf_nodes_size);
+  ok = ok && read_array(f, pack.object_node, header.object_node_size);
+  ok = ok && read_array(f, pack.prim_tri_index, header.prim_tri_index_size);
+  ok = ok && read_array(f, pack.prim_tri_verts, header.prim_tri_verts_size);
+  ok = ok && read_array(f, pack.prim_type, header.prim_type_size);
+  ok = ok && read_array(f, pack.prim_visibility, header.prim_visibility_size);
+  ok = ok && read_array(f, pack.prim_index, header.prim_index_size);
+  ok = ok && read_array(f, pack.prim_object, header.prim_object_size);
+  ok = ok && read_array(f, pack.prim_time, header.prim_time_size);
+
+  fclose(f);
+
+  if (!ok) {
+    /* Truncated or from another version, build again and overwrite it. */
+    VLOG(1) << "Ignoring invalid BVH cache file " << filepath << ".";
+    pack = PackedBVH();
+    return false;
+  }
+
+  pack.root_index = header.root_index;
+
+  /* Mark as recently used, so it is the last to be removed when the cache is full. */
+  path_touch(filepath);
+
+  VLOG(1) << "Read BVH from cache file " << filepath << ".";
+  return true;
+}
+
+bool bvh_cache_write(const string &directory, const string &key, const PackedBVH &pack)
+{
+  const string filepath = cache_filepath(directory, key);
+
+  BVHCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = BVH_CACHE_MAGIC;
+  header.version = BVH_CACHE_VERSION;
+  header.root_index = pack.root_index;
+  header.nodes_size = pack.nodes.size();
+  header.leaf_nodes_size = pack.leaf_nodes.size();
+  header.object_node_size = pack.object_node.size();
+  header.prim_tri_index_size = pack.prim_tri_index.size();
+  header.prim_tri_verts_size = pack.prim_tri_verts.size();
+  header.prim_type_size = pack.prim_type.size();
+  header.prim_visibility_size = pack.prim_visibility.size();
+  header.prim_index_size = pack.prim_index.size();
+  header.prim_object_size = pack.prim_object.size();
+  header.prim_time_size = pack.prim_time.size();
+
+  if (cache_file_size(header) > BVH_CACHE_MAX_SIZE) {
+    VLOG(1) << "Not writing BVH cache file " << filepath << ", it exceeds the cache size.";
+    return false;
+  }
+
+  /* Write to a unique file first and move it in place, so other renders reading the same
+   * directory never see a partially written file. */
+  const string tmp_filepath = filepath + string_printf(".%llx.%p.tmp",
+                                                       (unsigned long long)(time_dt() * 1e6),
+                                                       (const void *)&pack);
+  path_create_directories(tmp_filepath);
+
+  FILE *f = path_fopen(tmp_filepath, "wb");
+  if (!f) {
+    VLOG(1) << "Failed to create BVH cache file " << tmp_filepath << ".";
+    return false;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  ok = ok && write_array(f, pack.nodes);
+  ok = ok && write_array(f, pack.leaf_nodes);
+  ok = ok && write_array(f, pack.object_node);
+  ok = ok && write_array(f, pack.prim_tri_index);
+  ok = ok && write_array(f, pack.prim_tri_verts);
+  ok = ok && write_array(f, pack.prim_type);
+  ok = ok && write_array(f, pack.prim_visibility);
+  ok = ok && write_array(f, pack.prim_index);
+  ok = ok && write_array(f, pack.prim_object);
+  ok = ok && write_array(f, pack.prim_time);
+  ok = (fclose(f) == 0) && ok;
+
+  /* On Windows renaming fails when the file exists, in which case another render already
+   * wrote the same BVH. */
+  if (!ok || rename(tmp_filepath.c_str(), filepath.c_str()) != 0) {
+    path_remove(tmp_filepath);
+    if (!ok) {
+      VLOG(1) << "Failed to write BVH cache file " << tmp_filepath << ".";
+    }
+    return false;
+  }
+
+  VLOG(1) << "Wrote BVH to cache file " << filepath << ".";
+
+  path_cache_limit_size(directory, ".bvh", BVH_CACHE_MAX_SIZE);
+  return true;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BVH_CACHE_H__
+#define __BVH_CACHE_H__
+
+#include "util/util_string.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class BVHParams;
+class Geometry;
+class Object;
+struct PackedBVH;
+
+/* BVH Cache
+ *
+ * Packed BVH2 trees stored on disk, so renders of the same geometry can skip
+ * building them. Files are named after a hash of the build parameters and of
+ * all the geometry and object data the build reads, so any change results in
+ * a different file instead of invalidating an existing one. The least recently
+ * used files are removed when the cache grows beyond its size limit. */
+
+string bvh_cache_key(const BVHParams &params,
+                     const vector<Geometry *> &geometry,
+                     const vector<Object *> &objects);
+
+bool bvh_cache_read(const string &directory, const string &key, PackedBVH &pack);
+bool bvh_cache_write(const string &directory, const string &key, const PackedBVH &pack);
+
+CCL_NAMESPACE_END
+
+#endif /* __BVH_CACHE_H__ */
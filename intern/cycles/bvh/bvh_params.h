@@ -19,6 +19,7 @@
 #define __BVH_PARAMS_H__
 
 #include "util/util_boundbox.h"
+#include "util/util_string.h"
 
 #include "kernel/kernel_types.h"
 
@@ -91,6 +92,9 @@ class BVHParams {
   /* These are needed for Embree. */
   int curve_subdivisions;
 
+  /* Directory to read and write built BVH2 trees, disabled when empty. */
+  string cache_path;
+
   /* fixed parameters */
   enum { MAX_DEPTH = 64, MAX_SPATIAL_DEPTH = 48, NUM_SPATIAL_BINS = 32 };
 
@@ -35,10 +35,165 @@ typedef struct LightSample {
   LightType type; /* type of light */
 } LightSample;
 
+/* Light Tree */
+
+/* Estimate of the contribution of the emitters in a node to a shading point, as the energy
+ * over the squared distance and the cosine of the smallest possible emission angle towards the
+ * point. The receiver orientation is not taken into account, so that the same probabilities are
+ * found from the ray origin when evaluating MIS for emitters that were hit. */
+ccl_device float light_tree_node_importance(KernelGlobals *kg, const float3 P, int node_index)
+{
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes,
+                                                                  node_index);
+  if (knode->energy == 0.0f) {
+    return 0.0f;
+  }
+
+  const float3 bounds_min = make_float3(
+      knode->bounds_min[0], knode->bounds_min[1], knode->bounds_min[2]);
+  const float3 bounds_max = make_float3(
+      knode->bounds_max[0], knode->bounds_max[1], knode->bounds_max[2]);
+  const float3 centroid = 0.5f * (bounds_min + bounds_max);
+  const float radius = 0.5f * len(bounds_max - bounds_min);
+
+  float distance;
+  const float3 D = safe_normalize_len(P - centroid, &distance);
+
+  float cos_theta_i = 1.0f;
+  if (knode->theta_o < M_PI_F && distance > radius) {
+    /* Angle between the emission directions and the shading point, minus the angle the bounds
+     * subtend as seen from the shading point. */
+    const float3 axis = make_float3(knode->axis[0], knode->axis[1], knode->axis[2]);
+    const float theta = safe_acosf(dot(axis, D));
+    const float theta_u = safe_asinf(radius / distance);
+    const float theta_i = theta - knode->theta_o - theta_u;
+
+    if (theta_i >= knode->theta_e) {
+      return 0.0f;
+    }
+    cos_theta_i = (theta_i > 0.0f) ? cosf(theta_i) : 1.0f;
+  }
+
+  /* Clamp the distance to the bounds, to avoid singularities close to the emitters. */
+  const float distance_squared = max(max(distance * distance, radius * radius), 1e-8f);
+  return knode->energy * cos_theta_i / distance_squared;
+}
+
+/* Pick an emitter from the light tree or one of the infinite lights, returning its index in the
+ * light distribution and the probability of picking it. randu is rescaled for reuse. */
+ccl_device int light_tree_sample(KernelGlobals *kg, const float3 P, float *randu, float *pdf)
+{
+  const float pdf_light_tree = kernel_data.integrator.pdf_light_tree;
+  const int num_nodes = kernel_data.integrator.num_light_tree_nodes;
+  const int num_infinite = kernel_data.integrator.num_light_tree_infinite;
+  float r = *randu;
+
+  if (r >= pdf_light_tree) {
+    /* Infinite lights, with equal probability. */
+    r = (r - pdf_light_tree) / (1.0f - pdf_light_tree);
+    const int light = min((int)(r * num_infinite), num_infinite - 1);
+    *randu = r * num_infinite - light;
+    *pdf = kernel_data.integrator.pdf_lights;
+    return kernel_tex_fetch(__light_tree_nodes, num_nodes + light).emitter;
+  }
+
+  r /= pdf_light_tree;
+  float node_pdf = pdf_light_tree;
+  int node_index = 0;
+
+  while (true) {
+    const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes,
+                                                                    node_index);
+    if (knode->emitter != -1) {
+      *randu = r;
+      *pdf = node_pdf;
+      return knode->emitter;
+    }
+
+    const int left = node_index + 1;
+    const int right = knode->second_child;
+    const float left_importance = light_tree_node_importance(kg, P, left);
+    const float right_importance = light_tree_node_importance(kg, P, right);
+    const float total_importance = left_importance + right_importance;
+
+    if (!(total_importance > 0.0f)) {
+      return -1;
+    }
+
+    const float left_probability = left_importance / total_importance;
+    if (r < left_probability) {
+      node_index = left;
+      r = r / left_probability;
+      node_pdf *= left_probability;
+    }
+    else {
+      node_index = right;
+      r = (r - left_probability) / (1.0f - left_probability);
+      node_pdf *= 1.0f - left_probability;
+    }
+  }
+}
+
+/* Probability of light_tree_sample() picking the emitter in the given leaf. */
+ccl_device float light_tree_pdf(KernelGlobals *kg, const float3 P, int node_index)
+{
+  float pdf = kernel_data.integrator.pdf_light_tree;
+  int parent = kernel_tex_fetch(__light_tree_nodes, node_index).parent;
+
+  while (parent != -1) {
+    const ccl_global KernelLightTreeNode *kparent = &kernel_tex_fetch(__light_tree_nodes,
+                                                                      parent);
+    const int left = parent + 1;
+    const int right = kparent->second_child;
+    const float left_importance = light_tree_node_importance(kg, P, left);
+    const float right_importance = light_tree_node_importance(kg, P, right);
+    const float total_importance = left_importance + right_importance;
+
+    if (!(total_importance > 0.0f)) {
+      return 0.0f;
+    }
+
+    pdf *= ((node_index == left) ? left_importance : right_importance) / total_importance;
+
+    node_index = parent;
+    parent = kparent->parent;
+  }
+
+  return pdf;
+}
+
+ccl_device float light_tree_triangle_pdf(KernelGlobals *kg, int object, int prim, const float3 P)
+{
+  const int table = kernel_tex_fetch(__light_tree_triangles, object * 2 + 0);
+  if (table == -1) {
+    return 0.0f;
+  }
+
+  const int prim_offset = kernel_tex_fetch(__light_tree_triangles, object * 2 + 1);
+  const int node_index = kernel_tex_fetch(__light_tree_triangles, table + prim - prim_offset);
+  return (node_index != -1) ? light_tree_pdf(kg, P, node_index) : 0.0f;
+}
+
 /* Regular Light */
 
-ccl_device_inline bool lamp_light_sample(
-    KernelGlobals *kg, int lamp, float randu, float randv, float3 P, LightSample *ls)
+/* Probability of picking the light, when not sampling all lights. */
+ccl_device_inline float lamp_light_pick_pdf(KernelGlobals *kg,
+                                            const ccl_global KernelLight *klight,
+                                            const float3 P)
+{
+  if (kernel_data.integrator.use_light_tree && klight->light_tree_node != -1) {
+    return light_tree_pdf(kg, P, klight->light_tree_node);
+  }
+  return kernel_data.integrator.pdf_lights;
+}
+
+ccl_device_inline bool lamp_light_sample(KernelGlobals *kg,
+                                         int lamp,
+                                         float randu,
+                                         float randv,
+                                         float3 P,
+                                         float pick_pdf,
+                                         LightSample *ls)
 {
   const ccl_global KernelLight *klight = &kernel_tex_fetch(__lights, lamp);
   LightType type = (LightType)klight->type;
@@ -153,7 +308,7 @@ ccl_device_inline bool lamp_light_sample(
     }
   }
 
-  ls->pdf *= kernel_data.integrator.pdf_lights;
+  ls->pdf *= pick_pdf;
 
   return (ls->pdf > 0.0f);
 }
@@ -291,7 +446,7 @@ ccl_device bool lamp_light_eval(
     return false;
   }
 
-  ls->pdf *= kernel_data.integrator.pdf_lights;
+  ls->pdf *= lamp_light_pick_pdf(kg, klight, P);
 
   return true;
 }
@@ -328,18 +483,30 @@ ccl_device_inline bool triangle_world_space_vertices(
   return has_motion;
 }
 
-ccl_device_inline float triangle_light_pdf_area(KernelGlobals *kg,
+/* Probability of picking the triangle from the light distribution, proportional to its area. */
+ccl_device_inline float triangle_light_distribution_pdf(
+    KernelGlobals *kg, int object, int prim, float area, bool has_motion)
+{
+  if (has_motion) {
+    /* get the center frame vertices, this is what the PDF was calculated from */
+    float3 V[3];
+    triangle_world_space_vertices(kg, object, prim, -1.0f, V);
+    area = triangle_area(V[0], V[1], V[2]);
+  }
+  return area * kernel_data.integrator.pdf_triangles;
+}
+
+ccl_device_inline float triangle_light_pdf_area(const float pdf_area,
                                                 const float3 Ng,
                                                 const float3 I,
                                                 float t)
 {
-  float pdf = kernel_data.integrator.pdf_triangles;
   float cos_pi = fabsf(dot(Ng, I));
 
   if (cos_pi == 0.0f)
     return 0.0f;
 
-  return t * t * pdf / cos_pi;
+  return t * t * pdf_area / cos_pi;
 }
 
 ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *sd, float t)
@@ -357,11 +524,17 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
   const float longest_edge_squared = max(len_squared(e0), max(len_squared(e1), len_squared(e2)));
   const float3 N = cross(e0, e1);
   const float distance_to_plane = fabsf(dot(N, sd->I * t)) / dot(N, N);
+  const float area = 0.5f * len(N);
+
+  /* sd contains the point on the light source
+   * calculate Px, the point that we're shading */
+  const float3 Px = sd->P + sd->I * t;
+  const float pick_pdf = (kernel_data.integrator.use_light_tree) ?
+                             light_tree_triangle_pdf(kg, sd->object, sd->prim, Px) :
+                             triangle_light_distribution_pdf(
+                                 kg, sd->object, sd->prim, area, has_motion);
 
   if (longest_edge_squared > distance_to_plane * distance_to_plane) {
-    /* sd contains the point on the light source
-     * calculate Px, the point that we're shading */
-    const float3 Px = sd->P + sd->I * t;
     const float3 v0_p = V[0] - Px;
     const float3 v1_p = V[1] - Px;
     const float3 v2_p = V[2] - Px;
@@ -375,39 +548,20 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
     const float gamma = fast_acosf(dot(u02, u12));
     const float solid_angle = alpha + beta + gamma - M_PI_F;
 
-    /* pdf_triangles is calculated over triangle area, but we're not sampling over its area */
+    /* pick_pdf is for the whole triangle, but we're not sampling over its area */
     if (UNLIKELY(solid_angle == 0.0f)) {
       return 0.0f;
     }
     else {
-      float area = 1.0f;
-      if (has_motion) {
-        /* get the center frame vertices, this is what the PDF was calculated from */
-        triangle_world_space_vertices(kg, sd->object, sd->prim, -1.0f, V);
-        area = triangle_area(V[0], V[1], V[2]);
-      }
-      else {
-        area = 0.5f * len(N);
-      }
-      const float pdf = area * kernel_data.integrator.pdf_triangles;
-      return pdf / solid_angle;
+      return pick_pdf / solid_angle;
     }
   }
   else {
-    float pdf = triangle_light_pdf_area(kg, sd->Ng, sd->I, t);
-    if (has_motion) {
-      const float area = 0.5f * len(N);
-      if (UNLIKELY(area == 0.0f)) {
-        return 0.0f;
-      }
-      /* scale the PDF.
-       * area = the area the sample was taken from
-       * area_pre = the are from which pdf_triangles was calculated from */
-      triangle_world_space_vertices(kg, sd->object, sd->prim, -1.0f, V);
-      const float area_pre = triangle_area(V[0], V[1], V[2]);
-      pdf = pdf * area_pre / area;
+    /* area = the area the sample was taken from */
+    if (UNLIKELY(area == 0.0f)) {
+      return 0.0f;
     }
-    return pdf;
+    return triangle_light_pdf_area(pick_pdf / area, sd->Ng, sd->I, t);
   }
 }
 
@@ -418,7 +572,8 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
                                                   float randv,
                                                   float time,
                                                   LightSample *ls,
-                                                  const float3 P)
+                                                  const float3 P,
+                                                  float tree_pdf)
 {
   /* A naive heuristic to decide between costly solid angle sampling
    * and simple area sampling, comparing the distance to the triangle plane
@@ -449,6 +604,11 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
   ls->shader |= SHADER_USE_MIS;
   ls->type = LIGHT_TRIANGLE;
 
+  /* Probability of having picked this triangle. */
+  const float pick_pdf = (kernel_data.integrator.use_light_tree) ?
+                             tree_pdf :
+                             triangle_light_distribution_pdf(kg, object, prim, area, has_motion);
+
   float distance_to_plane = fabsf(dot(N0, V[0] - P) / dot(N0, N0));
 
   if (longest_edge_squared > distance_to_plane * distance_to_plane) {
@@ -531,19 +691,13 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
 
     ls->P = P + ls->D * ls->t;
 
-    /* pdf_triangles is calculated over triangle area, but we're sampling over solid angle */
+    /* pick_pdf is for the whole triangle, but we're sampling over solid angle */
     if (UNLIKELY(solid_angle == 0.0f)) {
       ls->pdf = 0.0f;
       return;
     }
     else {
-      if (has_motion) {
-        /* get the center frame vertices, this is what the PDF was calculated from */
-        triangle_world_space_vertices(kg, object, prim, -1.0f, V);
-        area = triangle_area(V[0], V[1], V[2]);
-      }
-      const float pdf = area * kernel_data.integrator.pdf_triangles;
-      ls->pdf = pdf / solid_angle;
+      ls->pdf = pick_pdf / solid_angle;
     }
   }
   else {
@@ -564,15 +718,9 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
     ls->P = u * V[0] + v * V[1] + t * V[2];
     /* compute incoming direction, distance and pdf */
     ls->D = normalize_len(ls->P - P, &ls->t);
-    ls->pdf = triangle_light_pdf_area(kg, ls->Ng, -ls->D, ls->t);
-    if (has_motion && area != 0.0f) {
-      /* scale the PDF.
-       * area = the area the sample was taken from
-       * area_pre = the are from which pdf_triangles was calculated from */
-      triangle_world_space_vertices(kg, object, prim, -1.0f, V);
-      const float area_pre = triangle_area(V[0], V[1], V[2]);
-      ls->pdf = ls->pdf * area_pre / area;
-    }
+    /* area = the area the sample was taken from */
+    ls->pdf = (area != 0.0f) ? triangle_light_pdf_area(pick_pdf / area, ls->Ng, -ls->D, ls->t) :
+                               0.0f;
     ls->u = u;
     ls->v = v;
   }
@@ -632,9 +780,21 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
                                       int bounce,
                                       LightSample *ls)
 {
+  /* Probability of picking the light, when sampling a single one. */
+  float pick_pdf = kernel_data.integrator.pdf_lights;
+
   if (lamp < 0) {
     /* sample index */
-    int index = light_distribution_sample(kg, &randu);
+    int index;
+    if (kernel_data.integrator.use_light_tree) {
+      index = light_tree_sample(kg, P, &randu, &pick_pdf);
+      if (index == -1) {
+        return false;
+      }
+    }
+    else {
+      index = light_distribution_sample(kg, &randu);
+    }
 
     /* fetch light data */
     const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(
@@ -645,7 +805,7 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
       int object = kdistribution->mesh_light.object_id;
       int shader_flag = kdistribution->mesh_light.shader_flag;
 
-      triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
+      triangle_light_sample(kg, prim, object, randu, randv, time, ls, P, pick_pdf);
       ls->shader |= shader_flag;
       return (ls->pdf > 0.0f);
     }
@@ -657,7 +817,7 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
     return false;
   }
 
-  return lamp_light_sample(kg, lamp, randu, randv, P, ls);
+  return lamp_light_sample(kg, lamp, randu, randv, P, pick_pdf, ls);
 }
 
 ccl_device_inline int light_select_num_samples(KernelGlobals *kg, int index)
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_TEXTURE_CACHE_H__
+#define __KERNEL_TEXTURE_CACHE_H__
+
+#include "util/util_texture.h"
+#include "util/util_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture Cache
+ *
+ * On the CPU, image files can be read through an OIIO texture system instead of being fully
+ * loaded before rendering. Tiles of the mipmap level matching the ray differentials are paged
+ * in the first time they are used, within a fixed memory budget.
+ *
+ * The lookup is implemented by the image manager, which owns the texture system, so OIIO
+ * headers stay out of the kernels compiled for different instruction sets, like OSL. */
+
+/* Lookup with the differentials of the texture coordinate, in texture space. Writes RGBA. */
+void kernel_tex_image_interp_cache(
+    const TextureInfo &info, float x, float y, float2 dx, float2 dy, float result[4]);
+
+CCL_NAMESPACE_END
+
+#endif /* __KERNEL_TEXTURE_CACHE_H__ */
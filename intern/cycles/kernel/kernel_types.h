@@ -1389,6 +1389,12 @@ typedef struct KernelIntegrator {
 
   int max_closures;
 
+  /* light tree */
+  int use_light_tree;
+  int num_light_tree_nodes;
+  int num_light_tree_infinite;
+  float pdf_light_tree;
+
   int pad1, pad2;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
@@ -1521,7 +1527,7 @@ typedef struct KernelLight {
   float max_bounces;
   float random;
   float strength[3];
-  float pad1;
+  int light_tree_node;
   Transform tfm;
   Transform itfm;
   union {
@@ -1548,6 +1554,26 @@ typedef struct KernelLightDistribution {
 } KernelLightDistribution;
 static_assert_align(KernelLightDistribution, 16);
 
+/* Node of the light tree, with the bounds of the emitters below it in space and
+ * in emission direction. Nodes are stored depth first, so the first child of an
+ * inner node is the node right after it. */
+typedef struct KernelLightTreeNode {
+  float bounds_min[3];
+  float energy;
+  float bounds_max[3];
+  /* Spread of the normals around the axis. */
+  float theta_o;
+  float axis[3];
+  /* Spread of the emission around the normals. */
+  float theta_e;
+  int second_child;
+  /* Index in the light distribution for leaves, -1 for inner nodes. */
+  int emitter;
+  int parent;
+  int pad;
+} KernelLightTreeNode;
+static_assert_align(KernelLightTreeNode, 16);
+
 typedef struct KernelParticle {
   int index;
   float age;
@@ -17,6 +17,8 @@
 #ifndef __KERNEL_CPU_IMAGE_H__
 #define __KERNEL_CPU_IMAGE_H__
 
+#include "kernel/kernel_texture_cache.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* Make template functions private so symbols don't conflict between kernels with different
@@ -474,6 +476,13 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
 {
   const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
 
+  if (info.cache_image) {
+    float result[4];
+    kernel_tex_image_interp_cache(
+        info, x, y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f), result);
+    return make_float4(result[0], result[1], result[2], result[3]);
+  }
+
   switch (info.data_type) {
     case IMAGE_DATA_TYPE_HALF:
       return TextureInterpolator<half>::interp(info, x, y);
@@ -498,6 +507,22 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
   }
 }
 
+/* Lookup with the differentials of the texture coordinate, which pick the mipmap level of images
+ * in the texture cache. Other images have no mipmaps and ignore them. */
+ccl_device float4
+kernel_tex_image_interp_filtered(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy)
+{
+  const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
+
+  if (info.cache_image) {
+    float result[4];
+    kernel_tex_image_interp_cache(info, x, y, dx, dy, result);
+    return make_float4(result[0], result[1], result[2], result[3]);
+  }
+
+  return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(KernelGlobals *kg,
                                              int id,
                                              float3 P,
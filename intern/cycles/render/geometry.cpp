@@ -40,6 +40,7 @@
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_progress.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -60,6 +61,7 @@ Geometry::Geometry(const NodeType *node_type, const Type type)
 {
   need_update = true;
   need_update_rebuild = false;
+  need_update_packing = true;
 
   transform_applied = false;
   transform_negative_scaled = false;
@@ -73,6 +75,11 @@ Geometry::Geometry(const NodeType *node_type, const Type type)
   attr_map_offset = 0;
   optix_prim_offset = 0;
   prim_offset = 0;
+
+  attr_float_offset = 0;
+  attr_float2_offset = 0;
+  attr_float3_offset = 0;
+  attr_uchar4_offset = 0;
 }
 
 Geometry::~Geometry()
@@ -212,6 +219,7 @@ void Geometry::compute_bvh(
       bparams.num_motion_curve_steps = params->num_bvh_time_steps;
       bparams.bvh_type = params->bvh_type;
       bparams.curve_subdivisions = params->curve_subdivisions();
+      bparams.cache_path = params->bvh_cache_path;
 
       delete bvh;
       bvh = BVH::create(bparams, geometry, objects);
@@ -516,7 +524,8 @@ static void update_attribute_element_offset(Geometry *geom,
                                             Attribute *mattr,
                                             AttributePrimitive prim,
                                             TypeDesc &type,
-                                            AttributeDescriptor &desc)
+                                            AttributeDescriptor &desc,
+                                            bool copy_data)
 {
   if (mattr) {
     /* store element and type */
@@ -540,8 +549,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_uchar4_offset;
 
       assert(attr_uchar4.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_uchar4[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_uchar4[offset + k] = data[k];
+        }
       }
       attr_uchar4_offset += size;
     }
@@ -550,8 +561,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float_offset;
 
       assert(attr_float.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_float[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_float[offset + k] = data[k];
+        }
       }
       attr_float_offset += size;
     }
@@ -560,8 +573,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float2_offset;
 
       assert(attr_float2.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_float2[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_float2[offset + k] = data[k];
+        }
       }
       attr_float2_offset += size;
     }
@@ -570,8 +585,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float3_offset;
 
       assert(attr_float3.size() >= offset + size * 3);
-      for (size_t k = 0; k < size * 3; k++) {
-        attr_float3[offset + k] = (&tfm->x)[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size * 3; k++) {
+          attr_float3[offset + k] = (&tfm->x)[k];
+        }
       }
       attr_float3_offset += size * 3;
     }
@@ -580,8 +597,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float3_offset;
 
       assert(attr_float3.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_float3[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_float3[offset + k] = data[k];
+        }
       }
       attr_float3_offset += size;
     }
@@ -656,15 +675,30 @@ void GeometryManager::device_update_attributes(Device *device,
    * maps next */
 
   /* Pre-allocate attributes to avoid arrays re-allocation which would
-   * take 2x of overall attribute memory usage.
+   * take 2x of overall attribute memory usage. The start of every geometry
+   * in the arrays is stored, so it can be filled independently.
    */
   size_t attr_float_size = 0;
   size_t attr_float2_size = 0;
   size_t attr_float3_size = 0;
   size_t attr_uchar4_size = 0;
+  vector<bool> geom_copy_data(scene->geometry.size());
   for (size_t i = 0; i < scene->geometry.size(); i++) {
     Geometry *geom = scene->geometry[i];
     AttributeRequestSet &attributes = geom_attributes[i];
+
+    /* Data of geometry that is not modified and did not move in the arrays is kept, changes to
+     * the requested attributes tag the geometry through Shader::need_update_geometry. */
+    geom_copy_data[i] = geom->need_update || geom->attr_float_offset != attr_float_size ||
+                        geom->attr_float2_offset != attr_float2_size ||
+                        geom->attr_float3_offset != attr_float3_size ||
+                        geom->attr_uchar4_offset != attr_uchar4_size;
+
+    geom->attr_float_offset = attr_float_size;
+    geom->attr_float2_offset = attr_float2_size;
+    geom->attr_float3_offset = attr_float3_size;
+    geom->attr_uchar4_offset = attr_uchar4_size;
+
     foreach (AttributeRequest &req, attributes.requests) {
       Attribute *attr = geom->attributes.find(req);
 
@@ -691,20 +725,27 @@ void GeometryManager::device_update_attributes(Device *device,
     }
   }
 
+  /* Arrays that were freed or change size lose their contents. */
+  const bool copy_all_data = dscene->attributes_float.size() != attr_float_size ||
+                             dscene->attributes_float2.size() != attr_float2_size ||
+                             dscene->attributes_float3.size() != attr_float3_size ||
+                             dscene->attributes_uchar4.size() != attr_uchar4_size;
+
   dscene->attributes_float.alloc(attr_float_size);
   dscene->attributes_float2.alloc(attr_float2_size);
   dscene->attributes_float3.alloc(attr_float3_size);
   dscene->attributes_uchar4.alloc(attr_uchar4_size);
 
-  size_t attr_float_offset = 0;
-  size_t attr_float2_offset = 0;
-  size_t attr_float3_offset = 0;
-  size_t attr_uchar4_offset = 0;
-
-  /* Fill in attributes. */
-  for (size_t i = 0; i < scene->geometry.size(); i++) {
+  /* Fill in attributes, every geometry writes its own range of the arrays. */
+  parallel_for(size_t(0), scene->geometry.size(), [&](size_t i) {
     Geometry *geom = scene->geometry[i];
     AttributeRequestSet &attributes = geom_attributes[i];
+    const bool copy_data = copy_all_data || geom_copy_data[i];
+
+    size_t attr_float_offset = geom->attr_float_offset;
+    size_t attr_float2_offset = geom->attr_float2_offset;
+    size_t attr_float3_offset = geom->attr_float3_offset;
+    size_t attr_uchar4_offset = geom->attr_uchar4_offset;
 
     /* todo: we now store std and name attributes from requests even if
      * they actually refer to the same mesh attributes, optimize */
@@ -722,7 +763,8 @@ void GeometryManager::device_update_attributes(Device *device,
                                       attr,
                                       ATTR_PRIM_GEOMETRY,
                                       req.type,
-                                      req.desc);
+                                      req.desc,
+                                      copy_data);
 
       if (geom->type == Geometry::MESH) {
         Mesh *mesh = static_cast<Mesh *>(geom);
@@ -740,13 +782,14 @@ void GeometryManager::device_update_attributes(Device *device,
                                         subd_attr,
                                         ATTR_PRIM_SUBD,
                                         req.subd_type,
-                                        req.subd_desc);
+                                        req.subd_desc,
+                                        copy_data);
       }
-
-      if (progress.get_cancel())
-        return;
     }
-  }
+  });
+
+  if (progress.get_cancel())
+    return;
 
   /* create attribute lookup maps */
   if (scene->shader_manager->use_osl())
@@ -796,9 +839,21 @@ void GeometryManager::mesh_calc_offset(Scene *scene)
   size_t optix_prim_size = 0;
 
   foreach (Geometry *geom, scene->geometry) {
+    /* Packed data contains offsets into the global arrays, so geometry that moved is packed
+     * again even if it was not modified. */
+    if (geom->need_update) {
+      geom->need_update_packing = true;
+    }
+
     if (geom->type == Geometry::MESH) {
       Mesh *mesh = static_cast<Mesh *>(geom);
 
+      if (mesh->vert_offset != vert_size || mesh->prim_offset != tri_size ||
+          mesh->patch_offset != patch_size || mesh->face_offset != face_size ||
+          mesh->corner_offset != corner_size) {
+        mesh->need_update_packing = true;
+      }
+
       mesh->vert_offset = vert_size;
       mesh->prim_offset = tri_size;
 
@@ -815,6 +870,9 @@ void GeometryManager::mesh_calc_offset(Scene *scene)
 
         /* patch tables are stored in same array so include them in patch_size */
         if (mesh->patch_table) {
+          if (mesh->patch_table_offset != patch_size) {
+            mesh->need_update_packing = true;
+          }
           mesh->patch_table_offset = patch_size;
           patch_size += mesh->patch_table->total_size();
         }
@@ -829,6 +887,10 @@ void GeometryManager::mesh_calc_offset(Scene *scene)
     else if (geom->type == Geometry::HAIR) {
       Hair *hair = static_cast<Hair *>(geom);
 
+      if (hair->curvekey_offset != curve_key_size || hair->prim_offset != curve_size) {
+        hair->need_update_packing = true;
+      }
+
       hair->curvekey_offset = curve_key_size;
       hair->prim_offset = curve_size;
 
@@ -904,32 +966,41 @@ void GeometryManager::device_update_mesh(
     }
   }
 
-  /* Fill in all the arrays. */
+  /* Fill in all the arrays. Arrays that were freed or change size lose their contents, otherwise
+   * only geometry that was modified or moved is packed again. */
   if (tri_size != 0) {
     /* normals */
     progress.set_status("Updating Mesh", "Computing normals");
 
+    const bool copy_all_data = dscene->tri_shader.size() != tri_size ||
+                               dscene->tri_vnormal.size() != vert_size;
+
     uint *tri_shader = dscene->tri_shader.alloc(tri_size);
     float4 *vnormal = dscene->tri_vnormal.alloc(vert_size);
     uint4 *tri_vindex = dscene->tri_vindex.alloc(tri_size);
     uint *tri_patch = dscene->tri_patch.alloc(tri_size);
     float2 *tri_patch_uv = dscene->tri_patch_uv.alloc(vert_size);
 
-    foreach (Geometry *geom, scene->geometry) {
+    parallel_for(size_t(0), scene->geometry.size(), [&](size_t i) {
+      Geometry *geom = scene->geometry[i];
       if (geom->type == Geometry::MESH) {
         Mesh *mesh = static_cast<Mesh *>(geom);
-        mesh->pack_shaders(scene, &tri_shader[mesh->prim_offset]);
-        mesh->pack_normals(&vnormal[mesh->vert_offset]);
+        if (copy_all_data || mesh->need_update_packing) {
+          mesh->pack_shaders(scene, &tri_shader[mesh->prim_offset]);
+          mesh->pack_normals(&vnormal[mesh->vert_offset]);
+        }
+        /* The primitive index of every triangle changes when the scene BVH is built again. */
         mesh->pack_verts(tri_prim_index,
                          &tri_vindex[mesh->prim_offset],
                          &tri_patch[mesh->prim_offset],
                          &tri_patch_uv[mesh->vert_offset],
                          mesh->vert_offset,
                          mesh->prim_offset);
-        if (progress.get_cancel())
-          return;
       }
-    }
+    });
+
+    if (progress.get_cancel())
+      return;
 
     /* vertex coordinates */
     progress.set_status("Updating Mesh", "Copying Mesh to device");
@@ -944,20 +1015,25 @@ void GeometryManager::device_update_mesh(
   if (curve_size != 0) {
     progress.set_status("Updating Mesh", "Copying Strands to device");
 
+    const bool copy_all_data = dscene->curve_keys.size() != curve_key_size ||
+                               dscene->curves.size() != curve_size;
+
     float4 *curve_keys = dscene->curve_keys.alloc(curve_key_size);
     float4 *curves = dscene->curves.alloc(curve_size);
 
-    foreach (Geometry *geom, scene->geometry) {
-      if (geom->type == Geometry::HAIR) {
+    parallel_for(size_t(0), scene->geometry.size(), [&](size_t i) {
+      Geometry *geom = scene->geometry[i];
+      if (geom->type == Geometry::HAIR && (copy_all_data || geom->need_update_packing)) {
         Hair *hair = static_cast<Hair *>(geom);
         hair->pack_curves(scene,
                           &curve_keys[hair->curvekey_offset],
                           &curves[hair->prim_offset],
                           hair->curvekey_offset);
-        if (progress.get_cancel())
-          return;
       }
-    }
+    });
+
+    if (progress.get_cancel())
+      return;
 
     dscene->curve_keys.copy_to_device();
     dscene->curves.copy_to_device();
@@ -966,10 +1042,13 @@ void GeometryManager::device_update_mesh(
   if (patch_size != 0) {
     progress.set_status("Updating Mesh", "Copying Patches to device");
 
+    const bool copy_all_data = dscene->patches.size() != patch_size;
+
     uint *patch_data = dscene->patches.alloc(patch_size);
 
-    foreach (Geometry *geom, scene->geometry) {
-      if (geom->type == Geometry::MESH) {
+    parallel_for(size_t(0), scene->geometry.size(), [&](size_t i) {
+      Geometry *geom = scene->geometry[i];
+      if (geom->type == Geometry::MESH && (copy_all_data || geom->need_update_packing)) {
         Mesh *mesh = static_cast<Mesh *>(geom);
         mesh->pack_patches(&patch_data[mesh->patch_offset],
                            mesh->vert_offset,
@@ -980,11 +1059,11 @@ void GeometryManager::device_update_mesh(
           mesh->patch_table->copy_adjusting_offsets(&patch_data[mesh->patch_table_offset],
                                                     mesh->patch_table_offset);
         }
-
-        if (progress.get_cancel())
-          return;
       }
-    }
+    });
+
+    if (progress.get_cancel())
+      return;
 
     dscene->patches.copy_to_device();
   }
@@ -1026,6 +1105,7 @@ void GeometryManager::device_update_bvh(Device *device,
   bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
   bparams.bvh_type = scene->params.bvh_type;
   bparams.curve_subdivisions = scene->params.curve_subdivisions();
+  bparams.cache_path = scene->params.bvh_cache_path;
 
   VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout) << " layout.";
 
@@ -1306,7 +1386,7 @@ void GeometryManager::device_update(Device *device,
   }
 
   /* Device update. */
-  device_free(device, dscene);
+  device_free_bvh(device, dscene);
 
   mesh_calc_offset(scene);
   if (true_displacement_used) {
@@ -1345,7 +1425,7 @@ void GeometryManager::device_update(Device *device,
 
   /* Device re-update after displacement. */
   if (displacement_done) {
-    device_free(device, dscene);
+    device_free_bvh(device, dscene);
 
     device_update_attributes(device, dscene, scene, progress);
     if (progress.get_cancel())
@@ -1393,6 +1473,10 @@ void GeometryManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
+  foreach (Geometry *geom, scene->geometry) {
+    geom->need_update_packing = false;
+  }
+
   need_update = false;
 
   if (true_displacement_used) {
@@ -1406,7 +1490,7 @@ void GeometryManager::device_update(Device *device,
   }
 }
 
-void GeometryManager::device_free(Device *device, DeviceScene *dscene)
+void GeometryManager::device_free_bvh(Device *, DeviceScene *dscene)
 {
 #ifdef WITH_EMBREE
   if (dscene->data.bvh.scene) {
@@ -1426,6 +1510,15 @@ void GeometryManager::device_free(Device *device, DeviceScene *dscene)
   dscene->prim_index.free();
   dscene->prim_object.free();
   dscene->prim_time.free();
+
+  /* Signal for shaders like displacement not to do ray tracing. */
+  dscene->data.bvh.bvh_layout = BVH_LAYOUT_NONE;
+}
+
+void GeometryManager::device_free(Device *device, DeviceScene *dscene)
+{
+  device_free_bvh(device, dscene);
+
   dscene->tri_shader.free();
   dscene->tri_vnormal.free();
   dscene->tri_vindex.free();
@@ -1440,9 +1533,6 @@ void GeometryManager::device_free(Device *device, DeviceScene *dscene)
   dscene->attributes_float3.free();
   dscene->attributes_uchar4.free();
 
-  /* Signal for shaders like displacement not to do ray tracing. */
-  dscene->data.bvh.bvh_layout = BVH_LAYOUT_NONE;
-
 #ifdef WITH_OSL
   OSLGlobals *og = (OSLGlobals *)device->osl_memory();
 
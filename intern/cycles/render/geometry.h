@@ -81,6 +81,12 @@ class Geometry : public Node {
   size_t prim_offset;
   size_t optix_prim_offset;
 
+  /* Start of the attribute data in the device arrays, see device_update_attributes(). */
+  size_t attr_float_offset;
+  size_t attr_float2_offset;
+  size_t attr_float3_offset;
+  size_t attr_uchar4_offset;
+
   /* Shader Properties */
   bool has_volume;         /* Set in the device_update_flags(). */
   bool has_surface_bssrdf; /* Set in the device_update_flags(). */
@@ -88,6 +94,9 @@ class Geometry : public Node {
   /* Update Flags */
   bool need_update;
   bool need_update_rebuild;
+  /* Modified or moved in the packed device arrays, so it needs to be packed again. Unlike
+   * need_update, this is only cleared once the packing after the BVH build finished. */
+  bool need_update_packing;
 
   /* Constructor/Destructor */
   explicit Geometry(const NodeType *node_type, const Type type);
@@ -177,7 +186,7 @@ class GeometryManager {
                              Scene *scene,
                              vector<AttributeRequestSet> &geom_attributes);
 
-  /* Compute verts/triangles/curves offsets in global arrays. */
+  /* Compute verts/triangles/curves offsets in global arrays, and tag geometry that moved. */
   void mesh_calc_offset(Scene *scene);
 
   void device_update_object(Device *device, DeviceScene *dscene, Scene *scene, Progress &progress);
@@ -195,6 +204,10 @@ class GeometryManager {
 
   void device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress &progress);
 
+  /* Free the BVH, but keep the packed geometry and attributes, so only geometry that was
+   * modified or moved needs to be packed again. */
+  void device_free_bvh(Device *device, DeviceScene *dscene);
+
   void device_update_displacement_images(Device *device, Scene *scene, Progress &progress);
 
   void device_update_volume_images(Device *device, Scene *scene, Progress &progress);
@@ -17,6 +17,7 @@
 #include "render/graph.h"
 #include "render/attribute.h"
 #include "render/constant_fold.h"
+#include "render/image.h"
 #include "render/nodes.h"
 #include "render/scene.h"
 #include "render/shader.h"
@@ -383,6 +384,10 @@ void ShaderGraph::finalize(Scene *scene, bool do_bump, bool do_simplify, bool bu
     if (do_bump)
       bump_from_displacement(bump_in_object_space);
 
+    /* After bump from displacement, so the copies it makes keep their own differentials. */
+    if (scene->image_manager->use_texture_cache() && !scene->shader_manager->use_osl())
+      refine_image_differentials(scene);
+
     ShaderInput *surface_in = output()->input("Surface");
     ShaderInput *volume_in = output()->input("Volume");
 
@@ -953,6 +958,58 @@ void ShaderGraph::refine_bump_nodes()
   }
 }
 
+void ShaderGraph::refine_image_differentials(Scene *scene)
+{
+  /* Images in the texture cache are mipmapped, and the level is picked from the differentials
+   * of the texture coordinate. Like for bump nodes, we copy the sub-graph defined from the
+   * "Vector" input twice, evaluated at positions shifted by the ray differentials, and connect
+   * them to the hidden "VectorDX" and "VectorDY" inputs. */
+
+  foreach (ShaderNode *node, nodes) {
+    if (node->type != ImageTextureNode::node_type) {
+      continue;
+    }
+
+    /* Box projection picks the image axes from the normal, and nodes that are already
+     * evaluated at shifted positions sample without differentials. */
+    ImageTextureNode *image_node = static_cast<ImageTextureNode *>(node);
+    ShaderInput *vector_in = node->input("Vector");
+    if (image_node->projection == NODE_IMAGE_PROJ_BOX || !vector_in->link ||
+        !(node->bump == SHADER_BUMP_NONE || node->bump == SHADER_BUMP_CENTER)) {
+      continue;
+    }
+
+    /* Images loaded in full are sampled without differentials, skip the extra evaluations. */
+    image_node->ensure_handle(scene, this);
+    if (!image_node->handle.use_texture_cache()) {
+      continue;
+    }
+
+    ShaderNodeSet nodes_vector;
+    ShaderNodeMap nodes_dx;
+    ShaderNodeMap nodes_dy;
+
+    find_dependencies(nodes_vector, vector_in);
+
+    copy_nodes(nodes_vector, nodes_dx);
+    copy_nodes(nodes_vector, nodes_dy);
+
+    foreach (NodePair &pair, nodes_dx)
+      pair.second->bump = SHADER_BUMP_DX;
+    foreach (NodePair &pair, nodes_dy)
+      pair.second->bump = SHADER_BUMP_DY;
+
+    ShaderOutput *out = vector_in->link;
+    connect(nodes_dx[out->parent]->output(out->name()), node->input("VectorDX"));
+    connect(nodes_dy[out->parent]->output(out->name()), node->input("VectorDY"));
+
+    foreach (NodePair &pair, nodes_dx)
+      add(pair.second);
+    foreach (NodePair &pair, nodes_dy)
+      add(pair.second);
+  }
+}
+
 void ShaderGraph::bump_from_displacement(bool use_object_space)
 {
   /* generate bump mapping automatically from displacement. bump mapping is
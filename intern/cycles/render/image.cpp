@@ -16,6 +16,7 @@
 
 #include "render/image.h"
 #include "device/device.h"
+#include "kernel/kernel_texture_cache.h"
 #include "render/colorspace.h"
 #include "render/image_oiio.h"
 #include "render/scene.h"
@@ -82,6 +83,40 @@ const char *name_from_type(ImageDataType type)
 
 }  // namespace
 
+/* Texture Cache */
+
+struct TextureCacheImage {
+  OIIO::TextureSystem *texture_system;
+  OIIO::TextureSystem::TextureHandle *handle;
+
+  OIIO::TextureOpt::Wrap wrap;
+  OIIO::TextureOpt::InterpMode interpolation;
+  OIIO::TextureOpt::MipMode mipmode;
+};
+
+void kernel_tex_image_interp_cache(
+    const TextureInfo &info, float x, float y, float2 dx, float2 dy, float result[4])
+{
+  const TextureCacheImage *image = (const TextureCacheImage *)info.cache_image;
+
+  OIIO::TextureOpt options;
+  options.swrap = image->wrap;
+  options.twrap = image->wrap;
+  options.interpmode = image->interpolation;
+  options.mipmode = image->mipmode;
+  /* Opaque alpha for images without alpha channel, gray images are already expanded to RGB. */
+  options.fill = 1.0f;
+
+  /* Image files have their origin at the top. The per-thread data is looked up by OIIO. */
+  if (!image->texture_system->texture(
+          image->handle, NULL, options, x, 1.0f - y, dx.x, -dx.y, dy.x, -dy.y, 4, result)) {
+    result[0] = TEX_IMAGE_MISSING_R;
+    result[1] = TEX_IMAGE_MISSING_G;
+    result[2] = TEX_IMAGE_MISSING_B;
+    result[3] = TEX_IMAGE_MISSING_A;
+  }
+}
+
 /* Image Handle */
 
 ImageHandle::ImageHandle() : manager(NULL)
@@ -146,6 +181,17 @@ ImageMetaData ImageHandle::metadata()
   return img->metadata;
 }
 
+bool ImageHandle::use_texture_cache()
+{
+  if (tile_slots.empty()) {
+    return false;
+  }
+
+  ImageManager::Image *img = manager->images[tile_slots.front()];
+  manager->load_image_metadata(img);
+  return manager->texture_cache_supported(img);
+}
+
 int ImageHandle::svm_slot(const int tile_index) const
 {
   if (tile_index >= tile_slots.size()) {
@@ -268,12 +314,21 @@ ImageManager::ImageManager(const DeviceInfo &info)
 
   /* Set image limits */
   has_half_images = info.has_half_images;
+
+  /* The kernel reads cached images through OIIO, which only works on the CPU. */
+  has_texture_cache = (info.type == DEVICE_CPU);
+  texture_cache_size = 0;
+  texture_cache = NULL;
 }
 
 ImageManager::~ImageManager()
 {
   for (size_t slot = 0; slot < images.size(); slot++)
     assert(!images[slot]);
+
+  if (texture_cache) {
+    OIIO::TextureSystem::destroy(texture_cache);
+  }
 }
 
 void ImageManager::set_osl_texture_system(void *texture_system)
@@ -281,6 +336,17 @@ void ImageManager::set_osl_texture_system(void *texture_system)
   osl_texture_system = texture_system;
 }
 
+void ImageManager::set_texture_cache_size(int size_mb)
+{
+  texture_cache_size = size_mb;
+}
+
+bool ImageManager::use_texture_cache() const
+{
+  /* OSL has its own texture system for image files. */
+  return has_texture_cache && texture_cache_size > 0 && !osl_texture_system;
+}
+
 bool ImageManager::set_animation_frame_update(int frame)
 {
   if (frame != animation_frame) {
@@ -410,6 +476,7 @@ int ImageManager::add_image_slot(ImageLoader *loader,
   img->builtin = builtin;
   img->users = 1;
   img->mem = NULL;
+  img->cache_image = NULL;
 
   images[slot] = img;
 
@@ -608,6 +675,82 @@ bool ImageManager::file_load_image(Image *img, int texture_limit)
   return true;
 }
 
+bool ImageManager::texture_cache_supported(Image *img) const
+{
+  if (!use_texture_cache()) {
+    return false;
+  }
+
+  /* Only image files can be read on demand, other images are already in memory. */
+  if (img->builtin || img->loader->osl_filepath().empty()) {
+    return false;
+  }
+
+  /* The texture system returns pixels as stored in the file, with associated alpha. Images that
+   * need another color space conversion than from sRGB (done in the kernel), or that need
+   * alpha to be left alone are loaded in full. So are 3D images and grayscale with alpha. */
+  const ImageMetaData &metadata = img->metadata;
+  return !(metadata.depth > 1 || metadata.channels == 2 ||
+           (metadata.channels == 4 && !image_associate_alpha(img)) ||
+           !(metadata.colorspace == u_colorspace_raw || metadata.colorspace == u_colorspace_srgb));
+}
+
+bool ImageManager::texture_cache_load_image(Image *img)
+{
+  if (!texture_cache || !texture_cache_supported(img)) {
+    return false;
+  }
+
+  const ustring filepath = img->loader->osl_filepath();
+  OIIO::ImageSpec spec;
+  if (!texture_cache->get_imagespec(filepath, 0, spec)) {
+    VLOG(1) << "Texture cache can't read " << img->loader->name() << ", loading it in full: "
+            << texture_cache->geterror();
+    return false;
+  }
+
+  TextureCacheImage *cache_image = new TextureCacheImage();
+  cache_image->texture_system = texture_cache;
+  cache_image->handle = texture_cache->get_texture_handle(filepath);
+
+  switch (img->params.extension) {
+    case EXTENSION_EXTEND:
+      cache_image->wrap = OIIO::TextureOpt::WrapClamp;
+      break;
+    case EXTENSION_CLIP:
+      cache_image->wrap = OIIO::TextureOpt::WrapBlack;
+      break;
+    default:
+      cache_image->wrap = OIIO::TextureOpt::WrapPeriodic;
+      break;
+  }
+
+  switch (img->params.interpolation) {
+    case INTERPOLATION_CLOSEST:
+      /* Stay sharp, but still use a level matching the footprint to not page in the full
+       * resolution for distant lookups. */
+      cache_image->interpolation = OIIO::TextureOpt::InterpClosest;
+      cache_image->mipmode = OIIO::TextureOpt::MipModeOneLevel;
+      break;
+    case INTERPOLATION_CUBIC:
+    case INTERPOLATION_SMART:
+      cache_image->interpolation = OIIO::TextureOpt::InterpBicubic;
+      cache_image->mipmode = OIIO::TextureOpt::MipModeDefault;
+      break;
+    default:
+      cache_image->interpolation = OIIO::TextureOpt::InterpBilinear;
+      cache_image->mipmode = OIIO::TextureOpt::MipModeDefault;
+      break;
+  }
+
+  img->cache_image = cache_image;
+  img->mem->info.cache_image = (uint64_t)cache_image;
+
+  VLOG(1) << "Reading " << img->loader->name() << " through the texture cache.";
+
+  return true;
+}
+
 void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Progress *progress)
 {
   if (progress->get_cancel()) {
@@ -632,6 +775,10 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
     delete img->mem;
     img->mem = NULL;
   }
+  if (img->cache_image) {
+    delete img->cache_image;
+    img->cache_image = NULL;
+  }
 
   img->mem = new device_texture(
       device, img->mem_name.c_str(), slot, type, img->params.interpolation, img->params.extension);
@@ -639,7 +786,13 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
   img->mem->info.transform_3d = img->metadata.transform_3d;
 
   /* Create new texture. */
-  if (type == IMAGE_DATA_TYPE_FLOAT4) {
+  if (texture_cache_load_image(img)) {
+    /* Pixels are paged in by the texture cache, the device texture only holds a placeholder. */
+    thread_scoped_lock device_lock(device_mutex);
+    void *pixels = img->mem->alloc(1, 1);
+    memset(pixels, 0, img->mem->memory_size());
+  }
+  else if (type == IMAGE_DATA_TYPE_FLOAT4) {
     if (!file_load_image<TypeDesc::FLOAT, float>(img, texture_limit)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
@@ -750,6 +903,12 @@ void ImageManager::device_free_image(Device *, int slot)
 #endif
   }
 
+  if (img->cache_image) {
+    /* Tiles are read again if the image file changed. */
+    texture_cache->invalidate(img->loader->osl_filepath());
+    delete img->cache_image;
+  }
+
   if (img->mem) {
     thread_scoped_lock device_lock(device_mutex);
     delete img->mem;
@@ -766,6 +925,15 @@ void ImageManager::device_update(Device *device, Scene *scene, Progress &progres
     return;
   }
 
+  if (!texture_cache && use_texture_cache()) {
+    /* Kept for the lifetime of the image manager, so tiles stay cached between updates. */
+    texture_cache = OIIO::TextureSystem::create(false);
+    texture_cache->attribute("max_memory_MB", texture_cache_size);
+    texture_cache->attribute("automip", 1);
+    texture_cache->attribute("autotile", 64);
+    texture_cache->attribute("gray_to_rgb", 1);
+  }
+
   TaskPool pool;
   for (size_t slot = 0; slot < images.size(); slot++) {
     Image *img = images[slot];
@@ -836,10 +1004,34 @@ void ImageManager::device_free(Device *device)
 
 void ImageManager::collect_statistics(RenderStats *stats)
 {
+  TextureCacheStats &cache_stats = stats->image.texture_cache;
+
   foreach (const Image *image, images) {
+    if (image->cache_image) {
+      cache_stats.num_images++;
+      continue;
+    }
     stats->image.textures.add_entry(
         NamedSizeEntry(image->loader->name(), image->mem->memory_size()));
   }
+
+  if (texture_cache) {
+    long long memory_used = 0, bytes_read = 0;
+    long long lookups = 0, tile_lookups = 0, tile_misses = 0;
+    texture_cache->getattribute("stat:cache_memory_used", TypeDesc::INT64, &memory_used);
+    texture_cache->getattribute("stat:bytes_read", TypeDesc::INT64, &bytes_read);
+    texture_cache->getattribute("stat:texture_queries", TypeDesc::INT64, &lookups);
+    texture_cache->getattribute("stat:find_tile_calls", TypeDesc::INT64, &tile_lookups);
+    texture_cache->getattribute("stat:find_tile_cache_misses", TypeDesc::INT64, &tile_misses);
+
+    cache_stats.enabled = true;
+    cache_stats.memory_used = memory_used;
+    cache_stats.max_memory = (size_t)texture_cache_size * 1024 * 1024;
+    cache_stats.bytes_read = bytes_read;
+    cache_stats.lookups = lookups;
+    cache_stats.tile_lookups = tile_lookups;
+    cache_stats.tile_misses = tile_misses;
+  }
 }
 
 CCL_NAMESPACE_END
@@ -27,6 +27,8 @@
 #include "util/util_unique_ptr.h"
 #include "util/util_vector.h"
 
+#include <OpenImageIO/texture.h>
+
 CCL_NAMESPACE_BEGIN
 
 class Device;
@@ -39,6 +41,7 @@ class Progress;
 class RenderStats;
 class Scene;
 class ColorSpaceProcessor;
+struct TextureCacheImage;
 
 /* Image Parameters */
 class ImageParams {
@@ -146,6 +149,7 @@ class ImageHandle {
   int num_tiles();
 
   ImageMetaData metadata();
+  bool use_texture_cache();
   int svm_slot(const int tile_index = 0) const;
   device_texture *image_memory(const int tile_index = 0) const;
 
@@ -181,6 +185,11 @@ class ImageManager {
   void set_osl_texture_system(void *texture_system);
   bool set_animation_frame_update(int frame);
 
+  /* Read image files on demand through a texture cache with a fixed memory budget in
+   * megabytes, instead of fully loading them. Only supported on the CPU and with SVM. */
+  void set_texture_cache_size(int size_mb);
+  bool use_texture_cache() const;
+
   void collect_statistics(RenderStats *stats);
 
   bool need_update;
@@ -197,6 +206,7 @@ class ImageManager {
 
     string mem_name;
     device_texture *mem;
+    TextureCacheImage *cache_image;
 
     int users;
     thread_mutex mutex;
@@ -212,6 +222,10 @@ class ImageManager {
   vector<Image *> images;
   void *osl_texture_system;
 
+  bool has_texture_cache;
+  int texture_cache_size;
+  OIIO::TextureSystem *texture_cache;
+
   int add_image_slot(ImageLoader *loader, const ImageParams &params, const bool builtin);
   void add_image_user(int slot);
   void remove_image_user(int slot);
@@ -220,6 +234,8 @@ class ImageManager {
 
   template<TypeDesc::BASETYPE FileFormat, typename StorageType>
   bool file_load_image(Image *img, int texture_limit);
+  bool texture_cache_supported(Image *img) const;
+  bool texture_cache_load_image(Image *img);
 
   void device_load_image(Device *device, Scene *scene, int slot, Progress *progress);
   void device_free_image(Device *device, int slot);
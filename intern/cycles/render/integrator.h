@@ -74,6 +74,8 @@ class Integrator : public Node {
   bool sample_all_lights_direct;
   bool sample_all_lights_indirect;
   float light_sampling_threshold;
+  /* Pick lights by their estimated contribution instead of their area, when sampling one. */
+  bool use_light_tree;
 
   int adaptive_min_samples;
   float adaptive_threshold;
@@ -20,6 +20,7 @@
 #include "render/film.h"
 #include "render/graph.h"
 #include "render/integrator.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
 #include "render/object.h"
@@ -527,6 +528,227 @@ void LightManager::device_update_distribution(Device *,
   }
 }
 
+void LightManager::device_update_light_tree(Device *,
+                                            DeviceScene *dscene,
+                                            Scene *scene,
+                                            Progress &progress)
+{
+  KernelIntegrator *kintegrator = &dscene->data.integrator;
+  Integrator *integrator = scene->integrator;
+
+  kintegrator->use_light_tree = 0;
+  kintegrator->num_light_tree_nodes = 0;
+  kintegrator->num_light_tree_infinite = 0;
+  kintegrator->pdf_light_tree = 0.0f;
+
+  /* Sampling all lights relies on the flat distribution. */
+  const bool sample_all_lights = integrator->method == Integrator::BRANCHED_PATH &&
+                                 (integrator->sample_all_lights_direct ||
+                                  integrator->sample_all_lights_indirect);
+
+  if (!integrator->use_light_tree || sample_all_lights || !kintegrator->use_direct_light) {
+    return;
+  }
+
+  progress.set_status("Updating Lights", "Building light tree");
+
+  vector<LightTreeEmitter> emitters;
+  vector<int> infinite_lights;
+
+  /* Emissive triangles, in the same order as in the distribution. */
+  vector<int> triangle_emitters;
+  vector<int> object_tables(scene->objects.size() * 2, -1);
+  int num_table_entries = 0;
+  int offset = 0;
+
+  for (size_t object_index = 0; object_index < scene->objects.size(); object_index++) {
+    if (progress.get_cancel())
+      return;
+
+    Object *object = scene->objects[object_index];
+    if (!object_usable_as_light(object)) {
+      continue;
+    }
+
+    Mesh *mesh = static_cast<Mesh *>(object->geometry);
+    bool transform_applied = mesh->transform_applied;
+    Transform tfm = object->tfm;
+
+    /* Power of the emission shaders, unknown when it is not constant. */
+    vector<float> shader_power(mesh->used_shaders.size(), 1.0f);
+    for (size_t i = 0; i < mesh->used_shaders.size(); i++) {
+      float3 emission;
+      if (mesh->used_shaders[i]->is_constant_emission(&emission)) {
+        shader_power[i] = max(average(emission), 0.0f);
+      }
+    }
+
+    object_tables[object_index * 2 + 0] = num_table_entries;
+    object_tables[object_index * 2 + 1] = mesh->prim_offset;
+
+    size_t mesh_num_triangles = mesh->num_triangles();
+    for (size_t i = 0; i < mesh_num_triangles; i++) {
+      int shader_index = mesh->shader[i];
+      Shader *shader = (shader_index < mesh->used_shaders.size()) ?
+                           mesh->used_shaders[shader_index] :
+                           scene->default_surface;
+
+      triangle_emitters.push_back(-1);
+      num_table_entries++;
+
+      if (!(shader->use_mis && shader->has_surface_emission)) {
+        continue;
+      }
+
+      const int distribution_index = offset++;
+
+      Mesh::Triangle t = mesh->get_triangle(i);
+      if (!t.valid(&mesh->verts[0])) {
+        continue;
+      }
+      float3 p1 = mesh->verts[t.v[0]];
+      float3 p2 = mesh->verts[t.v[1]];
+      float3 p3 = mesh->verts[t.v[2]];
+
+      if (!transform_applied) {
+        p1 = transform_point(&tfm, p1);
+        p2 = transform_point(&tfm, p2);
+        p3 = transform_point(&tfm, p3);
+      }
+
+      /* Emission is two sided, so the normal orientation does not matter. */
+      float area;
+      float3 N = safe_normalize_len(cross(p2 - p1, p3 - p1), &area);
+      area *= 0.5f;
+
+      const float power = (shader_index < mesh->used_shaders.size()) ?
+                              shader_power[shader_index] :
+                              1.0f;
+
+      LightTreeEmitter emitter;
+      emitter.bounds = BoundBox::empty;
+      emitter.bounds.grow(p1);
+      emitter.bounds.grow(p2);
+      emitter.bounds.grow(p3);
+      emitter.orientation = LightTreeOrientation(N, M_PI_F, M_PI_2_F);
+      emitter.energy = M_2PI_F * area * power;
+      emitter.distribution_index = distribution_index;
+
+      triangle_emitters.back() = emitters.size();
+      emitters.push_back(emitter);
+    }
+  }
+
+  /* Lights, infinite ones are sampled separately from the tree. */
+  vector<int> light_emitters;
+  int light_index = 0;
+
+  foreach (Light *light, scene->lights) {
+    if (!light->is_enabled)
+      continue;
+
+    const int distribution_index = offset + light_index;
+    light_emitters.push_back(-1);
+    light_index++;
+
+    if (light->type == LIGHT_DISTANT || light->type == LIGHT_BACKGROUND) {
+      infinite_lights.push_back(distribution_index);
+      continue;
+    }
+
+    const float3 dir = safe_normalize(light->dir);
+
+    LightTreeEmitter emitter;
+    emitter.bounds = BoundBox::empty;
+    emitter.energy = max(average(light->strength), 0.0f);
+    emitter.distribution_index = distribution_index;
+
+    if (light->type == LIGHT_AREA) {
+      const float3 axisu = light->axisu * (light->sizeu * light->size) * 0.5f;
+      const float3 axisv = light->axisv * (light->sizev * light->size) * 0.5f;
+      emitter.bounds.grow(light->co - axisu - axisv);
+      emitter.bounds.grow(light->co - axisu + axisv);
+      emitter.bounds.grow(light->co + axisu - axisv);
+      emitter.bounds.grow(light->co + axisu + axisv);
+      emitter.orientation = LightTreeOrientation(dir, 0.0f, M_PI_2_F);
+      emitter.energy *= M_PI_4_F;
+    }
+    else {
+      const float3 radius = make_float3(light->size, light->size, light->size);
+      emitter.bounds.grow(light->co - radius);
+      emitter.bounds.grow(light->co + radius);
+      if (light->type == LIGHT_SPOT) {
+        emitter.orientation = LightTreeOrientation(
+            dir, 0.0f, min(light->spot_angle * 0.5f, M_PI_F));
+      }
+      else {
+        emitter.orientation = LightTreeOrientation(dir, M_PI_F, M_PI_2_F);
+      }
+    }
+
+    light_emitters.back() = emitters.size();
+    emitters.push_back(emitter);
+  }
+
+  const int num_emitters = emitters.size();
+  const int num_infinite = infinite_lights.size();
+
+  if (num_emitters == 0) {
+    /* Only infinite lights, nothing to gain from the tree. */
+    return;
+  }
+
+  LightTree tree(emitters);
+  const int num_nodes = tree.nodes.size();
+
+  VLOG(1) << "Light tree with " << num_emitters << " emitters, " << num_nodes << " nodes and "
+          << num_infinite << " infinite lights.";
+
+  /* Tree nodes, followed by a leaf for each infinite light. */
+  KernelLightTreeNode *nodes = dscene->light_tree_nodes.alloc(num_nodes + num_infinite);
+  memcpy(nodes, tree.nodes.data(), sizeof(KernelLightTreeNode) * num_nodes);
+
+  for (int i = 0; i < num_infinite; i++) {
+    KernelLightTreeNode &knode = nodes[num_nodes + i];
+    memset(&knode, 0, sizeof(knode));
+    knode.second_child = -1;
+    knode.emitter = infinite_lights[i];
+    knode.parent = -1;
+  }
+
+  /* Leaf of each triangle, looked up from the object and primitive for MIS. */
+  int *triangles = dscene->light_tree_triangles.alloc(object_tables.size() +
+                                                      triangle_emitters.size());
+  const int num_objects = scene->objects.size();
+  for (int i = 0; i < num_objects * 2; i += 2) {
+    triangles[i + 0] = (object_tables[i] == -1) ? -1 : object_tables[i] + num_objects * 2;
+    triangles[i + 1] = object_tables[i + 1];
+  }
+  for (size_t i = 0; i < triangle_emitters.size(); i++) {
+    const int emitter = triangle_emitters[i];
+    triangles[num_objects * 2 + i] = (emitter == -1) ? -1 : tree.emitter_nodes[emitter];
+  }
+
+  /* Leaf of each light, only set for the local lights. */
+  KernelLight *klights = dscene->lights.data();
+  for (size_t i = 0; i < light_emitters.size(); i++) {
+    const int emitter = light_emitters[i];
+    klights[i].light_tree_node = (emitter == -1) ? -1 : tree.emitter_nodes[emitter];
+  }
+
+  kintegrator->use_light_tree = 1;
+  kintegrator->num_light_tree_nodes = num_nodes;
+  kintegrator->num_light_tree_infinite = num_infinite;
+  /* Sample the tree and each infinite light with equal probability, pdf_lights is then the
+   * probability of picking one infinite light. */
+  kintegrator->pdf_light_tree = 1.0f / (num_infinite + 1);
+  kintegrator->pdf_lights = (num_infinite) ? kintegrator->pdf_light_tree : 0.0f;
+
+  dscene->light_tree_nodes.copy_to_device();
+  dscene->light_tree_triangles.copy_to_device();
+  dscene->lights.copy_to_device();
+}
+
 static void background_cdf(
     int start, int end, int res_x, int res_y, const vector<float3> *pixels, float2 *cond_cdf)
 {
@@ -893,6 +1115,7 @@ void LightManager::device_update_points(Device *, DeviceScene *dscene, Scene *sc
 
     klights[light_index].max_bounces = max_bounces;
     klights[light_index].random = random;
+    klights[light_index].light_tree_node = -1;
 
     klights[light_index].tfm = light->tfm;
     klights[light_index].itfm = transform_inverse(light->tfm);
@@ -934,6 +1157,7 @@ void LightManager::device_update_points(Device *, DeviceScene *dscene, Scene *sc
     klights[light_index].area.dir[0] = dir.x;
     klights[light_index].area.dir[1] = dir.y;
     klights[light_index].area.dir[2] = dir.z;
+    klights[light_index].light_tree_node = -1;
     klights[light_index].tfm = light->tfm;
     klights[light_index].itfm = transform_inverse(light->tfm);
 
@@ -972,6 +1196,10 @@ void LightManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
+  device_update_light_tree(device, dscene, scene, progress);
+  if (progress.get_cancel())
+    return;
+
   if (need_update_background) {
     device_update_background(device, dscene, scene, progress);
     if (progress.get_cancel())
@@ -994,6 +1222,8 @@ void LightManager::device_update(Device *device,
 void LightManager::device_free(Device *, DeviceScene *dscene, const bool free_background)
 {
   dscene->light_distribution.free();
+  dscene->light_tree_nodes.free();
+  dscene->light_tree_triangles.free();
   dscene->lights.free();
   if (free_background) {
     dscene->light_background_marginal_cdf.free();
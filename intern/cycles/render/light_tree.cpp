@@ -0,0 +1,284 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Number of bins per axis when looking for the best split. */
+#define LIGHT_TREE_NUM_BINS 12
+/* Split in the middle below this depth, to bound the recursion for unbalanced trees. */
+#define LIGHT_TREE_MAX_SPLIT_DEPTH 48
+
+/* Orientation */
+
+float LightTreeOrientation::measure() const
+{
+  const float theta_w = min(theta_o + theta_e, M_PI_F);
+  const float cos_theta_o = cosf(theta_o);
+  const float sin_theta_o = sinf(theta_o);
+
+  return M_2PI_F * (1.0f - cos_theta_o) +
+         M_PI_2_F * (2.0f * theta_w * sin_theta_o - cosf(theta_o - 2.0f * theta_w) -
+                     2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+LightTreeOrientation merge(const LightTreeOrientation &a_, const LightTreeOrientation &b_)
+{
+  const bool swap = (b_.theta_o > a_.theta_o);
+  const LightTreeOrientation &a = (swap) ? b_ : a_;
+  const LightTreeOrientation &b = (swap) ? a_ : b_;
+  const float theta_e = max(a.theta_e, b.theta_e);
+
+  /* Emitting in all directions already, common for triangles which emit on both sides. */
+  if (a.theta_o >= M_PI_F) {
+    return LightTreeOrientation(a.axis, M_PI_F, theta_e);
+  }
+
+  const float theta_d = safe_acosf(dot(a.axis, b.axis));
+  if (min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+    return LightTreeOrientation(a.axis, a.theta_o, theta_e);
+  }
+
+  const float theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+  if (theta_o >= M_PI_F) {
+    return LightTreeOrientation(a.axis, M_PI_F, theta_e);
+  }
+
+  /* Rotate the axis of a towards the axis of b, in the plane of both. */
+  const float3 ortho = b.axis - a.axis * dot(a.axis, b.axis);
+  if (len_squared(ortho) == 0.0f) {
+    return LightTreeOrientation(a.axis, M_PI_F, theta_e);
+  }
+
+  const float theta_r = theta_o - a.theta_o;
+  const float3 axis = a.axis * cosf(theta_r) + normalize(ortho) * sinf(theta_r);
+  return LightTreeOrientation(normalize(axis), theta_o, theta_e);
+}
+
+/* Split Bins */
+
+namespace {
+
+struct LightTreeBin {
+  BoundBox bounds;
+  LightTreeOrientation orientation;
+  float energy;
+  int count;
+
+  LightTreeBin() : bounds(BoundBox::empty), energy(0.0f), count(0)
+  {
+  }
+
+  void add(const BoundBox &other_bounds,
+           const LightTreeOrientation &other_orientation,
+           float other_energy,
+           int other_count)
+  {
+    if (other_count == 0) {
+      return;
+    }
+    bounds.grow(other_bounds);
+    orientation = (count) ? merge(orientation, other_orientation) : other_orientation;
+    energy += other_energy;
+    count += other_count;
+  }
+
+  void add(const LightTreeBin &other)
+  {
+    add(other.bounds, other.orientation, other.energy, other.count);
+  }
+
+  float cost() const
+  {
+    return energy * bounds.safe_area() * orientation.measure();
+  }
+};
+
+}  // namespace
+
+/* Light Tree */
+
+LightTree::LightTree(const vector<LightTreeEmitter> &emitters_) : emitters(emitters_)
+{
+  const int num_emitters = emitters.size();
+  emitter_nodes.resize(num_emitters, -1);
+  if (num_emitters == 0) {
+    return;
+  }
+
+  indices.resize(num_emitters);
+  centroids.resize(num_emitters);
+  for (int i = 0; i < num_emitters; i++) {
+    indices[i] = i;
+    centroids[i] = emitters[i].bounds.center();
+  }
+
+  nodes.reserve(num_emitters * 2 - 1);
+  recursive_build(0, num_emitters, -1, 0);
+
+  indices.clear();
+  centroids.clear();
+}
+
+int LightTree::recursive_build(int start, int end, int parent, int depth)
+{
+  BoundBox bounds = BoundBox::empty;
+  BoundBox centroid_bounds = BoundBox::empty;
+  LightTreeOrientation orientation = emitters[indices[start]].orientation;
+  float energy = 0.0f;
+
+  for (int i = start; i < end; i++) {
+    const LightTreeEmitter &emitter = emitters[indices[i]];
+    bounds.grow(emitter.bounds);
+    centroid_bounds.grow(centroids[indices[i]]);
+    if (i != start) {
+      orientation = merge(orientation, emitter.orientation);
+    }
+    energy += emitter.energy;
+  }
+
+  const int node_index = nodes.size();
+  nodes.push_back(KernelLightTreeNode());
+
+  KernelLightTreeNode &knode = nodes[node_index];
+  memset(&knode, 0, sizeof(knode));
+  knode.bounds_min[0] = bounds.min.x;
+  knode.bounds_min[1] = bounds.min.y;
+  knode.bounds_min[2] = bounds.min.z;
+  knode.bounds_max[0] = bounds.max.x;
+  knode.bounds_max[1] = bounds.max.y;
+  knode.bounds_max[2] = bounds.max.z;
+  knode.energy = energy;
+  knode.axis[0] = orientation.axis.x;
+  knode.axis[1] = orientation.axis.y;
+  knode.axis[2] = orientation.axis.z;
+  knode.theta_o = orientation.theta_o;
+  knode.theta_e = orientation.theta_e;
+  knode.parent = parent;
+  knode.second_child = -1;
+  knode.emitter = -1;
+
+  if (end - start == 1) {
+    knode.emitter = emitters[indices[start]].distribution_index;
+    emitter_nodes[indices[start]] = node_index;
+    return node_index;
+  }
+
+  int mid = -1;
+  if (depth < LIGHT_TREE_MAX_SPLIT_DEPTH) {
+    mid = split(start, end, centroid_bounds);
+  }
+  if (mid == -1) {
+    /* Coincident emitters or no useful split, split in the middle of the longest axis. */
+    const float3 extent = centroid_bounds.size();
+    const int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) :
+                                             ((extent.y > extent.z) ? 1 : 2);
+    mid = (start + end) / 2;
+    std::nth_element(indices.begin() + start,
+                     indices.begin() + mid,
+                     indices.begin() + end,
+                     [&](const int a, const int b) {
+                       return centroids[a][axis] < centroids[b][axis];
+                     });
+  }
+
+  recursive_build(start, mid, node_index, depth + 1);
+  const int second_child = recursive_build(mid, end, node_index, depth + 1);
+  /* Not using the reference from before, the nodes may have been reallocated. */
+  nodes[node_index].second_child = second_child;
+
+  return node_index;
+}
+
+int LightTree::split(int start, int end, const BoundBox &centroid_bounds)
+{
+  const float3 extent = centroid_bounds.size();
+  const float max_extent = max(extent.x, max(extent.y, extent.z));
+  if (!(max_extent > 0.0f)) {
+    return -1;
+  }
+
+  float best_cost = FLT_MAX;
+  int best_axis = -1;
+  int best_bin = -1;
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (!(extent[axis] > 0.0f)) {
+      continue;
+    }
+
+    const float inv_extent = LIGHT_TREE_NUM_BINS / extent[axis];
+    LightTreeBin bins[LIGHT_TREE_NUM_BINS];
+    for (int i = start; i < end; i++) {
+      const int index = indices[i];
+      const int bin = clamp(
+          (int)((centroids[index][axis] - centroid_bounds.min[axis]) * inv_extent),
+          0,
+          LIGHT_TREE_NUM_BINS - 1);
+      const LightTreeEmitter &emitter = emitters[index];
+      bins[bin].add(emitter.bounds, emitter.orientation, emitter.energy, 1);
+    }
+
+    /* Accumulate from the right, then sweep from the left. */
+    LightTreeBin right[LIGHT_TREE_NUM_BINS];
+    right[LIGHT_TREE_NUM_BINS - 1] = bins[LIGHT_TREE_NUM_BINS - 1];
+    for (int bin = LIGHT_TREE_NUM_BINS - 2; bin > 0; bin--) {
+      right[bin] = right[bin + 1];
+      right[bin].add(bins[bin]);
+    }
+
+    /* Prefer splitting along the longer axes. */
+    const float regularization = max_extent / extent[axis];
+
+    LightTreeBin left;
+    for (int bin = 1; bin < LIGHT_TREE_NUM_BINS; bin++) {
+      left.add(bins[bin - 1]);
+      if (left.count == 0 || right[bin].count == 0) {
+        continue;
+      }
+
+      const float cost = (left.cost() + right[bin].cost()) * regularization;
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = bin;
+      }
+    }
+  }
+
+  if (best_axis == -1) {
+    return -1;
+  }
+
+  const float inv_extent = LIGHT_TREE_NUM_BINS / extent[best_axis];
+  const float min = centroid_bounds.min[best_axis];
+  const vector<int>::iterator mid = std::partition(
+      indices.begin() + start, indices.begin() + end, [&](const int index) {
+        const int bin = clamp((int)((centroids[index][best_axis] - min) * inv_extent),
+                              0,
+                              LIGHT_TREE_NUM_BINS - 1);
+        return bin < best_bin;
+      });
+
+  const int mid_index = mid - indices.begin();
+  return (mid_index == start || mid_index == end) ? -1 : mid_index;
+}
+
+CCL_NAMESPACE_END
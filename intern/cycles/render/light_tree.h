@@ -0,0 +1,89 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Directions in which a light or group of lights emits: normals within theta_o of the axis,
+ * each emitting up to theta_e away from the normal. */
+
+struct LightTreeOrientation {
+  float3 axis;
+  float theta_o;
+  float theta_e;
+
+  LightTreeOrientation() : axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(0.0f), theta_e(0.0f)
+  {
+  }
+
+  LightTreeOrientation(const float3 &axis, float theta_o, float theta_e)
+      : axis(axis), theta_o(theta_o), theta_e(theta_e)
+  {
+  }
+
+  /* Solid angle like measure of the emission directions, used for the split cost. */
+  float measure() const;
+};
+
+LightTreeOrientation merge(const LightTreeOrientation &a, const LightTreeOrientation &b);
+
+/* Light or emissive triangle in the tree, with its estimated power. */
+
+struct LightTreeEmitter {
+  BoundBox bounds;
+  LightTreeOrientation orientation;
+  float energy;
+  /* Index of the emitter in the light distribution. */
+  int distribution_index;
+};
+
+/* Light Tree
+ *
+ * Binary tree over the emitters, with one emitter per leaf. To sample a light, the kernel
+ * descends from the root, picking children proportional to their importance as estimated from
+ * their bounds, orientation and energy, see "Importance Sampling of Many Lights with Adaptive
+ * Tree Splitting" by Estevez and Kulla. Inner nodes are split with the surface area orientation
+ * heuristic of the same paper. */
+
+class LightTree {
+ public:
+  explicit LightTree(const vector<LightTreeEmitter> &emitters);
+
+  /* Depth first, the root is the first node. */
+  vector<KernelLightTreeNode> nodes;
+  /* Leaf node of each emitter, in the order they were passed in. */
+  vector<int> emitter_nodes;
+
+ protected:
+  int recursive_build(int start, int end, int parent, int depth);
+  int split(int start, int end, const BoundBox &centroid_bounds);
+
+  const vector<LightTreeEmitter> &emitters;
+  vector<int> indices;
+  vector<float3> centroids;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
@@ -140,6 +140,7 @@ Mesh::Mesh() : Geometry(node_type, Geometry::MESH), subd_attributes(this, ATTR_P
   vert_offset = 0;
 
   patch_offset = 0;
+  patch_table_offset = 0;
   face_offset = 0;
   corner_offset = 0;
 
@@ -247,6 +247,10 @@ NODE_DEFINE(ImageTextureNode)
   SOCKET_FLOAT(projection_blend, "Projection Blend", 0.0f);
 
   SOCKET_IN_POINT(vector, "Vector", make_float3(0.0f, 0.0f, 0.0f), SocketType::LINK_TEXTURE_UV);
+  SOCKET_IN_POINT(
+      vector_dx, "VectorDX", make_float3(0.0f, 0.0f, 0.0f), SocketType::SVM_INTERNAL);
+  SOCKET_IN_POINT(
+      vector_dy, "VectorDY", make_float3(0.0f, 0.0f, 0.0f), SocketType::SVM_INTERNAL);
 
   SOCKET_OUT_COLOR(color, "Color");
   SOCKET_OUT_FLOAT(alpha, "Alpha");
@@ -355,17 +359,22 @@ void ImageTextureNode::attributes(Shader *shader, AttributeRequestSet *attribute
   ShaderNode::attributes(shader, attributes);
 }
 
+void ImageTextureNode::ensure_handle(Scene *scene, ShaderGraph *graph)
+{
+  if (handle.empty()) {
+    cull_tiles(scene, graph);
+    ImageManager *image_manager = scene->image_manager;
+    handle = image_manager->add_image(filename.string(), image_params(), tiles);
+  }
+}
+
 void ImageTextureNode::compile(SVMCompiler &compiler)
 {
   ShaderInput *vector_in = input("Vector");
   ShaderOutput *color_out = output("Color");
   ShaderOutput *alpha_out = output("Alpha");
 
-  if (handle.empty()) {
-    cull_tiles(compiler.scene, compiler.current_graph);
-    ImageManager *image_manager = compiler.scene->image_manager;
-    handle = image_manager->add_image(filename.string(), image_params(), tiles);
-  }
+  ensure_handle(compiler.scene, compiler.current_graph);
 
   /* All tiles have the same metadata. */
   const ImageMetaData metadata = handle.metadata();
@@ -388,6 +397,20 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
     }
   }
 
+  /* Texture coordinate shifted by the ray differentials, see
+   * ShaderGraph::refine_image_differentials(). */
+  ShaderInput *vector_dx_in = input("VectorDX");
+  ShaderInput *vector_dy_in = input("VectorDY");
+  const bool use_differentials = vector_dx_in->link && vector_dy_in->link;
+  int vector_dx_offset = SVM_STACK_INVALID;
+  int vector_dy_offset = SVM_STACK_INVALID;
+
+  if (use_differentials) {
+    flags |= NODE_IMAGE_DIFFERENTIALS;
+    vector_dx_offset = tex_mapping.compile_begin(compiler, vector_dx_in);
+    vector_dy_offset = tex_mapping.compile_begin(compiler, vector_dy_in);
+  }
+
   if (projection != NODE_IMAGE_PROJ_BOX) {
     /* If there only is one image (a very common case), we encode it as a negative value. */
     int num_nodes;
@@ -406,6 +429,10 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                                              flags),
                       projection);
 
+    if (use_differentials) {
+      compiler.add_node(vector_dx_offset, vector_dy_offset, 0, 0);
+    }
+
     if (num_nodes > 0) {
       for (int i = 0; i < num_nodes; i++) {
         int4 node;
@@ -434,6 +461,10 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                       __float_as_int(projection_blend));
   }
 
+  if (use_differentials) {
+    tex_mapping.compile_end(compiler, vector_dx_in, vector_dx_offset);
+    tex_mapping.compile_end(compiler, vector_dy_in, vector_dy_offset);
+  }
   tex_mapping.compile_end(compiler, vector_in, vector_offset);
 }
 
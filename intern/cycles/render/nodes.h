@@ -106,6 +106,8 @@ class ImageTextureNode : public ImageSlotTextureNode {
   }
 
   ImageParams image_params() const;
+  /* Add the image to the image manager, if not done yet. */
+  void ensure_handle(Scene *scene, ShaderGraph *graph);
 
   /* Parameters. */
   ustring filename;
@@ -116,7 +118,7 @@ class ImageTextureNode : public ImageSlotTextureNode {
   ExtensionType extension;
   float projection_blend;
   bool animated;
-  float3 vector;
+  float3 vector, vector_dx, vector_dy;
   ccl::vector<int> tiles;
 
  protected:
@@ -108,6 +108,8 @@ class DeviceScene {
   device_vector<KernelLight> lights;
   device_vector<float2> light_background_marginal_cdf;
   device_vector<float2> light_background_conditional_cdf;
+  device_vector<KernelLightTreeNode> light_tree_nodes;
+  device_vector<int> light_tree_triangles;
 
   /* particles */
   device_vector<KernelParticle> particles;
@@ -151,6 +153,14 @@ class SceneParams {
      * slower to build final BVH tree but gives best possible render speed.
      */
     BVH_STATIC = 1,
+    /* BVH tree is calculated per geometry, and only the tree over the object
+     * instances is built again on updates.
+     *
+     * Moving objects doesn't rebuild the BVH of their geometry, so this is
+     * faster to update animations with persistent data, but slower to render
+     * than a static BVH.
+     */
+    BVH_TWO_LEVEL = 2,
 
     BVH_NUM_TYPES,
   };
@@ -168,10 +178,14 @@ class SceneParams {
   bool use_bvh_spatial_split;
   bool use_bvh_unaligned_nodes;
   int num_bvh_time_steps;
+  /* Directory to cache built BVHs in, disabled when empty. */
+  string bvh_cache_path;
   int hair_subdivisions;
   CurveShapeType hair_shape;
   bool persistent_data;
   int texture_limit;
+  /* Memory budget of the texture cache in megabytes, 0 loads all images in full. */
+  int texture_cache_size;
 
   bool background;
 
@@ -187,6 +201,7 @@ class SceneParams {
     hair_shape = CURVE_RIBBON;
     persistent_data = false;
     texture_limit = 0;
+    texture_cache_size = 0;
     background = true;
   }
 
@@ -197,8 +212,10 @@ class SceneParams {
              use_bvh_spatial_split == params.use_bvh_spatial_split &&
              use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes &&
              num_bvh_time_steps == params.num_bvh_time_steps &&
+             bvh_cache_path == params.bvh_cache_path &&
              hair_subdivisions == params.hair_subdivisions && hair_shape == params.hair_shape &&
-             persistent_data == params.persistent_data && texture_limit == params.texture_limit);
+             persistent_data == params.persistent_data && texture_limit == params.texture_limit &&
+             texture_cache_size == params.texture_cache_size);
   }
 
   int curve_subdivisions()
@@ -485,6 +485,10 @@ void ShaderManager::update_shaders_used(Scene *scene)
   uint id = 0;
   foreach (Shader *shader, scene->shaders) {
     shader->used = false;
+    /* Shader ids are packed with the geometry, update it when they change. */
+    if (shader->id != id) {
+      shader->need_update_geometry = true;
+    }
     shader->id = id++;
   }
 
@@ -210,6 +210,45 @@ string MeshStats::full_report(int indent_level)
   return result;
 }
 
+/* Texture cache statistics. */
+
+TextureCacheStats::TextureCacheStats()
+    : enabled(false),
+      num_images(0),
+      memory_used(0),
+      max_memory(0),
+      bytes_read(0),
+      lookups(0),
+      tile_lookups(0),
+      tile_misses(0)
+{
+}
+
+string TextureCacheStats::full_report(int indent_level)
+{
+  const string indent(indent_level * kIndentNumSpaces, ' ');
+  const uint64_t tile_hits = tile_lookups - min(tile_misses, tile_lookups);
+  string result = "";
+  result += string_printf("%sImages: %d\n", indent.c_str(), num_images);
+  result += string_printf("%sMemory: %s of %s\n",
+                          indent.c_str(),
+                          string_human_readable_size(memory_used).c_str(),
+                          string_human_readable_size(max_memory).c_str());
+  result += string_printf("%sRead from disk: %s\n",
+                          indent.c_str(),
+                          string_human_readable_size(bytes_read).c_str());
+  result += string_printf(
+      "%sLookups: %s\n", indent.c_str(), string_human_readable_number(lookups).c_str());
+  result += string_printf("%sTile hits: %s (%3.2f%%)\n",
+                          indent.c_str(),
+                          string_human_readable_number(tile_hits).c_str(),
+                          (tile_lookups) ? 100.0 * tile_hits / tile_lookups : 0.0);
+  result += string_printf("%sTile misses: %s\n",
+                          indent.c_str(),
+                          string_human_readable_number(tile_misses).c_str());
+  return result;
+}
+
 /* Image statistics. */
 
 ImageStats::ImageStats()
@@ -221,6 +260,9 @@ string ImageStats::full_report(int indent_level)
   const string indent(indent_level * kIndentNumSpaces, ' ');
   string result = "";
   result += indent + "Textures:\n" + textures.full_report(indent_level + 1);
+  if (texture_cache.enabled) {
+    result += indent + "Texture Cache:\n" + texture_cache.full_report(indent_level + 1);
+  }
   return result;
 }
 
@@ -124,6 +124,33 @@ class MeshStats {
   NamedSizeStats geometry;
 };
 
+/* Statistics about the texture cache, which pages in image files on demand. */
+class TextureCacheStats {
+ public:
+  TextureCacheStats();
+
+  /* Generate full human-readable report. */
+  string full_report(int indent_level = 0);
+
+  bool enabled;
+
+  /* Number of images read through the cache. */
+  int num_images;
+
+  /* Memory used by tiles in the cache, and the budget it is kept under. */
+  size_t memory_used;
+  size_t max_memory;
+
+  /* Bytes read from image files, including tiles read again after being evicted. */
+  size_t bytes_read;
+
+  /* Number of texture lookups, and of tile lookups they did. Tiles that were not in the
+   * cache yet are counted as misses. */
+  uint64_t lookups;
+  uint64_t tile_lookups;
+  uint64_t tile_misses;
+};
+
 /* Statistics about images held in memory. */
 class ImageStats {
  public:
@@ -133,6 +160,7 @@ class ImageStats {
   string full_report(int indent_level = 0);
 
   NamedSizeStats textures;
+  TextureCacheStats texture_cache;
 };
 
 /* Render process statistics. */
@@ -15,6 +15,7 @@
  */
 
 #include "util/util_path.h"
+#include "util/util_algorithm.h"
 #include "util/util_md5.h"
 #include "util/util_string.h"
 
@@ -25,6 +26,7 @@
 OIIO_NAMESPACE_USING
 
 #include <stdio.h>
+#include <time.h>
 
 #include <sys/stat.h>
 
@@ -739,6 +741,15 @@ bool path_remove(const string &path)
   return remove(path.c_str()) == 0;
 }
 
+bool path_touch(const string &path)
+{
+  if (!path_exists(path)) {
+    return false;
+  }
+  Filesystem::last_write_time(path, time(NULL));
+  return true;
+}
+
 struct SourceReplaceState {
   typedef map<string, string> ProcessedMapping;
   /* Base director for all relative include headers. */
@@ -938,4 +949,53 @@ void path_cache_clear_except(const string &name, const set<string> &except)
   }
 }
 
+/* Remove the least recently modified files ending with suffix, until the total size of those
+ * in the directory fits in max_size. */
+void path_cache_limit_size(const string &dir, const string &suffix, uint64_t max_size)
+{
+  if (!path_exists(dir)) {
+    return;
+  }
+
+  struct CacheFile {
+    uint64_t modified_time;
+    uint64_t size;
+    string path;
+
+    bool operator<(const CacheFile &other) const
+    {
+      return modified_time < other.modified_time;
+    }
+  };
+
+  vector<CacheFile> files;
+  uint64_t total_size = 0;
+
+  directory_iterator it(dir), it_end;
+  for (; it != it_end; ++it) {
+    const string path = it->path();
+    const size_t size = path_file_size(path);
+    if (!string_endswith(path, suffix.c_str()) || size == (size_t)-1) {
+      continue;
+    }
+    CacheFile file;
+    file.modified_time = path_modified_time(path);
+    file.size = size;
+    file.path = path;
+    files.push_back(file);
+    total_size += file.size;
+  }
+
+  if (total_size <= max_size) {
+    return;
+  }
+
+  std::sort(files.begin(), files.end());
+  for (size_t i = 0; i < files.size() && total_size > max_size; i++) {
+    if (path_remove(files[i].path)) {
+      total_size -= files[i].size;
+    }
+  }
+}
+
 CCL_NAMESPACE_END
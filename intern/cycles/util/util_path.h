@@ -64,6 +64,7 @@ bool path_read_text(const string &path, string &text);
 
 /* File manipulation. */
 bool path_remove(const string &path);
+bool path_touch(const string &path);
 
 /* source code utility */
 string path_source_replace_includes(const string &source,
@@ -72,6 +73,7 @@ string path_source_replace_includes(const string &source,
 
 /* cache utility */
 void path_cache_clear_except(const string &name, const set<string> &except);
+void path_cache_limit_size(const string &dir, const string &suffix, uint64_t max_size);
 
 CCL_NAMESPACE_END
 
@@ -93,6 +93,8 @@ typedef enum ExtensionType {
 typedef struct TextureInfo {
   /* Pointer, offset or texture depending on device. */
   uint64_t data;
+  /* Image paged in by the texture cache on the CPU, data then only holds a placeholder. */
+  uint64_t cache_image;
   /* Data Type */
   uint data_type;
   /* Buffer number for OpenCL. */
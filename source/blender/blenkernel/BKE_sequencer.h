@@ -87,11 +87,17 @@ void BKE_sequence_iterator_end(SeqIterator *iter);
   } \
   ((void)0)
 
+/* Maximum number of frames rendered at the same time by prefetching. */
+#define SEQ_PREFETCH_WORKERS_MAX 8
+
 typedef enum eSeqTaskId {
   SEQ_TASK_MAIN_RENDER,
+  /* Each prefetch worker uses its own ID, starting with this one. */
   SEQ_TASK_PREFETCH_RENDER,
 } eSeqTaskId;
 
+#define SEQ_TASK_MAX (SEQ_TASK_PREFETCH_RENDER + SEQ_PREFETCH_WORKERS_MAX)
+
 typedef struct SeqRenderData {
   struct Main *bmain;
   struct Depsgraph *depsgraph;
@@ -362,6 +368,18 @@ void BKE_sequencer_cache_iterate(struct Scene *scene,
                                                     float cost));
 bool BKE_sequencer_cache_is_full(struct Scene *scene);
 
+typedef struct SeqCacheStats {
+  /** Images found in memory cache. */
+  size_t hits;
+  /** Images read from disk cache. */
+  size_t disk_hits;
+  size_t misses;
+  /** Recycled frames (all images linked to a frame are freed at once). */
+  size_t evictions;
+} SeqCacheStats;
+
+void BKE_sequencer_cache_stats_get(struct Scene *scene, SeqCacheStats *r_stats);
+
 /* **********************************************************************
  * seqprefetch.c
  *
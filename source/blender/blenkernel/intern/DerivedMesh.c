@@ -1757,6 +1757,84 @@ static void mesh_runtime_check_normals_valid(const Mesh *mesh)
   BLI_assert(!(mesh->runtime.cd_dirty_poly & CD_MASK_NORMAL));
 }
 
+/**
+ * Take the batch cache of the previous evaluated mesh, when the new one can only differ in its
+ * vertex positions and normals: the previous mesh was only deformed, and neither the input mesh
+ * nor the requested data layers changed since. Only the modifiers, or the objects they depend on
+ * (e.g. the armature), were updated.
+ *
+ * Render depsgraphs are skipped: render engines modify the batches of the evaluated mesh, e.g.
+ * EEVEE motion blur adds the vertex buffers of the other time steps to them, which must not
+ * outlive the frame they were added for.
+ *
+ * \return NULL when the cache can't be reused.
+ */
+static void *mesh_build_data_batch_cache_take(struct Depsgraph *depsgraph,
+                                              Object *ob,
+                                              const CustomData_MeshMasks *dataMask,
+                                              const bool need_mapping,
+                                              int r_topology_len[4])
+{
+  if (DEG_get_mode(depsgraph) == DAG_EVAL_RENDER) {
+    return NULL;
+  }
+
+  ID *data_orig = ob->runtime.data_orig;
+  ID *data_eval = ob->runtime.data_eval;
+  if (data_orig == NULL || data_eval == NULL || !ob->runtime.is_data_eval_owned ||
+      GS(data_orig->name) != ID_ME || GS(data_eval->name) != ID_ME) {
+    return NULL;
+  }
+
+  const Mesh *mesh_input = (const Mesh *)data_orig;
+  Mesh *mesh_prev = (Mesh *)data_eval;
+  if (mesh_prev->runtime.batch_cache == NULL || !mesh_prev->runtime.deformed_only ||
+      mesh_prev->runtime.wrapper_type != ME_WRAPPER_TYPE_MDATA ||
+      mesh_input->edit_mesh != NULL || (mesh_input->id.recalc & ID_RECALC_ALL) != 0) {
+    return NULL;
+  }
+  if (ob->runtime.last_need_mapping != need_mapping ||
+      !CustomData_MeshMasks_are_matching(&ob->runtime.last_data_mask, dataMask) ||
+      !CustomData_MeshMasks_are_matching(dataMask, &ob->runtime.last_data_mask)) {
+    return NULL;
+  }
+
+  r_topology_len[0] = mesh_prev->totvert;
+  r_topology_len[1] = mesh_prev->totedge;
+  r_topology_len[2] = mesh_prev->totloop;
+  r_topology_len[3] = mesh_prev->totpoly;
+
+  void *batch_cache = mesh_prev->runtime.batch_cache;
+  mesh_prev->runtime.batch_cache = NULL;
+  return batch_cache;
+}
+
+/**
+ * Give the batch cache taken from the previous evaluated mesh to the new one, tagging it so only
+ * the buffers depending on vertex positions are updated. When the modifier stack changed the
+ * topology after all, the cache is freed.
+ */
+static void mesh_build_data_batch_cache_give(Mesh *mesh_eval,
+                                             const bool is_mesh_eval_owned,
+                                             void *batch_cache,
+                                             const int topology_len[4])
+{
+  if (is_mesh_eval_owned && mesh_eval->runtime.batch_cache == NULL &&
+      mesh_eval->runtime.deformed_only &&
+      mesh_eval->runtime.wrapper_type == ME_WRAPPER_TYPE_MDATA &&
+      mesh_eval->totvert == topology_len[0] && mesh_eval->totedge == topology_len[1] &&
+      mesh_eval->totloop == topology_len[2] && mesh_eval->totpoly == topology_len[3]) {
+    mesh_eval->runtime.batch_cache = batch_cache;
+    mesh_eval->runtime.is_batch_cache_deform_update = true;
+  }
+  else {
+    /* Only the runtime of the mesh is used to free its batch cache. */
+    Mesh mesh_temp = {{NULL}};
+    mesh_temp.runtime.batch_cache = batch_cache;
+    BKE_mesh_batch_cache_free(&mesh_temp);
+  }
+}
+
 static void mesh_build_data(struct Depsgraph *depsgraph,
                             Scene *scene,
                             Object *ob,
@@ -1769,6 +1847,10 @@ static void mesh_build_data(struct Depsgraph *depsgraph,
    * they aren't cleaned up properly on mode switch, causing crashes, e.g T58150. */
   BLI_assert(ob->id.tag & LIB_TAG_COPIED_ON_WRITE);
 
+  int batch_cache_topology_len[4];
+  void *batch_cache = mesh_build_data_batch_cache_take(
+      depsgraph, ob, dataMask, need_mapping, batch_cache_topology_len);
+
   BKE_object_free_derived_caches(ob);
   if (DEG_is_active(depsgraph)) {
     BKE_sculpt_update_object_before_eval(ob);
@@ -1806,6 +1888,11 @@ static void mesh_build_data(struct Depsgraph *depsgraph,
   const bool is_mesh_eval_owned = (mesh_eval != mesh->runtime.mesh_eval);
   BKE_object_eval_assign_data(ob, &mesh_eval->id, is_mesh_eval_owned);
 
+  if (batch_cache != NULL) {
+    mesh_build_data_batch_cache_give(
+        mesh_eval, is_mesh_eval_owned, batch_cache, batch_cache_topology_len);
+  }
+
   ob->runtime.mesh_deform_eval = mesh_deform_eval;
   ob->runtime.last_data_mask = *dataMask;
   ob->runtime.last_need_mapping = need_mapping;
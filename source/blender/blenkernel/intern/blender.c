@@ -57,6 +57,7 @@
 #include "BKE_studiolight.h"
 
 #include "DEG_depsgraph.h"
+#include "DEG_depsgraph_debug.h"
 
 #include "RE_pipeline.h"
 #include "RE_render_ext.h"
@@ -91,6 +92,7 @@ void BKE_blender_free(void)
   BKE_cachefiles_exit();
   BKE_images_exit();
   DEG_free_node_types();
+  DEG_debug_eval_trace_file_set(NULL);
 
   BKE_brush_system_exit();
   RE_texture_rng_exit();
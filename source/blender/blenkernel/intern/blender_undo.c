@@ -42,6 +42,8 @@
 #include "BLI_string.h"
 #include "BLI_utildefines.h"
 
+#include "CLG_log.h"
+
 #include "BKE_appdir.h"
 #include "BKE_blender_undo.h" /* own include */
 #include "BKE_blendfile.h"
@@ -55,6 +57,8 @@
 
 #include "DEG_depsgraph.h"
 
+static CLG_LogRef LOG = {"bke.memfile_undo"};
+
 /* -------------------------------------------------------------------- */
 /** \name Global Undo
  * \{ */
@@ -129,6 +133,13 @@ MemFileUndoData *BKE_memfile_undo_encode(Main *bmain, MemFileUndoData *mfu_prev)
     }
     /* success = */ /* UNUSED */ BLO_write_file_mem(bmain, prevfile, &mfu->memfile, G.fileflags);
     mfu->undo_size = mfu->memfile.size;
+
+    CLOG_INFO(&LOG,
+              1,
+              "written=%zu bytes, shared=%zu bytes, %u unchanged IDs reused",
+              mfu->memfile.size,
+              mfu->memfile.size_shared,
+              mfu->memfile.id_reused_len);
   }
 
   bmain->is_memfile_undo_written = true;
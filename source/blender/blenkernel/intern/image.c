@@ -290,6 +290,7 @@ static void imagecache_put(Image *image, int index, ImBuf *ibuf)
     image->cache = IMB_moviecache_create(
         "Image Datablock Cache", sizeof(ImageCacheKey), imagecache_hashhash, imagecache_hashcmp);
     IMB_moviecache_set_getdata_callback(image->cache, imagecache_keydata);
+    IMB_moviecache_set_budget(image->cache, 0.5f);
   }
 
   key.index = index;
@@ -5557,6 +5558,7 @@ bool BKE_image_is_dirty(Image *image)
 void BKE_image_mark_dirty(Image *UNUSED(image), ImBuf *ibuf)
 {
   ibuf->userflags |= IB_BITMAPDIRTY;
+  IMB_tag_changed(ibuf);
 }
 
 bool BKE_image_buffer_format_writable(ImBuf *ibuf)
@@ -41,6 +41,7 @@
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_polyfill_2d.h"
+#include "BLI_sort_utils.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
@@ -217,6 +218,10 @@ typedef struct MeshCalcNormalsData {
   float (*pnors)[3];
   float (*lnors_weighted)[3];
   float (*vnors)[3];
+  /* Vertex to loop map, the loops of vertex `v` are
+   * `vert_loops[vert_loop_offsets[v]]` to `vert_loops[vert_loop_offsets[v + 1] - 1]`. */
+  int *vert_loop_offsets;
+  int *vert_loops;
 } MeshCalcNormalsData;
 
 static void mesh_calc_normals_poly_cb(void *__restrict userdata,
@@ -229,21 +234,18 @@ static void mesh_calc_normals_poly_cb(void *__restrict userdata,
   BKE_mesh_calc_poly_normal(mp, data->mloop + mp->loopstart, data->mverts, data->pnors[pidx]);
 }
 
-static void mesh_calc_normals_poly_prepare_cb(void *__restrict userdata,
-                                              const int pidx,
-                                              const TaskParallelTLS *__restrict UNUSED(tls))
+/**
+ * Poly normal and angle weighted loop normals of one polygon.
+ * Inlined with a constant \a nverts for triangles and quads,
+ * so the loops can be unrolled and vectorized, and the edge vectors stay in registers.
+ */
+BLI_INLINE void mesh_calc_normals_poly_prepare_ex(const MLoop *ml,
+                                                  const MVert *mverts,
+                                                  float pnor[3],
+                                                  float (*lnors_weighted)[3],
+                                                  float (*edgevecbuf)[3],
+                                                  const int nverts)
 {
-  MeshCalcNormalsData *data = userdata;
-  const MPoly *mp = &data->mpolys[pidx];
-  const MLoop *ml = &data->mloop[mp->loopstart];
-  const MVert *mverts = data->mverts;
-
-  float pnor_temp[3];
-  float *pnor = data->pnors ? data->pnors[pidx] : pnor_temp;
-  float(*lnors_weighted)[3] = data->lnors_weighted;
-
-  const int nverts = mp->totloop;
-  float(*edgevecbuf)[3] = BLI_array_alloca(edgevecbuf, (size_t)nverts);
   int i;
 
   /* Polygon Normal and edge-vector */
@@ -273,12 +275,11 @@ static void mesh_calc_normals_poly_prepare_cb(void *__restrict userdata,
 
   /* accumulate angle weighted face normal */
   /* inline version of #accumulate_vertex_normals_poly_v3,
-   * split between this threaded callback and #mesh_calc_normals_poly_accum_cb. */
+   * split between this threaded callback and #mesh_calc_normals_poly_finalize_cb. */
   {
     const float *prev_edge = edgevecbuf[nverts - 1];
 
     for (i = 0; i < nverts; i++) {
-      const int lidx = mp->loopstart + i;
       const float *cur_edge = edgevecbuf[i];
 
       /* calculate angle between the two poly edges incident on
@@ -286,13 +287,74 @@ static void mesh_calc_normals_poly_prepare_cb(void *__restrict userdata,
       const float fac = saacos(-dot_v3v3(cur_edge, prev_edge));
 
       /* Store for later accumulation */
-      mul_v3_v3fl(lnors_weighted[lidx], pnor, fac);
+      mul_v3_v3fl(lnors_weighted[i], pnor, fac);
 
       prev_edge = cur_edge;
     }
   }
 }
 
+static void mesh_calc_normals_poly_prepare_cb(void *__restrict userdata,
+                                              const int pidx,
+                                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MeshCalcNormalsData *data = userdata;
+  const MPoly *mp = &data->mpolys[pidx];
+  const MLoop *ml = &data->mloop[mp->loopstart];
+  const MVert *mverts = data->mverts;
+  int *vert_loop_offsets = data->vert_loop_offsets;
+
+  float pnor_temp[3];
+  float *pnor = data->pnors ? data->pnors[pidx] : pnor_temp;
+  float(*lnors_weighted)[3] = &data->lnors_weighted[mp->loopstart];
+
+  const int nverts = mp->totloop;
+
+  switch (nverts) {
+    case 3: {
+      float edgevecbuf[3][3];
+      mesh_calc_normals_poly_prepare_ex(ml, mverts, pnor, lnors_weighted, edgevecbuf, 3);
+      break;
+    }
+    case 4: {
+      float edgevecbuf[4][3];
+      mesh_calc_normals_poly_prepare_ex(ml, mverts, pnor, lnors_weighted, edgevecbuf, 4);
+      break;
+    }
+    default: {
+      float(*edgevecbuf)[3] = BLI_array_alloca(edgevecbuf, (size_t)nverts);
+      mesh_calc_normals_poly_prepare_ex(ml, mverts, pnor, lnors_weighted, edgevecbuf, nverts);
+      break;
+    }
+  }
+
+  /* Count the loops of each vertex, for the vertex to loop map. */
+  for (int i = 0; i < nverts; i++) {
+    atomic_add_and_fetch_int32(&vert_loop_offsets[ml[i].v], 1);
+  }
+}
+
+static void mesh_calc_normals_poly_vert_loops_cb(void *__restrict userdata,
+                                                 const int pidx,
+                                                 const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MeshCalcNormalsData *data = userdata;
+  const MPoly *mp = &data->mpolys[pidx];
+  const MLoop *ml = &data->mloop[mp->loopstart];
+  int *vert_loop_offsets = data->vert_loop_offsets;
+  int *vert_loops = data->vert_loops;
+
+  /* Offsets point past the last loop of each vertex, fill them backwards,
+   * so once all loops are added the offsets point to the first loop. */
+  for (int i = 0; i < mp->totloop; i++) {
+    const int index = atomic_sub_and_fetch_int32(&vert_loop_offsets[ml[i].v], 1);
+    vert_loops[index] = mp->loopstart + i;
+  }
+}
+
+/* Above this number of loops per vertex, sort them with #qsort instead of an insertion sort. */
+#define MESH_CALC_NORMALS_INSERTION_SORT_MAX 16
+
 static void mesh_calc_normals_poly_finalize_cb(void *__restrict userdata,
                                                const int vidx,
                                                const TaskParallelTLS *__restrict UNUSED(tls))
@@ -300,7 +362,35 @@ static void mesh_calc_normals_poly_finalize_cb(void *__restrict userdata,
   MeshCalcNormalsData *data = userdata;
 
   MVert *mv = &data->mverts[vidx];
-  float *no = data->vnors[vidx];
+  const float(*lnors_weighted)[3] = (const float(*)[3])data->lnors_weighted;
+  int *vert_loops = &data->vert_loops[data->vert_loop_offsets[vidx]];
+  const int vert_loops_len = data->vert_loop_offsets[vidx + 1] - data->vert_loop_offsets[vidx];
+  float no_temp[3];
+  float *no = data->vnors ? data->vnors[vidx] : no_temp;
+
+  /* The map is filled from several threads, sort the loops so they are always summed in the
+   * same order, otherwise the result could change between two evaluations of the same mesh.
+   * Most vertices only have a few loops, where insertion sort is the fastest, but poles
+   * (cone tips, fans of triangles...) can have thousands of them. */
+  if (vert_loops_len > MESH_CALC_NORMALS_INSERTION_SORT_MAX) {
+    qsort(vert_loops, (size_t)vert_loops_len, sizeof(*vert_loops), BLI_sortutil_cmp_int);
+  }
+  else {
+    for (int i = 1; i < vert_loops_len; i++) {
+      const int lidx = vert_loops[i];
+      int j = i;
+      for (; j > 0 && vert_loops[j - 1] > lidx; j--) {
+        vert_loops[j] = vert_loops[j - 1];
+      }
+      vert_loops[j] = lidx;
+    }
+  }
+
+  /* Gather the weighted loop normals, each vertex only writes its own normal. */
+  zero_v3(no);
+  for (int i = 0; i < vert_loops_len; i++) {
+    add_v3_v3(no, lnors_weighted[vert_loops[i]]);
+  }
 
   if (UNLIKELY(normalize_v3(no) == 0.0f)) {
     /* following Mesh convention; we use vertex coordinate itself for normal in this case */
@@ -341,19 +431,10 @@ void BKE_mesh_calc_normals_poly(MVert *mverts,
     return;
   }
 
-  float(*vnors)[3] = r_vertnors;
   float(*lnors_weighted)[3] = MEM_malloc_arrayN(
       (size_t)numLoops, sizeof(*lnors_weighted), __func__);
-  bool free_vnors = false;
-
-  /* first go through and calculate normals for all the polys */
-  if (vnors == NULL) {
-    vnors = MEM_calloc_arrayN((size_t)numVerts, sizeof(*vnors), __func__);
-    free_vnors = true;
-  }
-  else {
-    memset(vnors, 0, sizeof(*vnors) * (size_t)numVerts);
-  }
+  int *vert_loop_offsets = MEM_calloc_arrayN((size_t)numVerts + 1, sizeof(int), __func__);
+  int *vert_loops = MEM_malloc_arrayN((size_t)numLoops, sizeof(int), __func__);
 
   MeshCalcNormalsData data = {
       .mpolys = mpolys,
@@ -361,26 +442,32 @@ void BKE_mesh_calc_normals_poly(MVert *mverts,
       .mverts = mverts,
       .pnors = pnors,
       .lnors_weighted = lnors_weighted,
-      .vnors = vnors,
+      .vnors = r_vertnors,
+      .vert_loop_offsets = vert_loop_offsets,
+      .vert_loops = vert_loops,
   };
 
-  /* Compute poly normals, and prepare weighted loop normals. */
+  /* Compute poly normals, prepare weighted loop normals, and count the loops of each vertex. */
   BLI_task_parallel_range(0, numPolys, &data, mesh_calc_normals_poly_prepare_cb, &settings);
 
-  /* Actually accumulate weighted loop normals into vertex ones. */
-  /* Unfortunately, not possible to thread that
-   * (not in a reasonable, totally lock- and barrier-free fashion),
-   * since several loops will point to the same vertex... */
-  for (int lidx = 0; lidx < numLoops; lidx++) {
-    add_v3_v3(vnors[mloop[lidx].v], data.lnors_weighted[lidx]);
+  /* Accumulating the weighted loop normals into the vertex ones from the polys does not thread
+   * well, since several loops point to the same vertex. Instead, build a vertex to loop map,
+   * so each vertex can gather its own loop normals without any locking. */
+  int offset = 0;
+  for (int vidx = 0; vidx < numVerts; vidx++) {
+    offset += vert_loop_offsets[vidx];
+    vert_loop_offsets[vidx] = offset;
   }
+  vert_loop_offsets[numVerts] = offset;
+  BLI_assert(offset == numLoops);
 
-  /* Normalize and validate computed vertex normals. */
+  BLI_task_parallel_range(0, numPolys, &data, mesh_calc_normals_poly_vert_loops_cb, &settings);
+
+  /* Gather, normalize and validate computed vertex normals. */
   BLI_task_parallel_range(0, numVerts, &data, mesh_calc_normals_poly_finalize_cb, &settings);
 
-  if (free_vnors) {
-    MEM_freeN(vnors);
-  }
+  MEM_freeN(vert_loop_offsets);
+  MEM_freeN(vert_loops);
   MEM_freeN(lnors_weighted);
 }
 
@@ -774,12 +861,28 @@ void BKE_lnor_space_custom_normal_to_data(MLoopNorSpace *lnor_space,
   }
 }
 
+/* Below this amount of loops, threading overhead is higher than the speed benefit. */
 #define LOOP_SPLIT_TASK_BLOCK_SIZE 1024
 
+/**
+ * Type of the smooth fan starting at each loop (#LoopSplitTaskDataCommon.loop_fan_types).
+ * Every smooth fan starts at exactly one loop, all other loops are #LOOP_FAN_NONE or
+ * #LOOP_FAN_VISITED.
+ */
+enum {
+  LOOP_FAN_NONE = 0,
+  /** Both edges of the loop are sharp, it gets its poly normal. */
+  LOOP_FAN_SINGLE = 1,
+  /** Start of a fan of smooth loops around the loop's vertex. */
+  LOOP_FAN_SMOOTH = 2,
+  /** Smooth loop already walked while looking for cyclic fans, not the start of a fan. */
+  LOOP_FAN_VISITED = 3,
+};
+
 typedef struct LoopSplitTaskData {
-  /* Specific to each instance (each task). */
+  /* Specific to each instance (each fan). */
 
-  /** We have to create those outside of tasks, since afaik memarena is not threadsafe. */
+  /** Item of #LoopSplitTaskDataCommon.lnor_spaces, allocated at once before evaluating fans. */
   MLoopNorSpace *lnor_space;
   float (*lnor)[3];
   const MLoop *ml_curr;
@@ -790,7 +893,7 @@ typedef struct LoopSplitTaskData {
   const int *e2l_prev;
   int mp_index;
 
-  /** This one is special, it's owned and managed by worker tasks,
+  /** This one is special, it's owned and managed by each thread (see #LoopSplitTaskTLS),
    * avoid to have to create it for each fan! */
   BLI_Stack *edge_vectors;
 
@@ -805,6 +908,23 @@ typedef struct LoopSplitTaskDataCommon {
   float (*loopnors)[3];
   short (*clnors_data)[2];
 
+  /* Fans, written by the detection pass, read by the evaluation pass. */
+  /** Loop aligned array of #LOOP_FAN_NONE, #LOOP_FAN_SINGLE, #LOOP_FAN_SMOOTH or
+   * #LOOP_FAN_VISITED. */
+  char *loop_fan_types;
+  /**
+   * Loops of each vertex, `vert_loops[vert_loop_offsets[v]]` to
+   * `vert_loops[vert_loop_offsets[v + 1] - 1]`. Cyclic fans are detected per vertex,
+   * since all loops of a fan share its vertex.
+   */
+  int *vert_loop_offsets;
+  int *vert_loops;
+  /** Start loop of each fan. */
+  int *fan_loops;
+  /** lnor space of each fan, when #lnors_spacearr is set. */
+  MLoopNorSpace *lnor_spaces;
+  int numFans;
+
   /* Read-only. */
   const MVert *mverts;
   const MEdge *medges;
@@ -814,6 +934,7 @@ typedef struct LoopSplitTaskDataCommon {
   int *loop_to_poly;
   const float (*polynors)[3];
 
+  int numVerts;
   int numEdges;
   int numLoops;
   int numPolys;
@@ -1300,94 +1421,52 @@ static void split_loop_nor_fan_do(LoopSplitTaskDataCommon *common_data, LoopSpli
   }
 }
 
-static void loop_split_worker_do(LoopSplitTaskDataCommon *common_data,
-                                 LoopSplitTaskData *data,
-                                 BLI_Stack *edge_vectors)
-{
-  BLI_assert(data->ml_curr);
-  if (data->e2l_prev) {
-    BLI_assert((edge_vectors == NULL) || BLI_stack_is_empty(edge_vectors));
-    data->edge_vectors = edge_vectors;
-    split_loop_nor_fan_do(common_data, data);
-  }
-  else {
-    /* No need for edge_vectors for 'single' case! */
-    split_loop_nor_single_do(common_data, data);
-  }
-}
-
-static void loop_split_worker(TaskPool *__restrict pool, void *taskdata)
-{
-  LoopSplitTaskDataCommon *common_data = BLI_task_pool_user_data(pool);
-  LoopSplitTaskData *data = taskdata;
-
-  /* Temp edge vectors stack, only used when computing lnor spacearr. */
-  BLI_Stack *edge_vectors = common_data->lnors_spacearr ?
-                                BLI_stack_new(sizeof(float[3]), __func__) :
-                                NULL;
-
-#ifdef DEBUG_TIME
-  TIMEIT_START_AVERAGED(loop_split_worker);
-#endif
-
-  for (int i = 0; i < LOOP_SPLIT_TASK_BLOCK_SIZE; i++, data++) {
-    /* A NULL ml_curr is used to tag ended data! */
-    if (data->ml_curr == NULL) {
-      break;
-    }
-
-    loop_split_worker_do(common_data, data, edge_vectors);
-  }
-
-  if (edge_vectors) {
-    BLI_stack_free(edge_vectors);
-  }
-
-#ifdef DEBUG_TIME
-  TIMEIT_END_AVERAGED(loop_split_worker);
-#endif
-}
-
 /**
- * Check whether given loop is part of an unknown-so-far cyclic smooth fan, or not.
+ * Walk the smooth fan around the vertex of \a ml_curr_index, tagging its loops as visited.
  * Needed because cyclic smooth fans have no obvious 'entry point',
  * and yet we need to walk them once, and only once.
+ *
+ * \return The first loop of the fan in polygon order when the fan is cyclic, -1 otherwise.
+ * Using that loop keeps the lnor spaces (and hence the decoded custom normals) identical to
+ * walking loops sequentially. Only loops of the same vertex are read and written, so this can
+ * be called for different vertices concurrently.
  */
-static bool loop_split_generator_check_cyclic_smooth_fan(const MLoop *mloops,
-                                                         const MPoly *mpolys,
-                                                         const int (*edge_to_loops)[2],
-                                                         const int *loop_to_poly,
-                                                         const int *e2l_prev,
-                                                         BLI_bitmap *skip_loops,
-                                                         const MLoop *ml_curr,
-                                                         const MLoop *ml_prev,
-                                                         const int ml_curr_index,
-                                                         const int ml_prev_index,
-                                                         const int mp_curr_index)
+static int loop_split_fan_find_cyclic_entry(LoopSplitTaskDataCommon *common_data,
+                                            const int ml_curr_index)
 {
-  const unsigned int mv_pivot_index = ml_curr->v; /* The vertex we are "fanning" around! */
+  const MLoop *mloops = common_data->mloops;
+  const MPoly *mpolys = common_data->mpolys;
+  const int(*edge_to_loops)[2] = common_data->edge_to_loops;
+  const int *loop_to_poly = common_data->loop_to_poly;
+  char *loop_fan_types = common_data->loop_fan_types;
+
+  const int mp_curr_index = loop_to_poly[ml_curr_index];
+  const MPoly *mp_curr = &mpolys[mp_curr_index];
+  const int ml_prev_index = (ml_curr_index == mp_curr->loopstart) ?
+                                (mp_curr->loopstart + mp_curr->totloop) - 1 :
+                                ml_curr_index - 1;
+
+  /* The vertex we are "fanning" around! */
+  const unsigned int mv_pivot_index = mloops[ml_curr_index].v;
   const int *e2lfan_curr;
   const MLoop *mlfan_curr;
   /* mlfan_vert_index: the loop of our current edge might not be the loop of our current vertex! */
   int mlfan_curr_index, mlfan_vert_index, mpfan_curr_index;
 
-  e2lfan_curr = e2l_prev;
+  e2lfan_curr = edge_to_loops[mloops[ml_prev_index].e];
   if (IS_EDGE_SHARP(e2lfan_curr)) {
     /* Sharp loop, so not a cyclic smooth fan... */
-    return false;
+    return -1;
   }
 
-  mlfan_curr = ml_prev;
+  mlfan_curr = &mloops[ml_prev_index];
   mlfan_curr_index = ml_prev_index;
   mlfan_vert_index = ml_curr_index;
   mpfan_curr_index = mp_curr_index;
 
-  BLI_assert(mlfan_curr_index >= 0);
-  BLI_assert(mlfan_vert_index >= 0);
-  BLI_assert(mpfan_curr_index >= 0);
-
-  BLI_assert(!BLI_BITMAP_TEST(skip_loops, mlfan_vert_index));
-  BLI_BITMAP_ENABLE(skip_loops, mlfan_vert_index);
+  BLI_assert(loop_fan_types[ml_curr_index] == LOOP_FAN_NONE);
+  loop_fan_types[ml_curr_index] = LOOP_FAN_VISITED;
+  int ml_entry_index = ml_curr_index;
 
   while (true) {
     /* Find next loop of the smooth fan. */
@@ -1405,196 +1484,265 @@ static bool loop_split_generator_check_cyclic_smooth_fan(const MLoop *mloops,
 
     if (IS_EDGE_SHARP(e2lfan_curr)) {
       /* Sharp loop/edge, so not a cyclic smooth fan... */
-      return false;
-    }
-    /* Smooth loop/edge... */
-    else if (BLI_BITMAP_TEST(skip_loops, mlfan_vert_index)) {
-      if (mlfan_vert_index == ml_curr_index) {
-        /* We walked around a whole cyclic smooth fan without finding any already-processed loop,
-         * means we can use initial ml_curr/ml_prev edge as start for this smooth fan. */
-        return true;
-      }
-      /* ... already checked in some previous looping, we can abort. */
-      return false;
+      return -1;
     }
-    else {
-      /* ... we can skip it in future, and keep checking the smooth fan. */
-      BLI_BITMAP_ENABLE(skip_loops, mlfan_vert_index);
+    if (mlfan_vert_index == ml_curr_index) {
+      /* We walked around a whole cyclic smooth fan. */
+      return ml_entry_index;
     }
+    if (loop_fan_types[mlfan_vert_index] != LOOP_FAN_NONE) {
+      /* Already checked in some previous walk, which ended on a sharp edge, we can abort. */
+      return -1;
+    }
+    /* ... we can skip it in future, and keep checking the smooth fan. */
+    loop_fan_types[mlfan_vert_index] = LOOP_FAN_VISITED;
+    ml_entry_index = min_ii(ml_entry_index, mlfan_vert_index);
   }
 }
 
-static void loop_split_generator(TaskPool *pool, LoopSplitTaskDataCommon *common_data)
+/**
+ * First pass, over polys: tag the loops starting a fan at a sharp edge, with the type of that fan.
+ */
+static void loop_split_fan_detect_cb(void *__restrict userdata,
+                                     const int mp_index,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  MLoopNorSpaceArray *lnors_spacearr = common_data->lnors_spacearr;
-  float(*loopnors)[3] = common_data->loopnors;
+  LoopSplitTaskDataCommon *common_data = userdata;
+  char *loop_fan_types = common_data->loop_fan_types;
 
   const MLoop *mloops = common_data->mloops;
   const MPoly *mpolys = common_data->mpolys;
-  const int *loop_to_poly = common_data->loop_to_poly;
   const int(*edge_to_loops)[2] = common_data->edge_to_loops;
-  const int numLoops = common_data->numLoops;
-  const int numPolys = common_data->numPolys;
 
-  const MPoly *mp;
-  int mp_index;
+  const MPoly *mp = &mpolys[mp_index];
+  const int ml_last_index = (mp->loopstart + mp->totloop) - 1;
+  int ml_curr_index = mp->loopstart;
+
+  const MLoop *ml_curr = &mloops[ml_curr_index];
+  const MLoop *ml_prev = &mloops[ml_last_index];
+
+  for (; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++) {
+    const int *e2l_curr = edge_to_loops[ml_curr->e];
+    const int *e2l_prev = edge_to_loops[ml_prev->e];
+    char fan_type = LOOP_FAN_NONE;
+
+    /* We *do not need* to check/tag loops as already computed!
+     * Due to the fact a loop only links to one of its two edges,
+     * a same fan *will never be walked more than once!*
+     * Since we consider edges having neighbor polys with inverted
+     * (flipped) normals as sharp, we are sure that no fan will be skipped,
+     * even only considering the case (sharp curr_edge, smooth prev_edge),
+     * and not the alternative (smooth curr_edge, sharp prev_edge).
+     * All this due/thanks to link between normals and loop ordering (i.e. winding).
+     */
+    if (IS_EDGE_SHARP(e2l_curr)) {
+      fan_type = IS_EDGE_SHARP(e2l_prev) ? LOOP_FAN_SINGLE : LOOP_FAN_SMOOTH;
+    }
+    /* A smooth edge, cyclic smooth fans are checked per vertex in the second pass. */
+    loop_fan_types[ml_curr_index] = fan_type;
 
-  const MLoop *ml_curr;
-  const MLoop *ml_prev;
-  int ml_curr_index;
-  int ml_prev_index;
+    ml_prev = ml_curr;
+  }
+}
 
-  BLI_bitmap *skip_loops = BLI_BITMAP_NEW(numLoops, __func__);
+static void loop_split_vert_loops_count_cb(void *__restrict userdata,
+                                           const int mp_index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  LoopSplitTaskDataCommon *common_data = userdata;
+  const MPoly *mp = &common_data->mpolys[mp_index];
+  const MLoop *ml = &common_data->mloops[mp->loopstart];
 
-  LoopSplitTaskData *data_buff = NULL;
-  int data_idx = 0;
+  for (int i = 0; i < mp->totloop; i++) {
+    atomic_add_and_fetch_int32(&common_data->vert_loop_offsets[ml[i].v], 1);
+  }
+}
 
-  /* Temp edge vectors stack, only used when computing lnor spacearr
-   * (and we are not multi-threading). */
-  BLI_Stack *edge_vectors = NULL;
+static void loop_split_vert_loops_fill_cb(void *__restrict userdata,
+                                          const int mp_index,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  LoopSplitTaskDataCommon *common_data = userdata;
+  const MPoly *mp = &common_data->mpolys[mp_index];
+  const MLoop *ml = &common_data->mloops[mp->loopstart];
 
-#ifdef DEBUG_TIME
-  TIMEIT_START_AVERAGED(loop_split_generator);
-#endif
+  /* Offsets point past the last loop of each vertex, fill them backwards,
+   * so once all loops are added the offsets point to the first loop. */
+  for (int i = 0; i < mp->totloop; i++) {
+    const int index = atomic_sub_and_fetch_int32(&common_data->vert_loop_offsets[ml[i].v], 1);
+    common_data->vert_loops[index] = mp->loopstart + i;
+  }
+}
 
-  if (!pool) {
-    if (lnors_spacearr) {
-      edge_vectors = BLI_stack_new(sizeof(float[3]), __func__);
+/**
+ * Second pass, over vertices: tag the first loop of each cyclic smooth fan.
+ * Each fan is only walked once, whatever the valence of the vertex.
+ */
+static void loop_split_fan_detect_cyclic_cb(void *__restrict userdata,
+                                            const int mv_index,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  LoopSplitTaskDataCommon *common_data = userdata;
+  char *loop_fan_types = common_data->loop_fan_types;
+  const int vert_loops_start = common_data->vert_loop_offsets[mv_index];
+  const int vert_loops_end = common_data->vert_loop_offsets[mv_index + 1];
+
+  for (int i = vert_loops_start; i < vert_loops_end; i++) {
+    const int ml_index = common_data->vert_loops[i];
+    /* Fan starting at a sharp edge, or walked from another loop already. */
+    if (loop_fan_types[ml_index] != LOOP_FAN_NONE) {
+      continue;
+    }
+    const int ml_entry_index = loop_split_fan_find_cyclic_entry(common_data, ml_index);
+    if (ml_entry_index != -1) {
+      loop_fan_types[ml_entry_index] = LOOP_FAN_SMOOTH;
     }
   }
+}
 
-  /* We now know edges that can be smoothed (with their vector, and their two loops),
-   * and edges that will be hard! Now, time to generate the normals.
-   */
-  for (mp = mpolys, mp_index = 0; mp_index < numPolys; mp++, mp_index++) {
-    float(*lnors)[3];
-    const int ml_last_index = (mp->loopstart + mp->totloop) - 1;
-    ml_curr_index = mp->loopstart;
-    ml_prev_index = ml_last_index;
+typedef struct LoopSplitTaskTLS {
+  /* Temp edge vectors stack, only used when computing lnor spacearr. */
+  BLI_Stack *edge_vectors;
+} LoopSplitTaskTLS;
 
-    ml_curr = &mloops[ml_curr_index];
-    ml_prev = &mloops[ml_prev_index];
-    lnors = &loopnors[ml_curr_index];
+/**
+ * Second pass: compute the normal (and lnor space) of each fan, fans never share loops.
+ */
+static void loop_split_fan_eval_cb(void *__restrict userdata,
+                                   const int fan_index,
+                                   const TaskParallelTLS *__restrict tls)
+{
+  LoopSplitTaskDataCommon *common_data = userdata;
+  LoopSplitTaskTLS *tls_data = tls->userdata_chunk;
 
-    for (; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++, lnors++) {
-      const int *e2l_curr = edge_to_loops[ml_curr->e];
-      const int *e2l_prev = edge_to_loops[ml_prev->e];
+  const MLoop *mloops = common_data->mloops;
+  const MPoly *mpolys = common_data->mpolys;
 
-#if 0
-      printf("Checking loop %d / edge %u / vert %u (sharp edge: %d, skiploop: %d)...",
-             ml_curr_index,
-             ml_curr->e,
-             ml_curr->v,
-             IS_EDGE_SHARP(e2l_curr),
-             BLI_BITMAP_TEST_BOOL(skip_loops, ml_curr_index));
-#endif
+  const int ml_curr_index = common_data->fan_loops[fan_index];
+  const int mp_index = common_data->loop_to_poly[ml_curr_index];
+  const MPoly *mp = &mpolys[mp_index];
+  const int ml_prev_index = (ml_curr_index == mp->loopstart) ?
+                                (mp->loopstart + mp->totloop) - 1 :
+                                ml_curr_index - 1;
+
+  LoopSplitTaskData data = {
+      .lnor_space = common_data->lnor_spaces ? &common_data->lnor_spaces[fan_index] : NULL,
+      .ml_curr = &mloops[ml_curr_index],
+      .ml_prev = &mloops[ml_prev_index],
+      .ml_curr_index = ml_curr_index,
+      .ml_prev_index = ml_prev_index,
+      .mp_index = mp_index,
+  };
 
-      /* A smooth edge, we have to check for cyclic smooth fan case.
-       * If we find a new, never-processed cyclic smooth fan, we can do it now using that loop/edge
-       * as 'entry point', otherwise we can skip it. */
-
-      /* Note: In theory, we could make loop_split_generator_check_cyclic_smooth_fan() store
-       * mlfan_vert_index'es and edge indexes in two stacks, to avoid having to fan again around
-       * the vert during actual computation of clnor & clnorspace. However, this would complicate
-       * the code, add more memory usage, and despite its logical complexity,
-       * loop_manifold_fan_around_vert_next() is quite cheap in term of CPU cycles,
-       * so really think it's not worth it. */
-      if (!IS_EDGE_SHARP(e2l_curr) && (BLI_BITMAP_TEST(skip_loops, ml_curr_index) ||
-                                       !loop_split_generator_check_cyclic_smooth_fan(mloops,
-                                                                                     mpolys,
-                                                                                     edge_to_loops,
-                                                                                     loop_to_poly,
-                                                                                     e2l_prev,
-                                                                                     skip_loops,
-                                                                                     ml_curr,
-                                                                                     ml_prev,
-                                                                                     ml_curr_index,
-                                                                                     ml_prev_index,
-                                                                                     mp_index))) {
-        //              printf("SKIPPING!\n");
-      }
-      else {
-        LoopSplitTaskData *data, data_local;
+  if (common_data->loop_fan_types[ml_curr_index] == LOOP_FAN_SINGLE) {
+    /* No need for edge_vectors for 'single' case! */
+    data.lnor = &common_data->loopnors[ml_curr_index];
+    split_loop_nor_single_do(common_data, &data);
+  }
+  else {
+    if (common_data->lnors_spacearr && tls_data->edge_vectors == NULL) {
+      tls_data->edge_vectors = BLI_stack_new(sizeof(float[3]), __func__);
+    }
+    BLI_assert((tls_data->edge_vectors == NULL) || BLI_stack_is_empty(tls_data->edge_vectors));
+    data.e2l_prev = common_data->edge_to_loops[data.ml_prev->e];
+    data.edge_vectors = tls_data->edge_vectors;
+    split_loop_nor_fan_do(common_data, &data);
+  }
+}
 
-        //              printf("PROCESSING!\n");
+static void loop_split_fan_eval_free(const void *__restrict UNUSED(userdata),
+                                     void *__restrict chunk)
+{
+  LoopSplitTaskTLS *tls_data = chunk;
+  if (tls_data->edge_vectors) {
+    BLI_stack_free(tls_data->edge_vectors);
+  }
+}
 
-        if (pool) {
-          if (data_idx == 0) {
-            data_buff = MEM_calloc_arrayN(
-                LOOP_SPLIT_TASK_BLOCK_SIZE, sizeof(*data_buff), __func__);
-          }
-          data = &data_buff[data_idx];
-        }
-        else {
-          data = &data_local;
-          memset(data, 0, sizeof(*data));
-        }
+/**
+ * Compute the loop normals in two passes over index ranges, both threaded: fan detection over
+ * polys, then evaluation over fans. Fans are written to flat arrays in between,
+ * so no per-fan task data or lnor space allocation is needed.
+ */
+static void loop_split_generator(LoopSplitTaskDataCommon *common_data)
+{
+  MLoopNorSpaceArray *lnors_spacearr = common_data->lnors_spacearr;
+  const int numLoops = common_data->numLoops;
 
-        if (IS_EDGE_SHARP(e2l_curr) && IS_EDGE_SHARP(e2l_prev)) {
-          data->lnor = lnors;
-          data->ml_curr = ml_curr;
-          data->ml_prev = ml_prev;
-          data->ml_curr_index = ml_curr_index;
-#if 0 /* Not needed for 'single' loop. */
-          data->ml_prev_index = ml_prev_index;
-          data->e2l_prev = NULL; /* Tag as 'single' task. */
-#endif
-          data->mp_index = mp_index;
-          if (lnors_spacearr) {
-            data->lnor_space = BKE_lnor_space_create(lnors_spacearr);
-          }
-        }
-        /* We *do not need* to check/tag loops as already computed!
-         * Due to the fact a loop only links to one of its two edges,
-         * a same fan *will never be walked more than once!*
-         * Since we consider edges having neighbor polys with inverted
-         * (flipped) normals as sharp, we are sure that no fan will be skipped,
-         * even only considering the case (sharp curr_edge, smooth prev_edge),
-         * and not the alternative (smooth curr_edge, sharp prev_edge).
-         * All this due/thanks to link between normals and loop ordering (i.e. winding).
-         */
-        else {
-#if 0 /* Not needed for 'fan' loops. */
-          data->lnor = lnors;
+#ifdef DEBUG_TIME
+  TIMEIT_START_AVERAGED(loop_split_generator);
 #endif
-          data->ml_curr = ml_curr;
-          data->ml_prev = ml_prev;
-          data->ml_curr_index = ml_curr_index;
-          data->ml_prev_index = ml_prev_index;
-          data->e2l_prev = e2l_prev; /* Also tag as 'fan' task. */
-          data->mp_index = mp_index;
-          if (lnors_spacearr) {
-            data->lnor_space = BKE_lnor_space_create(lnors_spacearr);
-          }
-        }
 
-        if (pool) {
-          data_idx++;
-          if (data_idx == LOOP_SPLIT_TASK_BLOCK_SIZE) {
-            BLI_task_pool_push(pool, loop_split_worker, data_buff, true, NULL);
-            data_idx = 0;
-          }
-        }
-        else {
-          loop_split_worker_do(common_data, data, edge_vectors);
-        }
-      }
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (numLoops >= LOOP_SPLIT_TASK_BLOCK_SIZE * 8);
+  settings.min_iter_per_thread = LOOP_SPLIT_TASK_BLOCK_SIZE;
 
-      ml_prev = ml_curr;
-      ml_prev_index = ml_curr_index;
+  /* We now know edges that can be smoothed (with their vector, and their two loops),
+   * and edges that will be hard! Now, time to find the fans. */
+  common_data->loop_fan_types = MEM_malloc_arrayN(
+      (size_t)numLoops, sizeof(*common_data->loop_fan_types), __func__);
+  BLI_task_parallel_range(
+      0, common_data->numPolys, common_data, loop_split_fan_detect_cb, &settings);
+
+  /* Cyclic smooth fans have no sharp edge to start from. Walking them from every loop is
+   * quadratic for high valence vertices (cone tips, n-gon fans), so they are walked once per
+   * vertex, using a vertex to loops map. */
+  const int numVerts = common_data->numVerts;
+  common_data->vert_loop_offsets = MEM_calloc_arrayN(
+      (size_t)numVerts + 1, sizeof(int), __func__);
+  common_data->vert_loops = MEM_malloc_arrayN((size_t)numLoops, sizeof(int), __func__);
+  BLI_task_parallel_range(
+      0, common_data->numPolys, common_data, loop_split_vert_loops_count_cb, &settings);
+  int offset = 0;
+  for (int mv_index = 0; mv_index < numVerts; mv_index++) {
+    offset += common_data->vert_loop_offsets[mv_index];
+    common_data->vert_loop_offsets[mv_index] = offset;
+  }
+  common_data->vert_loop_offsets[numVerts] = offset;
+  BLI_task_parallel_range(
+      0, common_data->numPolys, common_data, loop_split_vert_loops_fill_cb, &settings);
+  BLI_task_parallel_range(0, numVerts, common_data, loop_split_fan_detect_cyclic_cb, &settings);
+
+  MEM_freeN(common_data->vert_loop_offsets);
+  MEM_freeN(common_data->vert_loops);
+  common_data->vert_loop_offsets = NULL;
+  common_data->vert_loops = NULL;
+
+  /* Gather fan start loops, in loop order so fans sharing vertices stay close in memory. */
+  int numFans = 0;
+  for (int ml_index = 0; ml_index < numLoops; ml_index++) {
+    numFans += ELEM(common_data->loop_fan_types[ml_index], LOOP_FAN_SINGLE, LOOP_FAN_SMOOTH);
+  }
+  common_data->numFans = numFans;
+  common_data->fan_loops = MEM_malloc_arrayN((size_t)numFans, sizeof(int), __func__);
+  for (int ml_index = 0, fan_index = 0; ml_index < numLoops; ml_index++) {
+    if (ELEM(common_data->loop_fan_types[ml_index], LOOP_FAN_SINGLE, LOOP_FAN_SMOOTH)) {
+      common_data->fan_loops[fan_index++] = ml_index;
     }
   }
 
-  /* Last block of data... Since it is calloc'ed and we use first NULL item as stopper,
-   * everything is fine. */
-  if (pool && data_idx) {
-    BLI_task_pool_push(pool, loop_split_worker, data_buff, true, NULL);
+  /* Allocate all lnor spaces at once, in the space array's memarena as usual. */
+  common_data->lnor_spaces = NULL;
+  if (lnors_spacearr && numFans) {
+    common_data->lnor_spaces = BLI_memarena_calloc(lnors_spacearr->mem,
+                                                   sizeof(MLoopNorSpace) * (size_t)numFans);
+    lnors_spacearr->num_spaces += numFans;
   }
 
-  if (edge_vectors) {
-    BLI_stack_free(edge_vectors);
-  }
-  MEM_freeN(skip_loops);
+  /* Now, time to generate the normals. */
+  LoopSplitTaskTLS tls = {NULL};
+  settings.userdata_chunk = &tls;
+  settings.userdata_chunk_size = sizeof(tls);
+  settings.func_free = loop_split_fan_eval_free;
+  settings.min_iter_per_thread = LOOP_SPLIT_TASK_BLOCK_SIZE / 4;
+  BLI_task_parallel_range(0, numFans, common_data, loop_split_fan_eval_cb, &settings);
+
+  MEM_freeN(common_data->loop_fan_types);
+  MEM_freeN(common_data->fan_loops);
+  common_data->loop_fan_types = NULL;
+  common_data->fan_loops = NULL;
+  common_data->lnor_spaces = NULL;
 
 #ifdef DEBUG_TIME
   TIMEIT_END_AVERAGED(loop_split_generator);
@@ -1607,7 +1755,7 @@ static void loop_split_generator(TaskPool *pool, LoopSplitTaskDataCommon *common
  * (splitting edges).
  */
 void BKE_mesh_normals_loop_split(const MVert *mverts,
-                                 const int UNUSED(numVerts),
+                                 const int numVerts,
                                  MEdge *medges,
                                  const int numEdges,
                                  MLoop *mloops,
@@ -1707,6 +1855,7 @@ void BKE_mesh_normals_loop_split(const MVert *mverts,
       .edge_to_loops = edge_to_loops,
       .loop_to_poly = loop_to_poly,
       .polynors = polynors,
+      .numVerts = numVerts,
       .numEdges = numEdges,
       .numLoops = numLoops,
       .numPolys = numPolys,
@@ -1715,19 +1864,7 @@ void BKE_mesh_normals_loop_split(const MVert *mverts,
   /* This first loop check which edges are actually smooth, and compute edge vectors. */
   mesh_edges_sharp_tag(&common_data, check_angle, split_angle, false);
 
-  if (numLoops < LOOP_SPLIT_TASK_BLOCK_SIZE * 8) {
-    /* Not enough loops to be worth the whole threading overhead... */
-    loop_split_generator(NULL, &common_data);
-  }
-  else {
-    TaskPool *task_pool = BLI_task_pool_create(&common_data, TASK_PRIORITY_HIGH);
-
-    loop_split_generator(task_pool, &common_data);
-
-    BLI_task_pool_work_and_wait(task_pool);
-
-    BLI_task_pool_free(task_pool);
-  }
+  loop_split_generator(&common_data);
 
   MEM_freeN(edge_to_loops);
   if (!r_loop_to_poly) {
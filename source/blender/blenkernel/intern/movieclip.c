@@ -687,6 +687,8 @@ static bool put_imbuf_cache(
                                          moviecache_getprioritydata,
                                          moviecache_getitempriority,
                                          moviecache_prioritydeleter);
+    /* Leave room for tracking and image caches, which are used together with clips. */
+    IMB_moviecache_set_budget(moviecache, 0.5f);
 
     clip->cache->moviecache = moviecache;
     clip->cache->sequence_offset = -1;
@@ -26,6 +26,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "DNA_scene_types.h"
 #include "DNA_sequence_types.h"
 #include "DNA_space_types.h" /* for FILE_MAX. */
@@ -39,6 +41,7 @@
 #include "BLI_fileops.h"
 #include "BLI_fileops_types.h"
 #include "BLI_ghash.h"
+#include "BLI_heap.h"
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_path_util.h"
@@ -49,6 +52,18 @@
 #include "BKE_scene.h"
 #include "BKE_sequencer.h"
 
+#include "zlib.h"
+
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#  define LZO_HEAP_ALLOC(var, size) \
+    lzo_align_t __LZO_MMODEL var[((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
+#endif
+
 /**
  * Sequencer Cache Design Notes
  * ============================
@@ -73,6 +88,15 @@
  *
  * User can exclude caching of some images. Such entries will have is_temp_cache set.
  *
+ * Concurrency: items are distributed over SEQ_CACHE_SHARDS hash tables (shards), each with its
+ * own lock. Lookups only lock one shard, so rendering, prefetching and drawing threads don't
+ * contend on a single lock. Adding, removing and linking entries is still serialized by
+ * SeqCache.iterator_mutex (locked before any shard lock), as linking spans multiple entries.
+ *
+ * Recycling candidates (permanent entries at the end of a link chain, that are cheap enough
+ * to be re-rendered) are kept in two heaps ordered by frame, so the leftmost and rightmost
+ * candidate are found without iterating over all entries.
+ *
  *
  * Disk Cache Design Notes
  * =======================
@@ -81,8 +105,12 @@
  * For each cached non-temp image, image data and supplementary info are written to HDD.
  * Multiple(DCACHE_IMAGES_PER_FILE) images share the same file.
  * Each of these files contains header DiskCacheHeader followed by image data.
- * Zlib compression with user definable level can be used to compress image data(per image)
+ * Image data can be compressed (per image) with zlib (user definable level) or LZO,
+ * the codec is stored in the header entry, so files written with other settings remain readable.
  * Images are written in order in which they are rendered.
+ * Encoding and writing is done by a background thread (write-behind queue), reading only holds
+ * the file lock while reading the compressed data, decompression happens afterwards.
+ * If the queue is full, images are not written to disk to not block rendering.
  * Overwriting of individual entry is not possible.
  * Stored images are deleted by invalidation, or when size of all files exceeds maximum
  * size specified in user preferences.
@@ -94,11 +122,21 @@
 /* <cache type>-<resolution X>x<resolution Y>-<rendersize>%(<view_id>)-<frame no>.dcf */
 #define DCACHE_FNAME_FORMAT "%d-%dx%d-%d%%(%d)-%d.dcf"
 #define DCACHE_IMAGES_PER_FILE 100
-#define DCACHE_CURRENT_VERSION 1
+#define DCACHE_CURRENT_VERSION 2
+#define DCACHE_WRITE_QUEUE_MAX 32
+#define DCACHE_LZO_OUT_LEN(size) ((size) + (size) / 16 + 64 + 3)
 #define COLORSPACE_NAME_MAX 64 /* XXX: defined in imb intern */
 
+/* #DiskCacheHeaderEntry.codec */
+enum {
+  DCACHE_CODEC_ZLIB = 0,
+  DCACHE_CODEC_LZO = 1,
+  DCACHE_CODEC_RAW = 2,
+};
+
 typedef struct DiskCacheHeaderEntry {
   unsigned char encoding;
+  unsigned char codec;
   uint64_t frameno;
   uint64_t size_compressed;
   uint64_t size_raw;
@@ -116,8 +154,26 @@ typedef struct SeqDiskCache {
   ListBase files;
   ThreadMutex read_write_mutex;
   size_t size_total;
+
+  /* Images waiting to be written by `write_thread`, #DiskCacheWriteItem. */
+  ListBase write_queue;
+  int write_queue_len;
+  /* Incremented on invalidation, queued images of older generation are not written. */
+  int generation;
+  ThreadMutex write_queue_mutex;
+  ThreadCondition write_queue_cond;
+  ListBase write_thread;
+  bool write_thread_stop;
 } SeqDiskCache;
 
+typedef struct DiskCacheWriteItem {
+  struct DiskCacheWriteItem *next, *prev;
+  char path[FILE_MAX];
+  uint64_t frameno;
+  struct ImBuf *ibuf;
+  int generation;
+} DiskCacheWriteItem;
+
 typedef struct DiskCacheFile {
   struct DiskCacheFile *next, *prev;
   char path[FILE_MAX];
@@ -132,15 +188,29 @@ typedef struct DiskCacheFile {
   int start_frame;
 } DiskCacheFile;
 
+#define SEQ_CACHE_SHARDS 16
+
+typedef struct SeqCacheShard {
+  struct GHash *hash;
+  ThreadMutex mutex;
+} SeqCacheShard;
+
 typedef struct SeqCache {
   Main *bmain;
-  struct GHash *hash;
+  SeqCacheShard shards[SEQ_CACHE_SHARDS];
   ThreadMutex iterator_mutex;
   struct BLI_mempool *keys_pool;
   struct BLI_mempool *items_pool;
-  struct SeqCacheKey *last_key;
+  /* Last key put by each task, renders of different tasks can run at the same time. */
+  struct SeqCacheKey *last_key[SEQ_TASK_MAX];
   size_t memory_used;
   SeqDiskCache *disk_cache;
+  /* Recycling candidates ordered by frame, ascending and descending. */
+  struct Heap *recycle_heap_left;
+  struct Heap *recycle_heap_right;
+  /* #Editing.recycle_max_cost used to choose the candidates, heaps are rebuilt when it changes. */
+  float recycle_max_cost;
+  SeqCacheStats stats;
 } SeqCache;
 
 typedef struct SeqCacheItem {
@@ -161,11 +231,15 @@ typedef struct SeqCacheKey {
   /* ID of task for asigning temp cache entries to particular task(thread, etc.) */
   eSeqTaskId task_id;
   int type;
+  /* Nodes in recycle heaps, NULL when the key is not a recycling candidate. */
+  struct HeapNode *recycle_node_left;
+  struct HeapNode *recycle_node_right;
 } SeqCacheKey;
 
 static ThreadMutex cache_create_lock = BLI_MUTEX_INITIALIZER;
 static float seq_cache_cfra_to_frame_index(Sequence *seq, float cfra);
 static float seq_cache_frame_index_to_cfra(Sequence *seq, float nfra);
+static void seq_disk_cache_write_queue_clear(SeqDiskCache *disk_cache);
 
 static char *seq_disk_cache_base_dir(void)
 {
@@ -177,6 +251,7 @@ static int seq_disk_cache_compression_level(void)
   switch (U.sequencer_disk_cache_compression) {
     case USER_SEQ_DISK_CACHE_COMPRESSION_NONE:
       return 0;
+    case USER_SEQ_DISK_CACHE_COMPRESSION_FAST:
     case USER_SEQ_DISK_CACHE_COMPRESSION_LOW:
       return 1;
     case USER_SEQ_DISK_CACHE_COMPRESSION_HIGH:
@@ -466,6 +541,11 @@ static void seq_disk_cache_invalidate(Scene *scene,
 
   BLI_mutex_lock(&disk_cache->read_write_mutex);
 
+  /* Queued images may belong to invalidated files, drop them. */
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  seq_disk_cache_write_queue_clear(disk_cache);
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+
   start = seq_changed->startdisp - DCACHE_IMAGES_PER_FILE;
   end = seq_changed->enddisp;
 
@@ -474,31 +554,122 @@ static void seq_disk_cache_invalidate(Scene *scene,
   BLI_mutex_unlock(&disk_cache->read_write_mutex);
 }
 
-static size_t deflate_imbuf_to_file(ImBuf *ibuf,
-                                    FILE *file,
-                                    int level,
-                                    DiskCacheHeaderEntry *header_entry)
+/* Size in bytes of uncompressed image data. */
+static size_t seq_disk_cache_imbuf_size_raw(const ImBuf *ibuf)
 {
   if (ibuf->rect) {
-    return BLI_gzip_mem_to_file_at_pos(
-        ibuf->rect, header_entry->size_raw, file, header_entry->offset, level);
-  }
-  else {
-    return BLI_gzip_mem_to_file_at_pos(
-        ibuf->rect_float, header_entry->size_raw, file, header_entry->offset, level);
+    return (size_t)ibuf->x * ibuf->y * ibuf->channels;
   }
+  return (size_t)ibuf->x * ibuf->y * ibuf->channels * 4;
 }
 
-static size_t inflate_file_to_imbuf(ImBuf *ibuf, FILE *file, DiskCacheHeaderEntry *header_entry)
+static int seq_disk_cache_codec(void)
 {
-  if (ibuf->rect) {
-    return BLI_ungzip_file_to_mem_at_pos(
-        ibuf->rect, header_entry->size_raw, file, header_entry->offset);
+  switch (U.sequencer_disk_cache_compression) {
+    case USER_SEQ_DISK_CACHE_COMPRESSION_NONE:
+      return DCACHE_CODEC_RAW;
+    case USER_SEQ_DISK_CACHE_COMPRESSION_FAST:
+#ifdef WITH_LZO
+      return DCACHE_CODEC_LZO;
+#else
+      /* Fall back to fastest zlib level. */
+      return DCACHE_CODEC_ZLIB;
+#endif
+  }
+  return DCACHE_CODEC_ZLIB;
+}
+
+/**
+ * Compress image data to memory.
+ *
+ * \param r_codec: The codec used, may differ from the requested one
+ * (data which can't be compressed is stored raw).
+ * \return Encoded data, owned by the caller, NULL on failure.
+ */
+static void *seq_disk_cache_encode(const ImBuf *ibuf,
+                                   int codec,
+                                   size_t *r_size_compressed,
+                                   int *r_codec)
+{
+  const void *data = ibuf->rect ? (const void *)ibuf->rect : (const void *)ibuf->rect_float;
+  const size_t size_raw = seq_disk_cache_imbuf_size_raw(ibuf);
+  void *encoded = NULL;
+
+  if (codec == DCACHE_CODEC_ZLIB) {
+    uLongf size_compressed = compressBound((uLong)size_raw);
+    encoded = MEM_mallocN(size_compressed, __func__);
+    const int level = seq_disk_cache_compression_level();
+    if (compress2(encoded, &size_compressed, data, (uLong)size_raw, level) == Z_OK) {
+      *r_size_compressed = size_compressed;
+      *r_codec = DCACHE_CODEC_ZLIB;
+      return encoded;
+    }
+    MEM_freeN(encoded);
+    return NULL;
   }
-  else {
-    return BLI_ungzip_file_to_mem_at_pos(
-        ibuf->rect_float, header_entry->size_raw, file, header_entry->offset);
+
+#ifdef WITH_LZO
+  if (codec == DCACHE_CODEC_LZO) {
+    lzo_uint size_compressed = DCACHE_LZO_OUT_LEN(size_raw);
+    encoded = MEM_mallocN(size_compressed, __func__);
+    LZO_HEAP_ALLOC(wrkmem, LZO1X_MEM_COMPRESS);
+    if (lzo1x_1_compress(data, (lzo_uint)size_raw, encoded, &size_compressed, wrkmem) ==
+            LZO_E_OK &&
+        size_compressed < size_raw) {
+      *r_size_compressed = size_compressed;
+      *r_codec = DCACHE_CODEC_LZO;
+      return encoded;
+    }
+    MEM_freeN(encoded);
+    /* Incompressible data, store it raw. */
   }
+#endif
+
+  encoded = MEM_mallocN(size_raw, __func__);
+  memcpy(encoded, data, size_raw);
+  *r_size_compressed = size_raw;
+  *r_codec = DCACHE_CODEC_RAW;
+  return encoded;
+}
+
+/**
+ * Decompress image data read from a file into the image buffer.
+ * \return size of the decompressed data.
+ */
+static size_t seq_disk_cache_decode(ImBuf *ibuf,
+                                    const void *encoded,
+                                    const DiskCacheHeaderEntry *header_entry)
+{
+  void *data = ibuf->rect ? (void *)ibuf->rect : (void *)ibuf->rect_float;
+
+  switch (header_entry->codec) {
+    case DCACHE_CODEC_ZLIB: {
+      uLongf size = (uLongf)header_entry->size_raw;
+      if (uncompress(data, &size, encoded, (uLong)header_entry->size_compressed) != Z_OK) {
+        return 0;
+      }
+      return size;
+    }
+    case DCACHE_CODEC_LZO: {
+#ifdef WITH_LZO
+      lzo_uint size = (lzo_uint)header_entry->size_raw;
+      if (lzo1x_decompress_safe(
+              encoded, (lzo_uint)header_entry->size_compressed, data, &size, NULL) != LZO_E_OK) {
+        return 0;
+      }
+      return size;
+#else
+      return 0;
+#endif
+    }
+    case DCACHE_CODEC_RAW:
+      if (header_entry->size_compressed != header_entry->size_raw) {
+        return 0;
+      }
+      memcpy(data, encoded, header_entry->size_raw);
+      return header_entry->size_raw;
+  }
+  return 0;
 }
 
 static void seq_disk_cache_read_header(FILE *file, DiskCacheHeader *header)
@@ -522,7 +693,9 @@ static size_t seq_disk_cache_write_header(FILE *file, DiskCacheHeader *header)
   return fwrite(header, sizeof(*header), 1, file);
 }
 
-static int seq_disk_cache_add_header_entry(SeqCacheKey *key, ImBuf *ibuf, DiskCacheHeader *header)
+static int seq_disk_cache_add_header_entry(uint64_t frameno,
+                                           const ImBuf *ibuf,
+                                           DiskCacheHeader *header)
 {
   int i;
   uint64_t offset = sizeof(*header);
@@ -555,17 +728,16 @@ static int seq_disk_cache_add_header_entry(SeqCacheKey *key, ImBuf *ibuf, DiskCa
   }
 
   header->entry[i].offset = offset;
-  header->entry[i].frameno = key->nfra;
+  header->entry[i].frameno = frameno;
+  header->entry[i].size_raw = seq_disk_cache_imbuf_size_raw(ibuf);
 
   /* Store colorspace name of ibuf. */
   const char *colorspace_name;
   if (ibuf->rect) {
-    header->entry[i].size_raw = ibuf->x * ibuf->y * ibuf->channels;
-    colorspace_name = IMB_colormanagement_get_rect_colorspace(ibuf);
+    colorspace_name = IMB_colormanagement_get_rect_colorspace((ImBuf *)ibuf);
   }
   else {
-    header->entry[i].size_raw = ibuf->x * ibuf->y * ibuf->channels * 4;
-    colorspace_name = IMB_colormanagement_get_float_colorspace(ibuf);
+    colorspace_name = IMB_colormanagement_get_float_colorspace((ImBuf *)ibuf);
   }
   BLI_strncpy(
       header->entry[i].colorspace_name, colorspace_name, sizeof(header->entry[i].colorspace_name));
@@ -584,42 +756,45 @@ static int seq_disk_cache_get_header_entry(SeqCacheKey *key, DiskCacheHeader *he
   return -1;
 }
 
-static bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf *ibuf)
+/* Write already encoded image data, #SeqDiskCache.read_write_mutex must be locked. */
+static bool seq_disk_cache_write_file(SeqDiskCache *disk_cache,
+                                      DiskCacheWriteItem *item,
+                                      const void *encoded,
+                                      size_t size_compressed,
+                                      int codec)
 {
-  char path[FILE_MAX];
+  BLI_make_existing_file(item->path);
 
-  seq_disk_cache_get_file_path(disk_cache, key, path, sizeof(path));
-  BLI_make_existing_file(path);
-
-  FILE *file = BLI_fopen(path, "rb+");
+  FILE *file = BLI_fopen(item->path, "rb+");
   if (!file) {
-    file = BLI_fopen(path, "wb+");
+    file = BLI_fopen(item->path, "wb+");
     if (!file) {
       return false;
     }
-    seq_disk_cache_add_file_to_list(disk_cache, path);
+    seq_disk_cache_add_file_to_list(disk_cache, item->path);
   }
 
   DiskCacheHeader header;
   memset(&header, 0, sizeof(header));
   seq_disk_cache_read_header(file, &header);
-  int entry_index = seq_disk_cache_add_header_entry(key, ibuf, &header);
-  size_t bytes_written = deflate_imbuf_to_file(
-      ibuf, file, seq_disk_cache_compression_level(), &header.entry[entry_index]);
+  int entry_index = seq_disk_cache_add_header_entry(item->frameno, item->ibuf, &header);
+  DiskCacheHeaderEntry *header_entry = &header.entry[entry_index];
+
+  bool ok = (fseek(file, (long)header_entry->offset, SEEK_SET) == 0 &&
+             fwrite(encoded, 1, size_compressed, file) == size_compressed);
 
-  if (bytes_written != 0) {
+  if (ok) {
     /* Last step is writing header, as image data can be overwritten,
      * but missing data would cause problems.
      */
-    header.entry[entry_index].size_compressed = bytes_written;
+    header_entry->size_compressed = size_compressed;
+    header_entry->codec = (unsigned char)codec;
     seq_disk_cache_write_header(file, &header);
-    seq_disk_cache_update_file(disk_cache, path);
-    fclose(file);
-
-    return true;
   }
+  fclose(file);
+  seq_disk_cache_update_file(disk_cache, item->path);
 
-  return false;
+  return ok;
 }
 
 static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *key)
@@ -628,10 +803,14 @@ static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *ke
   DiskCacheHeader header;
 
   seq_disk_cache_get_file_path(disk_cache, key, path, sizeof(path));
-  BLI_make_existing_file(path);
+
+  /* Only reading the file needs a lock, decoding is done afterwards so other threads
+   * (prefetching for e.g.) can read or write meanwhile. */
+  BLI_mutex_lock(&disk_cache->read_write_mutex);
 
   FILE *file = BLI_fopen(path, "rb");
   if (!file) {
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
     return NULL;
   }
 
@@ -641,6 +820,24 @@ static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *ke
   /* Item not found. */
   if (entry_index < 0) {
     fclose(file);
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
+    return NULL;
+  }
+
+  const DiskCacheHeaderEntry header_entry = header.entry[entry_index];
+  void *encoded = MEM_mallocN(header_entry.size_compressed, __func__);
+  const bool ok = (fseek(file, (long)header_entry.offset, SEEK_SET) == 0 &&
+                   fread(encoded, 1, header_entry.size_compressed, file) ==
+                       header_entry.size_compressed);
+  fclose(file);
+  if (ok) {
+    BLI_file_touch(path);
+    seq_disk_cache_update_file(disk_cache, path);
+  }
+  BLI_mutex_unlock(&disk_cache->read_write_mutex);
+
+  if (!ok) {
+    MEM_freeN(encoded);
     return NULL;
   }
 
@@ -649,36 +846,155 @@ static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *ke
   uint64_t size_float = (uint64_t)key->context.rectx * key->context.recty * 16;
   size_t expected_size;
 
-  if (header.entry[entry_index].size_raw == size_char) {
+  if (header_entry.size_raw == size_char) {
     expected_size = size_char;
     ibuf = IMB_allocImBuf(key->context.rectx, key->context.recty, 32, IB_rect);
-    IMB_colormanagement_assign_rect_colorspace(ibuf, header.entry[entry_index].colorspace_name);
+    IMB_colormanagement_assign_rect_colorspace(ibuf, header_entry.colorspace_name);
   }
-  else if (header.entry[entry_index].size_raw == size_float) {
+  else if (header_entry.size_raw == size_float) {
     expected_size = size_float;
     ibuf = IMB_allocImBuf(key->context.rectx, key->context.recty, 32, IB_rectfloat);
-    IMB_colormanagement_assign_float_colorspace(ibuf, header.entry[entry_index].colorspace_name);
+    IMB_colormanagement_assign_float_colorspace(ibuf, header_entry.colorspace_name);
   }
   else {
-    fclose(file);
+    MEM_freeN(encoded);
     return NULL;
   }
 
-  size_t bytes_read = inflate_file_to_imbuf(ibuf, file, &header.entry[entry_index]);
+  size_t bytes_read = seq_disk_cache_decode(ibuf, encoded, &header_entry);
+  MEM_freeN(encoded);
 
   /* Sanity check. */
   if (bytes_read != expected_size) {
-    fclose(file);
     IMB_freeImBuf(ibuf);
     return NULL;
   }
-  BLI_file_touch(path);
-  seq_disk_cache_update_file(disk_cache, path);
-  fclose(file);
 
   return ibuf;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Disk Cache Write-Behind Queue
+ *
+ * Images are encoded and written to disk by a background thread,
+ * so rendering (and playback) doesn't wait for compression and I/O.
+ * \{ */
+
+static void seq_disk_cache_write_item_free(DiskCacheWriteItem *item)
+{
+  IMB_freeImBuf(item->ibuf);
+  MEM_freeN(item);
+}
+
+static void *seq_disk_cache_write_thread(void *disk_cache_v)
+{
+  SeqDiskCache *disk_cache = disk_cache_v;
+
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  while (true) {
+    while (BLI_listbase_is_empty(&disk_cache->write_queue) && !disk_cache->write_thread_stop) {
+      BLI_condition_wait(&disk_cache->write_queue_cond, &disk_cache->write_queue_mutex);
+    }
+    if (disk_cache->write_thread_stop) {
+      break;
+    }
+    DiskCacheWriteItem *item = BLI_pophead(&disk_cache->write_queue);
+    disk_cache->write_queue_len--;
+    BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+
+    size_t size_compressed;
+    int codec;
+    void *encoded = seq_disk_cache_encode(
+        item->ibuf, seq_disk_cache_codec(), &size_compressed, &codec);
+
+    if (encoded != NULL) {
+      BLI_mutex_lock(&disk_cache->read_write_mutex);
+      /* Files may have been invalidated while encoding, the data is outdated then. */
+      BLI_mutex_lock(&disk_cache->write_queue_mutex);
+      const bool is_valid = (item->generation == disk_cache->generation);
+      BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+      if (is_valid) {
+        seq_disk_cache_write_file(disk_cache, item, encoded, size_compressed, codec);
+      }
+      BLI_mutex_unlock(&disk_cache->read_write_mutex);
+      MEM_freeN(encoded);
+
+      if (is_valid) {
+        seq_disk_cache_enforce_limits(disk_cache);
+      }
+    }
+    seq_disk_cache_write_item_free(item);
+
+    BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  }
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+
+  return NULL;
+}
+
+static void seq_disk_cache_write_queue_init(SeqDiskCache *disk_cache)
+{
+  BLI_mutex_init(&disk_cache->write_queue_mutex);
+  BLI_condition_init(&disk_cache->write_queue_cond);
+  BLI_threadpool_init(&disk_cache->write_thread, seq_disk_cache_write_thread, 1);
+  BLI_threadpool_insert(&disk_cache->write_thread, disk_cache);
+}
+
+/* Drop images waiting to be written, must be called with the write queue locked. */
+static void seq_disk_cache_write_queue_clear(SeqDiskCache *disk_cache)
+{
+  DiskCacheWriteItem *item;
+  while ((item = BLI_pophead(&disk_cache->write_queue))) {
+    seq_disk_cache_write_item_free(item);
+  }
+  disk_cache->write_queue_len = 0;
+  disk_cache->generation++;
+}
+
+static void seq_disk_cache_write_queue_end(SeqDiskCache *disk_cache)
+{
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  disk_cache->write_thread_stop = true;
+  seq_disk_cache_write_queue_clear(disk_cache);
+  BLI_condition_notify_all(&disk_cache->write_queue_cond);
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+
+  BLI_threadpool_end(&disk_cache->write_thread);
+  BLI_condition_end(&disk_cache->write_queue_cond);
+  BLI_mutex_end(&disk_cache->write_queue_mutex);
+}
+
+/**
+ * Queue an image to be written to the disk cache.
+ * When the queue is full (storage slower than rendering) the image is not written,
+ * it's still in the memory cache.
+ */
+static void seq_disk_cache_write_queue_add(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf *ibuf)
+{
+  /* The path is computed now, the strip may be freed before the image is written. */
+  DiskCacheWriteItem *item = MEM_callocN(sizeof(*item), __func__);
+  seq_disk_cache_get_file_path(disk_cache, key, item->path, sizeof(item->path));
+  item->frameno = (uint64_t)key->nfra;
+  item->ibuf = ibuf;
+  IMB_refImBuf(ibuf);
+
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  if (disk_cache->write_queue_len < DCACHE_WRITE_QUEUE_MAX) {
+    item->generation = disk_cache->generation;
+    BLI_addtail(&disk_cache->write_queue, item);
+    disk_cache->write_queue_len++;
+    BLI_condition_notify_one(&disk_cache->write_queue_cond);
+    item = NULL;
+  }
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+
+  if (item != NULL) {
+    seq_disk_cache_write_item_free(item);
+  }
+}
+
+/** \} */
+
 #undef DCACHE_FNAME_FORMAT
 #undef DCACHE_IMAGES_PER_FILE
 #undef COLORSPACE_NAME_MAX
@@ -770,9 +1086,81 @@ static size_t seq_cache_get_mem_total(void)
   return ((size_t)U.memcachelimit) * 1024 * 1024;
 }
 
+static SeqCacheShard *seq_cache_shard_get(SeqCache *cache, const SeqCacheKey *key)
+{
+  /* Mix the hash, its low bits are not well distributed. */
+  const unsigned int hash = seq_cache_hashhash(key) * 2654435761u;
+  return &cache->shards[(hash >> 16) % SEQ_CACHE_SHARDS];
+}
+
+static bool seq_cache_key_is_recyclable(const SeqCache *cache, const SeqCacheKey *key)
+{
+  return !key->is_temp_cache && key->link_next == NULL && key->cost <= cache->recycle_max_cost;
+}
+
+static void seq_cache_recycle_heap_remove(SeqCache *cache, SeqCacheKey *key)
+{
+  if (key->recycle_node_left) {
+    BLI_heap_remove(cache->recycle_heap_left, key->recycle_node_left);
+    BLI_heap_remove(cache->recycle_heap_right, key->recycle_node_right);
+    key->recycle_node_left = NULL;
+    key->recycle_node_right = NULL;
+  }
+}
+
+/* Must be called when any property checked by #seq_cache_key_is_recyclable changes. */
+static void seq_cache_recycle_heap_update(SeqCache *cache, SeqCacheKey *key)
+{
+  if (!seq_cache_key_is_recyclable(cache, key)) {
+    seq_cache_recycle_heap_remove(cache, key);
+    return;
+  }
+
+  if (key->recycle_node_left == NULL) {
+    const float cfra = seq_cache_frame_index_to_cfra(key->seq, key->nfra);
+    key->recycle_node_left = BLI_heap_insert(cache->recycle_heap_left, cfra, key);
+    key->recycle_node_right = BLI_heap_insert(cache->recycle_heap_right, -cfra, key);
+  }
+}
+
+/**
+ * Key with the lowest priority in a recycle heap. Priorities are the frame of the key when it was
+ * inserted (negated for the right heap), they are updated here when the strip moved since then.
+ */
+static SeqCacheKey *seq_cache_recycle_heap_top(Heap *heap, const float sign)
+{
+  while (!BLI_heap_is_empty(heap)) {
+    HeapNode *node = BLI_heap_top(heap);
+    SeqCacheKey *key = BLI_heap_node_ptr(node);
+    const float value = sign * seq_cache_frame_index_to_cfra(key->seq, key->nfra);
+    if (value == BLI_heap_node_value(node)) {
+      return key;
+    }
+    BLI_heap_node_value_update(heap, node, value);
+  }
+  return NULL;
+}
+
+static void seq_cache_recycle_heap_rebuild(SeqCache *cache, float recycle_max_cost)
+{
+  cache->recycle_max_cost = recycle_max_cost;
+  BLI_heap_clear(cache->recycle_heap_left, NULL);
+  BLI_heap_clear(cache->recycle_heap_right, NULL);
+
+  for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+    GHASH_FOREACH_BEGIN (SeqCacheKey *, key, cache->shards[i].hash) {
+      key->recycle_node_left = NULL;
+      key->recycle_node_right = NULL;
+      seq_cache_recycle_heap_update(cache, key);
+    }
+    GHASH_FOREACH_END();
+  }
+}
+
 static void seq_cache_keyfree(void *val)
 {
   SeqCacheKey *key = val;
+  seq_cache_recycle_heap_remove(key->cache_owner, key);
   BLI_mempool_free(key->cache_owner->keys_pool, key);
 }
 
@@ -789,6 +1177,7 @@ static void seq_cache_valfree(void *val)
   BLI_mempool_free(item->cache_owner->items_pool, item);
 }
 
+/* Cache must be locked. */
 static void seq_cache_put(SeqCache *cache, SeqCacheKey *key, ImBuf *ibuf)
 {
   SeqCacheItem *item;
@@ -796,24 +1185,67 @@ static void seq_cache_put(SeqCache *cache, SeqCacheKey *key, ImBuf *ibuf)
   item->cache_owner = cache;
   item->ibuf = ibuf;
 
-  if (BLI_ghash_reinsert(cache->hash, key, item, seq_cache_keyfree, seq_cache_valfree)) {
-    IMB_refImBuf(ibuf);
-    cache->last_key = key;
-    cache->memory_used += IMB_get_size_in_memory(ibuf);
-  }
+  /* The cache is locked and the key was looked up, so it can't be in the cache yet. Replacing
+   * a key would free it while other keys still link to it. */
+  SeqCacheShard *shard = seq_cache_shard_get(cache, key);
+  BLI_mutex_lock(&shard->mutex);
+  BLI_ghash_insert(shard->hash, key, item);
+  BLI_mutex_unlock(&shard->mutex);
+
+  IMB_refImBuf(ibuf);
+  cache->last_key[key->task_id] = key;
+  cache->memory_used += IMB_get_size_in_memory(ibuf);
 }
 
+/* Doesn't need the cache to be locked, only the shard of the key is locked. */
 static ImBuf *seq_cache_get(SeqCache *cache, SeqCacheKey *key)
 {
-  SeqCacheItem *item = BLI_ghash_lookup(cache->hash, key);
+  SeqCacheShard *shard = seq_cache_shard_get(cache, key);
+  ImBuf *ibuf = NULL;
 
+  BLI_mutex_lock(&shard->mutex);
+  SeqCacheItem *item = BLI_ghash_lookup(shard->hash, key);
   if (item && item->ibuf) {
-    IMB_refImBuf(item->ibuf);
+    ibuf = item->ibuf;
+    IMB_refImBuf(ibuf);
+  }
+  BLI_mutex_unlock(&shard->mutex);
+
+  return ibuf;
+}
+
+/* Cache must be locked. */
+static void seq_cache_remove(SeqCache *cache, SeqCacheKey *key)
+{
+  SeqCacheShard *shard = seq_cache_shard_get(cache, key);
 
-    return item->ibuf;
+  BLI_mutex_lock(&shard->mutex);
+  BLI_ghash_remove(shard->hash, key, seq_cache_keyfree, seq_cache_valfree);
+  BLI_mutex_unlock(&shard->mutex);
+}
+
+/* Lookup image in RAM cache, `context` and `seq` must not be prefetch copies. */
+static ImBuf *seq_cache_lookup(SeqCache *cache,
+                               const SeqRenderData *context,
+                               Sequence *seq,
+                               float cfra,
+                               int type,
+                               SeqCacheKey *r_key)
+{
+  r_key->seq = seq;
+  r_key->context = *context;
+  r_key->nfra = seq_cache_cfra_to_frame_index(seq, cfra);
+  r_key->type = type;
+
+  if (cache == NULL) {
+    return NULL;
   }
+  return seq_cache_get(cache, r_key);
+}
 
-  return NULL;
+static void seq_cache_last_key_reset(SeqCache *cache)
+{
+  memset(cache->last_key, 0, sizeof(cache->last_key));
 }
 
 static void seq_cache_relink_keys(SeqCacheKey *link_next, SeqCacheKey *link_prev)
@@ -906,78 +1338,34 @@ static void seq_cache_recycle_linked(Scene *scene, SeqCacheKey *base)
 
   while (base) {
     SeqCacheKey *prev = base->link_prev;
-    BLI_ghash_remove(cache->hash, base, seq_cache_keyfree, seq_cache_valfree);
+    seq_cache_remove(cache, base);
     base = prev;
   }
 
   base = next;
   while (base) {
     next = base->link_next;
-    BLI_ghash_remove(cache->hash, base, seq_cache_keyfree, seq_cache_valfree);
+    seq_cache_remove(cache, base);
     base = next;
   }
+
+  atomic_add_and_fetch_z(&cache->stats.evictions, 1);
 }
 
 static SeqCacheKey *seq_cache_get_item_for_removal(Scene *scene)
 {
   SeqCache *cache = seq_cache_get_from_scene(scene);
-  SeqCacheKey *finalkey = NULL;
-  /* Leftmost key. */
-  SeqCacheKey *lkey = NULL;
-  /* Rightmost key. */
-  SeqCacheKey *rkey = NULL;
-  SeqCacheKey *key = NULL;
-
-  GHashIterator gh_iter;
-  BLI_ghashIterator_init(&gh_iter, cache->hash);
-  int total_count = 0;
-  int cheap_count = 0;
-
-  while (!BLI_ghashIterator_done(&gh_iter)) {
-    key = BLI_ghashIterator_getKey(&gh_iter);
-    SeqCacheItem *item = BLI_ghashIterator_getValue(&gh_iter);
-    BLI_ghashIterator_step(&gh_iter);
-
-    /* This shouldn't happen, but better be safe than sorry. */
-    if (!item->ibuf) {
-      seq_cache_recycle_linked(scene, key);
-      /* Can not continue iterating after linked remove. */
-      BLI_ghashIterator_init(&gh_iter, cache->hash);
-      continue;
-    }
 
-    if (key->is_temp_cache || key->link_next != NULL) {
-      continue;
-    }
-
-    total_count++;
-
-    if (key->cost <= scene->ed->recycle_max_cost) {
-      cheap_count++;
-      if (lkey) {
-        if (seq_cache_frame_index_to_cfra(key->seq, key->nfra) <
-            seq_cache_frame_index_to_cfra(lkey->seq, lkey->nfra)) {
-          lkey = key;
-        }
-      }
-      else {
-        lkey = key;
-      }
-      if (rkey) {
-        if (seq_cache_frame_index_to_cfra(key->seq, key->nfra) >
-            seq_cache_frame_index_to_cfra(rkey->seq, rkey->nfra)) {
-          rkey = key;
-        }
-      }
-      else {
-        rkey = key;
-      }
-    }
+  if (cache->recycle_max_cost != scene->ed->recycle_max_cost) {
+    seq_cache_recycle_heap_rebuild(cache, scene->ed->recycle_max_cost);
   }
 
-  finalkey = seq_cache_choose_key(scene, lkey, rkey);
+  /* Leftmost key. */
+  SeqCacheKey *lkey = seq_cache_recycle_heap_top(cache->recycle_heap_left, 1.0f);
+  /* Rightmost key. */
+  SeqCacheKey *rkey = seq_cache_recycle_heap_top(cache->recycle_heap_right, -1.0f);
 
-  return finalkey;
+  return seq_cache_choose_key(scene, lkey, rkey);
 }
 
 /* Find only "base" keys.
@@ -1021,6 +1409,7 @@ static void seq_cache_set_temp_cache_linked(Scene *scene, SeqCacheKey *base)
   while (base) {
     SeqCacheKey *prev = base->link_prev;
     base->is_temp_cache = true;
+    seq_cache_recycle_heap_update(cache, base);
     base = prev;
   }
 
@@ -1028,6 +1417,7 @@ static void seq_cache_set_temp_cache_linked(Scene *scene, SeqCacheKey *base)
   while (base) {
     next = base->link_next;
     base->is_temp_cache = true;
+    seq_cache_recycle_heap_update(cache, base);
     base = next;
   }
 }
@@ -1037,11 +1427,8 @@ static void seq_disk_cache_create(Main *bmain, Scene *scene)
   BLI_mutex_lock(&cache_create_lock);
   SeqCache *cache = seq_cache_get_from_scene(scene);
 
-  if (cache == NULL) {
-    return;
-  }
-
-  if (cache->disk_cache != NULL) {
+  if (cache == NULL || cache->disk_cache != NULL) {
+    BLI_mutex_unlock(&cache_create_lock);
     return;
   }
 
@@ -1051,6 +1438,7 @@ static void seq_disk_cache_create(Main *bmain, Scene *scene)
   seq_disk_cache_handle_versioning(cache->disk_cache);
   seq_disk_cache_get_files(cache->disk_cache, seq_disk_cache_base_dir());
   cache->disk_cache->timestamp = scene->ed->disk_cache_timestamp;
+  seq_disk_cache_write_queue_init(cache->disk_cache);
   BLI_mutex_unlock(&cache_create_lock);
 }
 
@@ -1061,8 +1449,14 @@ static void seq_cache_create(Main *bmain, Scene *scene)
     SeqCache *cache = MEM_callocN(sizeof(SeqCache), "SeqCache");
     cache->keys_pool = BLI_mempool_create(sizeof(SeqCacheKey), 0, 64, BLI_MEMPOOL_NOP);
     cache->items_pool = BLI_mempool_create(sizeof(SeqCacheItem), 0, 64, BLI_MEMPOOL_NOP);
-    cache->hash = BLI_ghash_new(seq_cache_hashhash, seq_cache_hashcmp, "SeqCache hash");
-    cache->last_key = NULL;
+    for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+      cache->shards[i].hash = BLI_ghash_new(
+          seq_cache_hashhash, seq_cache_hashcmp, "SeqCache hash");
+      BLI_mutex_init(&cache->shards[i].mutex);
+    }
+    cache->recycle_heap_left = BLI_heap_new();
+    cache->recycle_heap_right = BLI_heap_new();
+    cache->recycle_max_cost = scene->ed->recycle_max_cost;
     cache->bmain = bmain;
     BLI_mutex_init(&cache->iterator_mutex);
     scene->ed->cache = cache;
@@ -1085,16 +1479,23 @@ void BKE_sequencer_cache_free_temp_cache(Scene *scene, short id, int cfra)
 
   seq_cache_lock(scene);
 
-  GHashIterator gh_iter;
-  BLI_ghashIterator_init(&gh_iter, cache->hash);
-  while (!BLI_ghashIterator_done(&gh_iter)) {
-    SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
-    BLI_ghashIterator_step(&gh_iter);
+  for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+    SeqCacheShard *shard = &cache->shards[i];
+    BLI_mutex_lock(&shard->mutex);
 
-    if (key->is_temp_cache && key->task_id == id &&
-        seq_cache_frame_index_to_cfra(key->seq, key->nfra) != cfra) {
-      BLI_ghash_remove(cache->hash, key, seq_cache_keyfree, seq_cache_valfree);
+    GHashIterator gh_iter;
+    BLI_ghashIterator_init(&gh_iter, shard->hash);
+    while (!BLI_ghashIterator_done(&gh_iter)) {
+      SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
+      BLI_ghashIterator_step(&gh_iter);
+
+      if (key->is_temp_cache && key->task_id == id &&
+          seq_cache_frame_index_to_cfra(key->seq, key->nfra) != cfra) {
+        BLI_ghash_remove(shard->hash, key, seq_cache_keyfree, seq_cache_valfree);
+      }
     }
+
+    BLI_mutex_unlock(&shard->mutex);
   }
   seq_cache_unlock(scene);
 }
@@ -1106,12 +1507,18 @@ void BKE_sequencer_cache_destruct(Scene *scene)
     return;
   }
 
-  BLI_ghash_free(cache->hash, seq_cache_keyfree, seq_cache_valfree);
+  for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+    BLI_ghash_free(cache->shards[i].hash, seq_cache_keyfree, seq_cache_valfree);
+    BLI_mutex_end(&cache->shards[i].mutex);
+  }
+  BLI_heap_free(cache->recycle_heap_left, NULL);
+  BLI_heap_free(cache->recycle_heap_right, NULL);
   BLI_mempool_destroy(cache->keys_pool);
   BLI_mempool_destroy(cache->items_pool);
   BLI_mutex_end(&cache->iterator_mutex);
 
   if (cache->disk_cache != NULL) {
+    seq_disk_cache_write_queue_end(cache->disk_cache);
     BLI_freelistN(&cache->disk_cache->files);
     BLI_mutex_end(&cache->disk_cache->read_write_mutex);
     MEM_freeN(cache->disk_cache);
@@ -1138,15 +1545,13 @@ void BKE_sequencer_cache_cleanup(Scene *scene)
 
   seq_cache_lock(scene);
 
-  GHashIterator gh_iter;
-  BLI_ghashIterator_init(&gh_iter, cache->hash);
-  while (!BLI_ghashIterator_done(&gh_iter)) {
-    SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
-
-    BLI_ghashIterator_step(&gh_iter);
-    BLI_ghash_remove(cache->hash, key, seq_cache_keyfree, seq_cache_valfree);
+  for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+    SeqCacheShard *shard = &cache->shards[i];
+    BLI_mutex_lock(&shard->mutex);
+    BLI_ghash_clear(shard->hash, seq_cache_keyfree, seq_cache_valfree);
+    BLI_mutex_unlock(&shard->mutex);
   }
-  cache->last_key = NULL;
+  seq_cache_last_key_reset(cache);
   seq_cache_unlock(scene);
 }
 
@@ -1184,33 +1589,40 @@ void BKE_sequencer_cache_cleanup_sequence(Scene *scene,
   int invalidate_source = invalidate_types & (SEQ_CACHE_STORE_RAW | SEQ_CACHE_STORE_PREPROCESSED |
                                               SEQ_CACHE_STORE_COMPOSITE);
 
-  GHashIterator gh_iter;
-  BLI_ghashIterator_init(&gh_iter, cache->hash);
-  while (!BLI_ghashIterator_done(&gh_iter)) {
-    SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
-    BLI_ghashIterator_step(&gh_iter);
-
-    int key_cfra = seq_cache_frame_index_to_cfra(key->seq, key->nfra);
+  for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+    SeqCacheShard *shard = &cache->shards[i];
+    BLI_mutex_lock(&shard->mutex);
+
+    GHashIterator gh_iter;
+    BLI_ghashIterator_init(&gh_iter, shard->hash);
+    while (!BLI_ghashIterator_done(&gh_iter)) {
+      SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
+      BLI_ghashIterator_step(&gh_iter);
+
+      int key_cfra = seq_cache_frame_index_to_cfra(key->seq, key->nfra);
+
+      /* Clean all final and composite in intersection of seq and seq_changed. */
+      const bool remove_composite = key->type & invalidate_composite &&
+                                    key_cfra >= range_start && key_cfra <= range_end;
+      const bool remove_source = key->type & invalidate_source && key->seq == seq &&
+                                 key_cfra >= seq_changed->startdisp &&
+                                 key_cfra <= seq_changed->enddisp;
+
+      if (remove_composite || remove_source) {
+        if (key->link_next || key->link_prev) {
+          seq_cache_relink_keys(key->link_next, key->link_prev);
+          if (key->link_prev) {
+            seq_cache_recycle_heap_update(cache, key->link_prev);
+          }
+        }
 
-    /* Clean all final and composite in intersection of seq and seq_changed. */
-    if (key->type & invalidate_composite && key_cfra >= range_start && key_cfra <= range_end) {
-      if (key->link_next || key->link_prev) {
-        seq_cache_relink_keys(key->link_next, key->link_prev);
+        BLI_ghash_remove(shard->hash, key, seq_cache_keyfree, seq_cache_valfree);
       }
-
-      BLI_ghash_remove(cache->hash, key, seq_cache_keyfree, seq_cache_valfree);
     }
 
-    if (key->type & invalidate_source && key->seq == seq && key_cfra >= seq_changed->startdisp &&
-        key_cfra <= seq_changed->enddisp) {
-      if (key->link_next || key->link_prev) {
-        seq_cache_relink_keys(key->link_next, key->link_prev);
-      }
-
-      BLI_ghash_remove(cache->hash, key, seq_cache_keyfree, seq_cache_valfree);
-    }
+    BLI_mutex_unlock(&shard->mutex);
   }
-  cache->last_key = NULL;
+  seq_cache_last_key_reset(cache);
   seq_cache_unlock(scene);
 }
 
@@ -1238,23 +1650,14 @@ struct ImBuf *BKE_sequencer_cache_get(
     seq_cache_create(context->bmain, scene);
   }
 
-  seq_cache_lock(scene);
   SeqCache *cache = seq_cache_get_from_scene(scene);
-  ImBuf *ibuf = NULL;
   SeqCacheKey key;
 
   /* Try RAM cache: */
-  if (cache && seq) {
-    key.seq = seq;
-    key.context = *context;
-    key.nfra = seq_cache_cfra_to_frame_index(seq, cfra);
-    key.type = type;
-
-    ibuf = seq_cache_get(cache, &key);
-  }
-  seq_cache_unlock(scene);
+  ImBuf *ibuf = seq_cache_lookup(cache, context, seq, cfra, type, &key);
 
   if (ibuf) {
+    atomic_add_and_fetch_z(&cache->stats.hits, 1);
     return ibuf;
   }
 
@@ -1264,20 +1667,21 @@ struct ImBuf *BKE_sequencer_cache_get(
       seq_disk_cache_create(context->bmain, context->scene);
     }
 
-    BLI_mutex_lock(&cache->disk_cache->read_write_mutex);
     ibuf = seq_disk_cache_read_file(cache->disk_cache, &key);
-    BLI_mutex_unlock(&cache->disk_cache->read_write_mutex);
     if (ibuf) {
+      atomic_add_and_fetch_z(&cache->stats.disk_hits, 1);
       if (key.type == SEQ_CACHE_STORE_FINAL_OUT) {
         BKE_sequencer_cache_put_if_possible(context, seq, cfra, type, ibuf, 0.0f, true);
       }
       else {
         BKE_sequencer_cache_put(context, seq, cfra, type, ibuf, 0.0f, true);
       }
+      return ibuf;
     }
   }
 
-  return ibuf;
+  atomic_add_and_fetch_z(&cache->stats.misses, 1);
+  return NULL;
 }
 
 bool BKE_sequencer_cache_put_if_possible(const SeqRenderData *context,
@@ -1305,8 +1709,9 @@ bool BKE_sequencer_cache_put_if_possible(const SeqRenderData *context,
     return true;
   }
   else {
-    seq_cache_set_temp_cache_linked(scene, scene->ed->cache->last_key);
-    scene->ed->cache->last_key = NULL;
+    SeqCache *cache = scene->ed->cache;
+    seq_cache_set_temp_cache_linked(scene, cache->last_key[context->task_id]);
+    cache->last_key[context->task_id] = NULL;
     return false;
   }
 }
@@ -1331,20 +1736,25 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
     seq = BKE_sequencer_prefetch_get_original_sequence(seq, scene);
   }
 
-  /* Prevent reinserting, it breaks cache key linking. */
-  ImBuf *test = BKE_sequencer_cache_get(context, seq, cfra, type, true);
-  if (test) {
-    IMB_freeImBuf(test);
-    return;
-  }
-
   if (!scene->ed->cache) {
     seq_cache_create(context->bmain, scene);
   }
 
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+
   seq_cache_lock(scene);
 
-  SeqCache *cache = seq_cache_get_from_scene(scene);
+  /* Prevent reinserting, it breaks cache key linking. Checked with the cache locked, since
+   * prefetching and the main thread can render the same image concurrently: the image which
+   * is put last is dropped, the caller keeps its own reference. */
+  SeqCacheKey test_key;
+  ImBuf *test = seq_cache_lookup(cache, context, seq, cfra, type, &test_key);
+  if (test) {
+    IMB_freeImBuf(test);
+    seq_cache_unlock(scene);
+    return;
+  }
+
   int flag;
 
   if (seq->cache_flag & SEQ_CACHE_OVERRIDE) {
@@ -1374,31 +1784,35 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
   key->link_next = NULL;
   key->is_temp_cache = true;
   key->task_id = context->task_id;
+  key->recycle_node_left = NULL;
+  key->recycle_node_right = NULL;
 
   /* Item stored for later use */
   if (flag & type) {
     key->is_temp_cache = false;
-    key->link_prev = cache->last_key;
+    key->link_prev = cache->last_key[key->task_id];
   }
 
-  SeqCacheKey *temp_last_key = cache->last_key;
+  SeqCacheKey *temp_last_key = cache->last_key[key->task_id];
   seq_cache_put(cache, key, i);
 
   /* Restore pointer to previous item as this one will be freed when stack is rendered. */
   if (key->is_temp_cache) {
-    cache->last_key = temp_last_key;
+    cache->last_key[key->task_id] = temp_last_key;
   }
 
   /* Set last_key's reference to this key so we can look up chain backwards.
-   * Item is already put in cache, so cache->last_key points to current key.
+   * Item is already put in cache, so last key points to current key.
    */
   if (flag & type && temp_last_key) {
-    temp_last_key->link_next = cache->last_key;
+    temp_last_key->link_next = cache->last_key[key->task_id];
+    seq_cache_recycle_heap_update(cache, temp_last_key);
   }
+  seq_cache_recycle_heap_update(cache, key);
 
   /* Reset linking. */
   if (key->type == SEQ_CACHE_STORE_FINAL_OUT) {
-    cache->last_key = NULL;
+    cache->last_key[key->task_id] = NULL;
   }
 
   seq_cache_unlock(scene);
@@ -1409,10 +1823,7 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
         seq_disk_cache_create(context->bmain, context->scene);
       }
 
-      BLI_mutex_lock(&cache->disk_cache->read_write_mutex);
-      seq_disk_cache_write_file(cache->disk_cache, key, i);
-      BLI_mutex_unlock(&cache->disk_cache->read_write_mutex);
-      seq_disk_cache_enforce_limits(cache->disk_cache);
+      seq_disk_cache_write_queue_add(cache->disk_cache, key, i);
     }
   }
 }
@@ -1429,19 +1840,27 @@ void BKE_sequencer_cache_iterate(
   }
 
   seq_cache_lock(scene);
-  bool interrupt = callback_init(userdata, BLI_ghash_len(cache->hash));
 
-  GHashIterator gh_iter;
-  BLI_ghashIterator_init(&gh_iter, cache->hash);
+  size_t item_count = 0;
+  for (int i = 0; i < SEQ_CACHE_SHARDS; i++) {
+    item_count += BLI_ghash_len(cache->shards[i].hash);
+  }
+  bool interrupt = callback_init(userdata, item_count);
 
-  while (!BLI_ghashIterator_done(&gh_iter) && !interrupt) {
-    SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
-    BLI_ghashIterator_step(&gh_iter);
+  /* Shards are only modified with cache locked, no need to lock them for reading. */
+  for (int i = 0; i < SEQ_CACHE_SHARDS && !interrupt; i++) {
+    GHashIterator gh_iter;
+    BLI_ghashIterator_init(&gh_iter, cache->shards[i].hash);
 
-    interrupt = callback_iter(userdata, key->seq, key->nfra, key->type, key->cost);
+    while (!BLI_ghashIterator_done(&gh_iter) && !interrupt) {
+      SeqCacheKey *key = BLI_ghashIterator_getKey(&gh_iter);
+      BLI_ghashIterator_step(&gh_iter);
+
+      interrupt = callback_iter(userdata, key->seq, key->nfra, key->type, key->cost);
+    }
   }
 
-  cache->last_key = NULL;
+  seq_cache_last_key_reset(cache);
   seq_cache_unlock(scene);
 }
 
@@ -1455,3 +1874,14 @@ bool BKE_sequencer_cache_is_full(Scene *scene)
 
   return memory_total < cache->memory_used;
 }
+
+void BKE_sequencer_cache_stats_get(Scene *scene, SeqCacheStats *r_stats)
+{
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+  if (!cache) {
+    memset(r_stats, 0, sizeof(*r_stats));
+    return;
+  }
+
+  *r_stats = cache->stats;
+}
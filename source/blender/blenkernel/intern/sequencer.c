@@ -4028,6 +4028,37 @@ static ImBuf *seq_render_strip_stack(const SeqRenderData *context,
  * you have to free after usage!
  */
 
+/* Check whether the strip can be rendered by several prefetch threads at the same time.
+ * Text strips draw with the shared render font, so they are not. */
+static bool seq_render_is_thread_safe(Sequence *seq)
+{
+  if (seq == NULL) {
+    return true;
+  }
+  if (seq->type == SEQ_TYPE_TEXT) {
+    return false;
+  }
+  if (seq->type == SEQ_TYPE_META) {
+    LISTBASE_FOREACH (Sequence *, seq_meta, &seq->seqbase) {
+      if (!seq_render_is_thread_safe(seq_meta)) {
+        return false;
+      }
+    }
+  }
+  return seq_render_is_thread_safe(seq->seq1) && seq_render_is_thread_safe(seq->seq2) &&
+         seq_render_is_thread_safe(seq->seq3);
+}
+
+static bool seq_render_stack_is_thread_safe(Sequence **seq_arr, int count)
+{
+  for (int i = 0; i < count; i++) {
+    if (!seq_render_is_thread_safe(seq_arr[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int chanshown)
 {
   Scene *scene = context->scene;
@@ -4066,7 +4097,13 @@ ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int cha
   float cost = 0;
 
   if (count && !out) {
-    BLI_mutex_lock(&seq_render_mutex);
+    /* Prefetch workers render evaluated copies of the scene and link cache entries per task,
+     * so they don't need to wait for each other, unless some strip uses global state. */
+    const bool use_render_mutex = !context->is_prefetch_render ||
+                                  !seq_render_stack_is_thread_safe(seq_arr, count);
+    if (use_render_mutex) {
+      BLI_mutex_lock(&seq_render_mutex);
+    }
     out = seq_render_strip_stack(context, &state, seqbasep, cfra, chanshown);
     cost = seq_estimate_render_cost_end(context->scene, begin);
 
@@ -4078,7 +4115,9 @@ ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int cha
       BKE_sequencer_cache_put_if_possible(
           context, seq_arr[count - 1], cfra, SEQ_CACHE_STORE_FINAL_OUT, out, cost, false);
     }
-    BLI_mutex_unlock(&seq_render_mutex);
+    if (use_render_mutex) {
+      BLI_mutex_unlock(&seq_render_mutex);
+    }
   }
 
   BKE_sequencer_prefetch_start(context, cfra, cost);
@@ -1001,6 +1001,8 @@ TrackingImageAccessor *tracking_image_accessor_new(MovieClip *clips[MAX_ACCESSOR
 
   accessor->cache = IMB_moviecache_create(
       "frame access cache", sizeof(AccessCacheKey), accesscache_hashhash, accesscache_hashcmp);
+  /* Tracking only needs frames around the tracked one, don't push out clip playback cache. */
+  IMB_moviecache_set_budget(accessor->cache, 0.25f);
 
   memcpy(accessor->clips, clips, num_clips * sizeof(MovieClip *));
   accessor->num_clips = num_clips;
@@ -42,11 +42,18 @@ typedef struct {
   /** Session UUID of the ID being currently written (MAIN_ID_SESSION_UUID_UNSET when not writing
    * ID-related data). Used to find matching chunks in previous memundo step. */
   uint id_session_uuid;
+  /** Hash of the chunk content, avoids comparing memory of chunks that differ. */
+  uint hash;
 } MemFileChunk;
 
 typedef struct MemFile {
   ListBase chunks;
+  /** Size in bytes of the chunks owned by this memfile. */
   size_t size;
+  /** Size in bytes of the chunks shared with the previous step. */
+  size_t size_shared;
+  /** Number of IDs for which the chunks of the previous step were used without writing them. */
+  uint id_reused_len;
 } MemFile;
 
 typedef struct MemFileWriteData {
@@ -74,11 +81,13 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
 void BLO_memfile_write_finalize(MemFileWriteData *mem_data);
 
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned int size);
+bool BLO_memfile_id_chunks_reuse(MemFileWriteData *mem_data);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
 extern void BLO_memfile_clear_future(MemFile *memfile);
+extern void BLO_memfile_snapshot(const MemFile *memfile, MemFile *r_memfile);
 
 /* utilities */
 extern struct Main *BLO_memfile_main_get(struct MemFile *memfile,
@@ -107,6 +107,8 @@
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_mmap.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BLT_translation.h"
@@ -233,8 +235,10 @@
  * Delay reading blocks we might not use (especially applies to library linking).
  * which keeps large arrays in memory from data-blocks we may not even use.
  *
- * \note This is disabled when using compression,
+ * \note This is disabled when using gzip compression,
  * while zlib supports seek it's unusably slow, see: T61880.
+ * Files written as compressed frames support seeking (see #BLEND_FRAME_SIZE),
+ * only the frames which are read from are decompressed.
  */
 #define USE_BHEAD_READ_ON_DEMAND
 
@@ -327,12 +331,19 @@ typedef struct OldNew {
   int nr;
 } OldNew;
 
+/* Slots of the hash-map store the key next to the index in the `entries` array,
+ * so probing doesn't have to access the entries, which are only touched on a match. */
+typedef struct OldNewSlot {
+  const void *oldp;
+  int32_t index;
+} OldNewSlot;
+
 typedef struct OldNewMap {
   /* Array that stores the actual entries. */
   OldNew *entries;
   int nentries;
   /* Hashmap that stores indices into the `entries` array. */
-  int32_t *map;
+  OldNewSlot *map;
 
   int capacity_exp;
 } OldNewMap;
@@ -344,21 +355,19 @@ typedef struct OldNewMap {
 #define PERTURB_SHIFT 5
 
 /* based on the probing algorithm used in Python dicts. */
-#define ITER_SLOTS(onm, KEY, SLOT_NAME, INDEX_NAME) \
+#define ITER_SLOTS(onm, KEY, SLOT_NAME) \
   uint32_t hash = BLI_ghashutil_ptrhash(KEY); \
   uint32_t mask = SLOT_MASK(onm); \
   uint perturb = hash; \
   int SLOT_NAME = mask & hash; \
-  int INDEX_NAME = onm->map[SLOT_NAME]; \
-  for (;; SLOT_NAME = mask & ((5 * SLOT_NAME) + 1 + perturb), \
-          perturb >>= PERTURB_SHIFT, \
-          INDEX_NAME = onm->map[SLOT_NAME])
+  for (;; SLOT_NAME = mask & ((5 * SLOT_NAME) + 1 + perturb), perturb >>= PERTURB_SHIFT)
 
 static void oldnewmap_insert_index_in_map(OldNewMap *onm, const void *ptr, int index)
 {
-  ITER_SLOTS (onm, ptr, slot, stored_index) {
-    if (stored_index == -1) {
-      onm->map[slot] = index;
+  ITER_SLOTS (onm, ptr, slot) {
+    if (onm->map[slot].index == -1) {
+      onm->map[slot].oldp = ptr;
+      onm->map[slot].index = index;
       break;
     }
   }
@@ -366,15 +375,17 @@ static void oldnewmap_insert_index_in_map(OldNewMap *onm, const void *ptr, int i
 
 static void oldnewmap_insert_or_replace(OldNewMap *onm, OldNew entry)
 {
-  ITER_SLOTS (onm, entry.oldp, slot, index) {
-    if (index == -1) {
+  ITER_SLOTS (onm, entry.oldp, slot) {
+    OldNewSlot *map_slot = &onm->map[slot];
+    if (map_slot->index == -1) {
       onm->entries[onm->nentries] = entry;
-      onm->map[slot] = onm->nentries;
+      map_slot->oldp = entry.oldp;
+      map_slot->index = onm->nentries;
       onm->nentries++;
       break;
     }
-    else if (onm->entries[index].oldp == entry.oldp) {
-      onm->entries[index] = entry;
+    else if (map_slot->oldp == entry.oldp) {
+      onm->entries[map_slot->index] = entry;
       break;
     }
   }
@@ -382,27 +393,27 @@ static void oldnewmap_insert_or_replace(OldNewMap *onm, OldNew entry)
 
 static OldNew *oldnewmap_lookup_entry(const OldNewMap *onm, const void *addr)
 {
-  ITER_SLOTS (onm, addr, slot, index) {
-    if (index >= 0) {
-      OldNew *entry = &onm->entries[index];
-      if (entry->oldp == addr) {
-        return entry;
-      }
-    }
-    else {
+  ITER_SLOTS (onm, addr, slot) {
+    const OldNewSlot *map_slot = &onm->map[slot];
+    if (map_slot->index == -1) {
       return NULL;
     }
+    if (map_slot->oldp == addr) {
+      return &onm->entries[map_slot->index];
+    }
   }
 }
 
 static void oldnewmap_clear_map(OldNewMap *onm)
 {
+  /* Sets all indices to -1 (keys are ignored for empty slots). */
   memset(onm->map, 0xFF, MAP_CAPACITY(onm) * sizeof(*onm->map));
 }
 
-static void oldnewmap_increase_size(OldNewMap *onm)
+static void oldnewmap_resize(OldNewMap *onm, int capacity_exp)
 {
-  onm->capacity_exp++;
+  BLI_assert((1ll << capacity_exp) >= onm->nentries);
+  onm->capacity_exp = capacity_exp;
   onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * ENTRIES_CAPACITY(onm));
   onm->map = MEM_reallocN(onm->map, sizeof(*onm->map) * MAP_CAPACITY(onm));
   oldnewmap_clear_map(onm);
@@ -411,6 +422,11 @@ static void oldnewmap_increase_size(OldNewMap *onm)
   }
 }
 
+static void oldnewmap_increase_size(OldNewMap *onm)
+{
+  oldnewmap_resize(onm, onm->capacity_exp + 1);
+}
+
 /* Public OldNewMap API */
 
 static OldNewMap *oldnewmap_new(void)
@@ -426,6 +442,23 @@ static OldNewMap *oldnewmap_new(void)
   return onm;
 }
 
+/**
+ * Ensure there is room for \a nentries_extra more entries,
+ * so the map doesn't have to be rehashed several times while it is being filled.
+ */
+static void oldnewmap_reserve(OldNewMap *onm, int nentries_extra)
+{
+  const int64_t nentries_needed = (int64_t)onm->nentries + nentries_extra;
+  if (nentries_needed <= ENTRIES_CAPACITY(onm)) {
+    return;
+  }
+  int capacity_exp = onm->capacity_exp;
+  while ((1ll << capacity_exp) < nentries_needed) {
+    capacity_exp++;
+  }
+  oldnewmap_resize(onm, capacity_exp);
+}
+
 static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
 {
   if (oldaddr == NULL || newaddr == NULL) {
@@ -488,9 +521,20 @@ static void oldnewmap_clear(OldNewMap *onm)
     }
   }
 
-  onm->capacity_exp = DEFAULT_SIZE_EXP;
-  oldnewmap_clear_map(onm);
+  /* The data-map is cleared after every ID, keep a capacity that fits the previous contents
+   * (similar IDs tend to follow each other) instead of growing it again from the default size,
+   * while still shrinking it after big IDs so clearing stays cheap. */
+  int capacity_exp = DEFAULT_SIZE_EXP;
+  while ((1ll << capacity_exp) < onm->nentries) {
+    capacity_exp++;
+  }
   onm->nentries = 0;
+  if (capacity_exp != onm->capacity_exp) {
+    oldnewmap_resize(onm, capacity_exp);
+  }
+  else {
+    oldnewmap_clear_map(onm);
+  }
 }
 
 static void oldnewmap_free(OldNewMap *onm)
@@ -800,6 +844,17 @@ static void bh8_from_bh4(BHead *bhead, BHead4 *bhead4)
   }
 }
 
+static bool frame_reader_bhead_read(FileData *fd, void *buffer, uint size);
+
+/** Read a block header, from the index of compressed files when possible. */
+static int fd_read_bhead(FileData *fd, void *buffer, uint size)
+{
+  if ((fd->frame_reader != NULL) && frame_reader_bhead_read(fd, buffer, size)) {
+    return (int)size;
+  }
+  return fd->read(fd, buffer, size, NULL);
+}
+
 static BHeadN *get_bhead(FileData *fd)
 {
   BHeadN *new_bhead = NULL;
@@ -822,7 +877,7 @@ static BHeadN *get_bhead(FileData *fd)
        */
       if (fd->flags & FD_FLAGS_FILE_POINTSIZE_IS_4) {
         bhead4.code = DATA;
-        readsize = fd->read(fd, &bhead4, sizeof(bhead4), NULL);
+        readsize = fd_read_bhead(fd, &bhead4, sizeof(bhead4));
 
         if (readsize == sizeof(bhead4) || bhead4.code == ENDB) {
           if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
@@ -845,7 +900,7 @@ static BHeadN *get_bhead(FileData *fd)
       }
       else {
         bhead8.code = DATA;
-        readsize = fd->read(fd, &bhead8, sizeof(bhead8), NULL);
+        readsize = fd_read_bhead(fd, &bhead8, sizeof(bhead8));
 
         if (readsize == sizeof(bhead8) || bhead8.code == ENDB) {
           if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
@@ -1027,6 +1082,26 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   }
   return &new_bhead_data->bhead;
 }
+
+/**
+ * For memory mapped files, access the data of a block which wasn't read yet
+ * without allocating a copy of it (the data must not be modified).
+ *
+ * \return NULL when the file isn't memory mapped.
+ */
+static const void *blo_bhead_data_mapped(FileData *fd, BHead *thisblock)
+{
+  BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
+  BLI_assert(new_bhead->has_data == false);
+  if (fd->mmap_file == NULL) {
+    return NULL;
+  }
+  if (new_bhead->file_offset + new_bhead->bhead.len >
+      (off64_t)BLI_mmap_get_length(fd->mmap_file)) {
+    return NULL;
+  }
+  return POINTER_OFFSET(BLI_mmap_get_pointer(fd->mmap_file), new_bhead->file_offset);
+}
 #endif /* USE_BHEAD_READ_ON_DEMAND */
 
 /* Warning! Caller's responsibility to ensure given bhead **is** and ID one! */
@@ -1215,6 +1290,616 @@ static int fd_read_gzip_from_file(FileData *filedata,
   return (readsize);
 }
 
+/* Memory mapped file reading. */
+
+static int fd_read_from_mmap(FileData *filedata,
+                             void *buffer,
+                             uint size,
+                             bool *UNUSED(r_is_memchunck_identical))
+{
+  /* don't read more bytes then there are available in the file */
+  const size_t length = BLI_mmap_get_length(filedata->mmap_file);
+  const size_t readsize = MIN2((size_t)size, length - (size_t)filedata->file_offset);
+
+  if (!BLI_mmap_read(filedata->mmap_file, buffer, (size_t)filedata->file_offset, readsize)) {
+    return 0;
+  }
+  filedata->file_offset += readsize;
+
+  return (int)readsize;
+}
+
+static off64_t fd_seek_from_mmap(FileData *filedata, off64_t offset, int whence)
+{
+  const off64_t length = (off64_t)BLI_mmap_get_length(filedata->mmap_file);
+
+  if (whence == SEEK_CUR) {
+    offset += filedata->file_offset;
+  }
+  else if (whence == SEEK_END) {
+    offset += length;
+  }
+
+  if ((offset < 0) || (offset > length)) {
+    return -1;
+  }
+
+  filedata->file_offset = offset;
+  return offset;
+}
+
+/* Compressed frames reading. */
+
+void blo_frame_header_encode(uchar header[BLEND_FRAME_HEADER_SIZE],
+                             uint compressed_size,
+                             uint uncompressed_size)
+{
+  /* Magic, deflate method, FEXTRA flag, no time-stamp, no extra flags, unknown OS. */
+  const uchar header_gzip[10] = {0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff};
+  memcpy(header, header_gzip, sizeof(header_gzip));
+  /* Extra field length, then the sub-field ID and length. */
+  header[10] = 12;
+  header[11] = 0;
+  header[12] = 'B';
+  header[13] = 'L';
+  header[14] = 8;
+  header[15] = 0;
+  for (int i = 0; i < 4; i++) {
+    header[16 + i] = (uchar)(compressed_size >> (8 * i));
+    header[20 + i] = (uchar)(uncompressed_size >> (8 * i));
+  }
+}
+
+bool blo_frame_header_decode(const uchar header[BLEND_FRAME_HEADER_SIZE],
+                             uint *r_compressed_size,
+                             uint *r_uncompressed_size)
+{
+  if (!(header[0] == 0x1f && header[1] == 0x8b && header[2] == 0x08 && header[3] == 0x04 &&
+        header[10] == 12 && header[11] == 0 && header[12] == 'B' && header[13] == 'L' &&
+        header[14] == 8 && header[15] == 0)) {
+    return false;
+  }
+  uint compressed_size = 0, uncompressed_size = 0;
+  for (int i = 0; i < 4; i++) {
+    compressed_size |= (uint)header[16 + i] << (8 * i);
+    uncompressed_size |= (uint)header[20 + i] << (8 * i);
+  }
+  if (r_compressed_size) {
+    *r_compressed_size = compressed_size;
+  }
+  if (r_uncompressed_size) {
+    *r_uncompressed_size = uncompressed_size;
+  }
+  return true;
+}
+
+void blo_frame_index_header_encode(uchar header[BLEND_FRAME_INDEX_HEADER_SIZE], uint index_len)
+{
+  BLI_assert(index_len <= BLEND_FRAME_INDEX_CHUNK_SIZE);
+  const uchar header_gzip[10] = {0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff};
+  memcpy(header, header_gzip, sizeof(header_gzip));
+  header[10] = (uchar)(index_len + 4);
+  header[11] = (uchar)((index_len + 4) >> 8);
+  header[12] = 'B';
+  header[13] = 'I';
+  header[14] = (uchar)index_len;
+  header[15] = (uchar)(index_len >> 8);
+}
+
+bool blo_frame_index_header_decode(const uchar header[BLEND_FRAME_INDEX_HEADER_SIZE],
+                                   uint *r_index_len)
+{
+  if (!(header[0] == 0x1f && header[1] == 0x8b && header[2] == 0x08 && header[3] == 0x04 &&
+        header[12] == 'B' && header[13] == 'I')) {
+    return false;
+  }
+  const uint extra_len = (uint)header[10] | ((uint)header[11] << 8);
+  const uint index_len = (uint)header[14] | ((uint)header[15] << 8);
+  if (extra_len != index_len + 4) {
+    return false;
+  }
+  *r_index_len = index_len;
+  return true;
+}
+
+/** Maximum number of frames decompressed ahead of the frame being read. */
+#define FRAME_READ_AHEAD_MAX 16
+
+typedef struct FrameInfo {
+  /** Offset of the frame header in the file. */
+  off64_t file_offset;
+  /** Offset of the frame in the uncompressed stream. */
+  off64_t data_offset;
+  uint compressed_size;
+  uint uncompressed_size;
+} FrameInfo;
+
+/** State of a #FrameReadSlot in the read-ahead window. */
+typedef enum eFrameReadSlotState {
+  /** Not in the window, or decompressed. */
+  FRAME_READ_SLOT_DONE = 0,
+  /** Waiting for a task pool thread. */
+  FRAME_READ_SLOT_QUEUED,
+  FRAME_READ_SLOT_RUNNING,
+} eFrameReadSlotState;
+
+typedef struct FrameReadSlot {
+  /** Deflate stream followed by the gzip trailer, read from the file on the main thread. */
+  uchar *compressed;
+  uint compressed_len, compressed_alloc;
+  /** Decompressed frame. */
+  char *data;
+  uint data_len, data_alloc;
+  bool error;
+  /** Protected by #FrameReader.slot_mutex. */
+  eFrameReadSlotState state;
+} FrameReadSlot;
+
+typedef struct FrameReader {
+  /** Index of all frames in the file, read on open, used for seeking. */
+  FrameInfo *frames;
+  int frames_len;
+  /** Size of the uncompressed stream. */
+  off64_t data_len;
+  /** Frame the last read came from, checked before searching #FrameReader.frames. */
+  int frame_last;
+
+  /** Block header index (see #BLEND_FRAME_INDEX_HEADER_SIZE), NULL for files without one. */
+  uchar *bhead_index;
+  size_t bhead_index_len;
+  /** Entry of the next block header in #FrameReader.bhead_index, blocks are read in order. */
+  size_t bhead_index_next;
+
+  /**
+   * Read-ahead window: `slots_queued` frames starting at `frame_head`,
+   * stored in `slots` starting at `slot_head`, decompressing on `task_pool`.
+   */
+  TaskPool *task_pool;
+  /** Protects the state of the slots, the main thread waits on `slot_condition`. */
+  ThreadMutex slot_mutex;
+  ThreadCondition slot_condition;
+  FrameReadSlot *slots;
+  int slots_len;
+  int slot_head;
+  int slots_queued;
+  int frame_head;
+  /**
+   * Number of frames to decompress ahead, grows while frames are read in order and drops to a
+   * single frame on a seek, so reading a few blocks only decompresses the frames holding them.
+   */
+  int read_ahead_len;
+  /** Frame of the last read from the read-ahead window. */
+  int frame_read_prev;
+
+  /**
+   * Frame read from behind the read-ahead window (reading data-blocks on demand),
+   * decompressed on the main thread so the window isn't discarded.
+   */
+  FrameReadSlot slot_random;
+  int frame_random;
+} FrameReader;
+
+static void frame_reader_decompress(FrameReadSlot *slot)
+{
+  z_stream strm = {NULL};
+
+  slot->error = true;
+
+  if (inflateInit2(&strm, -MAX_WBITS) == Z_OK) {
+    strm.next_in = slot->compressed;
+    strm.avail_in = slot->compressed_len - BLEND_FRAME_TRAILER_SIZE;
+    strm.next_out = (Bytef *)slot->data;
+    strm.avail_out = slot->data_len;
+
+    if ((inflate(&strm, Z_FINISH) == Z_STREAM_END) && (strm.total_out == slot->data_len)) {
+      const uchar *trailer = slot->compressed + slot->compressed_len - BLEND_FRAME_TRAILER_SIZE;
+      uint crc_file = 0;
+      for (int i = 0; i < 4; i++) {
+        crc_file |= (uint)trailer[i] << (8 * i);
+      }
+      if (crc_file == (uint)crc32(0, (const Bytef *)slot->data, slot->data_len)) {
+        slot->error = false;
+      }
+    }
+    inflateEnd(&strm);
+  }
+}
+
+/** Decompress \a slot, unless another thread already started it. */
+static void frame_reader_slot_run(FrameReader *fr, FrameReadSlot *slot)
+{
+  BLI_mutex_lock(&fr->slot_mutex);
+  if (slot->state != FRAME_READ_SLOT_QUEUED) {
+    BLI_mutex_unlock(&fr->slot_mutex);
+    return;
+  }
+  slot->state = FRAME_READ_SLOT_RUNNING;
+  BLI_mutex_unlock(&fr->slot_mutex);
+
+  frame_reader_decompress(slot);
+
+  BLI_mutex_lock(&fr->slot_mutex);
+  slot->state = FRAME_READ_SLOT_DONE;
+  BLI_condition_notify_all(&fr->slot_condition);
+  BLI_mutex_unlock(&fr->slot_mutex);
+}
+
+static void frame_reader_decompress_task(TaskPool *__restrict pool, void *slot)
+{
+  frame_reader_slot_run(BLI_task_pool_user_data(pool), slot);
+}
+
+/**
+ * Wait for \a slot to be decompressed. When no thread started it yet, it's decompressed here,
+ * or skipped when \a discard is set.
+ */
+static void frame_reader_slot_wait(FrameReader *fr, FrameReadSlot *slot, const bool discard)
+{
+  if (discard) {
+    BLI_mutex_lock(&fr->slot_mutex);
+    if (slot->state == FRAME_READ_SLOT_QUEUED) {
+      slot->state = FRAME_READ_SLOT_DONE;
+      slot->error = true;
+    }
+    BLI_mutex_unlock(&fr->slot_mutex);
+  }
+  else {
+    frame_reader_slot_run(fr, slot);
+  }
+
+  BLI_mutex_lock(&fr->slot_mutex);
+  while (slot->state != FRAME_READ_SLOT_DONE) {
+    BLI_condition_wait(&fr->slot_condition, &fr->slot_mutex);
+  }
+  BLI_mutex_unlock(&fr->slot_mutex);
+}
+
+static void frame_read_slot_free_data(FrameReadSlot *slot)
+{
+  MEM_SAFE_FREE(slot->compressed);
+  MEM_SAFE_FREE(slot->data);
+}
+
+/**
+ * Read the frame header of every frame, so any offset in the uncompressed stream can be found.
+ * \return NULL when the file doesn't consist of compressed frames only.
+ */
+static FrameReader *frame_reader_new(int file)
+{
+  int frames_alloc = 64;
+  FrameInfo *frames = MEM_malloc_arrayN(frames_alloc, sizeof(*frames), __func__);
+  int frames_len = 0;
+  off64_t file_offset = 0;
+  off64_t data_offset = 0;
+  uchar *bhead_index = NULL;
+  size_t bhead_index_len = 0;
+
+  while (true) {
+    uchar header[BLEND_FRAME_HEADER_SIZE];
+    uint compressed_size, uncompressed_size;
+
+    if (BLI_lseek(file, file_offset, SEEK_SET) == -1) {
+      break;
+    }
+    const int header_len = read(file, header, sizeof(header));
+    if (header_len == 0) {
+      /* End of file. */
+      BLI_lseek(file, 0, SEEK_SET);
+
+      FrameReader *fr = MEM_callocN(sizeof(*fr), __func__);
+      fr->frames = frames;
+      fr->frames_len = frames_len;
+      fr->data_len = data_offset;
+      fr->bhead_index = bhead_index;
+      fr->bhead_index_len = bhead_index_len;
+      fr->frame_random = -1;
+      fr->frame_read_prev = -1;
+      fr->read_ahead_len = 1;
+      fr->slots_len = CLAMPIS(BLI_system_thread_count(), 2, FRAME_READ_AHEAD_MAX);
+      fr->slots = MEM_calloc_arrayN(fr->slots_len, sizeof(*fr->slots), __func__);
+      fr->task_pool = BLI_task_pool_create(fr, TASK_PRIORITY_HIGH);
+      BLI_mutex_init(&fr->slot_mutex);
+      BLI_condition_init(&fr->slot_condition);
+      return fr;
+    }
+    uint index_len;
+    if ((header_len == sizeof(header)) && blo_frame_index_header_decode(header, &index_len)) {
+      /* Block header index, only valid at the end of the file. */
+      bhead_index = MEM_reallocN(bhead_index, bhead_index_len + MAX2(index_len, 1));
+      if ((BLI_lseek(file, file_offset + BLEND_FRAME_INDEX_HEADER_SIZE, SEEK_SET) == -1) ||
+          (read(file, bhead_index + bhead_index_len, index_len) != index_len)) {
+        break;
+      }
+      bhead_index_len += index_len;
+      file_offset += BLEND_FRAME_INDEX_HEADER_SIZE + index_len + BLEND_FRAME_INDEX_FOOTER_SIZE;
+      continue;
+    }
+    if ((bhead_index != NULL) || (header_len != sizeof(header)) ||
+        !blo_frame_header_decode(header, &compressed_size, &uncompressed_size) ||
+        (compressed_size > INT_MAX - BLEND_FRAME_TRAILER_SIZE) || (uncompressed_size > INT_MAX)) {
+      break;
+    }
+
+    if (frames_len == frames_alloc) {
+      frames_alloc *= 2;
+      frames = MEM_reallocN(frames, sizeof(*frames) * frames_alloc);
+    }
+    FrameInfo *frame = &frames[frames_len++];
+    frame->file_offset = file_offset;
+    frame->data_offset = data_offset;
+    frame->compressed_size = compressed_size;
+    frame->uncompressed_size = uncompressed_size;
+
+    file_offset += BLEND_FRAME_HEADER_SIZE + compressed_size + BLEND_FRAME_TRAILER_SIZE;
+    data_offset += uncompressed_size;
+  }
+
+  BLI_lseek(file, 0, SEEK_SET);
+  MEM_freeN(frames);
+  MEM_SAFE_FREE(bhead_index);
+  return NULL;
+}
+
+/** Wait for all frames in the read-ahead window and empty it. */
+static void frame_reader_window_clear(FrameReader *fr)
+{
+  for (int i = 0; i < fr->slots_queued; i++) {
+    frame_reader_slot_wait(fr, &fr->slots[(fr->slot_head + i) % fr->slots_len], true);
+  }
+  fr->slots_queued = 0;
+}
+
+static void frame_reader_free(FrameReader *fr)
+{
+  frame_reader_window_clear(fr);
+  /* Tasks of slots decompressed on the main thread may still be pending, they do nothing. */
+  BLI_task_pool_work_and_wait(fr->task_pool);
+  BLI_task_pool_free(fr->task_pool);
+  BLI_condition_end(&fr->slot_condition);
+  BLI_mutex_end(&fr->slot_mutex);
+  for (int i = 0; i < fr->slots_len; i++) {
+    frame_read_slot_free_data(&fr->slots[i]);
+  }
+  frame_read_slot_free_data(&fr->slot_random);
+  MEM_freeN(fr->slots);
+  MEM_freeN(fr->frames);
+  MEM_SAFE_FREE(fr->bhead_index);
+  MEM_freeN(fr);
+}
+
+/** Read the compressed \a frame from the file into \a slot. */
+static bool frame_reader_slot_load(FileData *fd, FrameReadSlot *slot, int frame)
+{
+  const FrameInfo *info = &fd->frame_reader->frames[frame];
+
+  slot->compressed_len = info->compressed_size + BLEND_FRAME_TRAILER_SIZE;
+  if (slot->compressed_alloc < slot->compressed_len) {
+    MEM_SAFE_FREE(slot->compressed);
+    slot->compressed = MEM_mallocN(slot->compressed_len, __func__);
+    slot->compressed_alloc = slot->compressed_len;
+  }
+  slot->data_len = info->uncompressed_size;
+  if (slot->data_alloc < slot->data_len) {
+    MEM_SAFE_FREE(slot->data);
+    slot->data = MEM_mallocN(slot->data_len, __func__);
+    slot->data_alloc = slot->data_len;
+  }
+
+  slot->error = true;
+  if (BLI_lseek(fd->filedes, info->file_offset + BLEND_FRAME_HEADER_SIZE, SEEK_SET) == -1) {
+    return false;
+  }
+  if (read(fd->filedes, slot->compressed, slot->compressed_len) != slot->compressed_len) {
+    return false;
+  }
+  return true;
+}
+
+/** Queue frames after the window until it's full, these decompress in the background. */
+static void frame_reader_window_fill(FileData *fd)
+{
+  FrameReader *fr = fd->frame_reader;
+
+  while ((fr->slots_queued < fr->read_ahead_len) &&
+         (fr->frame_head + fr->slots_queued < fr->frames_len)) {
+    FrameReadSlot *slot = &fr->slots[(fr->slot_head + fr->slots_queued) % fr->slots_len];
+    if (frame_reader_slot_load(fd, slot, fr->frame_head + fr->slots_queued)) {
+      BLI_mutex_lock(&fr->slot_mutex);
+      slot->state = FRAME_READ_SLOT_QUEUED;
+      BLI_mutex_unlock(&fr->slot_mutex);
+      BLI_task_pool_push(fr->task_pool, frame_reader_decompress_task, slot, false, NULL);
+    }
+    fr->slots_queued++;
+  }
+}
+
+/**
+ * Ensure \a frame is decompressed.
+ * \return The slot holding the frame or NULL on error.
+ */
+static FrameReadSlot *frame_reader_slot_get(FileData *fd, int frame)
+{
+  FrameReader *fr = fd->frame_reader;
+
+  /* Behind the read-ahead window, decompress on the main thread. */
+  if ((frame < fr->frame_head) && (fr->slots_queued != 0)) {
+    FrameReadSlot *slot = &fr->slot_random;
+    if (fr->frame_random != frame) {
+      fr->frame_random = -1;
+      if (frame_reader_slot_load(fd, slot, frame)) {
+        frame_reader_decompress(slot);
+      }
+      if (slot->error) {
+        return NULL;
+      }
+      fr->frame_random = frame;
+    }
+    return slot;
+  }
+
+  if (frame != fr->frame_read_prev) {
+    fr->read_ahead_len = (frame == fr->frame_read_prev + 1) ?
+                             min_ii(fr->read_ahead_len * 2, fr->slots_len) :
+                             1;
+    fr->frame_read_prev = frame;
+  }
+
+  if ((frame < fr->frame_head) || (frame >= fr->frame_head + fr->slots_queued)) {
+    /* Outside of the window (the first read or a seek past it), start a new window. */
+    frame_reader_window_clear(fr);
+    fr->slot_head = 0;
+    fr->frame_head = frame;
+  }
+  else {
+    /* Drop frames before the one being read. */
+    while (fr->frame_head < frame) {
+      frame_reader_slot_wait(fr, &fr->slots[fr->slot_head], true);
+      fr->slot_head = (fr->slot_head + 1) % fr->slots_len;
+      fr->slots_queued--;
+      fr->frame_head++;
+    }
+  }
+
+  frame_reader_window_fill(fd);
+
+  FrameReadSlot *slot = &fr->slots[fr->slot_head];
+  frame_reader_slot_wait(fr, slot, false);
+  return slot->error ? NULL : slot;
+}
+
+/** \return The index of the frame containing \a offset or -1 when out of range. */
+static int frame_reader_frame_find(FrameReader *fr, off64_t offset)
+{
+  if ((offset < 0) || (offset >= fr->data_len)) {
+    return -1;
+  }
+
+  const FrameInfo *frame_last = &fr->frames[fr->frame_last];
+  if ((offset >= frame_last->data_offset) &&
+      (offset < frame_last->data_offset + frame_last->uncompressed_size)) {
+    return fr->frame_last;
+  }
+
+  int low = 0, high = fr->frames_len - 1;
+  while (low < high) {
+    const int mid = (low + high + 1) / 2;
+    if (fr->frames[mid].data_offset <= offset) {
+      low = mid;
+    }
+    else {
+      high = mid - 1;
+    }
+  }
+  fr->frame_last = low;
+  return low;
+}
+
+static int fd_read_frames_from_file(FileData *filedata,
+                                    void *buffer,
+                                    uint size,
+                                    bool *UNUSED(r_is_memchunck_identical))
+{
+  FrameReader *fr = filedata->frame_reader;
+  uint readsize = 0;
+
+  while (readsize < size) {
+    const int frame = frame_reader_frame_find(fr, filedata->file_offset);
+    if (frame == -1) {
+      break;
+    }
+    const FrameReadSlot *slot = frame_reader_slot_get(filedata, frame);
+    if (slot == NULL) {
+      /* The short read ends reading like a truncated file. */
+      BKE_reportf(filedata->reports,
+                  RPT_ERROR,
+                  "Failed to read blend file '%s', data could not be decompressed",
+                  filedata->relabase);
+      break;
+    }
+
+    const uint frame_offset = (uint)(filedata->file_offset - fr->frames[frame].data_offset);
+    const uint len = MIN2(size - readsize, slot->data_len - frame_offset);
+    memcpy(POINTER_OFFSET(buffer, readsize), slot->data + frame_offset, len);
+    filedata->file_offset += len;
+    readsize += len;
+  }
+
+  return (int)readsize;
+}
+
+static off64_t fd_seek_frames_from_file(FileData *filedata, off64_t offset, int whence)
+{
+  FrameReader *fr = filedata->frame_reader;
+
+  if (whence == SEEK_CUR) {
+    offset += filedata->file_offset;
+  }
+  else if (whence == SEEK_END) {
+    offset += fr->data_len;
+  }
+
+  if ((offset < 0) || (offset > fr->data_len)) {
+    return -1;
+  }
+
+  /* Frames are only decompressed once they're read from. */
+  filedata->file_offset = offset;
+  return offset;
+}
+
+static off64_t frame_reader_bhead_index_offset(const FrameReader *fr, size_t entry, uint size)
+{
+  const uchar *data = fr->bhead_index + entry * (8 + size);
+  uint64_t offset = 0;
+  for (int i = 0; i < 8; i++) {
+    offset |= (uint64_t)data[i] << (8 * i);
+  }
+  return (off64_t)offset;
+}
+
+/**
+ * Read the block header at the current offset from the block header index,
+ * instead of decompressing the frame it's in.
+ * \return False when the file has no index or it doesn't contain the block header.
+ */
+static bool frame_reader_bhead_read(FileData *fd, void *buffer, uint size)
+{
+  FrameReader *fr = fd->frame_reader;
+  if (fr->bhead_index == NULL) {
+    return false;
+  }
+  const size_t entries_len = fr->bhead_index_len / (8 + size);
+  const off64_t offset = fd->file_offset;
+
+  size_t entry = fr->bhead_index_next;
+  if ((entry >= entries_len) || (frame_reader_bhead_index_offset(fr, entry, size) != offset)) {
+    /* Not read in order, search for it. */
+    size_t low = 0, high = entries_len;
+    while (low < high) {
+      const size_t mid = (low + high) / 2;
+      if (frame_reader_bhead_index_offset(fr, mid, size) < offset) {
+        low = mid + 1;
+      }
+      else {
+        high = mid;
+      }
+    }
+    entry = low;
+    if ((entry >= entries_len) || (frame_reader_bhead_index_offset(fr, entry, size) != offset)) {
+      return false;
+    }
+  }
+
+  if (offset + size > fr->data_len) {
+    return false;
+  }
+
+  memcpy(buffer, fr->bhead_index + entry * (8 + size) + 8, size);
+  fd->file_offset += size;
+  fr->bhead_index_next = entry + 1;
+  return true;
+}
+
 /* Memory reading. */
 
 static int fd_read_from_memory(FileData *filedata,
@@ -1361,11 +2046,13 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   gzFile gzfile = (gzFile)Z_NULL;
 
-  char header[7];
+  /* Large enough for the "BLENDER" magic and a compressed frame header. */
+  uchar header[BLEND_FRAME_HEADER_SIZE];
 
   /* Regular file. */
   errno = 0;
-  if (read(file, header, sizeof(header)) != sizeof(header)) {
+  const int header_len = read(file, header, sizeof(header));
+  if (header_len < 7) {
     BKE_reportf(reports,
                 RPT_WARNING,
                 "Unable to read '%s': %s",
@@ -1378,9 +2065,31 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   }
 
   /* Regular file. */
-  if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
-    read_fn = fd_read_data_from_file;
-    seek_fn = fd_seek_data_from_file;
+  BLI_mmap_file *mmap_file = NULL;
+  if (memcmp(header, "BLENDER", 7) == 0) {
+    /* Prefer memory mapping the file, so reading data-blocks doesn't need a system call each. */
+    mmap_file = BLI_mmap_open(file);
+    if (mmap_file != NULL) {
+      read_fn = fd_read_from_mmap;
+      seek_fn = fd_seek_from_mmap;
+    }
+    else {
+      read_fn = fd_read_data_from_file;
+      seek_fn = fd_seek_data_from_file;
+    }
+    BLI_lseek(file, 0, SEEK_SET);
+  }
+
+  /* Compressed frames (a gzip file we can seek in and decompress in parallel). */
+  FrameReader *frame_reader = NULL;
+  if ((read_fn == NULL) && (header_len == sizeof(header)) &&
+      blo_frame_header_decode(header, NULL, NULL)) {
+    /* Otherwise fall back to reading as a regular gzip file. */
+    frame_reader = frame_reader_new(file);
+    if (frame_reader != NULL) {
+      read_fn = fd_read_frames_from_file;
+      seek_fn = fd_seek_frames_from_file;
+    }
   }
 
   /* Gzip file. */
@@ -1414,6 +2123,8 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   fd->filedes = file;
   fd->gzfiledes = gzfile;
+  fd->mmap_file = mmap_file;
+  fd->frame_reader = frame_reader;
 
   fd->read = read_fn;
   fd->seek = seek_fn;
@@ -1481,20 +2192,26 @@ static int fd_read_gzip_from_memory(FileData *filedata,
   filedata->strm.next_out = (Bytef *)buffer;
   filedata->strm.avail_out = size;
 
-  // Inflate another chunk.
-  err = inflate(&filedata->strm, Z_SYNC_FLUSH);
+  while (filedata->strm.avail_out != 0) {
+    // Inflate another chunk.
+    err = inflate(&filedata->strm, Z_SYNC_FLUSH);
 
-  if (err == Z_STREAM_END) {
-    return 0;
-  }
-  else if (err != Z_OK) {
-    printf("fd_read_gzip_from_memory: zlib error\n");
-    return 0;
+    if (err == Z_STREAM_END) {
+      /* Compressed files may contain multiple gzip members (frames), continue with the next. */
+      if ((filedata->strm.avail_in == 0) || (inflateReset(&filedata->strm) != Z_OK)) {
+        break;
+      }
+    }
+    else if (err != Z_OK) {
+      printf("fd_read_gzip_from_memory: zlib error\n");
+      return 0;
+    }
   }
 
-  filedata->file_offset += size;
+  const int readsize = (int)(size - filedata->strm.avail_out);
+  filedata->file_offset += readsize;
 
-  return (size);
+  return (readsize);
 }
 
 static int fd_read_gzip_from_memory_init(FileData *fd)
@@ -1576,6 +2293,14 @@ void blo_filedata_free(FileData *fd)
       gzclose(fd->gzfiledes);
     }
 
+    if (fd->frame_reader != NULL) {
+      frame_reader_free(fd->frame_reader);
+    }
+
+    if (fd->mmap_file != NULL) {
+      BLI_mmap_free(fd->mmap_file);
+    }
+
     if (fd->strm.next_in) {
       if (inflateEnd(&fd->strm) != Z_OK) {
         printf("close gzip stream error\n");
@@ -2189,17 +2914,28 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 
     if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
       if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+        const void *data = (bh + 1);
 #ifdef USE_BHEAD_READ_ON_DEMAND
         if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
-          bh = blo_bhead_read_full(fd, bh);
-          if (UNLIKELY(bh == NULL)) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
-            return NULL;
+          /* Reconstruct directly from the memory mapped file when possible. */
+          data = blo_bhead_data_mapped(fd, bh);
+          if (data == NULL) {
+            bh = blo_bhead_read_full(fd, bh);
+            if (UNLIKELY(bh == NULL)) {
+              fd->flags &= ~FD_FLAGS_FILE_OK;
+              return NULL;
+            }
+            data = (bh + 1);
           }
         }
 #endif
         temp = DNA_struct_reconstruct(
-            fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh + 1));
+            fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, data);
+#ifdef USE_BHEAD_READ_ON_DEMAND
+        if (UNLIKELY(fd->mmap_file && BLI_mmap_any_io_error(fd->mmap_file))) {
+          fd->flags &= ~FD_FLAGS_FILE_OK;
+        }
+#endif
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -8976,8 +9712,139 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
 }
 
 /* Read all data associated with a datablock into datamap. */
+#ifdef USE_BHEAD_READ_ON_DEMAND
+
+/* Only read the data of an ID on multiple threads when there is enough of it. */
+#  define DATAMAP_PARALLEL_MIN_BLOCKS 8
+#  define DATAMAP_PARALLEL_MIN_SIZE (256 * 1024)
+
+/**
+ * Like #read_struct, but only for data that can be accessed without reading from the file,
+ * this doesn't modify \a fd so it can run on multiple threads.
+ *
+ * \return false when the data has to be read with #read_struct.
+ */
+static bool read_struct_mapped(FileData *fd, BHead *bh, const char *blockname, void **r_data)
+{
+  *r_data = NULL;
+  if (bh->len == 0 || fd->compflags[bh->SDNAnr] == SDNA_CMP_REMOVED) {
+    return true;
+  }
+
+  const void *data = (bh + 1);
+  if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
+    data = blo_bhead_data_mapped(fd, bh);
+    if (data == NULL) {
+      return false;
+    }
+  }
+
+  if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+    *r_data = DNA_struct_reconstruct(
+        fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, data);
+  }
+  else {
+    /* SDNA_CMP_EQUAL */
+    *r_data = MEM_mallocN(bh->len, blockname);
+    memcpy(*r_data, data, bh->len);
+  }
+  return true;
+}
+
+typedef struct ReadDataMappedTaskData {
+  FileData *fd;
+  BHead **bheads;
+  void **data;
+  bool *is_read;
+  const char *allocname;
+} ReadDataMappedTaskData;
+
+static void read_data_mapped_task(void *__restrict userdata,
+                                  const int i,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ReadDataMappedTaskData *task_data = userdata;
+  task_data->is_read[i] = read_struct_mapped(
+      task_data->fd, task_data->bheads[i], task_data->allocname, &task_data->data[i]);
+}
+
+/**
+ * Read all data-blocks of an ID on multiple threads, only possible for memory mapped files
+ * since reading from the file descriptor or a stream is sequential.
+ *
+ * DNA reconstruction (when the file was written with different DNA) and copying of big arrays
+ * (mesh & curve data for e.g.) is the bulk of the work, each block is independent.
+ * Linking the pointers of the ID stays single threaded.
+ */
+static BHead *read_data_into_datamap_parallel(FileData *fd, BHead *bhead, const char *allocname)
+{
+  /* First collect the blocks of this ID, reading only their headers. */
+  int bheads_len = 0, bheads_alloc = 64;
+  BHead **bheads = MEM_malloc_arrayN(bheads_alloc, sizeof(*bheads), __func__);
+  size_t data_size = 0;
+
+  bhead = blo_bhead_next(fd, bhead);
+  while (bhead && bhead->code == DATA) {
+    if (bheads_len == bheads_alloc) {
+      bheads_alloc *= 2;
+      bheads = MEM_reallocN(bheads, sizeof(*bheads) * bheads_alloc);
+    }
+    bheads[bheads_len++] = bhead;
+    data_size += (size_t)bhead->len;
+    bhead = blo_bhead_next(fd, bhead);
+  }
+
+  void **data = MEM_calloc_arrayN(bheads_len, sizeof(*data), __func__);
+  bool *is_read = MEM_calloc_arrayN(bheads_len, sizeof(*is_read), __func__);
+
+  ReadDataMappedTaskData task_data = {
+      .fd = fd,
+      .bheads = bheads,
+      .data = data,
+      .is_read = is_read,
+      .allocname = allocname,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (bheads_len >= DATAMAP_PARALLEL_MIN_BLOCKS &&
+                            data_size >= DATAMAP_PARALLEL_MIN_SIZE);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, bheads_len, &task_data, read_data_mapped_task, &settings);
+
+  if (UNLIKELY(BLI_mmap_any_io_error(fd->mmap_file))) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
+
+  oldnewmap_reserve(fd->datamap, bheads_len);
+  for (int i = 0; i < bheads_len; i++) {
+    if (!is_read[i]) {
+      data[i] = read_struct(fd, bheads[i], allocname);
+    }
+    if (data[i]) {
+      oldnewmap_insert(fd->datamap, bheads[i]->old, data[i], 0);
+    }
+  }
+
+  MEM_freeN(bheads);
+  MEM_freeN(data);
+  MEM_freeN(is_read);
+
+  return bhead;
+}
+
+#  undef DATAMAP_PARALLEL_MIN_BLOCKS
+#  undef DATAMAP_PARALLEL_MIN_SIZE
+
+#endif /* USE_BHEAD_READ_ON_DEMAND */
+
 static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *allocname)
 {
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  if (fd->mmap_file && !(fd->flags & FD_FLAGS_SWITCH_ENDIAN)) {
+    return read_data_into_datamap_parallel(fd, bhead, allocname);
+  }
+#endif
+
   bhead = blo_bhead_next(fd, bhead);
 
   while (bhead && bhead->code == DATA) {
@@ -9919,6 +10786,13 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  if ((fd->mmap_file != NULL) && BLI_mmap_any_io_error(fd->mmap_file)) {
+    BKE_reportf(fd->reports,
+                RPT_ERROR,
+                "I/O error reading '%s', data may be missing or incomplete",
+                filepath);
+  }
+
   /* do before read_libraries, but skip undo case */
   if (fd->memfile == NULL) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
@@ -30,7 +30,9 @@
 #include "DNA_windowmanager_types.h" /* for ReportType */
 #include "zlib.h"
 
+struct BLI_mmap_file;
 struct BLOCacheStorage;
+struct FrameReader;
 struct GSet;
 struct IDNameLib_Map;
 struct Key;
@@ -81,6 +83,8 @@ typedef struct FileData {
 
   /** Regular file reading. */
   int filedes;
+  /** Regular file reading using a memory mapped file (when supported). */
+  struct BLI_mmap_file *mmap_file;
 
   /** Variables needed for reading from memory / stream. */
   const char *buffer;
@@ -94,6 +98,8 @@ typedef struct FileData {
   gzFile gzfiledes;
   /** Gzip stream for memory decompression. */
   z_stream strm;
+  /** Compressed frames, decompressed ahead of reading on multiple threads. */
+  struct FrameReader *frame_reader;
 
   /** Now only in use for library appending. */
   char relabase[FILE_MAX];
@@ -135,6 +141,51 @@ typedef struct FileData {
 
 #define SIZEOFBLENDERHEADER 12
 
+/* -------------------------------------------------------------------- */
+/** \name Compressed Frames
+ *
+ * Compressed files are written as a sequence of independent gzip members (frames),
+ * this allows frames to be compressed and decompressed on multiple threads,
+ * while the file remains readable by any gzip reader.
+ *
+ * Each frame header stores an extra field (`BL`) holding the compressed size of the deflate
+ * stream and the uncompressed size of the frame, so frames can be located without inflating them.
+ * \{ */
+
+/** Uncompressed size of each frame (the last frame may be smaller). */
+#define BLEND_FRAME_SIZE (1 << 20)
+/** gzip header (10 bytes), extra field length (2), sub-field header (4) and sizes (8). */
+#define BLEND_FRAME_HEADER_SIZE 24
+/** gzip trailer: CRC32 and uncompressed size. */
+#define BLEND_FRAME_TRAILER_SIZE 8
+
+void blo_frame_header_encode(unsigned char header[BLEND_FRAME_HEADER_SIZE],
+                             unsigned int compressed_size,
+                             unsigned int uncompressed_size);
+bool blo_frame_header_decode(const unsigned char header[BLEND_FRAME_HEADER_SIZE],
+                             unsigned int *r_compressed_size,
+                             unsigned int *r_uncompressed_size);
+
+/**
+ * The file ends with an index of all block headers, so they can be read without decompressing
+ * the frames they are in. The index is stored in the extra field (`BI`) of empty gzip members,
+ * which gzip readers skip. Each entry is the offset of the block header in the uncompressed
+ * stream (8 bytes, little endian), followed by the block header as written in the file.
+ */
+/** gzip header (10 bytes), extra field length (2) and sub-field header (4). */
+#define BLEND_FRAME_INDEX_HEADER_SIZE 16
+/** Empty deflate stream (2 bytes) and gzip trailer. */
+#define BLEND_FRAME_INDEX_FOOTER_SIZE 10
+/** Maximum size of the index data in one member, limited by the extra field length. */
+#define BLEND_FRAME_INDEX_CHUNK_SIZE (0xffff - 4)
+
+void blo_frame_index_header_encode(unsigned char header[BLEND_FRAME_INDEX_HEADER_SIZE],
+                                   unsigned int index_len);
+bool blo_frame_index_header_decode(const unsigned char header[BLEND_FRAME_INDEX_HEADER_SIZE],
+                                   unsigned int *r_index_len);
+
+/** \} */
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
@@ -42,6 +42,7 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.h"
@@ -66,6 +67,8 @@ void BLO_memfile_free(MemFile *memfile)
     MEM_freeN(chunk);
   }
   memfile->size = 0;
+  memfile->size_shared = 0;
+  memfile->id_reused_len = 0;
 }
 
 /* to keep list of memfiles consistent, 'first' is always first in list */
@@ -105,6 +108,43 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
   BLO_memfile_free(first);
 }
 
+/* Size of the chunks of a memfile snapshot. */
+#define MEMFILE_SNAPSHOT_CHUNK_SIZE (1 << 24)
+
+/**
+ * Copy the content of \a memfile into \a r_memfile, which owns all its memory (using a few big
+ * chunks), so it stays valid when undo steps are freed or merged,
+ * it can be written from another thread for e.g.
+ */
+void BLO_memfile_snapshot(const MemFile *memfile, MemFile *r_memfile)
+{
+  BLI_listbase_clear(&r_memfile->chunks);
+  r_memfile->size = 0;
+  r_memfile->size_shared = 0;
+  r_memfile->id_reused_len = 0;
+
+  MemFileChunk *snapchunk = NULL;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile->chunks) {
+    const char *buf = chunk->buf;
+    uint size = chunk->size;
+    while (size > 0) {
+      if (snapchunk == NULL || snapchunk->size == MEMFILE_SNAPSHOT_CHUNK_SIZE) {
+        snapchunk = MEM_callocN(sizeof(MemFileChunk), __func__);
+        snapchunk->buf = MEM_mallocN(MEMFILE_SNAPSHOT_CHUNK_SIZE, __func__);
+        BLI_addtail(&r_memfile->chunks, snapchunk);
+      }
+      const uint copy_size = MIN2(size, MEMFILE_SNAPSHOT_CHUNK_SIZE - snapchunk->size);
+      memcpy((char *)snapchunk->buf + snapchunk->size, buf, copy_size);
+      snapchunk->size += copy_size;
+      r_memfile->size += copy_size;
+      buf += copy_size;
+      size -= copy_size;
+    }
+  }
+}
+
+#undef MEMFILE_SNAPSHOT_CHUNK_SIZE
+
 /* Clear is_identical_future before adding next memfile. */
 void BLO_memfile_clear_future(MemFile *memfile)
 {
@@ -168,16 +208,20 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint siz
    * will then not be undo. Though it's not entirely clear that is wrong behavior. */
   curchunk->is_identical_future = true;
   curchunk->id_session_uuid = mem_data->current_id_session_uuid;
+  /* The new data is still in cache, while the previous step's memory often isn't:
+   * hashing allows to skip reading it for chunks that differ. */
+  curchunk->hash = BLI_hash_mm2((const uchar *)buf, size, 0);
   BLI_addtail(&memfile->chunks, curchunk);
 
   /* we compare compchunk with buf */
   if (*compchunk_step != NULL) {
     MemFileChunk *compchunk = *compchunk_step;
-    if (compchunk->size == curchunk->size) {
+    if (compchunk->size == curchunk->size && compchunk->hash == curchunk->hash) {
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
         curchunk->is_identical = true;
         compchunk->is_identical_future = true;
+        memfile->size_shared += size;
       }
     }
     *compchunk_step = compchunk->next;
@@ -192,6 +236,39 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint siz
   }
 }
 
+/**
+ * Share all chunks of the ID being written from the reference memfile,
+ * instead of writing the ID again, for IDs known to be unchanged since the previous step.
+ *
+ * \return false when the reference memfile has no chunks for that ID (nothing is done then).
+ */
+bool BLO_memfile_id_chunks_reuse(MemFileWriteData *mem_data)
+{
+  MemFile *memfile = mem_data->written_memfile;
+  MemFileChunk *compchunk = mem_data->reference_current_chunk;
+  const uint id_session_uuid = mem_data->current_id_session_uuid;
+
+  if (compchunk == NULL || id_session_uuid == MAIN_ID_SESSION_UUID_UNSET ||
+      compchunk->id_session_uuid != id_session_uuid) {
+    return false;
+  }
+
+  for (; compchunk != NULL && compchunk->id_session_uuid == id_session_uuid;
+       compchunk = compchunk->next) {
+    MemFileChunk *curchunk = MEM_dupallocN(compchunk);
+    curchunk->next = curchunk->prev = NULL;
+    curchunk->is_identical = true;
+    curchunk->is_identical_future = true;
+    compchunk->is_identical_future = true;
+    BLI_addtail(&memfile->chunks, curchunk);
+    memfile->size_shared += curchunk->size;
+  }
+
+  mem_data->reference_current_chunk = compchunk;
+  memfile->id_reused_len++;
+  return true;
+}
+
 struct Main *BLO_memfile_main_get(struct MemFile *memfile,
                                   struct Main *oldmain,
                                   struct Scene **r_scene)
@@ -218,12 +295,21 @@ struct Main *BLO_memfile_main_get(struct MemFile *memfile,
 /**
  * Saves .blend using undo buffer.
  *
+ * The file is written next to \a filename first, then renamed, so an existing file is only
+ * replaced once the new one is complete.
+ *
+ * \note Only reads \a memfile, so this can be called from any thread
+ * as long as the memfile isn't freed meanwhile (see #BLO_memfile_snapshot).
+ *
  * \return success.
  */
 bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
 {
   MemFileChunk *chunk;
   int file, oflags;
+  char tempname[FILE_MAX + 1];
+
+  BLI_snprintf(tempname, sizeof(tempname), "%s@", filename);
 
   /* note: This is currently used for autosave and 'quit.blend',
    * where _not_ following symlinks is OK,
@@ -241,12 +327,12 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
 #    warning "Symbolic links will be followed on undo save, possibly causing CVE-2008-1103"
 #  endif
 #endif
-  file = BLI_open(filename, oflags, 0666);
+  file = BLI_open(tempname, oflags, 0666);
 
   if (file == -1) {
     fprintf(stderr,
             "Unable to save '%s': %s\n",
-            filename,
+            tempname,
             errno ? strerror(errno) : "Unknown error opening file");
     return false;
   }
@@ -262,8 +348,15 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
   if (chunk) {
     fprintf(stderr,
             "Unable to save '%s': %s\n",
-            filename,
+            tempname,
             errno ? strerror(errno) : "Unknown error writing file");
+    BLI_delete(tempname, false, false);
+    return false;
+  }
+
+  if (BLI_rename(tempname, filename) != 0) {
+    fprintf(stderr, "Unable to save '%s': cannot rename '%s'\n", filename, tempname);
+    BLI_delete(tempname, false, false);
     return false;
   }
   return true;
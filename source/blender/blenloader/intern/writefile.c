@@ -148,7 +148,10 @@
 
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "MEM_guardedalloc.h"  // MEM_freeN
 
 #include "BKE_action.h"
@@ -208,14 +211,20 @@
 typedef enum {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZLIB,
+  /** Independent gzip frames, compressed on worker threads (see #BLEND_FRAME_SIZE). */
+  WW_WRAP_ZLIB_FRAMES,
 } eWriteWrapType;
 
+struct FrameWriter;
+
 typedef struct WriteWrap WriteWrap;
 struct WriteWrap {
   /* callbacks */
   bool (*open)(WriteWrap *ww, const char *filepath);
   bool (*close)(WriteWrap *ww);
   size_t (*write)(WriteWrap *ww, const char *data, size_t data_len);
+  /** Optional, called before writing each block header. */
+  void (*bhead_add)(WriteWrap *ww, const BHead *bhead);
 
   /* Buffer output (we only want when output isn't already buffered). */
   bool use_buf;
@@ -224,6 +233,7 @@ struct WriteWrap {
   union {
     int file_handle;
     gzFile gz_handle;
+    struct FrameWriter *frame_writer;
   } _user_data;
 };
 
@@ -281,6 +291,285 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* zlib frames (multi-threaded) */
+#define FRAME_WRITER(ww) (ww)->_user_data.frame_writer
+
+/** State of a #FrameWriteTask. */
+typedef enum eFrameWriteTaskState {
+  /** Waiting for a task pool thread. */
+  FRAME_WRITE_TASK_QUEUED = 0,
+  FRAME_WRITE_TASK_RUNNING,
+  /** Compressed, ready to be written. */
+  FRAME_WRITE_TASK_DONE,
+} eFrameWriteTaskState;
+
+typedef struct FrameWriteTask {
+  struct FrameWriteTask *next, *prev;
+  /** Uncompressed data, freed once compressed. */
+  char *data;
+  uint data_len;
+  /** Compressed frame including header and trailer, NULL on error. */
+  uchar *frame;
+  uint frame_len;
+  /** Protected by #FrameWriter.mutex. */
+  eFrameWriteTaskState state;
+} FrameWriteTask;
+
+typedef struct FrameWriter {
+  int file_handle;
+
+  /** The frame being filled, submitted once #BLEND_FRAME_SIZE is reached. */
+  char *buf;
+  uint buf_used_len;
+
+  TaskPool *task_pool;
+  /** Submitted tasks whose frame has not been written yet (oldest first). */
+  ListBase tasks;
+  int tasks_len;
+  /** Maximum number of frames in flight, limits the memory used. */
+  int tasks_max;
+  /**
+   * Tasks whose frame has been written. Their task in the pool may still be pending when the
+   * frame was compressed on the main thread, so they are only freed once the pool is done.
+   */
+  ListBase tasks_written;
+
+  /** Size of the uncompressed stream written so far. */
+  uint64_t data_len;
+  /** Block header index written at the end of the file (see #BLEND_FRAME_INDEX_HEADER_SIZE). */
+  uchar *bhead_index;
+  size_t bhead_index_len, bhead_index_alloc;
+
+  /** Protects the state of the tasks, the main thread waits on `condition` for a frame. */
+  ThreadMutex mutex;
+  ThreadCondition condition;
+  bool error;
+} FrameWriter;
+
+static void ww_zlib_frames_compress(FrameWriteTask *task)
+{
+  z_stream strm = {NULL};
+  uchar *frame = NULL;
+  uint frame_len = 0;
+
+  /* Use the same (fast) compression level as #ww_open_zlib. */
+  if (deflateInit2(&strm, 1, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+    const uint payload_len_max = deflateBound(&strm, task->data_len);
+    frame = MEM_mallocN(BLEND_FRAME_HEADER_SIZE + payload_len_max + BLEND_FRAME_TRAILER_SIZE,
+                        __func__);
+
+    strm.next_in = (Bytef *)task->data;
+    strm.avail_in = task->data_len;
+    strm.next_out = frame + BLEND_FRAME_HEADER_SIZE;
+    strm.avail_out = payload_len_max;
+
+    if (deflate(&strm, Z_FINISH) == Z_STREAM_END) {
+      const uint payload_len = (uint)strm.total_out;
+      const uint crc = (uint)crc32(0, (const Bytef *)task->data, task->data_len);
+      uchar *trailer = frame + BLEND_FRAME_HEADER_SIZE + payload_len;
+
+      blo_frame_header_encode(frame, payload_len, task->data_len);
+      for (int i = 0; i < 4; i++) {
+        trailer[i] = (uchar)(crc >> (8 * i));
+        trailer[i + 4] = (uchar)(task->data_len >> (8 * i));
+      }
+      frame_len = BLEND_FRAME_HEADER_SIZE + payload_len + BLEND_FRAME_TRAILER_SIZE;
+    }
+    deflateEnd(&strm);
+  }
+
+  if (frame_len == 0) {
+    MEM_SAFE_FREE(frame);
+  }
+
+  MEM_freeN(task->data);
+  task->data = NULL;
+  task->frame = frame;
+  task->frame_len = frame_len;
+}
+
+/** Compress the frame of \a task, unless another thread already started it. */
+static void ww_zlib_frames_task_run(FrameWriter *fw, FrameWriteTask *task)
+{
+  BLI_mutex_lock(&fw->mutex);
+  if (task->state != FRAME_WRITE_TASK_QUEUED) {
+    BLI_mutex_unlock(&fw->mutex);
+    return;
+  }
+  task->state = FRAME_WRITE_TASK_RUNNING;
+  BLI_mutex_unlock(&fw->mutex);
+
+  ww_zlib_frames_compress(task);
+
+  BLI_mutex_lock(&fw->mutex);
+  task->state = FRAME_WRITE_TASK_DONE;
+  BLI_condition_notify_all(&fw->condition);
+  BLI_mutex_unlock(&fw->mutex);
+}
+
+static void ww_zlib_frames_compress_task(TaskPool *__restrict pool, void *task)
+{
+  ww_zlib_frames_task_run(BLI_task_pool_user_data(pool), task);
+}
+
+/**
+ * Write the frame of the oldest task. When no thread started compressing it yet,
+ * it's compressed here.
+ */
+static void ww_zlib_frames_write_first(FrameWriter *fw)
+{
+  FrameWriteTask *task = fw->tasks.first;
+
+  ww_zlib_frames_task_run(fw, task);
+
+  BLI_mutex_lock(&fw->mutex);
+  while (task->state != FRAME_WRITE_TASK_DONE) {
+    BLI_condition_wait(&fw->condition, &fw->mutex);
+  }
+  BLI_mutex_unlock(&fw->mutex);
+
+  if (task->frame == NULL) {
+    fw->error = true;
+  }
+  else if (!fw->error) {
+    if (write(fw->file_handle, task->frame, task->frame_len) != task->frame_len) {
+      fw->error = true;
+    }
+  }
+  MEM_SAFE_FREE(task->frame);
+
+  BLI_remlink(&fw->tasks, task);
+  BLI_addtail(&fw->tasks_written, task);
+  fw->tasks_len--;
+}
+
+static void ww_zlib_frames_submit(FrameWriter *fw)
+{
+  FrameWriteTask *task = MEM_callocN(sizeof(*task), __func__);
+  task->data = fw->buf;
+  task->data_len = fw->buf_used_len;
+  task->state = FRAME_WRITE_TASK_QUEUED;
+
+  fw->buf = MEM_mallocN(BLEND_FRAME_SIZE, __func__);
+  fw->buf_used_len = 0;
+
+  BLI_addtail(&fw->tasks, task);
+  fw->tasks_len++;
+  BLI_task_pool_push(fw->task_pool, ww_zlib_frames_compress_task, task, false, NULL);
+
+  /* When too many frames are in flight, wait for the oldest frame to be written. */
+  while (fw->tasks_len > fw->tasks_max) {
+    ww_zlib_frames_write_first(fw);
+  }
+}
+
+static bool ww_open_zlib_frames(WriteWrap *ww, const char *filepath)
+{
+  int file;
+
+  file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+
+  if (file == -1) {
+    return false;
+  }
+
+  FrameWriter *fw = MEM_callocN(sizeof(*fw), __func__);
+  fw->file_handle = file;
+  fw->buf = MEM_mallocN(BLEND_FRAME_SIZE, __func__);
+
+  /* Keep all threads busy while the main thread fills the next frames. */
+  fw->task_pool = BLI_task_pool_create(fw, TASK_PRIORITY_HIGH);
+  fw->tasks_max = 2 * BLI_task_scheduler_num_threads();
+  BLI_mutex_init(&fw->mutex);
+  BLI_condition_init(&fw->condition);
+
+  FRAME_WRITER(ww) = fw;
+  return true;
+}
+static bool ww_close_zlib_frames(WriteWrap *ww)
+{
+  FrameWriter *fw = FRAME_WRITER(ww);
+
+  if (fw->buf_used_len != 0) {
+    ww_zlib_frames_submit(fw);
+  }
+  while (fw->tasks.first) {
+    ww_zlib_frames_write_first(fw);
+  }
+
+  BLI_task_pool_work_and_wait(fw->task_pool);
+  BLI_task_pool_free(fw->task_pool);
+  BLI_freelistN(&fw->tasks_written);
+
+  BLI_condition_end(&fw->condition);
+  BLI_mutex_end(&fw->mutex);
+
+  /* All frames are written, append the block header index in empty members. */
+  const uchar footer[BLEND_FRAME_INDEX_FOOTER_SIZE] = {0x03, 0x00};
+  for (size_t offset = 0; (offset < fw->bhead_index_len) && !fw->error;
+       offset += BLEND_FRAME_INDEX_CHUNK_SIZE) {
+    const uint len = (uint)MIN2(fw->bhead_index_len - offset, BLEND_FRAME_INDEX_CHUNK_SIZE);
+    uchar header[BLEND_FRAME_INDEX_HEADER_SIZE];
+    blo_frame_index_header_encode(header, len);
+    if ((write(fw->file_handle, header, sizeof(header)) != sizeof(header)) ||
+        (write(fw->file_handle, fw->bhead_index + offset, len) != len) ||
+        (write(fw->file_handle, footer, sizeof(footer)) != sizeof(footer))) {
+      fw->error = true;
+    }
+  }
+
+  const bool ok = (close(fw->file_handle) != -1) && !fw->error;
+
+  MEM_SAFE_FREE(fw->bhead_index);
+  MEM_freeN(fw->buf);
+  MEM_freeN(fw);
+  FRAME_WRITER(ww) = NULL;
+
+  return ok;
+}
+static size_t ww_write_zlib_frames(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  FrameWriter *fw = FRAME_WRITER(ww);
+  size_t buf_remain = buf_len;
+
+  fw->data_len += buf_len;
+
+  while (buf_remain != 0) {
+    const size_t len = MIN2(buf_remain, BLEND_FRAME_SIZE - fw->buf_used_len);
+    memcpy(fw->buf + fw->buf_used_len, buf, len);
+    fw->buf_used_len += len;
+    buf += len;
+    buf_remain -= len;
+
+    if (fw->buf_used_len == BLEND_FRAME_SIZE) {
+      ww_zlib_frames_submit(fw);
+      if (fw->error) {
+        return 0;
+      }
+    }
+  }
+
+  return buf_len;
+}
+static void ww_bhead_add_zlib_frames(WriteWrap *ww, const BHead *bhead)
+{
+  FrameWriter *fw = FRAME_WRITER(ww);
+  const size_t entry_len = 8 + sizeof(*bhead);
+
+  if (fw->bhead_index_len + entry_len > fw->bhead_index_alloc) {
+    fw->bhead_index_alloc = MAX2(fw->bhead_index_alloc * 2, 4096);
+    fw->bhead_index = MEM_reallocN(fw->bhead_index, fw->bhead_index_alloc);
+  }
+
+  uchar *entry = fw->bhead_index + fw->bhead_index_len;
+  for (int i = 0; i < 8; i++) {
+    entry[i] = (uchar)(fw->data_len >> (8 * i));
+  }
+  memcpy(entry + 8, bhead, sizeof(*bhead));
+  fw->bhead_index_len += entry_len;
+}
+#undef FRAME_WRITER
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -295,6 +584,14 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = false;
       break;
     }
+    case WW_WRAP_ZLIB_FRAMES: {
+      r_ww->open = ww_open_zlib_frames;
+      r_ww->close = ww_close_zlib_frames;
+      r_ww->write = ww_write_zlib_frames;
+      r_ww->bhead_add = ww_bhead_add_zlib_frames;
+      r_ww->use_buf = false;
+      break;
+    }
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -331,6 +628,14 @@ typedef struct {
   MemFileWriteData mem;
   /** When true, write to #WriteData.current, could also call 'is_undo'. */
   bool use_memfile;
+  /**
+   * When true, nothing is written, the data is only compared with the chunks of the ID in the
+   * reference memfile, see #mywrite_id_compare_begin.
+   */
+  bool use_memfile_compare;
+  /** Reference chunk holding the next data to compare, and the offset of that data in it. */
+  MemFileChunk *compare_chunk;
+  uint compare_offset;
 
   /**
    * Wrap writing, so we can use zlib or
@@ -411,6 +716,8 @@ static void mywrite_flush(WriteData *wd)
  * \param adr: Pointer to new chunk of data
  * \param len: Length of new chunk of data
  */
+static bool mywrite_id_compare(WriteData *wd, const void *adr, int len);
+
 static void mywrite(WriteData *wd, const void *adr, int len)
 {
   if (UNLIKELY(wd->error)) {
@@ -422,6 +729,10 @@ static void mywrite(WriteData *wd, const void *adr, int len)
     return;
   }
 
+  if (wd->use_memfile_compare && mywrite_id_compare(wd, adr, len)) {
+    return;
+  }
+
 #ifdef USE_WRITE_DATA_LEN
   wd->write_len += len;
 #endif
@@ -460,6 +771,19 @@ static void mywrite(WriteData *wd, const void *adr, int len)
   }
 }
 
+/**
+ * Write a block header, letting the write wrapper index it.
+ */
+static void mywrite_bhead(WriteData *wd, const BHead *bhead)
+{
+  if (!wd->use_memfile && !wd->use_memfile_compare && (wd->ww->bhead_add != NULL) && !wd->error) {
+    /* Offsets are counted by the wrapper, so nothing may be buffered in between. */
+    BLI_assert(wd->buf == NULL);
+    wd->ww->bhead_add(wd->ww, bhead);
+  }
+  mywrite(wd, bhead, sizeof(BHead));
+}
+
 /**
  * BeGiN initializer for mywrite
  * \param ww: File write wrapper.
@@ -530,13 +854,144 @@ static void mywrite_id_begin(WriteData *wd, ID *id)
 }
 
 /**
- * Start writing of data related to a single ID.
+ * Collect the object data (geometry) which may have been modified through its objects,
+ * editing tools (sculpting for e.g.) modify the data in place while only tagging the object.
+ */
+static GSet *mywrite_dirty_obdata_gset(Main *bmain)
+{
+  GSet *dirty_ids = BLI_gset_ptr_new(__func__);
+  LISTBASE_FOREACH (Object *, ob, &bmain->objects) {
+    if (ob->data != NULL &&
+        (ob->id.recalc_after_undo_push != 0 || ob->mode != OB_MODE_OBJECT)) {
+      BLI_gset_add(dirty_ids, ob->data);
+    }
+  }
+  return dirty_ids;
+}
+
+/**
+ * Copy the ID struct to the buffer it's written from.
+ */
+static void mywrite_id_buffer_init(void *id_buffer, const ID *id, size_t id_buffer_size)
+{
+  memcpy(id_buffer, id, id_buffer_size);
+
+  ((ID *)id_buffer)->tag = 0;
+  /* Those listbase data change every time we add/remove an ID, and also often when renaming
+   * one (due to re-sorting). This avoids generating a lot of false 'is changed' detections
+   * between undo steps. */
+  ((ID *)id_buffer)->prev = NULL;
+  ((ID *)id_buffer)->next = NULL;
+}
+
+/**
+ * When storing an undo step, check whether the ID is unchanged since the previous step,
+ * in which case the memory of that step is shared instead of writing the ID again.
+ *
+ * This is only done for geometry IDs, which hold the bulk of the data. IDs tagged for update
+ * (see #ID.recalc_after_undo_push) are written right away. Others are written in compare mode,
+ * since many changes are not tagged (Python `foreach_set` without an update, ID properties...):
+ * the data is compared with the chunks of the previous step as it's written, without copying it.
+ * On the first difference, the matching part is taken from those chunks and writing goes on as
+ * usual, so the ID is never written twice. See #mywrite_id_end for the unchanged case.
+ *
+ * \param dirty_ids: IDs which must be written (see #mywrite_dirty_obdata_gset).
+ */
+static void mywrite_id_compare_begin(WriteData *wd, ID *id, GSet *dirty_ids)
+{
+  if (!wd->use_memfile || wd->mem.reference_memfile == NULL ||
+      !ELEM(GS(id->name), ID_ME, ID_CU, ID_MB, ID_LT, ID_HA, ID_PT, ID_VO)) {
+    return;
+  }
+  if (id->recalc_up_to_undo_push != 0 || BLI_gset_haskey(dirty_ids, id)) {
+    return;
+  }
+
+  MemFileChunk *chunk = wd->mem.reference_current_chunk;
+  if (chunk == NULL || chunk->id_session_uuid != id->session_uuid) {
+    return;
+  }
+
+  wd->use_memfile_compare = true;
+  wd->compare_chunk = chunk;
+  wd->compare_offset = 0;
+}
+
+/**
+ * Write the reference data which matched so far, and leave compare mode.
+ */
+static void mywrite_id_compare_cancel(WriteData *wd)
+{
+  wd->use_memfile_compare = false;
+
+  for (MemFileChunk *chunk = wd->mem.reference_current_chunk; chunk != wd->compare_chunk;
+       chunk = chunk->next) {
+    mywrite(wd, chunk->buf, (int)chunk->size);
+  }
+  if (wd->compare_offset != 0) {
+    mywrite(wd, wd->compare_chunk->buf, (int)wd->compare_offset);
+  }
+}
+
+/**
+ * Compare data written in compare mode with the reference chunks of the ID.
+ *
+ * \return false when the data differs, compare mode is left then and the data must be written.
+ */
+static bool mywrite_id_compare(WriteData *wd, const void *adr, int len)
+{
+  const uint id_session_uuid = wd->mem.current_id_session_uuid;
+  MemFileChunk *chunk = wd->compare_chunk;
+  uint offset = wd->compare_offset;
+  const char *data = adr;
+  uint remaining = (uint)len;
+
+  while (remaining != 0) {
+    if (chunk == NULL || chunk->id_session_uuid != id_session_uuid) {
+      mywrite_id_compare_cancel(wd);
+      return false;
+    }
+    const uint compare_len = MIN2(chunk->size - offset, remaining);
+    if (memcmp(chunk->buf + offset, data, compare_len) != 0) {
+      mywrite_id_compare_cancel(wd);
+      return false;
+    }
+    data += compare_len;
+    remaining -= compare_len;
+    offset += compare_len;
+    if (offset == chunk->size) {
+      chunk = chunk->next;
+      offset = 0;
+    }
+  }
+
+  wd->compare_chunk = chunk;
+  wd->compare_offset = offset;
+  return true;
+}
+
+/**
+ * End writing of data related to a single ID.
  *
  * Only does something when storing an undo step.
  */
 static void mywrite_id_end(WriteData *wd, ID *UNUSED(id))
 {
   if (wd->use_memfile) {
+    if (wd->use_memfile_compare) {
+      const MemFileChunk *chunk = wd->compare_chunk;
+      if (wd->compare_offset == 0 &&
+          (chunk == NULL || chunk->id_session_uuid != wd->mem.current_id_session_uuid)) {
+        /* All the data matched the previous step, share its chunks. */
+        wd->use_memfile_compare = false;
+        BLO_memfile_id_chunks_reuse(&wd->mem);
+      }
+      else {
+        /* The ID wrote less data than in the previous step. */
+        mywrite_id_compare_cancel(wd);
+      }
+    }
+
     /* Very important to do it after every ID write now, otherwise we cannot know whether a
      * specific ID changed or not. */
     mywrite_flush(wd);
@@ -576,7 +1031,7 @@ static void writestruct_at_address_nr(
     return;
   }
 
-  mywrite(wd, &bh, sizeof(BHead));
+  mywrite_bhead(wd, &bh);
   mywrite(wd, data, bh.len);
 }
 
@@ -605,7 +1060,7 @@ static void writedata(WriteData *wd, int filecode, int len, const void *adr)
   bh.SDNAnr = 0;
   bh.len = len;
 
-  mywrite(wd, &bh, sizeof(BHead));
+  mywrite_bhead(wd, &bh);
   mywrite(wd, adr, len);
 }
 
@@ -4003,6 +4458,142 @@ static void write_thumb(WriteData *wd, const BlendThumbnail *thumb)
 /** \name File Writing (Private)
  * \{ */
 
+/**
+ * Write the data of an ID, using the type specific write function.
+ *
+ * \param id_buffer: A copy of the ID struct, the one which is written.
+ */
+static void write_id_by_type(BlendWriter *writer, ID *id, void *id_buffer)
+{
+  switch ((ID_Type)GS(id->name)) {
+    case ID_WM:
+      write_windowmanager(writer, (wmWindowManager *)id_buffer, id);
+      break;
+    case ID_WS:
+      write_workspace(writer, (WorkSpace *)id_buffer, id);
+      break;
+    case ID_SCR:
+      write_screen(writer, (bScreen *)id_buffer, id);
+      break;
+    case ID_MC:
+      write_movieclip(writer, (MovieClip *)id_buffer, id);
+      break;
+    case ID_MSK:
+      write_mask(writer, (Mask *)id_buffer, id);
+      break;
+    case ID_SCE:
+      write_scene(writer, (Scene *)id_buffer, id);
+      break;
+    case ID_CU:
+      write_curve(writer, (Curve *)id_buffer, id);
+      break;
+    case ID_MB:
+      write_mball(writer, (MetaBall *)id_buffer, id);
+      break;
+    case ID_IM:
+      write_image(writer, (Image *)id_buffer, id);
+      break;
+    case ID_CA:
+      write_camera(writer, (Camera *)id_buffer, id);
+      break;
+    case ID_LA:
+      write_light(writer, (Light *)id_buffer, id);
+      break;
+    case ID_LT:
+      write_lattice(writer, (Lattice *)id_buffer, id);
+      break;
+    case ID_VF:
+      write_vfont(writer, (VFont *)id_buffer, id);
+      break;
+    case ID_KE:
+      write_key(writer, (Key *)id_buffer, id);
+      break;
+    case ID_WO:
+      write_world(writer, (World *)id_buffer, id);
+      break;
+    case ID_TXT:
+      write_text(writer, (Text *)id_buffer, id);
+      break;
+    case ID_SPK:
+      write_speaker(writer, (Speaker *)id_buffer, id);
+      break;
+    case ID_LP:
+      write_probe(writer, (LightProbe *)id_buffer, id);
+      break;
+    case ID_SO:
+      write_sound(writer, (bSound *)id_buffer, id);
+      break;
+    case ID_GR:
+      write_collection(writer, (Collection *)id_buffer, id);
+      break;
+    case ID_AR:
+      write_armature(writer, (bArmature *)id_buffer, id);
+      break;
+    case ID_AC:
+      write_action(writer, (bAction *)id_buffer, id);
+      break;
+    case ID_OB:
+      write_object(writer, (Object *)id_buffer, id);
+      break;
+    case ID_MA:
+      write_material(writer, (Material *)id_buffer, id);
+      break;
+    case ID_TE:
+      write_texture(writer, (Tex *)id_buffer, id);
+      break;
+    case ID_ME:
+      write_mesh(writer, (Mesh *)id_buffer, id);
+      break;
+    case ID_PA:
+      write_particlesettings(writer, (ParticleSettings *)id_buffer, id);
+      break;
+    case ID_NT:
+      write_nodetree(writer, (bNodeTree *)id_buffer, id);
+      break;
+    case ID_BR:
+      write_brush(writer, (Brush *)id_buffer, id);
+      break;
+    case ID_PAL:
+      write_palette(writer, (Palette *)id_buffer, id);
+      break;
+    case ID_PC:
+      write_paintcurve(writer, (PaintCurve *)id_buffer, id);
+      break;
+    case ID_GD:
+      write_gpencil(writer, (bGPdata *)id_buffer, id);
+      break;
+    case ID_LS:
+      write_linestyle(writer, (FreestyleLineStyle *)id_buffer, id);
+      break;
+    case ID_CF:
+      write_cachefile(writer, (CacheFile *)id_buffer, id);
+      break;
+    case ID_HA:
+      write_hair(writer, (Hair *)id_buffer, id);
+      break;
+    case ID_PT:
+      write_pointcloud(writer, (PointCloud *)id_buffer, id);
+      break;
+    case ID_VO:
+      write_volume(writer, (Volume *)id_buffer, id);
+      break;
+    case ID_SIM:
+      write_simulation(writer, (Simulation *)id_buffer, id);
+      break;
+    case ID_LI:
+      /* Do nothing, handled below - and should never be reached. */
+      BLI_assert(0);
+      break;
+    case ID_IP:
+      /* Do nothing, deprecated. */
+      break;
+    default:
+      /* Should never be reached. */
+      BLI_assert(0);
+      break;
+  }
+}
+
 /* if MemFile * there's filesave to memory */
 static bool write_file_handle(Main *mainvar,
                               WriteWrap *ww,
@@ -4041,6 +4632,10 @@ static bool write_file_handle(Main *mainvar,
   OverrideLibraryStorage *override_storage =
       wd->use_memfile ? NULL : BKE_lib_override_library_operations_store_initialize();
 
+  /* Needs to be collected before the loop below clears the objects undo recalc flags. */
+  GSet *dirty_ids = (wd->use_memfile && compare != NULL) ? mywrite_dirty_obdata_gset(mainvar) :
+                                                           NULL;
+
 #define ID_BUFFER_STATIC_SIZE 8192
   /* This outer loop allows to save first data-blocks from real mainvar,
    * then the temp ones from override process,
@@ -4101,143 +4696,14 @@ static bool write_file_handle(Main *mainvar,
 
         mywrite_id_begin(wd, id);
 
-        memcpy(id_buffer, id, idtype_struct_size);
+        mywrite_id_buffer_init(id_buffer, id, idtype_struct_size);
 
-        ((ID *)id_buffer)->tag = 0;
-        /* Those listbase data change every time we add/remove an ID, and also often when renaming
-         * one (due to re-sorting). This avoids generating a lot of false 'is changed' detections
-         * between undo steps. */
-        ((ID *)id_buffer)->prev = NULL;
-        ((ID *)id_buffer)->next = NULL;
-
-        switch ((ID_Type)GS(id->name)) {
-          case ID_WM:
-            write_windowmanager(&writer, (wmWindowManager *)id_buffer, id);
-            break;
-          case ID_WS:
-            write_workspace(&writer, (WorkSpace *)id_buffer, id);
-            break;
-          case ID_SCR:
-            write_screen(&writer, (bScreen *)id_buffer, id);
-            break;
-          case ID_MC:
-            write_movieclip(&writer, (MovieClip *)id_buffer, id);
-            break;
-          case ID_MSK:
-            write_mask(&writer, (Mask *)id_buffer, id);
-            break;
-          case ID_SCE:
-            write_scene(&writer, (Scene *)id_buffer, id);
-            break;
-          case ID_CU:
-            write_curve(&writer, (Curve *)id_buffer, id);
-            break;
-          case ID_MB:
-            write_mball(&writer, (MetaBall *)id_buffer, id);
-            break;
-          case ID_IM:
-            write_image(&writer, (Image *)id_buffer, id);
-            break;
-          case ID_CA:
-            write_camera(&writer, (Camera *)id_buffer, id);
-            break;
-          case ID_LA:
-            write_light(&writer, (Light *)id_buffer, id);
-            break;
-          case ID_LT:
-            write_lattice(&writer, (Lattice *)id_buffer, id);
-            break;
-          case ID_VF:
-            write_vfont(&writer, (VFont *)id_buffer, id);
-            break;
-          case ID_KE:
-            write_key(&writer, (Key *)id_buffer, id);
-            break;
-          case ID_WO:
-            write_world(&writer, (World *)id_buffer, id);
-            break;
-          case ID_TXT:
-            write_text(&writer, (Text *)id_buffer, id);
-            break;
-          case ID_SPK:
-            write_speaker(&writer, (Speaker *)id_buffer, id);
-            break;
-          case ID_LP:
-            write_probe(&writer, (LightProbe *)id_buffer, id);
-            break;
-          case ID_SO:
-            write_sound(&writer, (bSound *)id_buffer, id);
-            break;
-          case ID_GR:
-            write_collection(&writer, (Collection *)id_buffer, id);
-            break;
-          case ID_AR:
-            write_armature(&writer, (bArmature *)id_buffer, id);
-            break;
-          case ID_AC:
-            write_action(&writer, (bAction *)id_buffer, id);
-            break;
-          case ID_OB:
-            write_object(&writer, (Object *)id_buffer, id);
-            break;
-          case ID_MA:
-            write_material(&writer, (Material *)id_buffer, id);
-            break;
-          case ID_TE:
-            write_texture(&writer, (Tex *)id_buffer, id);
-            break;
-          case ID_ME:
-            write_mesh(&writer, (Mesh *)id_buffer, id);
-            break;
-          case ID_PA:
-            write_particlesettings(&writer, (ParticleSettings *)id_buffer, id);
-            break;
-          case ID_NT:
-            write_nodetree(&writer, (bNodeTree *)id_buffer, id);
-            break;
-          case ID_BR:
-            write_brush(&writer, (Brush *)id_buffer, id);
-            break;
-          case ID_PAL:
-            write_palette(&writer, (Palette *)id_buffer, id);
-            break;
-          case ID_PC:
-            write_paintcurve(&writer, (PaintCurve *)id_buffer, id);
-            break;
-          case ID_GD:
-            write_gpencil(&writer, (bGPdata *)id_buffer, id);
-            break;
-          case ID_LS:
-            write_linestyle(&writer, (FreestyleLineStyle *)id_buffer, id);
-            break;
-          case ID_CF:
-            write_cachefile(&writer, (CacheFile *)id_buffer, id);
-            break;
-          case ID_HA:
-            write_hair(&writer, (Hair *)id_buffer, id);
-            break;
-          case ID_PT:
-            write_pointcloud(&writer, (PointCloud *)id_buffer, id);
-            break;
-          case ID_VO:
-            write_volume(&writer, (Volume *)id_buffer, id);
-            break;
-          case ID_SIM:
-            write_simulation(&writer, (Simulation *)id_buffer, id);
-            break;
-          case ID_LI:
-            /* Do nothing, handled below - and should never be reached. */
-            BLI_assert(0);
-            break;
-          case ID_IP:
-            /* Do nothing, deprecated. */
-            break;
-          default:
-            /* Should never be reached. */
-            BLI_assert(0);
-            break;
+        if (!do_override) {
+          mywrite_id_compare_begin(wd, id, dirty_ids);
         }
 
+        write_id_by_type(&writer, id, id_buffer);
+
         if (do_override) {
           BKE_lib_override_library_operations_store_end(override_storage, id);
         }
@@ -4258,6 +4724,10 @@ static bool write_file_handle(Main *mainvar,
     override_storage = NULL;
   }
 
+  if (dirty_ids) {
+    BLI_gset_free(dirty_ids, NULL);
+  }
+
   /* Special handling, operating over split Mains... */
   write_libraries(wd, mainvar->next);
 
@@ -4277,7 +4747,7 @@ static bool write_file_handle(Main *mainvar,
   /* end of file */
   memset(&bhead, 0, sizeof(BHead));
   bhead.code = ENDB;
-  mywrite(wd, &bhead, sizeof(BHead));
+  mywrite_bhead(wd, &bhead);
 
   blo_join_main(&mainlist);
 
@@ -4365,7 +4835,7 @@ bool BLO_write_file(Main *mainvar,
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   if (write_flags & G_FILE_COMPRESS) {
-    ww_type = WW_WRAP_ZLIB;
+    ww_type = WW_WRAP_ZLIB_FRAMES;
   }
   else {
     ww_type = WW_WRAP_NONE;
@@ -4440,9 +4910,12 @@ bool BLO_write_file(Main *mainvar,
   }
 
   /* actual file writing */
-  const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, use_userdef, thumb);
+  bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, use_userdef, thumb);
 
-  ww.close(&ww);
+  /* Compression may write asynchronously, so errors can also be reported on close. */
+  if (ww.close(&ww) == false) {
+    err = true;
+  }
 
   if (UNLIKELY(path_list_backup)) {
     BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
@@ -107,6 +107,13 @@ typedef enum OrderOfChunks {
 #define COM_NUM_CHANNELS_VECTOR 3
 #define COM_NUM_CHANNELS_COLOR 4
 
+/**
+ * \brief Maximum number of pixels calculated at once by #SocketReader::executeRow.
+ * Rows are processed in segments of this size so the intermediate results
+ * of every operation in the chain fit on the stack.
+ */
+#define COM_ROW_WIDTH_MAX 64
+
 #define COM_BLUR_BOKEH_PIXELS 512
 
 #endif /* __COM_DEFINES_H__ */
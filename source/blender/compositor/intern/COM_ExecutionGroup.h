@@ -182,6 +182,17 @@ class ExecutionGroup {
    */
   double m_executionStartTime;
 
+  /**
+   * \brief order in which the chunks are scheduled, valid between #beginExecution and
+   * #endExecution
+   */
+  unsigned int *m_chunkOrder;
+
+  /**
+   * \brief index in #m_chunkOrder before which all chunks have been executed
+   */
+  unsigned int m_chunkOrderStartIndex;
+
   // methods
   /**
    * \brief check whether parameter operation can be added to the execution group
@@ -333,6 +344,14 @@ class ExecutionGroup {
    */
   NodeOperation *getOutputOperation() const;
 
+  /**
+   * \brief get the ReadBufferOperations of this ExecutionGroup, valid after #initExecution
+   */
+  const Operations &getReadOperations() const
+  {
+    return this->m_cachedReadOperations;
+  }
+
   /**
    * \brief compose multiple chunks into a single chunk
    * \return Memorybuffer *consolidated chunk
@@ -383,22 +402,44 @@ class ExecutionGroup {
   void deinitExecution();
 
   /**
-   * \brief schedule an ExecutionGroup
-   * \note this method will return when all chunks have been calculated, or the execution has
-   * breaked (by user)
+   * \brief prepare the execution of this output group: determine the chunk order.
    *
-   * first the order of the chunks will be determined. This is determined by finding the
-   * ViewerOperation and get the relevant information from it.
-   *   - ChunkOrdering
-   *   - CenterX
-   *   - CenterY
-   *
-   * After determining the order of the chunks the chunks will be scheduled
+   * The order of the chunks is determined by the ViewerOperation when this group outputs to
+   * one (ChunkOrdering, CenterX and CenterY), the chunks are then scheduled with
+   * #scheduleChunks.
+   * \return false when there is nothing to execute, #endExecution must not be called then.
+   */
+  bool beginExecution(ExecutionSystem *system);
+
+  /**
+   * \brief schedule the next round of chunks of this output group.
    *
-   * \see ViewerOperation
-   * \param system:
+   * Several output groups can be scheduled before #WorkScheduler::finish is called,
+   * so independent groups (a viewer and the composite output for e.g.) run concurrently.
+   * \return true when all chunks have been executed.
+   */
+  bool scheduleChunks(ExecutionSystem *system);
+
+  /**
+   * \brief finish the execution started by #beginExecution.
+   */
+  void endExecution(ExecutionSystem *system);
+
+  /**
+   * \brief mark all chunks as executed, used when the output buffer was restored from the
+   * #ResultCache so neither this group nor the groups it depends on are scheduled.
+   */
+  void setChunksExecuted();
+
+  /**
+   * \brief mark a scheduled chunk as executed, see #WorkScheduler::waitForChunks.
+   */
+  void setChunkExecuted(unsigned int chunkNumber);
+
+  /**
+   * \brief have all chunks of this group been executed
    */
-  void execute(ExecutionSystem *system);
+  bool isFullyExecuted() const;
 
   /**
    * \brief this method determines the MemoryProxy's where this execution group depends on.
@@ -18,9 +18,17 @@
 
 #include "COM_ExecutionSystem.h"
 
+#include <string.h>
+#include <typeinfo>
+
+#include "BLI_listbase.h"
+#include "BLI_string.h"
 #include "BLI_utildefines.h"
 #include "PIL_time.h"
 
+#include "MEM_guardedalloc.h"
+
+#include "BKE_global.h"
 #include "BKE_node.h"
 
 #include "BLT_translation.h"
@@ -31,11 +39,9 @@
 #include "COM_NodeOperation.h"
 #include "COM_NodeOperationBuilder.h"
 #include "COM_ReadBufferOperation.h"
+#include "COM_ResultCache.h"
 #include "COM_WorkScheduler.h"
-
-#ifdef WITH_CXX_GUARDEDALLOC
-#  include "MEM_guardedalloc.h"
-#endif
+#include "COM_WriteBufferOperation.h"
 
 ExecutionSystem::ExecutionSystem(RenderData *rd,
                                  Scene *scene,
@@ -59,6 +65,8 @@ ExecutionSystem::ExecutionSystem(RenderData *rd,
     this->m_context.setQuality((CompositorQuality)editingtree->edit_quality);
   }
   this->m_context.setRendering(rendering);
+  /* Final renders start from new render results, caching only pays off while editing. */
+  this->m_useResultCache = !rendering;
   this->m_context.setHasActiveOpenCLDevices(WorkScheduler::hasGPUDevices() &&
                                             (editingtree->flag & NTREE_COM_OPENCL));
 
@@ -147,7 +155,7 @@ void ExecutionSystem::execute()
   }
   unsigned int index;
 
-  // First allocale all write buffer
+  // First initialize all write buffers, their memory is allocated by the MemoryPlanner
   for (index = 0; index < this->m_operations.size(); index++) {
     NodeOperation *operation = this->m_operations[index];
     if (operation->isWriteBufferOperation()) {
@@ -155,14 +163,6 @@ void ExecutionSystem::execute()
       operation->initExecution();
     }
   }
-  // Connect read buffers to their write buffers
-  for (index = 0; index < this->m_operations.size(); index++) {
-    NodeOperation *operation = this->m_operations[index];
-    if (operation->isReadBufferOperation()) {
-      ReadBufferOperation *readOperation = (ReadBufferOperation *)operation;
-      readOperation->updateMemoryBuffer();
-    }
-  }
   // initialize other operations
   for (index = 0; index < this->m_operations.size(); index++) {
     NodeOperation *operation = this->m_operations[index];
@@ -177,6 +177,14 @@ void ExecutionSystem::execute()
     executionGroup->initExecution();
   }
 
+  this->m_memoryPlanner.initExecution(this->m_operations, this->m_groups);
+
+  if (this->m_useResultCache) {
+    restoreCachedResults();
+  }
+
+  planMemory();
+
   WorkScheduler::start(this->m_context);
 
   executeGroups(COM_PRIORITY_HIGH);
@@ -188,6 +196,17 @@ void ExecutionSystem::execute()
   WorkScheduler::finish();
   WorkScheduler::stop();
 
+  if (this->m_useResultCache) {
+    storeCachedResults();
+  }
+
+  if (G.debug & G_DEBUG) {
+    char peak_str[15];
+    BLI_str_format_byte_unit(peak_str, this->m_memoryPlanner.getPeakSize(), false);
+    printf("Compositor: %s buffer memory peak %s\n", editingtree->id.name + 2, peak_str);
+  }
+  this->m_memoryPlanner.deinitExecution();
+
   editingtree->stats_draw(editingtree->sdh, TIP_("Compositing | De-initializing execution"));
   for (index = 0; index < this->m_operations.size(); index++) {
     NodeOperation *operation = this->m_operations[index];
@@ -205,9 +224,74 @@ void ExecutionSystem::executeGroups(CompositorPriority priority)
   vector<ExecutionGroup *> executionGroups;
   this->findOutputExecutionGroup(&executionGroups, priority);
 
+  /* Schedule the output groups together rather than one after the other, so chunks of
+   * independent outputs fill up the threads that a single group would leave idle. */
+  vector<ExecutionGroup *> activeGroups;
   for (index = 0; index < executionGroups.size(); index++) {
     ExecutionGroup *group = executionGroups[index];
-    group->execute(this);
+    if (group->beginExecution(this)) {
+      activeGroups.push_back(group);
+    }
+  }
+
+  /* Each group schedules the chunks whose inputs are available, then more every time a chunk
+   * finishes, without waiting for the chunks of other groups. */
+  const bNodeTree *bTree = this->getContext().getbNodeTree();
+  while (!activeGroups.empty()) {
+    index = 0;
+    while (index < activeGroups.size()) {
+      ExecutionGroup *group = activeGroups[index];
+      if (group->scheduleChunks(this)) {
+        group->endExecution(this);
+        activeGroups.erase(activeGroups.begin() + index);
+      }
+      else {
+        index++;
+      }
+    }
+    if (activeGroups.empty()) {
+      break;
+    }
+
+    WorkScheduler::waitForChunks();
+    this->m_memoryPlanner.releaseFinishedBuffers();
+
+    if (bTree->test_break && bTree->test_break(bTree->tbh)) {
+      break;
+    }
+  }
+
+  for (index = 0; index < activeGroups.size(); index++) {
+    activeGroups[index]->endExecution(this);
+  }
+}
+
+void ExecutionSystem::planMemory()
+{
+  vector<ExecutionGroup *> outputGroups;
+  this->findOutputExecutionGroup(&outputGroups, COM_PRIORITY_HIGH);
+  if (!this->getContext().isFastCalculation()) {
+    this->findOutputExecutionGroup(&outputGroups, COM_PRIORITY_MEDIUM);
+    this->findOutputExecutionGroup(&outputGroups, COM_PRIORITY_LOW);
+  }
+  this->m_memoryPlanner.plan(outputGroups);
+
+  char peak_str[15], total_str[15], buf[128];
+  BLI_str_format_byte_unit(peak_str, this->m_memoryPlanner.getPlannedPeakSize(), false);
+  BLI_str_format_byte_unit(total_str, this->m_memoryPlanner.getTotalSize(), false);
+  BLI_snprintf(buf,
+               sizeof(buf),
+               TIP_("Compositing | Buffer memory %s (%s without reuse)"),
+               peak_str,
+               total_str);
+
+  const bNodeTree *editingtree = this->m_context.getbNodeTree();
+  editingtree->stats_draw(editingtree->sdh, buf);
+  if (G.debug & G_DEBUG) {
+    printf("Compositor: %s planned buffer memory peak %s, %s without reuse\n",
+           editingtree->id.name + 2,
+           peak_str,
+           total_str);
   }
 }
 
@@ -233,3 +317,179 @@ void ExecutionSystem::findOutputExecutionGroup(vector<ExecutionGroup *> *result)
     }
   }
 }
+
+/* -------------------------------------------------------------------- */
+/** \name Result Cache
+ * \{ */
+
+typedef std::map<NodeOperation *, unsigned int> OperationIndices;
+
+static void signature_add(std::string &signature, const void *data, size_t size)
+{
+  signature.append((const char *)data, size);
+}
+
+static void signature_add_int(std::string &signature, unsigned int value)
+{
+  signature_add(signature, &value, sizeof(value));
+}
+
+static void signature_add_memory(std::string &signature, const void *data)
+{
+  if (data) {
+    signature_add(signature, data, MEM_allocN_len(data));
+  }
+  else {
+    signature_add_int(signature, 0);
+  }
+}
+
+/**
+ * Settings of the node an operation was created for. Nodes pass most of these to their
+ * operations when converting, so adding them avoids having to describe every operation.
+ */
+static void signature_add_bnode(std::string &signature, const bNode *node)
+{
+  signature_add_int(signature, node->type);
+  signature_add_int(signature, node->custom1);
+  signature_add_int(signature, node->custom2);
+  signature_add(signature, &node->custom3, sizeof(node->custom3));
+  signature_add(signature, &node->custom4, sizeof(node->custom4));
+  /* The address of a freed ID can be reused by a new one, the session UUID is never reused.
+   * The data of the ID is covered by the #NodeOperation::getCacheHash of operations reading it. */
+  signature_add_int(signature, (node->id) ? node->id->session_uuid : 0);
+  signature_add_memory(signature, node->storage);
+  LISTBASE_FOREACH (const bNodeSocket *, sock, &node->inputs) {
+    signature_add_memory(signature, sock->default_value);
+  }
+}
+
+/**
+ * Describe an operation and everything upstream of it, following read buffers to the operations
+ * writing them. Inputs are referred to by their index in indices, so operations used by several
+ * others are only described once.
+ * \return false when an operation upstream is not cacheable.
+ */
+static bool signature_add_operation(NodeOperation *operation,
+                                    OperationIndices &indices,
+                                    std::string &signature)
+{
+  if (indices.find(operation) != indices.end()) {
+    return true;
+  }
+  if (!operation->isCacheable()) {
+    return false;
+  }
+
+  NodeOperation *writeOperation = NULL;
+  if (operation->isReadBufferOperation()) {
+    ReadBufferOperation *readOperation = (ReadBufferOperation *)operation;
+    writeOperation = readOperation->getMemoryProxy()->getWriteBufferOperation();
+    if (!signature_add_operation(writeOperation, indices, signature)) {
+      return false;
+    }
+  }
+  for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+    NodeOperationInput *socket = operation->getInputSocket(index);
+    if (socket->isConnected() &&
+        !signature_add_operation(&socket->getLink()->getOperation(), indices, signature)) {
+      return false;
+    }
+  }
+
+  const char *type_name = typeid(*operation).name();
+  signature_add(signature, type_name, strlen(type_name) + 1);
+  signature_add_int(signature, operation->getWidth());
+  signature_add_int(signature, operation->getHeight());
+  signature_add_int(signature, operation->getCacheHash());
+  if (writeOperation) {
+    signature_add_int(signature, indices[writeOperation]);
+  }
+  for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+    NodeOperationInput *socket = operation->getInputSocket(index);
+    signature_add_int(
+        signature, (socket->isConnected()) ? indices[&socket->getLink()->getOperation()] : 0);
+  }
+  if (operation->getbNode()) {
+    signature_add_bnode(signature, operation->getbNode());
+  }
+  else {
+    signature_add_int(signature, 0);
+  }
+
+  /* Indices start at 1, 0 is used for unconnected inputs. */
+  const unsigned int operation_index = indices.size() + 1;
+  indices[operation] = operation_index;
+  return true;
+}
+
+void ExecutionSystem::restoreCachedResults()
+{
+  ResultCache::beginExecution();
+
+  /* Context settings that change the result of operations. */
+  std::string context_signature;
+  signature_add_int(context_signature, this->m_context.getFramenumber());
+  signature_add_int(context_signature, this->m_context.getQuality());
+  signature_add_int(context_signature, this->m_context.isFastCalculation());
+  if (this->m_context.getViewName()) {
+    const char *view_name = this->m_context.getViewName();
+    signature_add(context_signature, view_name, strlen(view_name) + 1);
+  }
+  else {
+    signature_add_int(context_signature, 0);
+  }
+
+  for (unsigned int index = 0; index < this->m_groups.size(); index++) {
+    ExecutionGroup *group = this->m_groups[index];
+    NodeOperation *operation = group->getOutputOperation();
+    /* Only complex groups are expensive enough to be worth the memory. */
+    if (!group->isComplex() || !operation->isWriteBufferOperation()) {
+      continue;
+    }
+
+    std::string signature = context_signature;
+    OperationIndices indices;
+    if (!signature_add_operation(operation, indices, signature)) {
+      continue;
+    }
+
+    WriteBufferOperation *writeOperation = (WriteBufferOperation *)operation;
+    MemoryProxy *memoryProxy = writeOperation->getMemoryProxy();
+    this->m_memoryPlanner.acquire(memoryProxy);
+    if (ResultCache::restore(signature, memoryProxy)) {
+      group->setChunksExecuted();
+    }
+    else {
+      /* Reused by the next buffer of the same size. */
+      this->m_memoryPlanner.release(memoryProxy);
+      this->m_memoryPlanner.keep(memoryProxy);
+      this->m_resultCacheKeys[writeOperation] = signature;
+    }
+  }
+}
+
+void ExecutionSystem::storeCachedResults()
+{
+  const bNodeTree *editingtree = this->m_context.getbNodeTree();
+  const bool breaked = editingtree->test_break && editingtree->test_break(editingtree->tbh);
+
+  if (!breaked) {
+    for (std::map<WriteBufferOperation *, std::string>::const_iterator it =
+             this->m_resultCacheKeys.begin();
+         it != this->m_resultCacheKeys.end();
+         ++it) {
+      MemoryProxy *memoryProxy = it->first->getMemoryProxy();
+      ExecutionGroup *group = memoryProxy->getExecutor();
+      /* Groups are only executed for the area their readers need. */
+      if (group && group->isFullyExecuted()) {
+        ResultCache::store(it->second, memoryProxy);
+      }
+    }
+  }
+  this->m_resultCacheKeys.clear();
+
+  ResultCache::endExecution();
+}
+
+/** \} */
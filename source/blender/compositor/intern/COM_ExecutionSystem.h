@@ -21,8 +21,12 @@ class ExecutionGroup;
 #ifndef __COM_EXECUTIONSYSTEM_H__
 #define __COM_EXECUTIONSYSTEM_H__
 
+#include <map>
+#include <string>
+
 #include "BKE_text.h"
 #include "COM_ExecutionGroup.h"
+#include "COM_MemoryPlanner.h"
 #include "COM_Node.h"
 #include "COM_NodeOperation.h"
 #include "DNA_color_types.h"
@@ -134,6 +138,22 @@ class ExecutionSystem {
    */
   Groups m_groups;
 
+  /**
+   * \brief use the #ResultCache for the outputs of complex groups
+   */
+  bool m_useResultCache;
+
+  /**
+   * \brief result cache keys of the complex group outputs that have to be calculated,
+   * stored in the #ResultCache once execution finished
+   */
+  std::map<WriteBufferOperation *, std::string> m_resultCacheKeys;
+
+  /**
+   * \brief allocates and frees the buffers of the WriteBufferOperations
+   */
+  MemoryPlanner m_memoryPlanner;
+
  private:  // methods
   /**
    * find all execution group with output nodes
@@ -146,6 +166,17 @@ class ExecutionSystem {
    */
   void findOutputExecutionGroup(vector<ExecutionGroup *> *result) const;
 
+  /**
+   * restore outputs of complex groups from the #ResultCache,
+   * groups that are restored (and the groups only they depend on) are not executed
+   */
+  void restoreCachedResults();
+
+  /**
+   * store outputs of complex groups that were fully calculated in the #ResultCache
+   */
+  void storeCachedResults();
+
  public:
   /**
    * \brief Create a new ExecutionSystem and initialize it with the
@@ -186,9 +217,22 @@ class ExecutionSystem {
     return this->m_context;
   }
 
+  /**
+   * \brief get the planner for the buffers of the WriteBufferOperations
+   */
+  MemoryPlanner &getMemoryPlanner()
+  {
+    return this->m_memoryPlanner;
+  }
+
  private:
   void executeGroups(CompositorPriority priority);
 
+  /**
+   * \brief plan the buffer memory and report the planned peak usage
+   */
+  void planMemory();
+
   /* allow the DebugInfo class to look at internals */
   friend class DebugInfo;
 
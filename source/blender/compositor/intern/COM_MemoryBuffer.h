@@ -129,6 +129,16 @@ class MemoryBuffer {
     return this->m_num_channels;
   }
 
+  /**
+   * \brief hand this buffer over to another proxy of the same size and data type,
+   * the content is overwritten by its executor
+   */
+  void setMemoryProxy(MemoryProxy *memoryProxy)
+  {
+    this->m_memoryProxy = memoryProxy;
+    this->m_state = COM_MB_ALLOCATED;
+  }
+
   /**
    * \brief get the data of this MemoryBuffer
    * \note buffer should already be available in memory
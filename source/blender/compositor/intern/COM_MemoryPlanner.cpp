@@ -0,0 +1,320 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#include <algorithm>
+#include <set>
+
+#include "COM_ExecutionGroup.h"
+#include "COM_MemoryBuffer.h"
+#include "COM_MemoryPlanner.h"
+#include "COM_MemoryProxy.h"
+#include "COM_ReadBufferOperation.h"
+#include "COM_WriteBufferOperation.h"
+
+#include "BLI_assert.h"
+
+static unsigned int num_channels_for_datatype(DataType datatype)
+{
+  switch (datatype) {
+    case COM_DT_VALUE:
+      return COM_NUM_CHANNELS_VALUE;
+    case COM_DT_VECTOR:
+      return COM_NUM_CHANNELS_VECTOR;
+    case COM_DT_COLOR:
+    default:
+      return COM_NUM_CHANNELS_COLOR;
+  }
+}
+
+static size_t buffer_size(MemoryBuffer *buffer)
+{
+  return sizeof(float) * (size_t)buffer->getWidth() * buffer->getHeight() *
+         buffer->get_num_channels();
+}
+
+static MemoryProxy *output_memory_proxy(ExecutionGroup *group)
+{
+  NodeOperation *operation = group->getOutputOperation();
+  if (operation->isWriteBufferOperation()) {
+    return ((WriteBufferOperation *)operation)->getMemoryProxy();
+  }
+  return NULL;
+}
+
+/* Inputs first, in the order the chunks of the output group request them. */
+static void add_group_in_execution_order(ExecutionGroup *group,
+                                         std::set<ExecutionGroup *> &visited,
+                                         std::vector<ExecutionGroup *> &order)
+{
+  if (!visited.insert(group).second) {
+    return;
+  }
+
+  /* Restored from the #ResultCache, the groups only it depends on are never scheduled. */
+  if (!group->isFullyExecuted()) {
+    const ExecutionGroup::Operations &readOperations = group->getReadOperations();
+    for (unsigned int index = 0; index < readOperations.size(); index++) {
+      ReadBufferOperation *readOperation = (ReadBufferOperation *)readOperations[index];
+      ExecutionGroup *inputGroup = readOperation->getMemoryProxy()->getExecutor();
+      if (inputGroup) {
+        add_group_in_execution_order(inputGroup, visited, order);
+      }
+    }
+  }
+
+  order.push_back(group);
+}
+
+MemoryPlanner::MemoryPlanner()
+{
+  this->m_totalSize = 0;
+  this->m_plannedPeakSize = 0;
+  this->m_allocatedSize = 0;
+  this->m_peakSize = 0;
+}
+
+MemoryPlanner::~MemoryPlanner()
+{
+  freeUnusedBuffers();
+}
+
+void MemoryPlanner::initExecution(const std::vector<NodeOperation *> &operations,
+                                  const std::vector<ExecutionGroup *> &groups)
+{
+  this->m_totalSize = 0;
+  this->m_plannedPeakSize = 0;
+  this->m_allocatedSize = 0;
+  this->m_peakSize = 0;
+
+  for (unsigned int index = 0; index < operations.size(); index++) {
+    NodeOperation *operation = operations[index];
+    if (operation->isWriteBufferOperation()) {
+      MemoryProxy *proxy = ((WriteBufferOperation *)operation)->getMemoryProxy();
+      BufferLiveness &liveness = this->m_buffers[proxy];
+      liveness.size = sizeof(float) * (size_t)operation->getWidth() * operation->getHeight() *
+                      num_channels_for_datatype(proxy->getDataType());
+      liveness.keep = false;
+      this->m_totalSize += liveness.size;
+    }
+  }
+
+  for (unsigned int index = 0; index < operations.size(); index++) {
+    NodeOperation *operation = operations[index];
+    if (operation->isReadBufferOperation()) {
+      ReadBufferOperation *readOperation = (ReadBufferOperation *)operation;
+      Buffers::iterator it = this->m_buffers.find(readOperation->getMemoryProxy());
+      if (it != this->m_buffers.end()) {
+        it->second.readers.push_back(readOperation);
+      }
+    }
+  }
+
+  /* Operations are shared by all groups they are used in. */
+  for (unsigned int index = 0; index < groups.size(); index++) {
+    ExecutionGroup *group = groups[index];
+    const ExecutionGroup::Operations &readOperations = group->getReadOperations();
+    for (unsigned int read_index = 0; read_index < readOperations.size(); read_index++) {
+      ReadBufferOperation *readOperation = (ReadBufferOperation *)readOperations[read_index];
+      Buffers::iterator it = this->m_buffers.find(readOperation->getMemoryProxy());
+      if (it == this->m_buffers.end()) {
+        continue;
+      }
+      std::vector<ExecutionGroup *> &readerGroups = it->second.readerGroups;
+      if (std::find(readerGroups.begin(), readerGroups.end(), group) == readerGroups.end()) {
+        readerGroups.push_back(group);
+      }
+    }
+  }
+}
+
+void MemoryPlanner::plan(const std::vector<ExecutionGroup *> &outputGroups)
+{
+  std::vector<ExecutionGroup *> order;
+  std::set<ExecutionGroup *> visited;
+  for (unsigned int index = 0; index < outputGroups.size(); index++) {
+    add_group_in_execution_order(outputGroups[index], visited, order);
+  }
+
+  /* Buffers restored from the #ResultCache are already allocated. */
+  std::set<MemoryProxy *> allocated;
+  size_t size = 0;
+  for (Buffers::iterator it = this->m_buffers.begin(); it != this->m_buffers.end(); ++it) {
+    if (it->first->getBuffer()) {
+      allocated.insert(it->first);
+      size += it->second.size;
+    }
+  }
+  size_t peakSize = size;
+
+  std::set<ExecutionGroup *> executed;
+  for (unsigned int index = 0; index < order.size(); index++) {
+    ExecutionGroup *group = order[index];
+    MemoryProxy *proxy = output_memory_proxy(group);
+    if (proxy && allocated.insert(proxy).second) {
+      size += this->m_buffers[proxy].size;
+      peakSize = max_zz(peakSize, size);
+    }
+    executed.insert(group);
+
+    std::set<MemoryProxy *>::iterator it = allocated.begin();
+    while (it != allocated.end()) {
+      const BufferLiveness &liveness = this->m_buffers[*it];
+      bool released = !liveness.keep && !liveness.readerGroups.empty();
+      for (unsigned int reader = 0; released && reader < liveness.readerGroups.size(); reader++) {
+        released = executed.count(liveness.readerGroups[reader]) != 0;
+      }
+      if (released) {
+        size -= liveness.size;
+        allocated.erase(it++);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  this->m_plannedPeakSize = peakSize;
+}
+
+void MemoryPlanner::deinitExecution()
+{
+  freeUnusedBuffers();
+  this->m_buffers.clear();
+}
+
+void MemoryPlanner::acquire(MemoryProxy *proxy)
+{
+  if (proxy->getBuffer()) {
+    return;
+  }
+
+  WriteBufferOperation *writeOperation = proxy->getWriteBufferOperation();
+  const int width = writeOperation->getWidth();
+  const int height = writeOperation->getHeight();
+  const unsigned int num_channels = num_channels_for_datatype(proxy->getDataType());
+
+  MemoryBuffer *buffer = NULL;
+  for (unsigned int index = 0; index < this->m_unusedBuffers.size(); index++) {
+    MemoryBuffer *unused = this->m_unusedBuffers[index];
+    if (unused->getWidth() == width && unused->getHeight() == height &&
+        unused->get_num_channels() == num_channels) {
+      buffer = unused;
+      this->m_unusedBuffers.erase(this->m_unusedBuffers.begin() + index);
+      break;
+    }
+  }
+
+  if (buffer) {
+    proxy->setBuffer(buffer);
+  }
+  else {
+    /* Free the buffers that don't fit before allocating, to keep the peak down. */
+    freeUnusedBuffers();
+    proxy->allocate(width, height);
+    this->m_allocatedSize += buffer_size(proxy->getBuffer());
+    this->m_peakSize = max_zz(this->m_peakSize, this->m_allocatedSize);
+  }
+
+  Buffers::iterator it = this->m_buffers.find(proxy);
+  BLI_assert(it != this->m_buffers.end());
+  if (it != this->m_buffers.end()) {
+    updateReaders(it->second);
+  }
+}
+
+void MemoryPlanner::release(MemoryProxy *proxy)
+{
+  MemoryBuffer *buffer = proxy->takeBuffer();
+  if (buffer == NULL) {
+    return;
+  }
+  this->m_unusedBuffers.push_back(buffer);
+
+  Buffers::iterator it = this->m_buffers.find(proxy);
+  if (it != this->m_buffers.end()) {
+    updateReaders(it->second);
+  }
+}
+
+void MemoryPlanner::keep(MemoryProxy *proxy)
+{
+  Buffers::iterator it = this->m_buffers.find(proxy);
+  if (it != this->m_buffers.end()) {
+    it->second.keep = true;
+  }
+}
+
+void MemoryPlanner::releaseFinishedBuffers()
+{
+  std::map<ExecutionGroup *, bool> finished;
+  for (Buffers::iterator it = this->m_buffers.begin(); it != this->m_buffers.end(); ++it) {
+    const BufferLiveness &liveness = it->second;
+    if (liveness.keep || liveness.readerGroups.empty() || it->first->getBuffer() == NULL) {
+      continue;
+    }
+
+    bool released = true;
+    for (unsigned int reader = 0; released && reader < liveness.readerGroups.size(); reader++) {
+      released = isFinished(liveness.readerGroups[reader], finished);
+    }
+    if (released) {
+      release(it->first);
+    }
+  }
+}
+
+bool MemoryPlanner::isFinished(ExecutionGroup *group, std::map<ExecutionGroup *, bool> &finished)
+{
+  std::map<ExecutionGroup *, bool>::iterator it = finished.find(group);
+  if (it != finished.end()) {
+    return it->second;
+  }
+
+  bool result = group->isFullyExecuted();
+  if (!result) {
+    /* A group that is only partially needed won't be scheduled once all its readers finished. */
+    Buffers::iterator buffer = this->m_buffers.find(output_memory_proxy(group));
+    if (buffer != this->m_buffers.end() && !buffer->second.readerGroups.empty()) {
+      const std::vector<ExecutionGroup *> &readerGroups = buffer->second.readerGroups;
+      result = true;
+      for (unsigned int reader = 0; result && reader < readerGroups.size(); reader++) {
+        result = isFinished(readerGroups[reader], finished);
+      }
+    }
+  }
+
+  finished[group] = result;
+  return result;
+}
+
+void MemoryPlanner::updateReaders(BufferLiveness &liveness)
+{
+  for (unsigned int index = 0; index < liveness.readers.size(); index++) {
+    liveness.readers[index]->updateMemoryBuffer();
+  }
+}
+
+void MemoryPlanner::freeUnusedBuffers()
+{
+  for (unsigned int index = 0; index < this->m_unusedBuffers.size(); index++) {
+    MemoryBuffer *buffer = this->m_unusedBuffers[index];
+    this->m_allocatedSize -= buffer_size(buffer);
+    delete buffer;
+  }
+  this->m_unusedBuffers.clear();
+}
@@ -0,0 +1,136 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#ifndef __COM_MEMORYPLANNER_H__
+#define __COM_MEMORYPLANNER_H__
+
+#include <map>
+#include <stddef.h>
+#include <vector>
+
+class ExecutionGroup;
+class MemoryBuffer;
+class MemoryProxy;
+class NodeOperation;
+class ReadBufferOperation;
+
+/**
+ * \brief Decides when the buffers of WriteBufferOperations are allocated and freed.
+ *
+ * Buffers are allocated when the first chunk writing to or reading from them is scheduled,
+ * instead of all at once when execution starts. Once every group reading a buffer is finished
+ * the buffer is released to a pool, where the next buffer of the same size and channel count
+ * reuses it.
+ *
+ * A group is finished when all its chunks were executed, or when all groups reading its output
+ * are finished, as groups are only executed for the area their readers need.
+ *
+ * \note Only accessed from the thread scheduling the chunks.
+ * \ingroup Memory
+ */
+class MemoryPlanner {
+ private:
+  typedef struct BufferLiveness {
+    /** \brief operations reading the buffer, their buffer pointer is updated on (re)allocation */
+    std::vector<ReadBufferOperation *> readers;
+    /** \brief groups containing the readers */
+    std::vector<ExecutionGroup *> readerGroups;
+    /** \brief size in bytes */
+    size_t size;
+    /** \brief keep the buffer until execution finished, for the #ResultCache */
+    bool keep;
+  } BufferLiveness;
+
+  typedef std::map<MemoryProxy *, BufferLiveness> Buffers;
+
+  Buffers m_buffers;
+
+  /**
+   * \brief released buffers waiting to be reused
+   */
+  std::vector<MemoryBuffer *> m_unusedBuffers;
+
+  /**
+   * \brief size of all buffers when every buffer is allocated at once
+   */
+  size_t m_totalSize;
+  size_t m_plannedPeakSize;
+  size_t m_allocatedSize;
+  size_t m_peakSize;
+
+  bool isFinished(ExecutionGroup *group, std::map<ExecutionGroup *, bool> &finished);
+  void updateReaders(BufferLiveness &liveness);
+  void freeUnusedBuffers();
+
+ public:
+  MemoryPlanner();
+  ~MemoryPlanner();
+
+  /**
+   * \brief run the liveness analysis, after the groups were initialized
+   */
+  void initExecution(const std::vector<NodeOperation *> &operations,
+                     const std::vector<ExecutionGroup *> &groups);
+
+  /**
+   * \brief determine the peak memory usage when the output groups are executed in order
+   */
+  void plan(const std::vector<ExecutionGroup *> &outputGroups);
+
+  /**
+   * \brief free the remaining unused buffers
+   */
+  void deinitExecution();
+
+  /**
+   * \brief make sure the buffer of the proxy is allocated, reusing a released buffer if possible
+   */
+  void acquire(MemoryProxy *proxy);
+
+  /**
+   * \brief release the buffer of the proxy for reuse
+   */
+  void release(MemoryProxy *proxy);
+
+  /**
+   * \brief keep the buffer of the proxy allocated until execution finished
+   */
+  void keep(MemoryProxy *proxy);
+
+  /**
+   * \brief release the buffers of which all readers are finished
+   */
+  void releaseFinishedBuffers();
+
+  size_t getTotalSize() const
+  {
+    return this->m_totalSize;
+  }
+
+  size_t getPlannedPeakSize() const
+  {
+    return this->m_plannedPeakSize;
+  }
+
+  size_t getPeakSize() const
+  {
+    return this->m_peakSize;
+  }
+};
+
+#endif
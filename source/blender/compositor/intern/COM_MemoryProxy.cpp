@@ -22,6 +22,7 @@ MemoryProxy::MemoryProxy(DataType datatype)
 {
   this->m_writeBufferOperation = NULL;
   this->m_executor = NULL;
+  this->m_buffer = NULL;
   this->m_datatype = datatype;
 }
 
@@ -43,3 +44,17 @@ void MemoryProxy::free()
     this->m_buffer = NULL;
   }
 }
+
+void MemoryProxy::setBuffer(MemoryBuffer *buffer)
+{
+  BLI_assert(this->m_buffer == NULL);
+  buffer->setMemoryProxy(this);
+  this->m_buffer = buffer;
+}
+
+MemoryBuffer *MemoryProxy::takeBuffer()
+{
+  MemoryBuffer *buffer = this->m_buffer;
+  this->m_buffer = NULL;
+  return buffer;
+}
@@ -112,6 +112,17 @@ class MemoryProxy {
    */
   void free();
 
+  /**
+   * \brief use a buffer released by another proxy of the same size and data type
+   * \see MemoryPlanner
+   */
+  void setBuffer(MemoryBuffer *buffer);
+
+  /**
+   * \brief take the allocated memory out of this proxy without freeing it
+   */
+  MemoryBuffer *takeBuffer();
+
   /**
    * \brief get the allocated memory
    */
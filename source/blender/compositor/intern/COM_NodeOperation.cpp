@@ -37,6 +37,7 @@ NodeOperation::NodeOperation()
   this->m_isResolutionSet = false;
   this->m_openCL = false;
   this->m_btree = NULL;
+  this->m_bnode = NULL;
 }
 
 NodeOperation::~NodeOperation()
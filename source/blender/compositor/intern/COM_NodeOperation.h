@@ -124,6 +124,12 @@ class NodeOperation : public SocketReader {
    */
   bool m_isResolutionSet;
 
+  /**
+   * \brief the node this operation was created for, NULL for operations added by the builder
+   * (buffers, conversions and constants of unconnected inputs)
+   */
+  const bNode *m_bnode;
+
  public:
   virtual ~NodeOperation();
 
@@ -188,6 +194,14 @@ class NodeOperation : public SocketReader {
   {
     this->m_btree = tree;
   }
+  void setbNode(const bNode *node)
+  {
+    this->m_bnode = node;
+  }
+  const bNode *getbNode() const
+  {
+    return this->m_bnode;
+  }
   virtual void initExecution();
 
   /**
@@ -366,6 +380,28 @@ class NodeOperation : public SocketReader {
     return true;
   }
 
+  /**
+   * \brief can the output of this operation be kept in the #ResultCache between executions.
+   * Only operations whose result depends on nothing but their inputs, the settings of their
+   * #bNode (custom values, storage and socket default values) and #getCacheHash return true.
+   * Operations reading data that can change without the node tree changing
+   * (masks, textures, tracking data, curve mappings) are never cached.
+   */
+  virtual bool isCacheable() const
+  {
+    return false;
+  }
+
+  /**
+   * \brief hash of the settings of this operation that are not stored in its #bNode
+   * (constant values, external data), part of the #ResultCache key.
+   * \note called after #initExecution, so operations can hash the data they acquired.
+   */
+  virtual unsigned int getCacheHash()
+  {
+    return 0;
+  }
+
   inline bool isBraked() const
   {
     return this->m_btree->test_break(this->m_btree->tbh);
@@ -0,0 +1,111 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#include <map>
+
+#include "COM_MemoryProxy.h"
+#include "COM_ResultCache.h"
+
+#include "BLI_hash_mm2a.h"
+
+#include "MEM_guardedalloc.h"
+
+typedef struct ResultCacheEntry {
+  MemoryBuffer *buffer;
+  /** Compared on lookup, the key is only a hash of it. */
+  std::string signature;
+  /** The last execution that used or stored this entry. */
+  unsigned int generation;
+} ResultCacheEntry;
+
+typedef std::map<uint64_t, ResultCacheEntry> ResultCacheEntries;
+
+static ResultCacheEntries g_entries;
+static unsigned int g_generation = 0;
+
+static uint64_t signature_key(const std::string &signature)
+{
+  const unsigned char *data = (const unsigned char *)signature.data();
+  return ((uint64_t)BLI_hash_mm2(data, signature.size(), 0) << 32) |
+         (uint64_t)BLI_hash_mm2(data, signature.size(), 1);
+}
+
+void ResultCache::beginExecution()
+{
+  g_generation++;
+}
+
+void ResultCache::endExecution()
+{
+  ResultCacheEntries::iterator it = g_entries.begin();
+  while (it != g_entries.end()) {
+    if (g_generation - it->second.generation > 1) {
+      delete it->second.buffer;
+      g_entries.erase(it++);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+bool ResultCache::restore(const std::string &signature, MemoryProxy *proxy)
+{
+  MemoryBuffer *buffer = proxy->getBuffer();
+  ResultCacheEntries::iterator it = g_entries.find(signature_key(signature));
+  if (it == g_entries.end() || it->second.signature != signature) {
+    return false;
+  }
+
+  MemoryBuffer *cached = it->second.buffer;
+  if (cached->getWidth() != buffer->getWidth() || cached->getHeight() != buffer->getHeight() ||
+      cached->get_num_channels() != buffer->get_num_channels()) {
+    return false;
+  }
+
+  buffer->copyContentFrom(cached);
+  buffer->setCreatedState();
+  it->second.generation = g_generation;
+  return true;
+}
+
+void ResultCache::store(const std::string &signature, MemoryProxy *proxy)
+{
+  MemoryBuffer *buffer = proxy->getBuffer();
+  const uint64_t key = signature_key(signature);
+  ResultCacheEntries::iterator it = g_entries.find(key);
+  if (it != g_entries.end()) {
+    delete it->second.buffer;
+    g_entries.erase(it);
+  }
+
+  ResultCacheEntry entry;
+  entry.buffer = new MemoryBuffer(proxy->getDataType(), buffer->getRect());
+  entry.buffer->copyContentFrom(buffer);
+  entry.signature = signature;
+  entry.generation = g_generation;
+  g_entries[key] = entry;
+}
+
+void ResultCache::clear()
+{
+  for (ResultCacheEntries::iterator it = g_entries.begin(); it != g_entries.end(); ++it) {
+    delete it->second.buffer;
+  }
+  g_entries.clear();
+}
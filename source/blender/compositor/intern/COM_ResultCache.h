@@ -0,0 +1,69 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#ifndef __COM_RESULTCACHE_H__
+#define __COM_RESULTCACHE_H__
+
+#include <string>
+
+#include "COM_MemoryBuffer.h"
+
+/**
+ * \brief Keeps output buffers of expensive execution groups alive between executions.
+ *
+ * Entries are keyed by a signature describing all operations upstream of a WriteBufferOperation,
+ * including the settings of the nodes they were created for, so when a tree is executed
+ * again after a tweak only the groups whose upstream changed are recalculated.
+ * Entries are looked up by a 64-bit hash of the signature, and the signature itself is
+ * compared before a result is used.
+ *
+ * Entries that were not used by the last two executions are freed,
+ * two so the fast and the full pass of two-pass editing don't evict each other.
+ * \note Only accessed while the compositor mutex is held.
+ * \ingroup Memory
+ */
+class ResultCache {
+ public:
+  /**
+   * \brief start a new execution, entries used from now on are kept by #endExecution
+   */
+  static void beginExecution();
+
+  /**
+   * \brief free the entries that weren't used by this or the previous execution
+   */
+  static void endExecution();
+
+  /**
+   * \brief copy the cached result for signature into the buffer of proxy
+   * \return false when there is no matching result
+   */
+  static bool restore(const std::string &signature, MemoryProxy *proxy);
+
+  /**
+   * \brief store a copy of the buffer of proxy as the result for signature
+   */
+  static void store(const std::string &signature, MemoryProxy *proxy);
+
+  /**
+   * \brief free all cached results
+   */
+  static void clear();
+};
+
+#endif
@@ -18,6 +18,7 @@
 
 #ifndef __COM_SOCKETREADER_H__
 #define __COM_SOCKETREADER_H__
+#include "BLI_assert.h"
 #include "BLI_rect.h"
 #include "COM_defines.h"
 
@@ -94,6 +95,23 @@ class SocketReader {
   {
   }
 
+  /**
+   * \brief calculate a row of pixels
+   * \note this method is called for non-complex, operations that can process a whole row
+   * at once override this to avoid the per pixel virtual calls of #executePixelSampled.
+   * \param output: is a float array of `width * COM_NUM_CHANNELS_COLOR` to store the result,
+   * each pixel uses a stride of #COM_NUM_CHANNELS_COLOR regardless of the data type.
+   * \param x: the x-coordinate of the first pixel to calculate in image space
+   * \param y: the y-coordinate of the row to calculate in image space
+   * \param width: the number of pixels to calculate, at most #COM_ROW_WIDTH_MAX
+   */
+  virtual void executeRow(float *output, int x, int y, int width)
+  {
+    for (int i = 0; i < width; i++) {
+      executePixelSampled(&output[i * COM_NUM_CHANNELS_COLOR], x + i, y, COM_PS_NEAREST);
+    }
+  }
+
  public:
   inline void readSampled(float result[4], float x, float y, PixelSampler sampler)
   {
@@ -107,6 +125,11 @@ class SocketReader {
   {
     executePixelFiltered(result, x, y, dx, dy);
   }
+  inline void readRow(float *result, int x, int y, int width)
+  {
+    BLI_assert(width <= COM_ROW_WIDTH_MAX);
+    executeRow(result, x, y, width);
+  }
 
   virtual void *initializeTileData(rcti * /*rect*/)
   {
@@ -29,6 +29,7 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "PIL_time.h"
 
@@ -48,12 +49,56 @@
 static vector<CPUDevice *> g_cpudevices;
 static ThreadLocal(CPUDevice *) g_thread_device;
 
+/// \brief chunks finished on a device and not yet marked executed in their group
+static vector<WorkPackage> g_finished_work;
+/// \brief number of scheduled chunks not yet marked executed in their group
+static unsigned int g_scheduled_work_len = 0;
+static ThreadMutex g_finished_work_mutex = BLI_MUTEX_INITIALIZER;
+static ThreadCondition g_finished_work_cond;
+
+/**
+ * Record a chunk as finished, chunk states are only changed by the thread scheduling them,
+ * see #WorkScheduler::waitForChunks.
+ */
+static void work_finished(const WorkPackage *work)
+{
+  BLI_mutex_lock(&g_finished_work_mutex);
+  g_finished_work.push_back(*work);
+  BLI_condition_notify_one(&g_finished_work_cond);
+  BLI_mutex_unlock(&g_finished_work_mutex);
+}
+
+/**
+ * Mark the chunks which finished since the last call as executed in their group.
+ * \param wait: Wait for a chunk to finish when none did and some are still scheduled.
+ */
+static void work_finished_apply(const bool wait)
+{
+  vector<WorkPackage> finished_work;
+
+  BLI_mutex_lock(&g_finished_work_mutex);
+  while (wait && g_finished_work.empty() && g_scheduled_work_len != 0) {
+    BLI_condition_wait(&g_finished_work_cond, &g_finished_work_mutex);
+  }
+  finished_work.swap(g_finished_work);
+  g_scheduled_work_len -= finished_work.size();
+  BLI_mutex_unlock(&g_finished_work_mutex);
+
+  for (unsigned int index = 0; index < finished_work.size(); index++) {
+    const WorkPackage &work = finished_work[index];
+    work.getExecutionGroup()->setChunkExecuted(work.getChunkNumber());
+  }
+}
+
 #if COM_CURRENT_THREADING_MODEL == COM_TM_QUEUE
-/// \brief list of all thread for every CPUDevice in cpudevices a thread exists
-static ListBase g_cputhreads;
+/// \brief number of CPUDevices requested by the last initialize
+static int g_cpu_num_threads = 0;
 static bool g_cpuInitialized = false;
-/// \brief all scheduled work for the cpu
-static ThreadQueue *g_cpuqueue;
+/// \brief task pool executing all scheduled work for the cpu on the shared task scheduler
+static TaskPool *g_cpupool;
+/// \brief CPUDevices not executing a chunk, every chunk takes one for its duration
+static vector<CPUDevice *> g_cpudevices_free;
+static ThreadMutex g_cpudevices_mutex = BLI_MUTEX_INITIALIZER;
 static ThreadQueue *g_gpuqueue;
 #  ifdef COM_OPENCL_ENABLED
 static cl_context g_context;
@@ -72,17 +117,51 @@ static bool g_openclInitialized = false;
 #endif
 
 #if COM_CURRENT_THREADING_MODEL == COM_TM_QUEUE
-void *WorkScheduler::thread_execute_cpu(void *data)
+static CPUDevice *cpu_device_acquire()
 {
-  CPUDevice *device = (CPUDevice *)data;
-  WorkPackage *work;
-  BLI_thread_local_set(g_thread_device, device);
-  while ((work = (WorkPackage *)BLI_thread_queue_pop(g_cpuqueue))) {
-    device->execute(work);
-    delete work;
+  CPUDevice *device;
+  BLI_mutex_lock(&g_cpudevices_mutex);
+  if (g_cpudevices_free.empty()) {
+    /* More chunks run at the same time than there are threads, this happens when operations use
+     * nested parallelism and the task scheduler picks up other chunks while they wait. */
+    device = new CPUDevice(g_cpudevices.size());
+    device->initialize();
+    g_cpudevices.push_back(device);
   }
+  else {
+    device = g_cpudevices_free.back();
+    g_cpudevices_free.pop_back();
+  }
+  BLI_mutex_unlock(&g_cpudevices_mutex);
+  return device;
+}
 
-  return NULL;
+static void cpu_device_release(CPUDevice *device)
+{
+  BLI_mutex_lock(&g_cpudevices_mutex);
+  g_cpudevices_free.push_back(device);
+  BLI_mutex_unlock(&g_cpudevices_mutex);
+}
+
+void WorkScheduler::thread_execute_cpu(TaskPool *__restrict /*pool*/, void *taskdata)
+{
+  WorkPackage *work = (WorkPackage *)taskdata;
+  CPUDevice *device = cpu_device_acquire();
+
+  /* Chunks can be nested on the same thread, see #cpu_device_acquire. */
+  CPUDevice *previous_device = (CPUDevice *)BLI_thread_local_get(g_thread_device);
+  BLI_thread_local_set(g_thread_device, device);
+  device->execute(work);
+  BLI_thread_local_set(g_thread_device, previous_device);
+
+  cpu_device_release(device);
+  work_finished(work);
+}
+
+static void work_package_free(TaskPool *__restrict /*pool*/, void *taskdata)
+{
+  WorkPackage *work = (WorkPackage *)taskdata;
+  delete work;
 }
 
 void *WorkScheduler::thread_execute_gpu(void *data)
@@ -92,6 +171,7 @@ void *WorkScheduler::thread_execute_gpu(void *data)
 
   while ((work = (WorkPackage *)BLI_thread_queue_pop(g_gpuqueue))) {
     device->execute(work);
+    work_finished(work);
     delete work;
   }
 
@@ -102,9 +182,15 @@ void *WorkScheduler::thread_execute_gpu(void *data)
 void WorkScheduler::schedule(ExecutionGroup *group, int chunkNumber)
 {
   WorkPackage *package = new WorkPackage(group, chunkNumber);
+
+  BLI_mutex_lock(&g_finished_work_mutex);
+  g_scheduled_work_len++;
+  BLI_mutex_unlock(&g_finished_work_mutex);
+
 #if COM_CURRENT_THREADING_MODEL == COM_TM_NOTHREAD
   CPUDevice device(0);
   device.execute(package);
+  work_finished(package);
   delete package;
 #elif COM_CURRENT_THREADING_MODEL == COM_TM_QUEUE
 #  ifdef COM_OPENCL_ENABLED
@@ -112,24 +198,21 @@ void WorkScheduler::schedule(ExecutionGroup *group, int chunkNumber)
     BLI_thread_queue_push(g_gpuqueue, package);
   }
   else {
-    BLI_thread_queue_push(g_cpuqueue, package);
+    BLI_task_pool_push(g_cpupool, thread_execute_cpu, package, true, work_package_free);
   }
 #  else
-  BLI_thread_queue_push(g_cpuqueue, package);
+  BLI_task_pool_push(g_cpupool, thread_execute_cpu, package, true, work_package_free);
 #  endif
 #endif
 }
 
 void WorkScheduler::start(CompositorContext &context)
 {
+  BLI_condition_init(&g_finished_work_cond);
 #if COM_CURRENT_THREADING_MODEL == COM_TM_QUEUE
   unsigned int index;
-  g_cpuqueue = BLI_thread_queue_init();
-  BLI_threadpool_init(&g_cputhreads, thread_execute_cpu, g_cpudevices.size());
-  for (index = 0; index < g_cpudevices.size(); index++) {
-    Device *device = g_cpudevices[index];
-    BLI_threadpool_insert(&g_cputhreads, device);
-  }
+  g_cpupool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+  g_cpudevices_free = g_cpudevices;
 #  ifdef COM_OPENCL_ENABLED
   if (context.getHasActiveOpenCLDevices()) {
     g_gpuqueue = BLI_thread_queue_init();
@@ -152,23 +235,25 @@ void WorkScheduler::finish()
 #  ifdef COM_OPENCL_ENABLED
   if (g_openclActive) {
     BLI_thread_queue_wait_finish(g_gpuqueue);
-    BLI_thread_queue_wait_finish(g_cpuqueue);
-  }
-  else {
-    BLI_thread_queue_wait_finish(g_cpuqueue);
   }
-#  else
-  BLI_thread_queue_wait_finish(cpuqueue);
 #  endif
+  /* The calling thread executes chunks as well while waiting. */
+  BLI_task_pool_work_and_wait(g_cpupool);
 #endif
+  work_finished_apply(false);
+}
+
+void WorkScheduler::waitForChunks()
+{
+  work_finished_apply(true);
 }
 void WorkScheduler::stop()
 {
+  BLI_condition_end(&g_finished_work_cond);
 #if COM_CURRENT_THREADING_MODEL == COM_TM_QUEUE
-  BLI_thread_queue_nowait(g_cpuqueue);
-  BLI_threadpool_end(&g_cputhreads);
-  BLI_thread_queue_free(g_cpuqueue);
-  g_cpuqueue = NULL;
+  BLI_task_pool_free(g_cpupool);
+  g_cpupool = NULL;
+  g_cpudevices_free.clear();
 #  ifdef COM_OPENCL_ENABLED
   if (g_openclActive) {
     BLI_thread_queue_nowait(g_gpuqueue);
@@ -207,7 +292,7 @@ void WorkScheduler::initialize(bool use_opencl, int num_cpu_threads)
 {
 #if COM_CURRENT_THREADING_MODEL == COM_TM_QUEUE
   /* deinitialize if number of threads doesn't match */
-  if (g_cpudevices.size() != num_cpu_threads) {
+  if (g_cpu_num_threads != num_cpu_threads) {
     Device *device;
 
     while (!g_cpudevices.empty()) {
@@ -230,6 +315,7 @@ void WorkScheduler::initialize(bool use_opencl, int num_cpu_threads)
       g_cpudevices.push_back(device);
     }
     BLI_thread_local_create(g_thread_device);
+    g_cpu_num_threads = num_cpu_threads;
     g_cpuInitialized = true;
   }
 
@@ -338,6 +424,7 @@ void WorkScheduler::deinitialize()
       delete device;
     }
     BLI_thread_local_delete(g_thread_device);
+    g_cpu_num_threads = 0;
     g_cpuInitialized = false;
   }
 
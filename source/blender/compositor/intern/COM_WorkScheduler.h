@@ -21,6 +21,7 @@
 
 #include "COM_ExecutionGroup.h"
 
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "COM_Device.h"
@@ -39,10 +40,11 @@ class WorkScheduler {
   static bool isStopping();
 
   /**
-   * \brief main thread loop for cpudevices
-   * inside this loop new work is queried and being executed
+   * \brief task executing a single WorkPackage on a free CPUDevice.
+   * CPU work runs on the shared task scheduler, so idle threads steal chunks from busy ones
+   * and independent execution groups can be calculated at the same time.
    */
-  static void *thread_execute_cpu(void *data);
+  static void thread_execute_cpu(TaskPool *__restrict pool, void *taskdata);
 
   /**
    * \brief main thread loop for gpudevices
@@ -102,6 +104,14 @@ class WorkScheduler {
    */
   static void finish();
 
+  /**
+   * \brief wait until a scheduled chunk finished, returns right away when chunks finished since
+   * the last call or when none are scheduled.
+   * Finished chunks are marked executed in their #ExecutionGroup by this call (and #finish),
+   * so dependent chunks can be scheduled.
+   */
+  static void waitForChunks();
+
   /**
    * \brief Are there OpenCL capable GPU devices initialized?
    * the result of this method is stored in the CompositorContext
@@ -52,6 +52,11 @@ class BlurBaseOperation : public NodeOperation, public QualityStepHelper {
   bool m_extend_bounds;
 
  public:
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * Initialize the execution
    */
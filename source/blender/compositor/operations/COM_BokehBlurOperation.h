@@ -38,6 +38,11 @@ class BokehBlurOperation : public NodeOperation, public QualityStepHelper {
  public:
   BokehBlurOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void *initializeTileData(rcti *rect);
   /**
    * the inner loop of this program
@@ -107,6 +107,11 @@ class BokehImageOperation : public NodeOperation {
  public:
   BokehImageOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * \brief the inner loop of this program
    */
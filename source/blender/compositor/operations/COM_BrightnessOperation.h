@@ -34,6 +34,11 @@ class BrightnessOperation : public NodeOperation {
  public:
   BrightnessOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
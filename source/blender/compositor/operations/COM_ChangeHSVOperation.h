@@ -37,6 +37,11 @@ class ChangeHSVOperation : public NodeOperation {
    */
   ChangeHSVOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void initExecution();
   void deinitExecution();
 
@@ -42,6 +42,11 @@ class ColorBalanceASCCDLOperation : public NodeOperation {
    */
   ColorBalanceASCCDLOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
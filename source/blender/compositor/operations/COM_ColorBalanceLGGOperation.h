@@ -42,6 +42,11 @@ class ColorBalanceLGGOperation : public NodeOperation {
    */
   ColorBalanceLGGOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
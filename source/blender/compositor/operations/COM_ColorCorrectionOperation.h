@@ -36,6 +36,11 @@ class ColorCorrectionOperation : public NodeOperation {
  public:
   ColorCorrectionOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -44,6 +44,17 @@ void ColorRampOperation::executePixelSampled(float output[4],
   BKE_colorband_evaluate(this->m_colorBand, values[0], output);
 }
 
+void ColorRampOperation::executeRow(float *output, int x, int y, int width)
+{
+  float values[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  this->m_inputProgram->readRow(values, x, y, width);
+  for (int i = 0; i < width; i++) {
+    const int offset = i * COM_NUM_CHANNELS_COLOR;
+    BKE_colorband_evaluate(this->m_colorBand, values[offset], &output[offset]);
+  }
+}
+
 void ColorRampOperation::deinitExecution()
 {
   this->m_inputProgram = NULL;
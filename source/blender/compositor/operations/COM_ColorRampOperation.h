@@ -36,6 +36,7 @@ class ColorRampOperation : public NodeOperation {
    * the inner loop of this program
    */
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 
   /**
    * Initialize the execution
@@ -18,6 +18,7 @@
 
 #include "COM_ConvertDepthToRadiusOperation.h"
 #include "BKE_camera.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "DNA_camera_types.h"
 
@@ -29,6 +30,7 @@ ConvertDepthToRadiusOperation::ConvertDepthToRadiusOperation() : NodeOperation()
   this->m_fStop = 128.0f;
   this->m_cameraObject = NULL;
   this->m_maxRadius = 32.0f;
+  this->m_cam_lens = 50.0f;
   this->m_blurPostOperation = NULL;
 }
 
@@ -74,6 +76,15 @@ void ConvertDepthToRadiusOperation::initExecution()
   }
 }
 
+unsigned int ConvertDepthToRadiusOperation::getCacheHash()
+{
+  /* Camera settings are not part of the node, hash the values derived from the focus distance,
+   * lens and sensor size in #initExecution. */
+  const float camera_settings[4] = {
+      this->m_inverseFocalDistance, this->m_cam_lens, this->m_aperture, this->m_dof_sp};
+  return BLI_hash_mm2((const unsigned char *)camera_settings, sizeof(camera_settings), 0);
+}
+
 void ConvertDepthToRadiusOperation::executePixelSampled(float output[4],
                                                         float x,
                                                         float y,
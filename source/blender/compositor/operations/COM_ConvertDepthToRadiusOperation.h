@@ -48,6 +48,11 @@ class ConvertDepthToRadiusOperation : public NodeOperation {
    */
   ConvertDepthToRadiusOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -76,6 +81,7 @@ class ConvertDepthToRadiusOperation : public NodeOperation {
     this->m_cameraObject = camera;
   }
   float determineFocalDistance();
+  unsigned int getCacheHash();
   void setPostBlur(FastGaussianBlurValueOperation *operation)
   {
     this->m_blurPostOperation = operation;
@@ -28,6 +28,11 @@ class ConvertBaseOperation : public NodeOperation {
  public:
   ConvertBaseOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void initExecution();
   void deinitExecution();
 };
@@ -158,6 +163,12 @@ class SeparateChannelOperation : public NodeOperation {
 
  public:
   SeparateChannelOperation();
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
 
   void initExecution();
@@ -178,6 +189,12 @@ class CombineChannelsOperation : public NodeOperation {
 
  public:
   CombineChannelsOperation();
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
 
   void initExecution();
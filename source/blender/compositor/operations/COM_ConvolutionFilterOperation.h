@@ -33,6 +33,12 @@ class ConvolutionFilterOperation : public NodeOperation {
 
  public:
   ConvolutionFilterOperation();
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void set3x3Filter(
       float f1, float f2, float f3, float f4, float f5, float f6, float f7, float f8, float f9);
   bool determineDependingAreaOfInterest(rcti *input,
@@ -18,6 +18,8 @@
 
 #include "COM_CryptomatteOperation.h"
 
+#include "BLI_hash_mm2a.h"
+
 CryptomatteOperation::CryptomatteOperation(size_t num_inputs) : NodeOperation()
 {
   for (size_t i = 0; i < num_inputs; i++) {
@@ -35,6 +37,17 @@ void CryptomatteOperation::initExecution()
   }
 }
 
+unsigned int CryptomatteOperation::getCacheHash()
+{
+  /* The selected objects are stored as a string in the node. */
+  if (m_objectIndex.empty()) {
+    return 0;
+  }
+  return BLI_hash_mm2((const unsigned char *)&m_objectIndex[0],
+                      sizeof(float) * m_objectIndex.size(),
+                      0);
+}
+
 void CryptomatteOperation::addObjectIndex(float objectIndex)
 {
   if (objectIndex != 0.0f) {
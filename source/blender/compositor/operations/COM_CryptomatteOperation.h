@@ -33,5 +33,7 @@ class CryptomatteOperation : public NodeOperation {
   void executePixel(float output[4], int x, int y, void *data);
 
   void addObjectIndex(float objectIndex);
+
+  unsigned int getCacheHash();
 };
 #endif
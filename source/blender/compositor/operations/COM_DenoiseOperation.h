@@ -38,6 +38,12 @@ class DenoiseOperation : public SingleThreadedOperation {
 
  public:
   DenoiseOperation();
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * Initialize the execution
    */
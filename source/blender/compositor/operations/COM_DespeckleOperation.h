@@ -34,6 +34,12 @@ class DespeckleOperation : public NodeOperation {
 
  public:
   DespeckleOperation();
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   bool determineDependingAreaOfInterest(rcti *input,
                                         ReadBufferOperation *readOperation,
                                         rcti *output);
@@ -40,6 +40,11 @@ class DilateErodeThresholdOperation : public NodeOperation {
  public:
   DilateErodeThresholdOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -87,6 +92,11 @@ class DilateDistanceOperation : public NodeOperation {
  public:
   DilateDistanceOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -147,6 +157,11 @@ class DilateStepOperation : public NodeOperation {
  public:
   DilateStepOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
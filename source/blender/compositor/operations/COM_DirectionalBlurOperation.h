@@ -33,6 +33,11 @@ class DirectionalBlurOperation : public NodeOperation, public QualityStepHelper
  public:
   DirectionalBlurOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
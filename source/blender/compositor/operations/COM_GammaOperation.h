@@ -31,6 +31,11 @@ class GammaOperation : public NodeOperation {
  public:
   GammaOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
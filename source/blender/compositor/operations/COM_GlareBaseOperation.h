@@ -49,6 +49,11 @@ class GlareBaseOperation : public SingleThreadedOperation {
   NodeGlare *m_settings;
 
  public:
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * Initialize the execution
    */
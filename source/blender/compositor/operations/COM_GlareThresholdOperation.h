@@ -36,6 +36,11 @@ class GlareThresholdOperation : public NodeOperation {
  public:
   GlareThresholdOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -102,6 +102,19 @@ void BaseImageOperation::deinitExecution()
   BKE_image_release_ibuf(this->m_image, this->m_buffer, NULL);
 }
 
+bool BaseImageOperation::isCacheable() const
+{
+  /* Render results and viewers are written without their buffers being tagged changed. */
+  return !(this->m_image &&
+           ELEM(this->m_image->type, IMA_TYPE_R_RESULT, IMA_TYPE_COMPOSITE));
+}
+
+unsigned int BaseImageOperation::getCacheHash()
+{
+  /* Painting and reloading the image update the change timestamp of the buffer. */
+  return (this->m_buffer) ? this->m_buffer->changed_timestamp : 0;
+}
+
 void BaseImageOperation::determineResolution(unsigned int resolution[2],
                                              unsigned int /*preferredResolution*/[2])
 {
@@ -78,6 +78,9 @@ class BaseImageOperation : public NodeOperation {
   {
     this->m_framenumber = framenumber;
   }
+
+  bool isCacheable() const;
+  unsigned int getCacheHash();
 };
 class ImageOperation : public BaseImageOperation {
  public:
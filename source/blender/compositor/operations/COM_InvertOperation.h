@@ -34,6 +34,11 @@ class InvertOperation : public NodeOperation {
  public:
   InvertOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
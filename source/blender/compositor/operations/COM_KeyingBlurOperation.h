@@ -37,6 +37,11 @@ class KeyingBlurOperation : public NodeOperation {
 
   KeyingBlurOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void setSize(int value)
   {
     this->m_size = value;
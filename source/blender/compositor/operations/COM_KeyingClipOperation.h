@@ -37,6 +37,11 @@ class KeyingClipOperation : public NodeOperation {
  public:
   KeyingClipOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void setClipBlack(float value)
   {
     this->m_clipBlack = value;
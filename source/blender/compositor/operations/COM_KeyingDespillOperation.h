@@ -34,6 +34,11 @@ class KeyingDespillOperation : public NodeOperation {
  public:
   KeyingDespillOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void initExecution();
   void deinitExecution();
 
@@ -38,6 +38,11 @@ class KeyingOperation : public NodeOperation {
  public:
   KeyingOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void initExecution();
   void deinitExecution();
 
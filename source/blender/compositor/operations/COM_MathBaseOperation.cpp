@@ -71,6 +71,15 @@ void MathBaseOperation::clampIfNeeded(float *color)
   }
 }
 
+void MathBaseOperation::clampRowIfNeeded(float *values, int width)
+{
+  if (this->m_useClamp) {
+    for (int i = 0; i < width; i++) {
+      CLAMP(values[i * COM_NUM_CHANNELS_COLOR], 0.0f, 1.0f);
+    }
+  }
+}
+
 void MathAddOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
   float inputValue1[4];
@@ -84,6 +93,21 @@ void MathAddOperation::executePixelSampled(float output[4], float x, float y, Pi
   clampIfNeeded(output);
 }
 
+void MathAddOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputValue2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  this->m_inputValue1Operation->readRow(inputValue1, x, y, width);
+  this->m_inputValue2Operation->readRow(inputValue2, x, y, width);
+
+  for (int i = 0; i < width * COM_NUM_CHANNELS_COLOR; i += COM_NUM_CHANNELS_COLOR) {
+    output[i] = inputValue1[i] + inputValue2[i];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 void MathSubtractOperation::executePixelSampled(float output[4],
                                                 float x,
                                                 float y,
@@ -100,6 +124,21 @@ void MathSubtractOperation::executePixelSampled(float output[4],
   clampIfNeeded(output);
 }
 
+void MathSubtractOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputValue2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  this->m_inputValue1Operation->readRow(inputValue1, x, y, width);
+  this->m_inputValue2Operation->readRow(inputValue2, x, y, width);
+
+  for (int i = 0; i < width * COM_NUM_CHANNELS_COLOR; i += COM_NUM_CHANNELS_COLOR) {
+    output[i] = inputValue1[i] - inputValue2[i];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 void MathMultiplyOperation::executePixelSampled(float output[4],
                                                 float x,
                                                 float y,
@@ -116,6 +155,21 @@ void MathMultiplyOperation::executePixelSampled(float output[4],
   clampIfNeeded(output);
 }
 
+void MathMultiplyOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputValue2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  this->m_inputValue1Operation->readRow(inputValue1, x, y, width);
+  this->m_inputValue2Operation->readRow(inputValue2, x, y, width);
+
+  for (int i = 0; i < width * COM_NUM_CHANNELS_COLOR; i += COM_NUM_CHANNELS_COLOR) {
+    output[i] = inputValue1[i] * inputValue2[i];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 void MathDivideOperation::executePixelSampled(float output[4],
                                               float x,
                                               float y,
@@ -41,7 +41,13 @@ class MathBaseOperation : public NodeOperation {
    */
   MathBaseOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void clampIfNeeded(float color[4]);
+  void clampRowIfNeeded(float *values, int width);
 
  public:
   /**
@@ -76,6 +82,7 @@ class MathAddOperation : public MathBaseOperation {
   {
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 class MathSubtractOperation : public MathBaseOperation {
  public:
@@ -83,6 +90,7 @@ class MathSubtractOperation : public MathBaseOperation {
   {
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 class MathMultiplyOperation : public MathBaseOperation {
  public:
@@ -90,6 +98,7 @@ class MathMultiplyOperation : public MathBaseOperation {
   {
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 class MathDivideOperation : public MathBaseOperation {
  public:
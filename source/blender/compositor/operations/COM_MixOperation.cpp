@@ -63,6 +63,20 @@ void MixBaseOperation::executePixelSampled(float output[4], float x, float y, Pi
   output[3] = inputColor1[3];
 }
 
+void MixBaseOperation::readInputRows(
+    float *values, float *colors1, float *colors2, int x, int y, int width)
+{
+  this->m_inputValueOperation->readRow(values, x, y, width);
+  this->m_inputColor1Operation->readRow(colors1, x, y, width);
+  this->m_inputColor2Operation->readRow(colors2, x, y, width);
+
+  if (this->useValueAlphaMultiply()) {
+    for (int i = 0; i < width; i++) {
+      values[i * COM_NUM_CHANNELS_COLOR] *= colors2[i * COM_NUM_CHANNELS_COLOR + 3];
+    }
+  }
+}
+
 void MixBaseOperation::determineResolution(unsigned int resolution[2],
                                            unsigned int preferredResolution[2])
 {
@@ -124,6 +138,27 @@ void MixAddOperation::executePixelSampled(float output[4], float x, float y, Pix
   clampIfNeeded(output);
 }
 
+void MixAddOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  readInputRows(inputValue, inputColor1, inputColor2, x, y, width);
+  for (int i = 0; i < width; i++) {
+    const float value = inputValue[i * COM_NUM_CHANNELS_COLOR];
+    const float *color1 = &inputColor1[i * COM_NUM_CHANNELS_COLOR];
+    const float *color2 = &inputColor2[i * COM_NUM_CHANNELS_COLOR];
+    float *out = &output[i * COM_NUM_CHANNELS_COLOR];
+    out[0] = color1[0] + value * color2[0];
+    out[1] = color1[1] + value * color2[1];
+    out[2] = color1[2] + value * color2[2];
+    out[3] = color1[3];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 /* ******** Mix Blend Operation ******** */
 
 MixBlendOperation::MixBlendOperation() : MixBaseOperation()
@@ -158,6 +193,28 @@ void MixBlendOperation::executePixelSampled(float output[4],
   clampIfNeeded(output);
 }
 
+void MixBlendOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  readInputRows(inputValue, inputColor1, inputColor2, x, y, width);
+  for (int i = 0; i < width; i++) {
+    const float value = inputValue[i * COM_NUM_CHANNELS_COLOR];
+    const float *color1 = &inputColor1[i * COM_NUM_CHANNELS_COLOR];
+    const float *color2 = &inputColor2[i * COM_NUM_CHANNELS_COLOR];
+    float *out = &output[i * COM_NUM_CHANNELS_COLOR];
+    const float valuem = 1.0f - value;
+    out[0] = valuem * color1[0] + value * color2[0];
+    out[1] = valuem * color1[1] + value * color2[1];
+    out[2] = valuem * color1[2] + value * color2[2];
+    out[3] = color1[3];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 /* ******** Mix Burn Operation ******** */
 
 MixColorBurnOperation::MixColorBurnOperation() : MixBaseOperation()
@@ -705,6 +762,28 @@ void MixMultiplyOperation::executePixelSampled(float output[4],
   clampIfNeeded(output);
 }
 
+void MixMultiplyOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  readInputRows(inputValue, inputColor1, inputColor2, x, y, width);
+  for (int i = 0; i < width; i++) {
+    const float value = inputValue[i * COM_NUM_CHANNELS_COLOR];
+    const float *color1 = &inputColor1[i * COM_NUM_CHANNELS_COLOR];
+    const float *color2 = &inputColor2[i * COM_NUM_CHANNELS_COLOR];
+    float *out = &output[i * COM_NUM_CHANNELS_COLOR];
+    const float valuem = 1.0f - value;
+    out[0] = color1[0] * (valuem + value * color2[0]);
+    out[1] = color1[1] * (valuem + value * color2[1]);
+    out[2] = color1[2] * (valuem + value * color2[2]);
+    out[3] = color1[3];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 /* ******** Mix Ovelray Operation ******** */
 
 MixOverlayOperation::MixOverlayOperation() : MixBaseOperation()
@@ -909,6 +988,27 @@ void MixSubtractOperation::executePixelSampled(float output[4],
   clampIfNeeded(output);
 }
 
+void MixSubtractOperation::executeRow(float *output, int x, int y, int width)
+{
+  float inputValue[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor1[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+  float inputColor2[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
+
+  readInputRows(inputValue, inputColor1, inputColor2, x, y, width);
+  for (int i = 0; i < width; i++) {
+    const float value = inputValue[i * COM_NUM_CHANNELS_COLOR];
+    const float *color1 = &inputColor1[i * COM_NUM_CHANNELS_COLOR];
+    const float *color2 = &inputColor2[i * COM_NUM_CHANNELS_COLOR];
+    float *out = &output[i * COM_NUM_CHANNELS_COLOR];
+    out[0] = color1[0] - value * color2[0];
+    out[1] = color1[1] - value * color2[1];
+    out[2] = color1[2] - value * color2[2];
+    out[3] = color1[3];
+  }
+
+  clampRowIfNeeded(output, width);
+}
+
 /* ******** Mix Value Operation ******** */
 
 MixValueOperation::MixValueOperation() : MixBaseOperation()
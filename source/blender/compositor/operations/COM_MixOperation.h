@@ -43,12 +43,33 @@ class MixBaseOperation : public NodeOperation {
     }
   }
 
+  inline void clampRowIfNeeded(float *colors, int width)
+  {
+    if (m_useClamp) {
+      for (int i = 0; i < width * COM_NUM_CHANNELS_COLOR; i++) {
+        CLAMP(colors[i], 0.0f, 1.0f);
+      }
+    }
+  }
+
+  /**
+   * Read a row of all inputs for #executeRow, the factor of each pixel is stored in
+   * `values[i * COM_NUM_CHANNELS_COLOR]` and already multiplied by the alpha of the second color
+   * when #useValueAlphaMultiply is set.
+   */
+  void readInputRows(float *values, float *colors1, float *colors2, int x, int y, int width);
+
  public:
   /**
    * Default constructor
    */
   MixBaseOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -84,12 +105,14 @@ class MixAddOperation : public MixBaseOperation {
  public:
   MixAddOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 
 class MixBlendOperation : public MixBaseOperation {
  public:
   MixBlendOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 
 class MixColorBurnOperation : public MixBaseOperation {
@@ -156,6 +179,7 @@ class MixMultiplyOperation : public MixBaseOperation {
  public:
   MixMultiplyOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 
 class MixOverlayOperation : public MixBaseOperation {
@@ -186,6 +210,7 @@ class MixSubtractOperation : public MixBaseOperation {
  public:
   MixSubtractOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 };
 
 class MixValueOperation : public MixBaseOperation {
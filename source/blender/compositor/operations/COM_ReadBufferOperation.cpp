@@ -20,6 +20,8 @@
 #include "COM_WriteBufferOperation.h"
 #include "COM_defines.h"
 
+#include <string.h>
+
 ReadBufferOperation::ReadBufferOperation(DataType datatype) : NodeOperation()
 {
   this->addOutputSocket(datatype);
@@ -74,6 +76,29 @@ void ReadBufferOperation::executePixelSampled(float output[4],
   }
 }
 
+void ReadBufferOperation::executeRow(float *output, int x, int y, int width)
+{
+  const rcti *rect = m_buffer->getRect();
+  if (m_single_value || y < rect->ymin || y >= rect->ymax || x < rect->xmin ||
+      x + width > rect->xmax) {
+    NodeOperation::executeRow(output, x, y, width);
+    return;
+  }
+
+  const int num_channels = m_buffer->get_num_channels();
+  const float *buffer = &m_buffer->getBuffer()[(m_buffer->getWidth() * y + x) * num_channels];
+  if (num_channels == COM_NUM_CHANNELS_COLOR) {
+    memcpy(output, buffer, sizeof(float) * COM_NUM_CHANNELS_COLOR * width);
+  }
+  else {
+    for (int i = 0; i < width; i++) {
+      memcpy(&output[i * COM_NUM_CHANNELS_COLOR],
+             &buffer[i * num_channels],
+             sizeof(float) * num_channels);
+    }
+  }
+}
+
 void ReadBufferOperation::executePixelExtend(float output[4],
                                              float x,
                                              float y,
@@ -32,6 +32,12 @@ class ReadBufferOperation : public NodeOperation {
 
  public:
   ReadBufferOperation(DataType datetype);
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void setMemoryProxy(MemoryProxy *memoryProxy)
   {
     this->m_memoryProxy = memoryProxy;
@@ -51,6 +57,7 @@ class ReadBufferOperation : public NodeOperation {
                           MemoryBufferExtend extend_x,
                           MemoryBufferExtend extend_y);
   void executePixelFiltered(float output[4], float x, float y, float dx[2], float dy[2]);
+  void executeRow(float *output, int x, int y, int width);
   bool isReadBufferOperation() const
   {
     return true;
@@ -33,6 +33,7 @@ RenderLayersProg::RenderLayersProg(const char *passName, DataType type, int elem
 {
   this->setScene(NULL);
   this->m_inputBuffer = NULL;
+  this->m_resultTimestamp = 0;
   this->m_elementsize = elementsize;
   this->m_rd = NULL;
 
@@ -50,6 +51,7 @@ void RenderLayersProg::initExecution()
   }
 
   if (rr) {
+    this->m_resultTimestamp = rr->changed_timestamp;
     ViewLayer *view_layer = (ViewLayer *)BLI_findlink(&scene->view_layers, getLayerId());
     if (view_layer) {
 
@@ -180,6 +182,12 @@ void RenderLayersProg::deinitExecution()
   this->m_inputBuffer = NULL;
 }
 
+unsigned int RenderLayersProg::getCacheHash()
+{
+  /* Rendering and loading results update their change timestamp. */
+  return (this->m_inputBuffer) ? this->m_resultTimestamp : 0;
+}
+
 void RenderLayersProg::determineResolution(unsigned int resolution[2],
                                            unsigned int /*preferredResolution*/[2])
 {
@@ -54,6 +54,11 @@ class RenderLayersProg : public NodeOperation {
    */
   float *m_inputBuffer;
 
+  /**
+   * change timestamp of the render result the buffer belongs to
+   */
+  unsigned int m_resultTimestamp;
+
   /**
    * Render-pass where this operation needs to get its data from.
    */
@@ -86,6 +91,12 @@ class RenderLayersProg : public NodeOperation {
    * Constructor
    */
   RenderLayersProg(const char *passName, DataType type, int elementsize);
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * setter for the scene field. Will be called from
    * \see RenderLayerNode to set the actual scene where
@@ -122,6 +133,8 @@ class RenderLayersProg : public NodeOperation {
   void initExecution();
   void deinitExecution();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+
+  unsigned int getCacheHash();
 };
 
 class RenderLayersAOOperation : public RenderLayersProg {
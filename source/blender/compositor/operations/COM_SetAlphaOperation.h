@@ -35,6 +35,11 @@ class SetAlphaOperation : public NodeOperation {
    */
   SetAlphaOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
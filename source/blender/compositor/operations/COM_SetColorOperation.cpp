@@ -18,6 +18,8 @@
 
 #include "COM_SetColorOperation.h"
 
+#include "BLI_hash_mm2a.h"
+
 SetColorOperation::SetColorOperation() : NodeOperation()
 {
   this->addOutputSocket(COM_DT_COLOR);
@@ -31,6 +33,18 @@ void SetColorOperation::executePixelSampled(float output[4],
   copy_v4_v4(output, this->m_color);
 }
 
+void SetColorOperation::executeRow(float *output, int /*x*/, int /*y*/, int width)
+{
+  for (int i = 0; i < width; i++) {
+    copy_v4_v4(&output[i * COM_NUM_CHANNELS_COLOR], this->m_color);
+  }
+}
+
+unsigned int SetColorOperation::getCacheHash()
+{
+  return BLI_hash_mm2((const unsigned char *)this->m_color, sizeof(this->m_color), 0);
+}
+
 void SetColorOperation::determineResolution(unsigned int resolution[2],
                                             unsigned int preferredResolution[2])
 {
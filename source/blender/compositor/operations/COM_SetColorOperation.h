@@ -34,6 +34,11 @@ class SetColorOperation : public NodeOperation {
    */
   SetColorOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   float getChannel1()
   {
     return this->m_color[0];
@@ -75,11 +80,14 @@ class SetColorOperation : public NodeOperation {
    * the inner loop of this program
    */
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 
   void determineResolution(unsigned int resolution[2], unsigned int preferredResolution[2]);
   bool isSetOperation() const
   {
     return true;
   }
+
+  unsigned int getCacheHash();
 };
 #endif
@@ -35,6 +35,11 @@ class SetSamplerOperation : public NodeOperation {
    */
   SetSamplerOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void setSampler(PixelSampler sampler)
   {
     this->m_sampler = sampler;
@@ -18,6 +18,8 @@
 
 #include "COM_SetValueOperation.h"
 
+#include "BLI_hash_mm2a.h"
+
 SetValueOperation::SetValueOperation() : NodeOperation()
 {
   this->addOutputSocket(COM_DT_VALUE);
@@ -31,6 +33,18 @@ void SetValueOperation::executePixelSampled(float output[4],
   output[0] = this->m_value;
 }
 
+void SetValueOperation::executeRow(float *output, int /*x*/, int /*y*/, int width)
+{
+  for (int i = 0; i < width; i++) {
+    output[i * COM_NUM_CHANNELS_COLOR] = this->m_value;
+  }
+}
+
+unsigned int SetValueOperation::getCacheHash()
+{
+  return BLI_hash_mm2((const unsigned char *)&this->m_value, sizeof(this->m_value), 0);
+}
+
 void SetValueOperation::determineResolution(unsigned int resolution[2],
                                             unsigned int preferredResolution[2])
 {
@@ -34,6 +34,11 @@ class SetValueOperation : public NodeOperation {
    */
   SetValueOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   float getValue()
   {
     return this->m_value;
@@ -47,11 +52,14 @@ class SetValueOperation : public NodeOperation {
    * the inner loop of this program
    */
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
   void determineResolution(unsigned int resolution[2], unsigned int preferredResolution[2]);
 
   bool isSetOperation() const
   {
     return true;
   }
+
+  unsigned int getCacheHash();
 };
 #endif
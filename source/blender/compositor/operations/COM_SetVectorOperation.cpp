@@ -17,6 +17,8 @@
  */
 
 #include "COM_SetVectorOperation.h"
+
+#include "BLI_hash_mm2a.h"
 #include "COM_defines.h"
 
 SetVectorOperation::SetVectorOperation() : NodeOperation()
@@ -34,6 +36,22 @@ void SetVectorOperation::executePixelSampled(float output[4],
   output[2] = this->m_z;
 }
 
+void SetVectorOperation::executeRow(float *output, int /*x*/, int /*y*/, int width)
+{
+  for (int i = 0; i < width; i++) {
+    float *out = &output[i * COM_NUM_CHANNELS_COLOR];
+    out[0] = this->m_x;
+    out[1] = this->m_y;
+    out[2] = this->m_z;
+  }
+}
+
+unsigned int SetVectorOperation::getCacheHash()
+{
+  const float vector[4] = {this->m_x, this->m_y, this->m_z, this->m_w};
+  return BLI_hash_mm2((const unsigned char *)vector, sizeof(vector), 0);
+}
+
 void SetVectorOperation::determineResolution(unsigned int resolution[2],
                                              unsigned int preferredResolution[2])
 {
@@ -37,6 +37,11 @@ class SetVectorOperation : public NodeOperation {
    */
   SetVectorOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   float getX()
   {
     return this->m_x;
@@ -74,6 +79,7 @@ class SetVectorOperation : public NodeOperation {
    * the inner loop of this program
    */
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width);
 
   void determineResolution(unsigned int resolution[2], unsigned int preferredResolution[2]);
   bool isSetOperation() const
@@ -87,5 +93,7 @@ class SetVectorOperation : public NodeOperation {
     setY(vector[1]);
     setZ(vector[2]);
   }
+
+  unsigned int getCacheHash();
 };
 #endif
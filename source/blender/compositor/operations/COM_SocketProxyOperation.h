@@ -25,6 +25,11 @@ class SocketProxyOperation : public NodeOperation {
  public:
   SocketProxyOperation(DataType type, bool use_conversion);
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   bool isProxyOperation() const
   {
     return true;
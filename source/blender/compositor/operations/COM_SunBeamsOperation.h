@@ -24,6 +24,11 @@ class SunBeamsOperation : public NodeOperation {
  public:
   SunBeamsOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   void executePixel(float output[4], int x, int y, void *data);
 
   void initExecution();
@@ -57,6 +57,11 @@ class TonemapOperation : public NodeOperation {
  public:
   TonemapOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
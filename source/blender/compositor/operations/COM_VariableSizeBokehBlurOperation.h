@@ -38,6 +38,11 @@ class VariableSizeBokehBlurOperation : public NodeOperation, public QualityStepH
  public:
   VariableSizeBokehBlurOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
@@ -95,6 +100,11 @@ class InverseSearchRadiusOperation : public NodeOperation {
 
   InverseSearchRadiusOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
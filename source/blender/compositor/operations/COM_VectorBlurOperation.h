@@ -41,6 +41,11 @@ class VectorBlurOperation : public NodeOperation, public QualityStepHelper {
  public:
   VectorBlurOperation();
 
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   /**
    * the inner loop of this program
    */
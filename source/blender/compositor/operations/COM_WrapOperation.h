@@ -31,6 +31,11 @@ class WrapOperation : public ReadBufferOperation {
                                         ReadBufferOperation *readOperation,
                                         rcti *output);
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executeRow(float *output, int x, int y, int width)
+  {
+    /* Wrapped coordinates don't map to a contiguous row of the buffer. */
+    NodeOperation::executeRow(output, x, y, width);
+  }
 
   void setWrapping(int wrapping_type);
   float getWrappedOriginalXPos(float x);
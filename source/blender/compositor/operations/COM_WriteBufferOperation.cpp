@@ -20,6 +20,7 @@
 #include "COM_OpenCLDevice.h"
 #include "COM_defines.h"
 #include <stdio.h>
+#include <string.h>
 
 WriteBufferOperation::WriteBufferOperation(DataType datatype) : NodeOperation()
 {
@@ -46,8 +47,8 @@ void WriteBufferOperation::executePixelSampled(float output[4],
 
 void WriteBufferOperation::initExecution()
 {
+  /* The buffer is allocated by the #MemoryPlanner once a chunk is scheduled. */
   this->m_input = this->getInputOperation(0);
-  this->m_memoryProxy->allocate(this->m_width, this->m_height);
 }
 
 void WriteBufferOperation::deinitExecution()
@@ -91,14 +92,28 @@ void WriteBufferOperation::executeRegion(rcti *rect, unsigned int /*tileNumber*/
     int x2 = rect->xmax;
     int y2 = rect->ymax;
 
+    /* Rows are calculated in segments, the input chain fills a segment at once and only
+     * operations that don't implement #SocketReader::executeRow fall back to per pixel calls. */
+    float row[COM_ROW_WIDTH_MAX * COM_NUM_CHANNELS_COLOR];
     int x;
     int y;
     bool breaked = false;
     for (y = y1; y < y2 && (!breaked); y++) {
       int offset4 = (y * memoryBuffer->getWidth() + x1) * num_channels;
-      for (x = x1; x < x2; x++) {
-        this->m_input->readSampled(&(buffer[offset4]), x, y, COM_PS_NEAREST);
-        offset4 += num_channels;
+      for (x = x1; x < x2; x += COM_ROW_WIDTH_MAX) {
+        const int width = min_ii(COM_ROW_WIDTH_MAX, x2 - x);
+        this->m_input->readRow(row, x, y, width);
+        if (num_channels == COM_NUM_CHANNELS_COLOR) {
+          memcpy(&buffer[offset4], row, sizeof(float) * COM_NUM_CHANNELS_COLOR * width);
+          offset4 += COM_NUM_CHANNELS_COLOR * width;
+        }
+        else {
+          for (int i = 0; i < width; i++) {
+            memcpy(
+                &buffer[offset4], &row[i * COM_NUM_CHANNELS_COLOR], sizeof(float) * num_channels);
+            offset4 += num_channels;
+          }
+        }
       }
       if (isBraked()) {
         breaked = true;
@@ -34,6 +34,12 @@ class WriteBufferOperation : public NodeOperation {
  public:
   WriteBufferOperation(DataType datatype);
   ~WriteBufferOperation();
+
+  bool isCacheable() const
+  {
+    return true;
+  }
+
   MemoryProxy *getMemoryProxy()
   {
     return this->m_memoryProxy;
@@ -46,6 +46,10 @@ int DEG_debug_flags_get(const struct Depsgraph *depsgraph);
 void DEG_debug_name_set(struct Depsgraph *depsgraph, const char *name);
 const char *DEG_debug_name_get(struct Depsgraph *depsgraph);
 
+/* Append the timeline of every following evaluation of any dependency graph to the file,
+ * in the Chrome trace event format. Pass NULL to close the file. */
+bool DEG_debug_eval_trace_file_set(const char *filepath);
+
 /* ------------------------------------------------ */
 
 void DEG_stats_simple(const struct Depsgraph *graph,
@@ -25,11 +25,14 @@
 
 #include "intern/eval/deg_eval.h"
 
+#include <queue>
+
 #include "PIL_time.h"
 
 #include "BLI_compiler_attrs.h"
 #include "BLI_gsqueue.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_global.h"
@@ -69,10 +72,7 @@ void schedule_children(DepsgraphEvalState *state,
                        ScheduleFunction *schedule_function,
                        ScheduleFunctionArgs... schedule_function_args);
 
-void schedule_node_to_pool(OperationNode *node, const int UNUSED(thread_id), TaskPool *pool)
-{
-  BLI_task_pool_push(pool, deg_task_run_func, node, false, NULL);
-}
+void schedule_node_to_pool(OperationNode *node, const int thread_id, TaskPool *pool);
 
 /* Denotes which part of dependency graph is being evaluated. */
 enum class EvaluationStage {
@@ -91,9 +91,36 @@ enum class EvaluationStage {
   SINGLE_THREADED_WORKAROUND,
 };
 
+/* Operations which took less than this to evaluate last time are taken from the queue in
+ * batches, so scheduling overhead does not dominate scenes with many small objects.
+ * Tune with the `depsgraph_eval_performance_test` in `tests/gtests/depsgraph`. */
+constexpr float BATCH_OPERATION_MAX_TIME = 20e-6f;
+constexpr int BATCH_MAX_SIZE = 32;
+
+struct OperationPriorityCompare {
+  bool operator()(const OperationNode *a, const OperationNode *b) const
+  {
+    return a->priority < b->priority;
+  }
+};
+
 struct DepsgraphEvalState {
   Depsgraph *graph;
   bool do_stats;
+  /* Operations which are ready to be evaluated, highest priority first.
+   * Tasks in the pool take operations from the top until it is empty, rather than evaluating the
+   * operation which made them pushed, so long chains of operations are started first. */
+  std::priority_queue<OperationNode *, std::vector<OperationNode *>, OperationPriorityCompare>
+      ready_operations;
+  /* Tasks in the pool which did not take operations from the queue yet. A task is only pushed
+   * when there are more ready operations than pending tasks. */
+  int num_pending_tasks;
+  SpinLock ready_operations_lock;
+  /* Number of threads taking operations from the queue, to keep batches small enough for all
+   * threads to get work. */
+  int num_threads;
+  /* Timeline of evaluated operations, when a trace file is set. */
+  EvaluationTrace *trace;
   EvaluationStage stage;
   bool need_single_thread_pass;
 };
@@ -104,28 +131,121 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
 
   /* Sanity checks. */
   BLI_assert(!operation_node->is_noop() && "NOOP nodes should not actually be scheduled");
-  /* Perform operation. */
+  /* Perform operation, its time is used for the priority in the next evaluation. */
+  const double start_time = PIL_check_seconds_timer();
+  operation_node->evaluate(depsgraph);
+  const double end_time = PIL_check_seconds_timer();
+  operation_node->eval_time = (float)(end_time - start_time);
   if (state->do_stats) {
-    const double start_time = PIL_check_seconds_timer();
-    operation_node->evaluate(depsgraph);
-    operation_node->stats.current_time += PIL_check_seconds_timer() - start_time;
+    operation_node->stats.current_time += end_time - start_time;
   }
-  else {
-    operation_node->evaluate(depsgraph);
+  if (state->trace) {
+    state->trace->record(operation_node, start_time, end_time);
+  }
+}
+
+void schedule_node_to_pool(OperationNode *node, const int UNUSED(thread_id), TaskPool *pool)
+{
+  DepsgraphEvalState *state = (DepsgraphEvalState *)BLI_task_pool_user_data(pool);
+  BLI_spin_lock(&state->ready_operations_lock);
+  state->ready_operations.push(node);
+  const bool need_task = state->num_pending_tasks < (int)state->ready_operations.size();
+  if (need_task) {
+    state->num_pending_tasks++;
+  }
+  BLI_spin_unlock(&state->ready_operations_lock);
+
+  if (need_task) {
+    BLI_task_pool_push(pool, deg_task_run_func, NULL, false, NULL);
   }
 }
 
-void deg_task_run_func(TaskPool *pool, void *taskdata)
+void schedule_node_to_vector(OperationNode *node,
+                             const int UNUSED(thread_id),
+                             Vector<OperationNode *> *ready_operations)
+{
+  ready_operations->append(node);
+}
+
+/* Take the highest priority operation from the queue, along with more operations when they are
+ * cheap to evaluate. Returns the number of operations, zero when the queue is empty. */
+int pop_ready_operations(DepsgraphEvalState *state, OperationNode **r_batch, bool is_task_start)
+{
+  BLI_spin_lock(&state->ready_operations_lock);
+  if (is_task_start) {
+    state->num_pending_tasks--;
+  }
+  const int num_ready = (int)state->ready_operations.size();
+  const int max_size = max(1, min_ii(BATCH_MAX_SIZE, num_ready / state->num_threads));
+  int size = 0;
+  while (size < max_size && !state->ready_operations.empty()) {
+    OperationNode *operation_node = state->ready_operations.top();
+    const bool is_cheap = operation_node->eval_time > 0.0f &&
+                          operation_node->eval_time < BATCH_OPERATION_MAX_TIME;
+    if (size != 0 && !is_cheap) {
+      break;
+    }
+    state->ready_operations.pop();
+    r_batch[size++] = operation_node;
+    if (!is_cheap) {
+      break;
+    }
+  }
+  BLI_spin_unlock(&state->ready_operations_lock);
+  return size;
+}
+
+/* Evaluate the operation and its children which become ready, the highest priority child is
+ * evaluated right away on this thread, so chains of operations don't go through the queue. */
+void evaluate_operation_chain(DepsgraphEvalState *state,
+                              OperationNode *operation_node,
+                              TaskPool *pool)
+{
+  Vector<OperationNode *> ready_children;
+  while (operation_node != nullptr) {
+    evaluate_node(state, operation_node);
+
+    ready_children.clear();
+    schedule_children(state, operation_node, schedule_node_to_vector, &ready_children);
+
+    operation_node = nullptr;
+    for (OperationNode *child : ready_children) {
+      if (operation_node == nullptr) {
+        operation_node = child;
+      }
+      else if (child->priority > operation_node->priority) {
+        schedule_node_to_pool(operation_node, 0, pool);
+        operation_node = child;
+      }
+      else {
+        schedule_node_to_pool(child, 0, pool);
+      }
+    }
+  }
+}
+
+void deg_task_run_func(TaskPool *pool, void *UNUSED(taskdata))
 {
   void *userdata_v = BLI_task_pool_user_data(pool);
   DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
 
-  /* Evaluate node. */
-  OperationNode *operation_node = reinterpret_cast<OperationNode *>(taskdata);
-  evaluate_node(state, operation_node);
-
-  /* Schedule children. */
-  schedule_children(state, operation_node, schedule_node_to_pool, pool);
+  OperationNode *batch[BATCH_MAX_SIZE];
+  bool is_task_start = true;
+  while (true) {
+    const int batch_size = pop_ready_operations(state, batch, is_task_start);
+    is_task_start = false;
+    if (batch_size == 0) {
+      break;
+    }
+    /* Children of all but the last operation go through the queue, so idle threads can pick
+     * them up while this one is busy with the rest of the batch. Only the last operation
+     * continues its chain on this thread. */
+    for (int i = 0; i < batch_size - 1; i++) {
+      evaluate_node(state, batch[i]);
+      schedule_children(state, batch[i], schedule_node_to_pool, pool);
+    }
+    evaluate_operation_chain(state, batch[batch_size - 1], pool);
+  }
 }
 
 bool check_operation_node_visible(OperationNode *op_node)
@@ -330,6 +450,65 @@ void evaluate_graph_single_threaded(DepsgraphEvalState *state)
   BLI_gsqueue_free(evaluation_queue);
 }
 
+/* Cost of an operation used for the priority, operations which were never evaluated yet
+ * get a small cost so the longest chain is followed at least. */
+float operation_cost(const OperationNode *node)
+{
+  if (node->is_noop()) {
+    return 0.0f;
+  }
+  return max(node->eval_time, 1e-6f);
+}
+
+/* Update priorities of the operations evaluated by the last evaluation from their time.
+ * Operations which were not evaluated keep their priority from an earlier evaluation. */
+void update_operation_priorities(Depsgraph *graph)
+{
+  enum { PRIORITY_UNKNOWN = 0, PRIORITY_IN_PROGRESS = 1, PRIORITY_DONE = 2 };
+  for (OperationNode *node : graph->operations) {
+    node->custom_flags = PRIORITY_UNKNOWN;
+  }
+  /* Post-order over the children with an explicit stack, as chains can be very long. */
+  Vector<OperationNode *> stack;
+  for (OperationNode *root : graph->operations) {
+    if (!root->scheduled || root->custom_flags == PRIORITY_DONE) {
+      continue;
+    }
+    stack.append(root);
+    while (!stack.is_empty()) {
+      OperationNode *node = stack.last();
+      if (node->custom_flags == PRIORITY_DONE) {
+        stack.remove_last();
+        continue;
+      }
+      node->custom_flags = PRIORITY_IN_PROGRESS;
+      bool children_done = true;
+      float children_priority = 0.0f;
+      for (Relation *rel : node->outlinks) {
+        OperationNode *child = (OperationNode *)rel->to;
+        if (rel->flag & RELATION_FLAG_CYCLIC) {
+          continue;
+        }
+        if (child->scheduled && child->custom_flags != PRIORITY_DONE) {
+          /* Children which are in progress are part of a cycle. */
+          if (child->custom_flags == PRIORITY_UNKNOWN) {
+            children_done = false;
+            stack.append(child);
+          }
+          continue;
+        }
+        children_priority = max(children_priority, child->priority);
+      }
+      if (!children_done) {
+        continue;
+      }
+      node->priority = operation_cost(node) + children_priority;
+      node->custom_flags = PRIORITY_DONE;
+      stack.remove_last();
+    }
+  }
+}
+
 void depsgraph_ensure_view_layer(Depsgraph *graph)
 {
   /* We update copy-on-write scene in the following cases:
@@ -380,9 +559,20 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   DepsgraphEvalState state;
   state.graph = graph;
   state.do_stats = graph->debug.do_time_debug();
+  state.trace = nullptr;
   state.need_single_thread_pass = false;
+  state.num_pending_tasks = 0;
+  state.num_threads = (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) ?
+                          1 :
+                          BLI_task_scheduler_num_threads();
+  BLI_spin_init(&state.ready_operations_lock);
   /* Prepare all nodes for evaluation. */
   initialize_execution(&state, graph);
+  unique_ptr<EvaluationTrace> trace;
+  if (deg_eval_trace_is_enabled()) {
+    trace = std::make_unique<EvaluationTrace>(graph);
+    state.trace = trace.get();
+  }
 
   /* Do actual evaluation now. */
   /* First, process all Copy-On-Write nodes. */
@@ -410,6 +600,11 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   if (state.do_stats) {
     deg_eval_stats_aggregate(graph);
   }
+  if (state.trace) {
+    state.trace->finish();
+  }
+  update_operation_priorities(graph);
+  BLI_spin_end(&state.ready_operations_lock);
   /* Clear any uncleared tags - just in case. */
   deg_graph_clear_tags(graph);
   graph->is_evaluating = false;
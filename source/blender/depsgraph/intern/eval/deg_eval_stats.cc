@@ -23,9 +23,21 @@
 
 #include "intern/eval/deg_eval_stats.h"
 
+#include <cstdio>
+#include <mutex>
+
+#include "PIL_time.h"
+
+#include "BLI_fileops.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
+#include "BKE_global.h"
+
+#include "atomic_ops.h"
+
 #include "intern/depsgraph.h"
+#include "intern/depsgraph_relation.h"
 
 #include "intern/node/deg_node.h"
 #include "intern/node/deg_node_component.h"
@@ -55,5 +67,288 @@ void deg_eval_stats_aggregate(Depsgraph *graph)
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Evaluation Trace
+ * \{ */
+
+namespace {
+
+/* Trace file shared by all dependency graphs, events are appended after every evaluation.
+ * Dependency graphs can be evaluated from different threads (viewport and final render), so
+ * all the trace file state is guarded by the mutex. */
+std::mutex trace_mutex;
+FILE *trace_file = nullptr;
+double trace_start_time = 0.0;
+bool trace_is_empty = true;
+
+/* Thread 0 is used for the evaluation itself, threads are numbered in order of their first
+ * evaluated operation. */
+int trace_thread_id()
+{
+  static int num_threads = 0;
+  static thread_local int thread_id = 0;
+  if (thread_id == 0) {
+    thread_id = atomic_add_and_fetch_int32(&num_threads, 1);
+  }
+  return thread_id;
+}
+
+string json_escape(const string &str)
+{
+  string result;
+  result.reserve(str.size());
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    }
+    else if ((unsigned char)c < 0x20) {
+      result += ' ';
+    }
+    else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+/* Must be called with the trace mutex locked. */
+void trace_write_event(const string &name,
+                       const char *category,
+                       double start_time,
+                       double end_time,
+                       int thread_id,
+                       const string &args)
+{
+  fprintf(trace_file,
+          "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+          "\"pid\":1,\"tid\":%d,\"args\":{%s}}",
+          trace_is_empty ? "" : ",\n",
+          json_escape(name).c_str(),
+          category,
+          (start_time - trace_start_time) * 1e6,
+          (end_time - start_time) * 1e6,
+          thread_id,
+          args.c_str());
+  trace_is_empty = false;
+}
+
+}  // namespace
+
+bool deg_eval_trace_file_set(const char *filepath)
+{
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  if (trace_file != nullptr) {
+    /* The closing bracket is optional in the trace format, it is only written here so the file
+     * is valid JSON as well. */
+    fprintf(trace_file, "\n]\n");
+    fclose(trace_file);
+    trace_file = nullptr;
+  }
+  if (filepath == nullptr) {
+    return true;
+  }
+
+  trace_file = BLI_fopen(filepath, "w");
+  if (trace_file == nullptr) {
+    fprintf(stderr, "Failed to open depsgraph trace file '%s'\n", filepath);
+    return false;
+  }
+  fprintf(trace_file, "[\n");
+  trace_start_time = PIL_check_seconds_timer();
+  trace_is_empty = true;
+  return true;
+}
+
+bool deg_eval_trace_is_enabled()
+{
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  return trace_file != nullptr;
+}
+
+EvaluationTrace::EvaluationTrace(Depsgraph *graph)
+    : graph_(graph),
+      start_time_(PIL_check_seconds_timer()),
+      end_time_(0.0),
+      events_(graph->operations.size()),
+      critical_path_end_(-1)
+{
+  /* Filled in before evaluation, so it is only read from the evaluation threads. */
+  for (const int i : graph->operations.index_range()) {
+    operation_index_.add_new(graph->operations[i], i);
+    OperationEvent &event = events_[i];
+    event.start_time = event.end_time = 0.0;
+    event.thread_id = 0;
+    event.evaluated = false;
+    event.path_time = -1.0;
+    event.path_parent = -1;
+    event.on_critical_path = false;
+  }
+}
+
+void EvaluationTrace::record(const OperationNode *operation_node,
+                             double start_time,
+                             double end_time)
+{
+  OperationEvent &event = events_[operation_index_.lookup(operation_node)];
+  event.start_time = start_time;
+  event.end_time = end_time;
+  event.thread_id = trace_thread_id();
+  event.evaluated = true;
+}
+
+void EvaluationTrace::finish()
+{
+  end_time_ = PIL_check_seconds_timer();
+  compute_critical_path();
+  print_summary();
+  write_events();
+}
+
+void EvaluationTrace::compute_critical_path()
+{
+  /* Longest path over the operations scheduled in this evaluation, no-op operations take no
+   * time but still connect their parents and children. Depth first with an explicit stack, as
+   * chains of operations in rigs can be very long. */
+  Vector<int> stack;
+  for (const int root : graph_->operations.index_range()) {
+    if (!graph_->operations[root]->scheduled || events_[root].path_time >= 0.0) {
+      continue;
+    }
+    stack.append(root);
+    while (!stack.is_empty()) {
+      const int index = stack.last();
+      OperationEvent &event = events_[index];
+      if (event.path_time >= 0.0) {
+        stack.remove_last();
+        continue;
+      }
+
+      OperationNode *operation_node = graph_->operations[index];
+      bool parents_done = true;
+      double parent_time = 0.0;
+      int parent_index = -1;
+      for (Relation *rel : operation_node->inlinks) {
+        if (rel->from->type != NodeType::OPERATION || (rel->flag & RELATION_FLAG_CYCLIC)) {
+          continue;
+        }
+        const OperationNode *from = (const OperationNode *)rel->from;
+        if (!from->scheduled) {
+          continue;
+        }
+        const int from_index = operation_index_.lookup(from);
+        const double from_time = events_[from_index].path_time;
+        if (from_time < 0.0) {
+          parents_done = false;
+          stack.append(from_index);
+        }
+        else if (from_time > parent_time || parent_index == -1) {
+          parent_time = from_time;
+          parent_index = from_index;
+        }
+      }
+      if (!parents_done) {
+        continue;
+      }
+
+      const double time = event.evaluated ? event.end_time - event.start_time : 0.0;
+      event.path_time = parent_time + time;
+      event.path_parent = parent_index;
+      stack.remove_last();
+
+      if (critical_path_end_ == -1 || event.path_time > events_[critical_path_end_].path_time) {
+        critical_path_end_ = index;
+      }
+    }
+  }
+
+  for (int index = critical_path_end_; index != -1; index = events_[index].path_parent) {
+    events_[index].on_critical_path = true;
+  }
+}
+
+void EvaluationTrace::print_summary()
+{
+  const int num_threads = (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) ?
+                              1 :
+                              BLI_task_scheduler_num_threads();
+  const double wall_time = end_time_ - start_time_;
+  double busy_time = 0.0;
+  int num_evaluated = 0;
+  Vector<int> critical_path;
+  for (const int i : events_.index_range()) {
+    const OperationEvent &event = events_[i];
+    if (!event.evaluated) {
+      continue;
+    }
+    busy_time += event.end_time - event.start_time;
+    num_evaluated++;
+    if (event.on_critical_path) {
+      critical_path.append(i);
+    }
+  }
+  const double critical_time = (critical_path_end_ != -1) ?
+                                   events_[critical_path_end_].path_time :
+                                   0.0;
+
+  printf("Depsgraph %s: %d operations in %.3f ms on %d threads\n",
+         graph_->debug.name.c_str(),
+         num_evaluated,
+         wall_time * 1000.0,
+         num_threads);
+  printf("  busy %.3f ms, parallelism %.2f, idle %.3f ms\n",
+         busy_time * 1000.0,
+         (wall_time > 0.0) ? busy_time / wall_time : 0.0,
+         max(0.0, wall_time * num_threads - busy_time) * 1000.0);
+  printf("  critical path %.3f ms over %d evaluated operations\n",
+         critical_time * 1000.0,
+         (int)critical_path.size());
+
+  /* The operations which serialize evaluation most. */
+  std::sort(critical_path.begin(), critical_path.end(), [&](const int a, const int b) {
+    return events_[a].end_time - events_[a].start_time >
+           events_[b].end_time - events_[b].start_time;
+  });
+  const int num_printed = std::min((int)critical_path.size(), 10);
+  for (int i = 0; i < num_printed; i++) {
+    const OperationEvent &event = events_[critical_path[i]];
+    printf("  %10.3f ms  %s\n",
+           (event.end_time - event.start_time) * 1000.0,
+           graph_->operations[critical_path[i]]->full_identifier().c_str());
+  }
+}
+
+void EvaluationTrace::write_events()
+{
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  /* The file may have been closed since the evaluation started. */
+  if (trace_file == nullptr) {
+    return;
+  }
+
+  const string graph_args = "\"depsgraph\":\"" + json_escape(graph_->debug.name) + "\"";
+  trace_write_event("Evaluation", "depsgraph", start_time_, end_time_, 0, graph_args);
+
+  for (const int i : events_.index_range()) {
+    const OperationEvent &event = events_[i];
+    if (!event.evaluated) {
+      continue;
+    }
+    const OperationNode *operation_node = graph_->operations[i];
+    const string args = graph_args + ",\"id\":\"" +
+                        json_escape(operation_node->owner->owner->name) +
+                        "\",\"critical_path\":" + (event.on_critical_path ? "true" : "false");
+    trace_write_event(operation_node->full_identifier(),
+                      "operation",
+                      event.start_time,
+                      event.end_time,
+                      event.thread_id,
+                      args);
+  }
+  fflush(trace_file);
+}
+
+/** \} */
+
 }  // namespace deg
 }  // namespace blender
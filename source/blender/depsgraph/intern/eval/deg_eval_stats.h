@@ -23,13 +23,61 @@
 
 #pragma once
 
+#include "BLI_array.hh"
+
+#include "intern/depsgraph_type.h"
+
 namespace blender {
 namespace deg {
 
 struct Depsgraph;
+struct OperationNode;
 
 /* Aggregate operation timings to overall component and ID nodes timing. */
 void deg_eval_stats_aggregate(Depsgraph *graph);
 
+/* Start appending evaluation traces to the given file, or stop when it is NULL. */
+bool deg_eval_trace_file_set(const char *filepath);
+bool deg_eval_trace_is_enabled();
+
+/* Timeline of all operations evaluated by a single graph evaluation.
+ *
+ * Once evaluation is finished the critical path (the longest chain of dependent operations) is
+ * computed and a summary printed, and all operations are appended to the trace file in the
+ * Chrome trace event format, which can be opened in chrome://tracing or ui.perfetto.dev. */
+class EvaluationTrace {
+ public:
+  EvaluationTrace(Depsgraph *graph);
+
+  /* Is called from the evaluation threads. */
+  void record(const OperationNode *operation_node, double start_time, double end_time);
+
+  /* Must be called before the update tags are cleared. */
+  void finish();
+
+ protected:
+  struct OperationEvent {
+    double start_time;
+    double end_time;
+    int thread_id;
+    bool evaluated;
+    /* Evaluation time of the longest chain of operations ending in this one. */
+    double path_time;
+    int path_parent;
+    bool on_critical_path;
+  };
+
+  void compute_critical_path();
+  void print_summary();
+  void write_events();
+
+  Depsgraph *graph_;
+  double start_time_;
+  double end_time_;
+  Map<const OperationNode *, int> operation_index_;
+  Array<OperationEvent> events_;
+  int critical_path_end_;
+};
+
 }  // namespace deg
 }  // namespace blender
@@ -265,6 +265,12 @@ struct OperationNode : public Node {
   uint32_t num_links_pending;
   bool scheduled;
 
+  /* Time spent on the last evaluation of this operation, in seconds. */
+  float eval_time;
+  /* Cost of the longest chain of operations depending on this one, including this one.
+   * Ready operations with a higher priority are evaluated first. */
+  float priority;
+
   /* Identifier for the operation being performed. */
   OperationCode opcode;
   int name_tag;
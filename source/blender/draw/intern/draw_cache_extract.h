@@ -231,6 +231,8 @@ typedef struct MeshBatchCache {
   int vert_len;
   int mat_len;
   bool is_dirty; /* Instantly invalidates cache, skipping mesh check */
+  /* Only vertex positions changed, see #BKE_MESH_BATCH_DIRTY_DEFORM. */
+  bool is_deform_dirty;
   bool is_editmode;
   bool is_uvsyncsel;
 
@@ -593,6 +593,51 @@ static void mesh_batch_cache_discard_uvedit_select(MeshBatchCache *cache)
   cache->batch_ready &= ~MBC_EDITUV;
 }
 
+/* Vertex positions changed: extract the buffers depending on them again. They are cleared in
+ * place, so the batches using them stay valid and the index buffers can be kept. */
+static void mesh_batch_cache_deform_update(MeshBatchCache *cache)
+{
+  FOREACH_MESH_BUFFER_CACHE (cache, mbufcache) {
+    GPUVertBuf *vbos[] = {
+        mbufcache->vbo.pos_nor,
+        mbufcache->vbo.lnor,
+        mbufcache->vbo.edge_fac,
+        mbufcache->vbo.tan,
+        mbufcache->vbo.stretch_area,
+        mbufcache->vbo.stretch_angle,
+        mbufcache->vbo.mesh_analysis,
+        mbufcache->vbo.fdots_pos,
+        mbufcache->vbo.fdots_nor,
+    };
+    for (int i = 0; i < ARRAY_SIZE(vbos); i++) {
+      if (vbos[i] != NULL) {
+        GPU_vertbuf_clear(vbos[i]);
+        /* Tag as requested. */
+        GPU_vertbuf_init(vbos[i], GPU_USAGE_STATIC);
+      }
+    }
+  }
+
+  /* Vertex array objects still reference the freed vertex buffers. */
+  for (int i = 0; i < sizeof(cache->batch) / sizeof(void *); i++) {
+    GPUBatch *batch = ((GPUBatch **)&cache->batch)[i];
+    if (batch != NULL) {
+      GPU_batch_vao_cache_clear(batch);
+    }
+  }
+  if (cache->surface_per_mat) {
+    for (int i = 0; i < cache->mat_len; i++) {
+      if (cache->surface_per_mat[i] != NULL) {
+        GPU_batch_vao_cache_clear(cache->surface_per_mat[i]);
+      }
+    }
+  }
+
+  cache->tot_area = 0.0f;
+  cache->tot_uv_area = 0.0f;
+  cache->is_deform_dirty = false;
+}
+
 void DRW_mesh_batch_cache_dirty_tag(Mesh *me, int mode)
 {
   MeshBatchCache *cache = me->runtime.batch_cache;
@@ -642,6 +687,10 @@ void DRW_mesh_batch_cache_dirty_tag(Mesh *me, int mode)
     case BKE_MESH_BATCH_DIRTY_ALL:
       cache->is_dirty = true;
       break;
+    case BKE_MESH_BATCH_DIRTY_DEFORM:
+      /* Buffers are updated from the drawing thread, see #mesh_batch_cache_deform_update. */
+      cache->is_deform_dirty = true;
+      break;
     case BKE_MESH_BATCH_DIRTY_SHADING:
       mesh_batch_cache_discard_shaded_tri(cache);
       mesh_batch_cache_discard_uvedit(cache);
@@ -1139,6 +1188,10 @@ void DRW_mesh_batch_cache_create_requested(struct TaskGraph *task_graph,
   DRWBatchFlag batch_requested = cache->batch_requested;
   cache->batch_requested = 0;
 
+  if (cache->is_deform_dirty) {
+    mesh_batch_cache_deform_update(cache);
+  }
+
   if (batch_requested & MBC_SURFACE_WEIGHTS) {
     /* Check vertex weights. */
     if ((cache->batch.surface_weights != NULL) && (ts != NULL)) {
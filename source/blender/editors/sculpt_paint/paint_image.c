@@ -176,6 +176,9 @@ void imapaint_image_update(
     ibuf->userflags |= IB_MIPMAP_INVALID;
   }
 
+  /* Pixels were written after the region was tagged dirty. */
+  IMB_tag_changed(ibuf);
+
   /* todo: should set_tpage create ->rect? */
   if (texpaint || (sima && sima->lock)) {
     int w = imapaintpartial.x2 - imapaintpartial.x1;
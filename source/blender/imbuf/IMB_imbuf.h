@@ -164,6 +164,14 @@ struct ImBuf *IMB_allocFromBuffer(const unsigned int *rect,
 void IMB_refImBuf(struct ImBuf *ibuf);
 struct ImBuf *IMB_makeSingleUser(struct ImBuf *ibuf);
 
+/**
+ * Assign a new unique change timestamp, to be called after modifying the pixels in place.
+ * Lets users of the buffer detect changes, also when a new buffer reuses the same address.
+ *
+ * ttention Defined in allocimbuf.c
+ */
+void IMB_tag_changed(struct ImBuf *ibuf);
+
 /**
  *
  * \attention Defined in allocimbuf.c
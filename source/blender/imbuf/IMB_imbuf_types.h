@@ -237,6 +237,8 @@ typedef struct ImBuf {
   int index;
   /** used to set imbuf to dirty and other stuff */
   int userflags;
+  /** unique value assigned whenever the pixels change, see #IMB_tag_changed */
+  unsigned int changed_timestamp;
   /** image metadata */
   struct IDProperty *metadata;
   /** temporary storage */
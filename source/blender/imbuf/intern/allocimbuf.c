@@ -41,7 +41,10 @@
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
+#include "atomic_ops.h"
+
 static SpinLock refcounter_spin;
+static uint32_t changed_timestamp = 0;
 
 void imb_refcounter_lock_init(void)
 {
@@ -243,6 +246,11 @@ void IMB_refImBuf(ImBuf *ibuf)
   BLI_spin_unlock(&refcounter_spin);
 }
 
+void IMB_tag_changed(ImBuf *ibuf)
+{
+  ibuf->changed_timestamp = atomic_add_and_fetch_uint32(&changed_timestamp, 1);
+}
+
 ImBuf *IMB_makeSingleUser(ImBuf *ibuf)
 {
   ImBuf *rval;
@@ -497,6 +505,7 @@ bool IMB_initImBuf(
 {
   memset(ibuf, 0, sizeof(ImBuf));
 
+  IMB_tag_changed(ibuf);
   ibuf->x = x;
   ibuf->y = y;
   ibuf->planes = planes;
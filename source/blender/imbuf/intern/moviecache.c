@@ -23,13 +23,18 @@
 
 #undef DEBUG_MESSAGES
 
+#include <limits.h>
 #include <memory.h>
 #include <stdlib.h> /* for qsort */
 
 #include "MEM_CacheLimiterC-Api.h"
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_ghash.h"
+#include "BLI_listbase.h"
+#include "BLI_math_base.h"
 #include "BLI_mempool.h"
 #include "BLI_string.h"
 #include "BLI_threads.h"
@@ -53,6 +58,27 @@
 static MEM_CacheLimiterC *limitor = NULL;
 static pthread_mutex_t limitor_lock = BLI_MUTEX_INITIALIZER;
 
+/* Items of caches using more memory than their budget are freed first,
+ * so caches within their budget don't lose items to one filling the memory. */
+#define MOVIECACHE_OVER_BUDGET_PRIORITY (INT_MIN / 2)
+/* Scale of priorities, so weighting by reload cost doesn't lose precision. */
+#define MOVIECACHE_PRIORITY_SCALE 16
+
+/* Budget shared by all caches with the same name, e.g. the caches of all images,
+ * so it limits the memory used by that type of cache rather than by a single cache. */
+typedef struct MovieCacheBudget {
+  struct MovieCacheBudget *next, *prev;
+  char name[64];
+
+  /* Memory used by the items of all the caches sharing the budget. */
+  size_t memory_used;
+  /* Fraction of the global cache limit the caches should stay within together. */
+  float budget;
+} MovieCacheBudget;
+
+static ListBase budgets = {NULL, NULL};
+static ThreadMutex budgets_lock = BLI_MUTEX_INITIALIZER;
+
 typedef struct MovieCache {
   char name[64];
 
@@ -73,6 +99,11 @@ typedef struct MovieCache {
 
   void *last_userkey;
 
+  /* Memory used by the items. */
+  size_t memory_used;
+  /* Budget shared with the other caches of the same type, NULL when unlimited. */
+  MovieCacheBudget *budget;
+
   int totseg, *points, proxy, render_flags; /* for visual statistics optimization */
   int pad;
 } MovieCache;
@@ -87,8 +118,29 @@ typedef struct MovieCacheItem {
   ImBuf *ibuf;
   MEM_CacheLimiterHandleC *c_handle;
   void *priority_data;
+  /* Size accounted in #MovieCache.memory_used. */
+  size_t size;
+  /* Factor for the item priority, higher for items which are cheap to reload
+   * compared to the memory they use, see #get_item_evict_weight. */
+  float evict_weight;
 } MovieCacheItem;
 
+static void moviecache_memory_add(MovieCache *cache, size_t size)
+{
+  atomic_add_and_fetch_z(&cache->memory_used, size);
+  if (cache->budget) {
+    atomic_add_and_fetch_z(&cache->budget->memory_used, size);
+  }
+}
+
+static void moviecache_memory_sub(MovieCache *cache, size_t size)
+{
+  atomic_sub_and_fetch_z(&cache->memory_used, size);
+  if (cache->budget) {
+    atomic_sub_and_fetch_z(&cache->budget->memory_used, size);
+  }
+}
+
 static unsigned int moviecache_hashhash(const void *keyv)
 {
   const MovieCacheKey *key = keyv;
@@ -123,6 +175,7 @@ static void moviecache_valfree(void *val)
   if (item->ibuf) {
     MEM_CacheLimiter_unmanage(item->c_handle);
     IMB_freeImBuf(item->ibuf);
+    moviecache_memory_sub(cache, item->size);
   }
 
   if (item->priority_data && cache->prioritydeleterfp) {
@@ -174,6 +227,7 @@ static void IMB_moviecache_destructor(void *p)
     PRINT("%s: cache '%s' destroy item %p buffer %p\n", __func__, cache->name, item, item->ibuf);
 
     IMB_freeImBuf(item->ibuf);
+    moviecache_memory_sub(cache, item->size);
 
     item->ibuf = NULL;
     item->c_handle = NULL;
@@ -208,6 +262,69 @@ static size_t get_item_size(void *p)
   return size;
 }
 
+/**
+ * Rough relative cost of reloading an image per pixel, depending on the file format.
+ * High bit depth and float formats are slow to decode (and their files slow to read),
+ * while 8 bit formats (as used for proxies) are cheap.
+ */
+static float get_item_reload_cost(const ImBuf *ibuf)
+{
+  switch (ibuf->ftype) {
+    case IMB_FTYPE_OPENEXR:
+      return 16.0f;
+#ifdef WITH_CINEON
+    case IMB_FTYPE_DPX:
+    case IMB_FTYPE_CINEON:
+      return 8.0f;
+#endif
+#ifdef WITH_HDR
+    case IMB_FTYPE_RADHDR:
+      return 8.0f;
+#endif
+#ifdef WITH_TIFF
+    case IMB_FTYPE_TIF:
+      return 6.0f;
+#endif
+#ifdef WITH_OPENJPEG
+    case IMB_FTYPE_JP2:
+      return 6.0f;
+#endif
+    case IMB_FTYPE_PNG:
+      return 4.0f;
+    case IMB_FTYPE_JPG:
+      return 1.0f;
+    default:
+      break;
+  }
+
+  /* Other formats and frames decoded from movie files (which may need seeking). */
+  return 2.0f;
+}
+
+/* Memory used per pixel relative to the reload cost, normalized so 8 bit JPEG images are 1. */
+static float get_item_evict_weight(const ImBuf *ibuf, size_t size)
+{
+  const size_t num_pixels = (size_t)ibuf->x * (size_t)ibuf->y;
+
+  if (num_pixels == 0 || size == 0) {
+    return 1.0f;
+  }
+
+  const float bytes_per_pixel = (float)size / (float)num_pixels;
+  return (bytes_per_pixel / 4.0f) / get_item_reload_cost(ibuf);
+}
+
+static bool moviecache_is_over_budget(const MovieCache *cache)
+{
+  const MovieCacheBudget *budget = cache->budget;
+  if (budget == NULL || budget->budget >= 1.0f) {
+    return false;
+  }
+
+  const size_t limit = (size_t)((double)MEM_CacheLimiter_get_maximum() * budget->budget);
+  return budget->memory_used > limit;
+}
+
 static int get_item_priority(void *item_v, int default_priority)
 {
   MovieCacheItem *item = (MovieCacheItem *)item_v;
@@ -221,10 +338,20 @@ static int get_item_priority(void *item_v, int default_priority)
           item,
           default_priority);
 
-    return default_priority;
+    priority = default_priority;
+  }
+  else {
+    priority = cache->getitempriorityfp(cache->last_userkey, item->priority_data);
   }
 
-  priority = cache->getitempriorityfp(cache->last_userkey, item->priority_data);
+  /* Lower priority items are freed first: of items equally far from the current frame,
+   * free ones which use most memory for their reload cost first. */
+  float weighted_priority = (float)priority * MOVIECACHE_PRIORITY_SCALE * item->evict_weight;
+  priority = (int)max_ff(weighted_priority, (float)(MOVIECACHE_OVER_BUDGET_PRIORITY / 2));
+
+  if (moviecache_is_over_budget(cache)) {
+    priority += MOVIECACHE_OVER_BUDGET_PRIORITY;
+  }
 
   PRINT("%s: cache '%s' item %p priority %d\n", __func__, cache->name, item, priority);
 
@@ -258,6 +385,7 @@ void IMB_moviecache_destruct(void)
   if (limitor) {
     delete_MEM_CacheLimiter(limitor);
   }
+  BLI_freelistN(&budgets);
 }
 
 MovieCache *IMB_moviecache_create(const char *name,
@@ -304,6 +432,30 @@ void IMB_moviecache_set_priority_callback(struct MovieCache *cache,
   cache->prioritydeleterfp = prioritydeleterfp;
 }
 
+/**
+ * Set the fraction of the global cache limit the caches with the name of this one are expected
+ * to stay within together. When memory runs out, items of caches exceeding their budget are
+ * freed first.
+ */
+void IMB_moviecache_set_budget(MovieCache *cache, float budget)
+{
+  BLI_mutex_lock(&budgets_lock);
+  MovieCacheBudget *cache_budget = BLI_findstring(
+      &budgets, cache->name, offsetof(MovieCacheBudget, name));
+  if (cache_budget == NULL) {
+    cache_budget = MEM_callocN(sizeof(MovieCacheBudget), "MovieCacheBudget");
+    BLI_strncpy(cache_budget->name, cache->name, sizeof(cache_budget->name));
+    BLI_addtail(&budgets, cache_budget);
+  }
+  cache_budget->budget = budget;
+
+  if (cache->budget == NULL) {
+    cache->budget = cache_budget;
+    atomic_add_and_fetch_z(&cache_budget->memory_used, cache->memory_used);
+  }
+  BLI_mutex_unlock(&budgets_lock);
+}
+
 static void do_moviecache_put(MovieCache *cache, void *userkey, ImBuf *ibuf, bool need_lock)
 {
   MovieCacheKey *key;
@@ -328,6 +480,9 @@ static void do_moviecache_put(MovieCache *cache, void *userkey, ImBuf *ibuf, boo
   item->cache_owner = cache;
   item->c_handle = NULL;
   item->priority_data = NULL;
+  item->size = get_size_in_memory(ibuf);
+  item->evict_weight = get_item_evict_weight(ibuf, item->size);
+  moviecache_memory_add(cache, item->size);
 
   if (cache->getprioritydatafp) {
     item->priority_data = cache->getprioritydatafp(userkey);
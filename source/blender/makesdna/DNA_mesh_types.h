@@ -123,7 +123,13 @@ typedef struct Mesh_Runtime {
    */
   char wrapper_type_finalize;
 
-  char _pad[4];
+  /**
+   * The batch cache was taken from the previous evaluated mesh, which only differed in vertex
+   * positions and normals (see #BKE_object_batch_cache_dirty_tag).
+   */
+  char is_batch_cache_deform_update;
+
+  char _pad[3];
 
   /** Needed in case we need to lazily initialize the mesh. */
   CustomData_MeshMasks cd_mask_extra;
@@ -151,6 +151,10 @@ typedef struct RenderResult {
   /* for acquire image, to indicate if it there is a combined layer */
   int have_combined;
 
+  /* unique value assigned whenever passes are allocated or written, so users can detect
+   * changes also when a new result reuses the same memory */
+  unsigned int changed_timestamp;
+
   /* render info text */
   char *text;
   char *error;
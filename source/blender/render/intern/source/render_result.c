@@ -28,6 +28,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_ghash.h"
 #include "BLI_hash_md5.h"
 #include "BLI_listbase.h"
@@ -285,6 +287,13 @@ RenderPass *render_layer_add_pass(RenderResult *rr,
 /* will read info from Render *re to define layers */
 /* called in threads */
 /* re->winx,winy is coordinate space of entire image, partrct the part within */
+static uint32_t render_result_changed_timestamp = 0;
+
+static void render_result_tag_changed(RenderResult *rr)
+{
+  rr->changed_timestamp = atomic_add_and_fetch_uint32(&render_result_changed_timestamp, 1);
+}
+
 RenderResult *render_result_new(Render *re,
                                 rcti *partrct,
                                 int crop,
@@ -305,6 +314,7 @@ RenderResult *render_result_new(Render *re,
   }
 
   rr = MEM_callocN(sizeof(RenderResult), "new render result");
+  render_result_tag_changed(rr);
   rr->rectx = rectx;
   rr->recty = recty;
   rr->renrect.xmin = 0;
@@ -757,6 +767,7 @@ RenderResult *render_result_new_from_exr(
 
   rr->rectx = rectx;
   rr->recty = recty;
+  render_result_tag_changed(rr);
 
   IMB_exr_multilayer_convert(exrhandle, rr, ml_addview_cb, ml_addlayer_cb, ml_addpass_cb);
 
@@ -888,6 +899,8 @@ void render_result_merge(RenderResult *rr, RenderResult *rrpart)
       }
     }
   }
+
+  render_result_tag_changed(rr);
 }
 
 /* Called from the UI and render pipeline, to save multilayer and multiview
@@ -1383,6 +1396,8 @@ int render_result_exr_file_read_path(RenderResult *rr,
   IMB_exr_read_channels(exrhandle);
   IMB_exr_close(exrhandle);
 
+  render_result_tag_changed(rr);
+
   return 1;
 }
 
@@ -1605,6 +1605,47 @@ void WM_autosave_init(wmWindowManager *wm)
   }
 }
 
+typedef struct AutosaveJob {
+  char filepath[FILE_MAX];
+  /** Copy of the undo memfile, undo steps may be freed while writing. */
+  MemFile memfile;
+} AutosaveJob;
+
+static void wm_autosave_job_startjob(void *customdata,
+                                     short *UNUSED(stop),
+                                     short *UNUSED(do_update),
+                                     float *UNUSED(progress))
+{
+  AutosaveJob *autosave_job = customdata;
+  BLO_memfile_write_file(&autosave_job->memfile, autosave_job->filepath);
+}
+
+static void wm_autosave_job_free(void *customdata)
+{
+  AutosaveJob *autosave_job = customdata;
+  BLO_memfile_free(&autosave_job->memfile);
+  MEM_freeN(autosave_job);
+}
+
+/**
+ * Write the undo memfile from a job, so big files don't freeze the interface while saving.
+ * Copying the memfile is much faster than writing it to disk.
+ */
+static void wm_autosave_write_memfile_job(wmWindowManager *wm,
+                                          MemFile *memfile,
+                                          const char *filepath)
+{
+  AutosaveJob *autosave_job = MEM_callocN(sizeof(*autosave_job), __func__);
+  BLI_strncpy(autosave_job->filepath, filepath, sizeof(autosave_job->filepath));
+  BLO_memfile_snapshot(memfile, &autosave_job->memfile);
+
+  wmJob *wm_job = WM_jobs_get(wm, wm->winactive, wm, "Autosave", 0, WM_JOB_TYPE_AUTOSAVE);
+  WM_jobs_customdata_set(wm_job, autosave_job, wm_autosave_job_free);
+  WM_jobs_timer(wm_job, 0.5, 0, 0);
+  WM_jobs_callbacks(wm_job, wm_autosave_job_startjob, NULL, NULL, NULL);
+  WM_jobs_start(wm, wm_job);
+}
+
 void wm_autosave_timer(Main *bmain, wmWindowManager *wm, wmTimer *UNUSED(wt))
 {
   char filepath[FILE_MAX];
@@ -1630,8 +1671,10 @@ void wm_autosave_timer(Main *bmain, wmWindowManager *wm, wmTimer *UNUSED(wt))
   if (U.uiflag & USER_GLOBALUNDO) {
     /* fast save of last undobuffer, now with UI */
     struct MemFile *memfile = ED_undosys_stack_memfile_get_active(wm->undo_stack);
-    if (memfile) {
-      BLO_memfile_write_file(memfile, filepath);
+    /* Skip when the previous autosave is still being written (slow drive for e.g.),
+     * the timer is added again below. */
+    if (memfile && !WM_jobs_test(wm, wm, WM_JOB_TYPE_AUTOSAVE)) {
+      wm_autosave_write_memfile_job(wm, memfile, filepath);
     }
   }
   else {
@@ -598,6 +598,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph-no-threads");
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph-time");
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph-pretty");
+  BLI_argsPrintArgDoc(ba, "--debug-depsgraph-trace");
   BLI_argsPrintArgDoc(ba, "--debug-gpu");
   BLI_argsPrintArgDoc(ba, "--debug-gpumem");
   BLI_argsPrintArgDoc(ba, "--debug-gpu-shaders");
@@ -981,6 +982,24 @@ static const char arg_handle_debug_mode_generic_set_doc_depsgraph_no_threads[] =
 static const char arg_handle_debug_mode_generic_set_doc_depsgraph_pretty[] =
     "\n\t"
     "Enable colors for dependency graph debug messages.";
+static const char arg_handle_debug_depsgraph_trace_set_doc[] =
+    "<filepath>\n"
+    "\tWrite the timeline of all dependency graph evaluations to <filepath>,\n"
+    "\tand print a summary of their critical path. The file can be opened in chrome://tracing.";
+static int arg_handle_debug_depsgraph_trace_set(int argc,
+                                                const char **argv,
+                                                void *UNUSED(data))
+{
+  if (argc > 1) {
+    DEG_debug_eval_trace_file_set(argv[1]);
+    return 1;
+  }
+  else {
+    printf("\nError: you must specify a path after '--debug-depsgraph-trace'.\n");
+    return 0;
+  }
+}
+
 static const char arg_handle_debug_mode_generic_set_doc_gpumem[] =
     "\n\t"
     "Enable GPU memory stats in status bar.";
@@ -2203,6 +2222,12 @@ void main_args_setup(bContext *C, bArgs *ba)
               "--debug-depsgraph-pretty",
               CB_EX(arg_handle_debug_mode_generic_set, depsgraph_pretty),
               (void *)G_DEBUG_DEPSGRAPH_PRETTY);
+  BLI_argsAdd(ba,
+              1,
+              NULL,
+              "--debug-depsgraph-trace",
+              CB(arg_handle_debug_depsgraph_trace_set),
+              NULL);
   BLI_argsAdd(ba,
               1,
               NULL,
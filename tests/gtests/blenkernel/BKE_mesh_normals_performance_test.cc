@@ -0,0 +1,410 @@
+/* Apache License, Version 2.0 */
+#include "testing/testing.h"
+
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_alloca.h"
+#include "BLI_math.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_mesh.h"
+
+#include "DNA_meshdata_types.h"
+
+#include "PIL_time.h"
+}
+
+#define NUM_RUN_AVERAGED 5
+
+/* Quads around the torus in both directions, 2048 * 1024 quads give about 8M loops. */
+#define TORUS_SEGMENTS_U 2048
+#define TORUS_SEGMENTS_V 1024
+
+/* Triangles around the tip of the cone, a single vertex with that many loops. */
+#define CONE_SEGMENTS (1 << 20)
+
+/* Previous implementation of #BKE_mesh_calc_normals_poly: threaded poly normals and loop
+ * weights, with a single threaded accumulation of the loop normals into the vertices. */
+struct ReferenceNormalsData {
+  const MPoly *mpolys;
+  const MLoop *mloop;
+  MVert *mverts;
+  float (*pnors)[3];
+  float (*lnors_weighted)[3];
+  float (*vnors)[3];
+};
+
+static void reference_normals_prepare_cb(void *__restrict userdata,
+                                         const int pidx,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ReferenceNormalsData *data = (ReferenceNormalsData *)userdata;
+  const MPoly *mp = &data->mpolys[pidx];
+  const MLoop *ml = &data->mloop[mp->loopstart];
+  const MVert *mverts = data->mverts;
+  float *pnor = data->pnors[pidx];
+
+  const int nverts = mp->totloop;
+  float(*edgevecbuf)[3] = BLI_array_alloca(edgevecbuf, (size_t)nverts);
+
+  int i_prev = nverts - 1;
+  const float *v_prev = mverts[ml[i_prev].v].co;
+  zero_v3(pnor);
+  for (int i = 0; i < nverts; i++) {
+    const float *v_curr = mverts[ml[i].v].co;
+    add_newell_cross_v3_v3v3(pnor, v_prev, v_curr);
+    sub_v3_v3v3(edgevecbuf[i_prev], v_prev, v_curr);
+    normalize_v3(edgevecbuf[i_prev]);
+    i_prev = i;
+    v_prev = v_curr;
+  }
+  if (UNLIKELY(normalize_v3(pnor) == 0.0f)) {
+    pnor[2] = 1.0f;
+  }
+
+  const float *prev_edge = edgevecbuf[nverts - 1];
+  for (int i = 0; i < nverts; i++) {
+    const float *cur_edge = edgevecbuf[i];
+    const float fac = saacos(-dot_v3v3(cur_edge, prev_edge));
+    mul_v3_v3fl(data->lnors_weighted[mp->loopstart + i], pnor, fac);
+    prev_edge = cur_edge;
+  }
+}
+
+static void reference_normals_finalize_cb(void *__restrict userdata,
+                                          const int vidx,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ReferenceNormalsData *data = (ReferenceNormalsData *)userdata;
+  MVert *mv = &data->mverts[vidx];
+  float *no = data->vnors[vidx];
+
+  if (UNLIKELY(normalize_v3(no) == 0.0f)) {
+    normalize_v3_v3(no, mv->co);
+  }
+  normal_float_to_short_v3(mv->no, no);
+}
+
+/**
+ * Closed quad torus, with a wavy minor radius so auto-smooth splits some of the edges.
+ * All polygons are smooth, so without splitting every fan is cyclic.
+ */
+class MeshNormalsPerformanceTest : public testing::Test {
+ protected:
+  MVert *mverts = nullptr;
+  MEdge *medges = nullptr;
+  MLoop *mloops = nullptr;
+  MPoly *mpolys = nullptr;
+  float (*polynors)[3] = nullptr;
+  int numVerts = 0, numEdges = 0, numLoops = 0, numPolys = 0;
+
+  void SetUp() override
+  {
+    BLI_threadapi_init();
+  }
+
+  void TearDown() override
+  {
+    free_mesh();
+    BLI_threadapi_exit();
+  }
+
+  void free_mesh()
+  {
+    MEM_SAFE_FREE(mverts);
+    MEM_SAFE_FREE(medges);
+    MEM_SAFE_FREE(mloops);
+    MEM_SAFE_FREE(mpolys);
+    MEM_SAFE_FREE(polynors);
+  }
+
+  void build_torus(const int segments_u, const int segments_v)
+  {
+    numVerts = segments_u * segments_v;
+    numEdges = numVerts * 2;
+    numPolys = numVerts;
+    numLoops = numPolys * 4;
+
+    mverts = (MVert *)MEM_calloc_arrayN(numVerts, sizeof(*mverts), __func__);
+    medges = (MEdge *)MEM_calloc_arrayN(numEdges, sizeof(*medges), __func__);
+    mloops = (MLoop *)MEM_calloc_arrayN(numLoops, sizeof(*mloops), __func__);
+    mpolys = (MPoly *)MEM_calloc_arrayN(numPolys, sizeof(*mpolys), __func__);
+    polynors = (float(*)[3])MEM_malloc_arrayN(numPolys, sizeof(*polynors), __func__);
+
+    for (int v = 0; v < segments_v; v++) {
+      for (int u = 0; u < segments_u; u++) {
+        const int index = v * segments_u + u;
+        const int u_next = (u + 1) % segments_u;
+        const int v_next = (v + 1) % segments_v;
+
+        const float angle_u = (float)(2.0 * M_PI) * u / segments_u;
+        const float angle_v = (float)(2.0 * M_PI) * v / segments_v;
+        const float radius = 0.25f + 0.05f * sinf(angle_u * 64.0f) * cosf(angle_v * 16.0f);
+        float *co = mverts[index].co;
+        co[0] = (1.0f + radius * cosf(angle_v)) * cosf(angle_u);
+        co[1] = (1.0f + radius * cosf(angle_v)) * sinf(angle_u);
+        co[2] = radius * sinf(angle_v);
+
+        /* Edge along u, then edge along v, from each vertex. */
+        MEdge *me_u = &medges[index];
+        me_u->v1 = index;
+        me_u->v2 = v * segments_u + u_next;
+        MEdge *me_v = &medges[numVerts + index];
+        me_v->v1 = index;
+        me_v->v2 = v_next * segments_u + u;
+
+        MPoly *mp = &mpolys[index];
+        mp->loopstart = index * 4;
+        mp->totloop = 4;
+        mp->flag = ME_SMOOTH;
+
+        MLoop *ml = &mloops[mp->loopstart];
+        ml[0].v = index;
+        ml[0].e = index;
+        ml[1].v = v * segments_u + u_next;
+        ml[1].e = numVerts + v * segments_u + u_next;
+        ml[2].v = v_next * segments_u + u_next;
+        ml[2].e = v_next * segments_u + u;
+        ml[3].v = v_next * segments_u + u;
+        ml[3].e = numVerts + index;
+      }
+    }
+
+    BKE_mesh_calc_normals_poly(
+        mverts, nullptr, numVerts, mloops, mpolys, numLoops, numPolys, polynors, false);
+  }
+
+  /**
+   * Open cone made of triangles, all smooth. The tip is a cyclic smooth fan of `segments` loops,
+   * with loop indices increasing around it.
+   */
+  void build_cone(const int segments)
+  {
+    numVerts = segments + 1;
+    numEdges = segments * 2;
+    numPolys = segments;
+    numLoops = numPolys * 3;
+    const int tip = segments;
+
+    mverts = (MVert *)MEM_calloc_arrayN(numVerts, sizeof(*mverts), __func__);
+    medges = (MEdge *)MEM_calloc_arrayN(numEdges, sizeof(*medges), __func__);
+    mloops = (MLoop *)MEM_calloc_arrayN(numLoops, sizeof(*mloops), __func__);
+    mpolys = (MPoly *)MEM_calloc_arrayN(numPolys, sizeof(*mpolys), __func__);
+    polynors = (float(*)[3])MEM_malloc_arrayN(numPolys, sizeof(*polynors), __func__);
+
+    copy_v3_fl3(mverts[tip].co, 0.0f, 0.0f, 1.0f);
+    for (int i = 0; i < segments; i++) {
+      const int i_next = (i + 1) % segments;
+      const float angle = (float)(2.0 * M_PI) * i / segments;
+      copy_v3_fl3(mverts[i].co, cosf(angle), sinf(angle), 0.0f);
+
+      /* Edge along the base, then edge to the tip, from each base vertex. */
+      medges[i].v1 = i;
+      medges[i].v2 = i_next;
+      medges[segments + i].v1 = i;
+      medges[segments + i].v2 = tip;
+
+      MPoly *mp = &mpolys[i];
+      mp->loopstart = i * 3;
+      mp->totloop = 3;
+      mp->flag = ME_SMOOTH;
+
+      MLoop *ml = &mloops[mp->loopstart];
+      ml[0].v = i;
+      ml[0].e = i;
+      ml[1].v = i_next;
+      ml[1].e = segments + i_next;
+      ml[2].v = tip;
+      ml[2].e = segments + i;
+    }
+
+    BKE_mesh_calc_normals_poly(
+        mverts, nullptr, numVerts, mloops, mpolys, numLoops, numPolys, polynors, false);
+  }
+
+  double calc_vert_normals(float (*r_vertnors)[3])
+  {
+    const double init_time = PIL_check_seconds_timer();
+    BKE_mesh_calc_normals_poly(
+        mverts, r_vertnors, numVerts, mloops, mpolys, numLoops, numPolys, polynors, false);
+    return PIL_check_seconds_timer() - init_time;
+  }
+
+  /* Previous threaded implementation of #BKE_mesh_calc_normals_poly, for comparison. */
+  double calc_vert_normals_reference(float (*r_vertnors)[3])
+  {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1024;
+
+    const double init_time = PIL_check_seconds_timer();
+    float(*lnors_weighted)[3] = (float(*)[3])MEM_malloc_arrayN(
+        (size_t)numLoops, sizeof(*lnors_weighted), __func__);
+    memset(r_vertnors, 0, sizeof(*r_vertnors) * (size_t)numVerts);
+
+    ReferenceNormalsData data = {mpolys, mloops, mverts, polynors, lnors_weighted, r_vertnors};
+
+    BLI_task_parallel_range(0, numPolys, &data, reference_normals_prepare_cb, &settings);
+    for (int lidx = 0; lidx < numLoops; lidx++) {
+      add_v3_v3(r_vertnors[mloops[lidx].v], lnors_weighted[lidx]);
+    }
+    BLI_task_parallel_range(0, numVerts, &data, reference_normals_finalize_cb, &settings);
+
+    MEM_freeN(lnors_weighted);
+    return PIL_check_seconds_timer() - init_time;
+  }
+
+  double calc_loop_normals(float (*r_loopnors)[3],
+                           const float split_angle,
+                           const bool use_spaces,
+                           short (*clnors_data)[2])
+  {
+    MLoopNorSpaceArray lnors_spacearr = {nullptr};
+    const double init_time = PIL_check_seconds_timer();
+    BKE_mesh_normals_loop_split(mverts,
+                                numVerts,
+                                medges,
+                                numEdges,
+                                mloops,
+                                r_loopnors,
+                                numLoops,
+                                mpolys,
+                                polynors,
+                                numPolys,
+                                true,
+                                split_angle,
+                                use_spaces ? &lnors_spacearr : nullptr,
+                                clnors_data,
+                                nullptr);
+    const double time = PIL_check_seconds_timer() - init_time;
+    if (use_spaces) {
+      BKE_lnor_spacearr_free(&lnors_spacearr);
+    }
+    return time;
+  }
+};
+
+TEST_F(MeshNormalsPerformanceTest, CalcNormalsPoly)
+{
+  /* About 1M, 8M and 32M vertices, bigger meshes only measure the memory bandwidth. */
+  const int segments[][2] = {{1024, 1024}, {4096, 2048}, {8192, 4096}};
+
+  for (int size = 0; size < (int)ARRAY_SIZE(segments); size++) {
+    build_torus(segments[size][0], segments[size][1]);
+    float(*vertnors)[3] = (float(*)[3])MEM_malloc_arrayN(numVerts, sizeof(*vertnors), __func__);
+    float(*ref_vertnors)[3] = (float(*)[3])MEM_malloc_arrayN(
+        numVerts, sizeof(*ref_vertnors), __func__);
+
+    double timing = 0.0, ref_timing = 0.0;
+    for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+      timing += calc_vert_normals(vertnors);
+      ref_timing += calc_vert_normals_reference(ref_vertnors);
+    }
+
+    for (int mv_index = 0; mv_index < numVerts; mv_index++) {
+      ASSERT_NEAR(dot_v3v3(vertnors[mv_index], ref_vertnors[mv_index]), 1.0f, 1e-4f);
+    }
+
+    printf("\t%d vertices: %fs, previous implementation: %fs on average over %d runs\n",
+           numVerts,
+           timing / NUM_RUN_AVERAGED,
+           ref_timing / NUM_RUN_AVERAGED,
+           NUM_RUN_AVERAGED);
+
+    MEM_freeN(vertnors);
+    MEM_freeN(ref_vertnors);
+    free_mesh();
+  }
+}
+
+TEST_F(MeshNormalsPerformanceTest, LoopSplitSmooth)
+{
+  build_torus(TORUS_SEGMENTS_U, TORUS_SEGMENTS_V);
+  float(*loopnors)[3] = (float(*)[3])MEM_malloc_arrayN(numLoops, sizeof(*loopnors), __func__);
+
+  double timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    timing += calc_loop_normals(loopnors, (float)M_PI, false, nullptr);
+  }
+
+  /* Without any sharp edge, every loop gets the normal of its vertex. */
+  for (int ml_index = 0; ml_index < numLoops; ml_index++) {
+    float vnor[3];
+    normal_short_to_float_v3(vnor, mverts[mloops[ml_index].v].no);
+    ASSERT_NEAR(dot_v3v3(loopnors[ml_index], vnor), 1.0f, 1e-3f);
+  }
+
+  printf("\t%d loops, all smooth: %fs on average over %d runs\n",
+         numLoops,
+         timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  MEM_freeN(loopnors);
+}
+
+TEST_F(MeshNormalsPerformanceTest, LoopSplitAutoSmooth)
+{
+  build_torus(TORUS_SEGMENTS_U, TORUS_SEGMENTS_V);
+  float(*loopnors)[3] = (float(*)[3])MEM_malloc_arrayN(numLoops, sizeof(*loopnors), __func__);
+  float(*custom_loopnors)[3] = (float(*)[3])MEM_malloc_arrayN(
+      numLoops, sizeof(*custom_loopnors), __func__);
+  short(*clnors_data)[2] = (short(*)[2])MEM_calloc_arrayN(
+      numLoops, sizeof(*clnors_data), __func__);
+
+  double timing = 0.0, spaces_timing = 0.0, custom_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    timing += calc_loop_normals(loopnors, DEG2RADF(10.0f), false, nullptr);
+    spaces_timing += calc_loop_normals(loopnors, DEG2RADF(10.0f), true, nullptr);
+    /* Custom normals disable the angle check, all loops are smooth again. */
+    custom_timing += calc_loop_normals(custom_loopnors, DEG2RADF(10.0f), true, clnors_data);
+  }
+
+  /* Zero custom normal data means using the automatic normal. */
+  calc_loop_normals(loopnors, (float)M_PI, false, nullptr);
+  for (int ml_index = 0; ml_index < numLoops; ml_index++) {
+    ASSERT_NEAR(dot_v3v3(loopnors[ml_index], custom_loopnors[ml_index]), 1.0f, 1e-4f);
+  }
+
+  printf("\t%d loops, auto smooth: %fs, with spaces: %fs, with custom normals: %fs "
+         "on average over %d runs\n",
+         numLoops,
+         timing / NUM_RUN_AVERAGED,
+         spaces_timing / NUM_RUN_AVERAGED,
+         custom_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  MEM_freeN(loopnors);
+  MEM_freeN(custom_loopnors);
+  MEM_freeN(clnors_data);
+}
+
+TEST_F(MeshNormalsPerformanceTest, LoopSplitHighValence)
+{
+  build_cone(CONE_SEGMENTS);
+  float(*loopnors)[3] = (float(*)[3])MEM_malloc_arrayN(numLoops, sizeof(*loopnors), __func__);
+
+  double timing = 0.0, spaces_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    timing += calc_loop_normals(loopnors, DEG2RADF(30.0f), false, nullptr);
+    spaces_timing += calc_loop_normals(loopnors, DEG2RADF(30.0f), true, nullptr);
+  }
+
+  /* The tip is a single smooth fan, its normal points up. */
+  const float up[3] = {0.0f, 0.0f, 1.0f};
+  for (int mp_index = 0; mp_index < numPolys; mp_index++) {
+    ASSERT_NEAR(dot_v3v3(loopnors[mp_index * 3 + 2], up), 1.0f, 1e-4f);
+  }
+
+  printf("\t%d loops around a single vertex: %fs, with spaces: %fs on average over %d runs\n",
+         numPolys,
+         timing / NUM_RUN_AVERAGED,
+         spaces_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  MEM_freeN(loopnors);
+}
@@ -0,0 +1,48 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "BLI_mmap.h"
+}
+
+#ifndef WIN32
+
+TEST(mmap, ReadWithinFile)
+{
+  FILE *fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  const char data[] = "Hello, memory mapped world!";
+  fwrite(data, 1, sizeof(data), fp);
+  fflush(fp);
+
+  BLI_mmap_file *file = BLI_mmap_open(fileno(fp));
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(BLI_mmap_get_length(file), sizeof(data));
+  EXPECT_EQ(memcmp(BLI_mmap_get_pointer(file), data, sizeof(data)), 0);
+
+  char buf[sizeof(data)];
+  EXPECT_TRUE(BLI_mmap_read(file, buf, 7, 6));
+  EXPECT_EQ(memcmp(buf, "memory", 6), 0);
+
+  /* Reading past the end fails. */
+  EXPECT_FALSE(BLI_mmap_read(file, buf, 7, sizeof(data)));
+  EXPECT_FALSE(BLI_mmap_any_io_error(file));
+
+  BLI_mmap_free(file);
+  fclose(fp);
+}
+
+TEST(mmap, EmptyFile)
+{
+  FILE *fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  /* Nothing to map. */
+  EXPECT_EQ(BLI_mmap_open(fileno(fp)), nullptr);
+  fclose(fp);
+}
+
+#endif
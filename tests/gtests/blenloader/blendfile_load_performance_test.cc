@@ -0,0 +1,135 @@
+/* Apache License, Version 2.0 */
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BKE_appdir.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_customdata.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_scene.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_ID.h"
+#include "DNA_mesh_types.h"
+#include "DNA_object_types.h"
+
+#include "PIL_time.h"
+}
+
+#define NUM_RUN_AVERAGED 5
+
+/* Grid size of the synthetic meshes, large enough for the data of each mesh to be read on
+ * multiple threads (see `DATAMAP_PARALLEL_MIN_SIZE` in `readfile.c`). */
+#define MESH_GRID_SIZE 64
+
+class BlendfileLoadingPerformanceTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+
+  /* Add an ID created without a main, ensuring unique names is quadratic when adding that many
+   * IDs. */
+  static void main_add_id_nomain(ListBase *lb, ID *id, const char *prefix, const int index)
+  {
+    BLI_snprintf(id->name + 2, sizeof(id->name) - 2, "%s.%06d", prefix, index);
+    id->tag &= ~(LIB_TAG_NO_MAIN | LIB_TAG_NO_USER_REFCOUNT);
+    BLI_addtail(lb, id);
+  }
+
+  /* A grid of quads, with UVs. Topology is left zeroed, only the amount of data matters. */
+  static Mesh *mesh_grid_new()
+  {
+    const int verts_len = (MESH_GRID_SIZE + 1) * (MESH_GRID_SIZE + 1);
+    const int edges_len = 2 * MESH_GRID_SIZE * (MESH_GRID_SIZE + 1);
+    const int polys_len = MESH_GRID_SIZE * MESH_GRID_SIZE;
+    Mesh *mesh = BKE_mesh_new_nomain(verts_len, edges_len, 0, polys_len * 4, polys_len);
+    CustomData_add_layer(&mesh->ldata, CD_MLOOPUV, CD_CALLOC, NULL, mesh->totloop);
+    BKE_mesh_update_customdata_pointers(mesh, false);
+    return mesh;
+  }
+
+  /* Write a file with a scene, `num_ids` empty objects and `num_meshes` meshes to the temporary
+   * directory. */
+  bool write_synthetic_file(const int num_ids, const int num_meshes, const bool compress)
+  {
+    BKE_tempdir_init(NULL);
+    BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), "synthetic.blend");
+
+    Main *bmain = BKE_main_new();
+    BKE_scene_add(bmain, "Scene");
+    for (int i = 0; i < num_ids; i++) {
+      ID *id = static_cast<ID *>(BKE_id_new_nomain(ID_OB, NULL));
+      main_add_id_nomain(&bmain->objects, id, "Empty", i);
+    }
+    for (int i = 0; i < num_meshes; i++) {
+      main_add_id_nomain(&bmain->meshes, &mesh_grid_new()->id, "Mesh", i);
+    }
+
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    const bool ok = BLO_write_file(
+        bmain, filepath, compress ? G_FILE_COMPRESS : 0, &params, NULL);
+    BKE_main_free(bmain);
+    return ok;
+  }
+
+  void load_synthetic_file(const int num_ids, const int num_meshes, const bool compress)
+  {
+    ASSERT_TRUE(write_synthetic_file(num_ids, num_meshes, compress));
+
+    double averaged_timing = 0.0;
+    for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+      const double init_time = PIL_check_seconds_timer();
+      bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, NULL);
+      averaged_timing += PIL_check_seconds_timer() - init_time;
+
+      ASSERT_NE(bfile, nullptr);
+      EXPECT_EQ(BLI_listbase_count(&bfile->main->objects), num_ids);
+      EXPECT_EQ(BLI_listbase_count(&bfile->main->meshes), num_meshes);
+      blendfile_free();
+    }
+
+    printf("\t%d IDs, %d meshes%s: loaded in %fs on average over %d runs\n",
+           num_ids,
+           num_meshes,
+           compress ? " (compressed)" : "",
+           averaged_timing / NUM_RUN_AVERAGED,
+           NUM_RUN_AVERAGED);
+
+    BLI_delete(filepath, false, false);
+  }
+};
+
+TEST_F(BlendfileLoadingPerformanceTest, Load10kIDs)
+{
+  load_synthetic_file(10000, 0, false);
+}
+
+TEST_F(BlendfileLoadingPerformanceTest, Load100kIDs)
+{
+  load_synthetic_file(100000, 0, false);
+}
+
+TEST_F(BlendfileLoadingPerformanceTest, Load100kIDsCompressed)
+{
+  load_synthetic_file(100000, 0, true);
+}
+
+TEST_F(BlendfileLoadingPerformanceTest, Load500Meshes)
+{
+  load_synthetic_file(0, 500, false);
+}
+
+TEST_F(BlendfileLoadingPerformanceTest, Load500MeshesCompressed)
+{
+  load_synthetic_file(0, 500, true);
+}
@@ -0,0 +1,35 @@
+/* Apache License, Version 2.0 */
+#include "COM_row_execution_test_base.h"
+
+#define NUM_RUN_AVERAGED 5
+
+/* 4K UHD, the resolution of the multilayer EXR renders this is meant to represent. */
+#define IMAGE_WIDTH 3840
+#define IMAGE_HEIGHT 2160
+
+class CompositorRowExecutionPerformanceTest : public CompositorRowExecutionTestBase {
+};
+
+TEST_F(CompositorRowExecutionPerformanceTest, PassRecombination)
+{
+  build_pass_recombination(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+  const size_t num_floats = (size_t)IMAGE_WIDTH * IMAGE_HEIGHT * COM_NUM_CHANNELS_COLOR;
+  float *result = (float *)MEM_mallocN(sizeof(float) * num_floats, __func__);
+
+  double pixel_timing = 0.0;
+  double row_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    pixel_timing += execute_per_pixel(result);
+    row_timing += execute_rows(result);
+  }
+
+  printf("\t%dx%d: per pixel %fs, rows %fs on average over %d runs\n",
+         IMAGE_WIDTH,
+         IMAGE_HEIGHT,
+         pixel_timing / NUM_RUN_AVERAGED,
+         row_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  MEM_freeN(result);
+}
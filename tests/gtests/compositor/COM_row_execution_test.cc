@@ -0,0 +1,28 @@
+/* Apache License, Version 2.0 */
+#include "COM_row_execution_test_base.h"
+
+/* Not a multiple of #COM_ROW_WIDTH_MAX, so the last row of each line is partial. */
+#define IMAGE_WIDTH 1000
+#define IMAGE_HEIGHT 64
+
+class CompositorRowExecutionTest : public CompositorRowExecutionTestBase {
+};
+
+TEST_F(CompositorRowExecutionTest, PassRecombination)
+{
+  build_pass_recombination(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+  const size_t num_floats = (size_t)IMAGE_WIDTH * IMAGE_HEIGHT * COM_NUM_CHANNELS_COLOR;
+  float *pixel_result = (float *)MEM_mallocN(sizeof(float) * num_floats, __func__);
+  float *row_result = (float *)MEM_mallocN(sizeof(float) * num_floats, __func__);
+
+  execute_per_pixel(pixel_result);
+  execute_rows(row_result);
+
+  for (size_t i = 0; i < num_floats; i++) {
+    ASSERT_NEAR(pixel_result[i], row_result[i], 1e-6f);
+  }
+
+  MEM_freeN(pixel_result);
+  MEM_freeN(row_result);
+}
@@ -0,0 +1,169 @@
+/* Apache License, Version 2.0 */
+#ifndef __COM_ROW_EXECUTION_TEST_BASE_H__
+#define __COM_ROW_EXECUTION_TEST_BASE_H__
+
+#include "testing/testing.h"
+
+#include <string.h>
+#include <vector>
+
+#include "COM_MixOperation.h"
+#include "COM_NodeOperation.h"
+#include "COM_SetColorOperation.h"
+#include "COM_SetValueOperation.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_math_base.h"
+#include "BLI_rand.h"
+
+#include "PIL_time.h"
+}
+
+/**
+ * Color pass of a render layer, standing in for a multilayer EXR pass read by the
+ * Image or Render Layers nodes without the file I/O, so only execution is measured.
+ */
+class PassOperation : public NodeOperation {
+ private:
+  float *m_buffer;
+  int m_width;
+
+ public:
+  PassOperation(RNG *rng, const int width, const int height) : NodeOperation()
+  {
+    this->m_width = width;
+    this->addOutputSocket(COM_DT_COLOR);
+    unsigned int resolution[2] = {(unsigned int)width, (unsigned int)height};
+    this->setResolution(resolution);
+
+    const size_t num_floats = (size_t)width * height * COM_NUM_CHANNELS_COLOR;
+    this->m_buffer = (float *)MEM_mallocN(sizeof(float) * num_floats, __func__);
+    for (size_t i = 0; i < num_floats; i++) {
+      this->m_buffer[i] = BLI_rng_get_float(rng);
+    }
+  }
+
+  ~PassOperation()
+  {
+    MEM_freeN(this->m_buffer);
+  }
+
+  void executePixelSampled(float output[4], float x, float y, PixelSampler /*sampler*/)
+  {
+    const size_t offset = ((size_t)y * this->m_width + (size_t)x) * COM_NUM_CHANNELS_COLOR;
+    copy_v4_v4(output, &this->m_buffer[offset]);
+  }
+
+  void executeRow(float *output, int x, int y, int width)
+  {
+    const size_t offset = ((size_t)y * this->m_width + (size_t)x) * COM_NUM_CHANNELS_COLOR;
+    memcpy(output, &this->m_buffer[offset], sizeof(float) * COM_NUM_CHANNELS_COLOR * width);
+  }
+};
+
+class CompositorRowExecutionTestBase : public testing::Test {
+ protected:
+  int width = 0;
+  int height = 0;
+  std::vector<NodeOperation *> operations;
+  NodeOperation *output_operation = nullptr;
+
+  void TearDown() override
+  {
+    for (NodeOperation *operation : operations) {
+      operation->deinitExecution();
+      delete operation;
+    }
+    operations.clear();
+  }
+
+  template<typename T> T *add_operation(T *operation)
+  {
+    operations.push_back(operation);
+    return operation;
+  }
+
+  NodeOperation *add_mix(MixBaseOperation *mix,
+                         NodeOperation *factor,
+                         NodeOperation *color1,
+                         NodeOperation *color2)
+  {
+    add_operation(mix);
+    mix->getInputSocket(0)->setLink(factor->getOutputSocket());
+    mix->getInputSocket(1)->setLink(color1->getOutputSocket());
+    mix->getInputSocket(2)->setLink(color2->getOutputSocket());
+    return mix;
+  }
+
+  /**
+   * Build the usual pass recombination chain of a multilayer render:
+   * `(diffuse_direct * diffuse_color) + (glossy_direct * glossy_color) + emission`,
+   * followed by a clamped blend with a constant color.
+   */
+  void build_pass_recombination(const int image_width, const int image_height)
+  {
+    width = image_width;
+    height = image_height;
+
+    RNG *rng = BLI_rng_new(0);
+    NodeOperation *diffuse_direct = add_operation(new PassOperation(rng, width, height));
+    NodeOperation *diffuse_color = add_operation(new PassOperation(rng, width, height));
+    NodeOperation *glossy_direct = add_operation(new PassOperation(rng, width, height));
+    NodeOperation *glossy_color = add_operation(new PassOperation(rng, width, height));
+    NodeOperation *emission = add_operation(new PassOperation(rng, width, height));
+    BLI_rng_free(rng);
+
+    SetValueOperation *one = add_operation(new SetValueOperation());
+    one->setValue(1.0f);
+    SetValueOperation *half = add_operation(new SetValueOperation());
+    half->setValue(0.5f);
+    SetColorOperation *tint = add_operation(new SetColorOperation());
+    const float tint_color[4] = {1.0f, 0.8f, 0.6f, 1.0f};
+    tint->setChannels(tint_color);
+
+    NodeOperation *diffuse = add_mix(
+        new MixMultiplyOperation(), one, diffuse_direct, diffuse_color);
+    NodeOperation *glossy = add_mix(new MixMultiplyOperation(), one, glossy_direct, glossy_color);
+    NodeOperation *combined = add_mix(new MixAddOperation(), one, diffuse, glossy);
+    combined = add_mix(new MixAddOperation(), one, combined, emission);
+
+    MixBlendOperation *blend = new MixBlendOperation();
+    blend->setUseClamp(true);
+    output_operation = add_mix(blend, half, combined, tint);
+
+    for (NodeOperation *operation : operations) {
+      operation->initExecution();
+    }
+  }
+
+  double execute_per_pixel(float *buffer)
+  {
+    const double init_time = PIL_check_seconds_timer();
+    float *pixel = buffer;
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        output_operation->readSampled(pixel, x, y, COM_PS_NEAREST);
+        pixel += COM_NUM_CHANNELS_COLOR;
+      }
+    }
+    return PIL_check_seconds_timer() - init_time;
+  }
+
+  double execute_rows(float *buffer)
+  {
+    const double init_time = PIL_check_seconds_timer();
+    float *row = buffer;
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x += COM_ROW_WIDTH_MAX) {
+        const int width = min_ii(COM_ROW_WIDTH_MAX, width - x);
+        output_operation->readRow(row, x, y, width);
+        row += COM_NUM_CHANNELS_COLOR * width;
+      }
+    }
+    return PIL_check_seconds_timer() - init_time;
+  }
+};
+
+#endif /* __COM_ROW_EXECUTION_TEST_BASE_H__ */
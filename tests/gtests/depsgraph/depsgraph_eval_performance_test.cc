@@ -0,0 +1,120 @@
+/* Apache License, Version 2.0 */
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BKE_appdir.h"
+#include "BKE_layer.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_scene.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DEG_depsgraph.h"
+
+#include "DNA_collection_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "PIL_time.h"
+}
+
+#define NUM_RUN_AVERAGED 5
+
+class DepsgraphEvalPerformanceTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+
+  /* Write a file with a scene containing `num_objects` empty objects, parented in chains of
+   * `chain_len` objects, to the temporary directory. */
+  bool write_synthetic_file(const int num_objects, const int chain_len)
+  {
+    BKE_tempdir_init(NULL);
+    BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), "depsgraph.blend");
+
+    Main *bmain = BKE_main_new();
+    Scene *scene = BKE_scene_add(bmain, "Scene");
+    Collection *collection = scene->master_collection;
+
+    Object *parent = NULL;
+    for (int i = 0; i < num_objects; i++) {
+      char name[MAX_ID_NAME - 2];
+      BLI_snprintf(name, sizeof(name), "Empty.%06d", i);
+      /* Add without a main, ensuring unique names is quadratic when adding that many IDs. */
+      Object *ob = static_cast<Object *>(BKE_id_new_nomain(ID_OB, name));
+      ob->id.tag &= ~(LIB_TAG_NO_MAIN | LIB_TAG_NO_USER_REFCOUNT);
+      BLI_addtail(&bmain->objects, ob);
+
+      ob->parent = (i % chain_len != 0) ? parent : NULL;
+      ob->loc[0] = 0.1f;
+      parent = ob;
+
+      /* Link directly, syncing the view layer for every object is quadratic as well. */
+      CollectionObject *cob = static_cast<CollectionObject *>(
+          MEM_callocN(sizeof(CollectionObject), __func__));
+      cob->ob = ob;
+      BLI_addtail(&collection->gobject, cob);
+      id_us_plus(&ob->id);
+    }
+    BKE_main_collection_sync(bmain);
+
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    const bool ok = BLO_write_file(bmain, filepath, 0, &params, NULL);
+    BKE_main_free(bmain);
+    return ok;
+  }
+
+  void evaluate_synthetic_file(const int num_objects, const int chain_len)
+  {
+    ASSERT_TRUE(write_synthetic_file(num_objects, chain_len));
+
+    bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, NULL);
+    ASSERT_NE(bfile, nullptr);
+    ASSERT_EQ(BLI_listbase_count(&bfile->main->objects), num_objects);
+
+    /* Builds the depsgraph and does the initial evaluation. */
+    depsgraph_create(DAG_EVAL_VIEWPORT);
+
+    double averaged_timing = 0.0;
+    for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+      LISTBASE_FOREACH (Object *, ob, &bfile->main->objects) {
+        DEG_graph_id_tag_update(bfile->main, depsgraph, &ob->id, ID_RECALC_TRANSFORM);
+      }
+
+      const double init_time = PIL_check_seconds_timer();
+      BKE_scene_graph_update_tagged(depsgraph, bfile->main);
+      averaged_timing += PIL_check_seconds_timer() - init_time;
+    }
+
+    printf("\t%d objects in chains of %d: evaluated in %fs on average over %d runs\n",
+           num_objects,
+           chain_len,
+           averaged_timing / NUM_RUN_AVERAGED,
+           NUM_RUN_AVERAGED);
+
+    BLI_delete(filepath, false, false);
+  }
+};
+
+TEST_F(DepsgraphEvalPerformanceTest, Evaluate10kObjects)
+{
+  evaluate_synthetic_file(10000, 1);
+}
+
+TEST_F(DepsgraphEvalPerformanceTest, Evaluate10kObjectsChained)
+{
+  evaluate_synthetic_file(10000, 10);
+}
+
+TEST_F(DepsgraphEvalPerformanceTest, Evaluate10kObjectsLongChains)
+{
+  evaluate_synthetic_file(10000, 1000);
+}
@@ -0,0 +1,234 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Benchmark comparing noise per unit of render time in Cycles, with and without
+# the light tree, for a procedurally generated scene with many small lights.
+#
+# The error of each render is measured against a high sample count reference.
+# Efficiency is reported as 1 / (MSE * time), higher is better.
+#
+# Usage:
+#   blender -b --factory-startup --python tests/python/cycles_light_tree_benchmark.py -- \
+#       --lights 2000 --samples 16 32 64 --reference-samples 2048
+
+import argparse
+import os
+import random
+import sys
+import tempfile
+import time
+
+import bpy
+import numpy as np
+
+
+def parse_arguments():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+
+    parser = argparse.ArgumentParser(description="Cycles light tree benchmark")
+    parser.add_argument("--lights", type=int, default=1000,
+                        help="Number of emissive quads, a quarter as many point lights are added")
+    parser.add_argument("--samples", type=int, nargs="+", default=[16, 32, 64, 128])
+    parser.add_argument("--reference-samples", type=int, default=2048)
+    parser.add_argument("--resolution", type=int, default=320)
+    parser.add_argument("--device", default="CPU", choices=("CPU", "GPU"))
+    parser.add_argument("--seed", type=int, default=0)
+    return parser.parse_args(argv)
+
+
+def clear_scene():
+    for obj in list(bpy.data.objects):
+        bpy.data.objects.remove(obj, do_unlink=True)
+    for collection in (bpy.data.meshes, bpy.data.materials, bpy.data.lights, bpy.data.cameras):
+        for datablock in list(collection):
+            collection.remove(datablock)
+
+
+def emission_material(name, color, strength):
+    material = bpy.data.materials.new(name)
+    material.use_nodes = True
+    nodes = material.node_tree.nodes
+    nodes.clear()
+
+    emission = nodes.new("ShaderNodeEmission")
+    emission.inputs["Color"].default_value = color + (1.0,)
+    emission.inputs["Strength"].default_value = strength
+    output = nodes.new("ShaderNodeOutputMaterial")
+    material.node_tree.links.new(emission.outputs["Emission"], output.inputs["Surface"])
+    return material
+
+
+def diffuse_material(name, color):
+    material = bpy.data.materials.new(name)
+    material.use_nodes = True
+    bsdf = material.node_tree.nodes["Principled BSDF"]
+    bsdf.inputs["Base Color"].default_value = color + (1.0,)
+    bsdf.inputs["Roughness"].default_value = 0.5
+    return material
+
+
+def add_mesh(name, verts, faces, materials, material_indices=None):
+    mesh = bpy.data.meshes.new(name)
+    mesh.from_pydata(verts, [], faces)
+    for material in materials:
+        mesh.materials.append(material)
+    if material_indices:
+        mesh.polygons.foreach_set("material_index", material_indices)
+    mesh.update()
+
+    obj = bpy.data.objects.new(name, mesh)
+    bpy.context.scene.collection.objects.link(obj)
+    return obj
+
+
+def build_scene(args):
+    """
+    City at night: blocks of buildings on a ground plane, covered in small
+    windows of random colors and lit by street lights.
+    """
+    rng = random.Random(args.seed)
+    clear_scene()
+
+    scene = bpy.context.scene
+    size = 40.0
+
+    # Ground and buildings.
+    verts = [(-size, -size, 0.0), (size, -size, 0.0), (size, size, 0.0), (-size, size, 0.0)]
+    faces = [(0, 1, 2, 3)]
+    buildings = []
+    for _ in range(64):
+        x, y = rng.uniform(-size, size), rng.uniform(-size, size)
+        w, d, h = rng.uniform(1.0, 4.0), rng.uniform(1.0, 4.0), rng.uniform(2.0, 12.0)
+        buildings.append((x, y, w, d, h))
+        base = len(verts)
+        for z in (0.0, h):
+            verts += [(x - w, y - d, z), (x + w, y - d, z), (x + w, y + d, z), (x - w, y + d, z)]
+        faces += [
+            (base + 0, base + 1, base + 5, base + 4),
+            (base + 1, base + 2, base + 6, base + 5),
+            (base + 2, base + 3, base + 7, base + 6),
+            (base + 3, base + 0, base + 4, base + 7),
+            (base + 4, base + 5, base + 6, base + 7),
+        ]
+    add_mesh("City", verts, faces, [diffuse_material("Concrete", (0.5, 0.5, 0.5))])
+
+    # Windows, small emissive quads slightly in front of the building walls.
+    palette = [(1.0, 0.8, 0.5), (0.6, 0.8, 1.0), (1.0, 0.4, 0.3), (0.5, 1.0, 0.6)]
+    materials = [emission_material("Window%d" % i, color, 20.0) for i, color in enumerate(palette)]
+    verts = []
+    faces = []
+    material_indices = []
+    for _ in range(args.lights):
+        x, y, w, d, h = rng.choice(buildings)
+        z = rng.uniform(0.5, h - 0.5)
+        side = rng.randrange(4)
+        offset = 0.01
+        half = 0.2
+        if side < 2:
+            wall_y = y - d - offset if side == 0 else y + d + offset
+            cx = rng.uniform(x - w + half, x + w - half)
+            quad = [(cx - half, wall_y, z - half), (cx + half, wall_y, z - half),
+                    (cx + half, wall_y, z + half), (cx - half, wall_y, z + half)]
+        else:
+            wall_x = x - w - offset if side == 2 else x + w + offset
+            cy = rng.uniform(y - d + half, y + d - half)
+            quad = [(wall_x, cy - half, z - half), (wall_x, cy + half, z - half),
+                    (wall_x, cy + half, z + half), (wall_x, cy - half, z + half)]
+        base = len(verts)
+        verts += quad
+        faces.append((base, base + 1, base + 2, base + 3))
+        material_indices.append(rng.randrange(len(materials)))
+    add_mesh("Windows", verts, faces, materials, material_indices)
+
+    # Street lights.
+    for i in range(max(args.lights // 4, 1)):
+        light = bpy.data.lights.new("Street%d" % i, 'POINT')
+        light.energy = rng.uniform(50.0, 200.0)
+        light.color = rng.choice(palette)
+        light.shadow_soft_size = 0.1
+        obj = bpy.data.objects.new(light.name, light)
+        obj.location = (rng.uniform(-size, size), rng.uniform(-size, size), 0.5)
+        scene.collection.objects.link(obj)
+
+    # Camera looking over the city.
+    camera = bpy.data.cameras.new("Camera")
+    camera_object = bpy.data.objects.new("Camera", camera)
+    camera_object.location = (0.0, -size * 1.2, 25.0)
+    camera_object.rotation_euler = (1.05, 0.0, 0.0)
+    scene.collection.objects.link(camera_object)
+    scene.camera = camera_object
+
+    scene.world = bpy.data.worlds.new("World")
+    scene.world.color = (0.0, 0.0, 0.0)
+
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = args.resolution
+    scene.render.resolution_y = args.resolution
+    scene.render.resolution_percentage = 100
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.render.image_settings.color_depth = '32'
+    scene.cycles.device = args.device
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.max_bounces = 2
+    scene.cycles.use_denoising = False
+    scene.cycles.use_adaptive_sampling = False
+    scene.cycles.light_sampling_threshold = 0.0
+    scene.cycles.seed = args.seed
+
+
+def render(filepath, samples, use_light_tree):
+    scene = bpy.context.scene
+    scene.cycles.samples = samples
+    scene.cycles.use_light_tree = use_light_tree
+    scene.render.filepath = filepath
+
+    start_time = time.time()
+    bpy.ops.render.render(write_still=True)
+    elapsed = time.time() - start_time
+
+    image = bpy.data.images.load(filepath)
+    pixels = np.array(image.pixels[:], dtype=np.float64).reshape(-1, 4)[:, :3]
+    bpy.data.images.remove(image)
+    return elapsed, pixels
+
+
+def main():
+    args = parse_arguments()
+    build_scene(args)
+
+    with tempfile.TemporaryDirectory() as directory:
+        print("Rendering reference with %d samples..." % args.reference_samples)
+        _, reference = render(os.path.join(directory, "reference.exr"),
+                              args.reference_samples, True)
+
+        print("")
+        print("%-10s %8s %10s %12s %14s" % ("Method", "Samples", "Time (s)", "RMSE", "1/(MSE*s)"))
+        for samples in args.samples:
+            for use_light_tree in (False, True):
+                filepath = os.path.join(directory, "render.exr")
+                elapsed, pixels = render(filepath, samples, use_light_tree)
+                mse = float(np.mean((pixels - reference) ** 2))
+                efficiency = 1.0 / (mse * elapsed) if mse > 0.0 else float("inf")
+                print("%-10s %8d %10.3f %12.6f %14.3f" % (
+                    "Tree" if use_light_tree else "Flat", samples, elapsed, mse ** 0.5, efficiency))
+
+
+if __name__ == "__main__":
+    main()